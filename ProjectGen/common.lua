@@ -49,6 +49,10 @@ function CommonSetup (architecture, solutionName, extraDefines)
   symbols "On"
   editandcontinue "Off"
 
+  -- float8 and the batched kernels built on it (ibl and sobol batches, triangle batches) only use AVX2 when the compiler
+  -- targets it. Without this every project builds their SSE fallbacks.
+  vectorextensions "AVX2"
+
   location(ProjectsTempDir .. solutionName)
 
   projectRootDef = "ProjectRootName_=\"" .. RootDirectoryName .. "\""
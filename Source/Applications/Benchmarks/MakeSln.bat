@@ -0,0 +1,8 @@
+@echo off
+
+echo.
+echo "Generating Win64 Benchmarks..."
+rd /s /q ..\..\..\_Projects\Benchmarks
+call ..\..\..\Middleware\Premake\premake5.exe vs2017 win64
+
+@echo on
@@ -0,0 +1,185 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "TextureLib/TextureFiltering.h"
+#include "UtilityLib/QuickSort.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatStructs.h"
+#include "ThreadingLib/JobSystem.h"
+#include "StringLib/StringUtil.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/MinMax.h"
+
+namespace Selas
+{
+    static volatile float  consumedFloats = 0.0f;
+    static volatile uint64 consumedIntegers = 0;
+
+    //=============================================================================================================================
+    void Benchmark_Consume(float value)
+    {
+        consumedFloats = consumedFloats + value;
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Consume(uint64 value)
+    {
+        consumedIntegers = consumedIntegers + value;
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Initialize(BenchmarkContext* context, const BenchmarkSettings& settings, FILE* output)
+    {
+        context->settings = settings;
+        context->settings.maxRepetitions = Clamp<uint>(settings.maxRepetitions, 1, MaxBenchmarkRepetitions_);
+        context->settings.minRepetitions = Clamp<uint>(settings.minRepetitions, 1, context->settings.maxRepetitions);
+        context->output = output;
+        context->resultCount = 0;
+        context->timestampsPerNanosecond = SystemTime::TimestampsPerMicrosecond() / 1000.0;
+
+        #if Debug_
+            cpointer configuration = "Debug";
+        #else
+            cpointer configuration = "Release";
+        #endif
+
+        fprintf(output, "{\"configuration\":\"%s\",\"jobThreads\":%u,\"timestampsPerMicrosecond\":%.3f,\"benchmarks\":[",
+                configuration, (uint32)JobSystem_ThreadCount(), SystemTime::TimestampsPerMicrosecond());
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Shutdown(BenchmarkContext* context)
+    {
+        fprintf(context->output, "\n]}\n");
+        fflush(context->output);
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Run(BenchmarkContext* context, cpointer name, uint64 operationCount, BenchmarkFunction function,
+                       void* userData)
+    {
+        const BenchmarkSettings& settings = context->settings;
+        if(settings.filter != nullptr && StringUtil::FindSubString(name, settings.filter) == nullptr) {
+            return;
+        }
+
+        for(uint scan = 0; scan < settings.warmupRepetitions; ++scan) {
+            function(userData);
+        }
+
+        uint64 elapsed[MaxBenchmarkRepetitions_];
+        uint64 totalElapsed = 0;
+        uint64 minTotalElapsed = (uint64)(settings.minSeconds * 1e9 * context->timestampsPerNanosecond);
+
+        uint32 repetitionCount = 0;
+        while(repetitionCount < settings.maxRepetitions) {
+            uint64 repetition = function(userData);
+            elapsed[repetitionCount++] = repetition;
+            totalElapsed += repetition;
+
+            if(repetitionCount >= settings.minRepetitions && totalElapsed >= minTotalElapsed) {
+                break;
+            }
+        }
+
+        QuickSort(elapsed, repetitionCount);
+
+        // -- The median and its absolute deviation rather than the mean and standard deviation so that the odd repetition
+        // -- that was interrupted does not move the numbers
+        uint64 median = elapsed[repetitionCount / 2];
+        uint64 deviations[MaxBenchmarkRepetitions_];
+        for(uint scan = 0; scan < repetitionCount; ++scan) {
+            deviations[scan] = elapsed[scan] > median ? elapsed[scan] - median : median - elapsed[scan];
+        }
+        QuickSort(deviations, repetitionCount);
+
+        double toNsPerOp = 1.0 / (context->timestampsPerNanosecond * (double)Max<uint64>(operationCount, 1));
+        double minNs = elapsed[0] * toNsPerOp;
+        double medianNs = median * toNsPerOp;
+        double meanNs = (totalElapsed * toNsPerOp) / repetitionCount;
+        double maxNs = elapsed[repetitionCount - 1] * toNsPerOp;
+        double noise = median > 0 ? (double)deviations[repetitionCount / 2] / (double)median : 0.0;
+        double operationsPerSecond = medianNs > 0.0 ? 1e9 / medianNs : 0.0;
+
+        fprintf(context->output, "%s\n{\"name\":\"%s\",\"operations\":%llu,\"repetitions\":%u,\"minNs\":%.3f,\"medianNs\":%.3f,"
+                                 "\"meanNs\":%.3f,\"maxNs\":%.3f,\"noise\":%.4f,\"operationsPerSecond\":%.1f}",
+                context->resultCount == 0 ? "" : ",", name, operationCount, repetitionCount, minNs, medianNs, meanNs, maxNs,
+                noise, operationsPerSecond);
+        fflush(context->output);
+        ++context->resultCount;
+
+        WriteDebugInfo_("%-36s %12.3f ns/op  min %12.3f  noise %5.2f%%  (%u x %llu)", name, medianNs, minNs, noise * 100.0,
+                        repetitionCount, operationCount);
+    }
+
+    //=============================================================================================================================
+    void Benchmark_Report(BenchmarkContext* context, cpointer name, const BenchmarkCounter* counters, uint counterCount)
+    {
+        const BenchmarkSettings& settings = context->settings;
+        if(settings.filter != nullptr && StringUtil::FindSubString(name, settings.filter) == nullptr) {
+            return;
+        }
+
+        fprintf(context->output, "%s\n{\"name\":\"%s\",\"counters\":{", context->resultCount == 0 ? "" : ",", name);
+        for(uint scan = 0; scan < counterCount; ++scan) {
+            fprintf(context->output, "%s\"%s\":%llu", scan == 0 ? "" : ",", counters[scan].name, counters[scan].value);
+            WriteDebugInfo_("%-36s %s %llu", name, counters[scan].name, counters[scan].value);
+        }
+        fprintf(context->output, "}}");
+        fflush(context->output);
+        ++context->resultCount;
+    }
+
+    //=============================================================================================================================
+    void Benchmark_CreateTexture(TextureResourceData::TexelLayout layout, uint32 dimension, Random::Pcg32* pcg,
+                                 TextureResourceData* texture)
+    {
+        Memory::Zero(texture, sizeof(TextureResourceData));
+        texture->format = TextureResourceData::Float3;
+        texture->layout = layout;
+
+        uint64 dataSize = 0;
+        uint32 width = dimension;
+        uint32 height = dimension;
+        while(texture->mipCount < TextureResourceData::MaxMipCount) {
+            texture->mipWidths[texture->mipCount] = width;
+            texture->mipHeights[texture->mipCount] = height;
+            texture->mipOffsets[texture->mipCount] = dataSize;
+            ++texture->mipCount;
+
+            uint64 texelCount = (uint64)width * height;
+            if(layout == TextureResourceData::Tiled4x4) {
+                uint64 tilesX = (width + TextureResourceData::TileDimension - 1) / TextureResourceData::TileDimension;
+                uint64 tilesY = (height + TextureResourceData::TileDimension - 1) / TextureResourceData::TileDimension;
+                texelCount = tilesX * tilesY * TextureResourceData::TileDimension * TextureResourceData::TileDimension;
+            }
+            dataSize += texelCount * sizeof(float3);
+
+            if(width == 1 && height == 1) {
+                break;
+            }
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+
+        texture->dataSize = (uint32)dataSize;
+        texture->texture = AllocArrayAligned_(uint8, dataSize, CacheLineSize_);
+        Memory::Zero(texture->texture, dataSize);
+
+        for(uint32 level = 0; level < texture->mipCount; ++level) {
+            float3* mip = reinterpret_cast<float3*>(texture->texture + texture->mipOffsets[level]);
+            for(int32 t = 0; t < (int32)texture->mipHeights[level]; ++t) {
+                for(int32 s = 0; s < (int32)texture->mipWidths[level]; ++s) {
+                    uint index = TextureFiltering::TexelIndex(layout, texture->mipWidths[level], s, t);
+                    mip[index] = float3(Random::Pcg32Float(pcg), Random::Pcg32Float(pcg), Random::Pcg32Float(pcg));
+                }
+            }
+        }
+    }
+}
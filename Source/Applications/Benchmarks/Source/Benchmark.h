@@ -0,0 +1,89 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/TextureResource.h"
+#include "SystemLib/BasicTypes.h"
+
+#include <stdio.h>
+
+#define MaxBenchmarkRepetitions_ 1024
+
+namespace Selas
+{
+    namespace Random
+    {
+        struct Pcg32;
+    }
+
+    //=============================================================================================================================
+    // -- A repetition runs the benchmark's operations once and returns the timestamps they took. Benchmarks time themselves so
+    // -- anything that has to be restored between repetitions can be left out of the measurement.
+    //=============================================================================================================================
+    typedef uint64 (*BenchmarkFunction)(void* userData);
+
+    struct BenchmarkSettings
+    {
+        // -- Only benchmarks with the filter somewhere in their name are run. Null runs all of them.
+        cpointer filter;
+        uint     warmupRepetitions;
+        uint     minRepetitions;
+        uint     maxRepetitions;
+        // -- Past minRepetitions keep going until this much time has been measured
+        float    minSeconds;
+    };
+
+    struct BenchmarkContext
+    {
+        BenchmarkSettings settings;
+        FILE*  output;
+        uint   resultCount;
+        double timestampsPerNanosecond;
+    };
+
+    // -- Results are written to output as a single JSON object and a summary of each is logged as it finishes
+    void Benchmark_Initialize(BenchmarkContext* context, const BenchmarkSettings& settings, FILE* output);
+    void Benchmark_Shutdown(BenchmarkContext* context);
+
+    void Benchmark_Run(BenchmarkContext* context, cpointer name, uint64 operationCount, BenchmarkFunction function,
+                       void* userData);
+
+    // -- Counts that go with a benchmark's timings, such as how much of its work crossed NUMA nodes. They are written to output
+    // -- as an entry of their own with a counters object in place of the timings.
+    struct BenchmarkCounter
+    {
+        cpointer name;
+        uint64   value;
+    };
+
+    void Benchmark_Report(BenchmarkContext* context, cpointer name, const BenchmarkCounter* counters, uint counterCount);
+
+    // -- Results passed here are folded into a volatile so the compiler cannot throw away the work that produced them
+    void Benchmark_Consume(float value);
+    void Benchmark_Consume(uint64 value);
+
+    // -- Random Float3 texels in every mip down to 1x1. The texels are freed with FreeAligned_.
+    void Benchmark_CreateTexture(TextureResourceData::TexelLayout layout, uint32 dimension, Random::Pcg32* pcg,
+                                 TextureResourceData* texture);
+
+    //=============================================================================================================================
+    // -- Suites. Each one builds its synthetic data from a fixed seed so every run measures the same work.
+    //=============================================================================================================================
+    void RunShadingBenchmarks(BenchmarkContext* context);
+    void RunPathShadingBenchmarks(BenchmarkContext* context);
+    void RunTextureBenchmarks(BenchmarkContext* context);
+    void RunLightingBenchmarks(BenchmarkContext* context);
+    void RunSortingBenchmarks(BenchmarkContext* context);
+    void RunHashGridBenchmarks(BenchmarkContext* context);
+    void RunIoBenchmarks(BenchmarkContext* context);
+    void RunFramebufferBenchmarks(BenchmarkContext* context);
+    void RunBatcherBenchmarks(BenchmarkContext* context);
+
+    //=============================================================================================================================
+    // -- Validation. Batched kernels are compared against the scalar code they mirror before anything is timed. Each returns
+    // -- false when any lane differs.
+    //=============================================================================================================================
+    bool ValidateBatchedBsdfs();
+}
@@ -0,0 +1,165 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "Shading/PathTracingBatcher.h"
+#include "ThreadingLib/JobSystem.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatFuncs.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/CountOf.h"
+#include "SystemLib/SystemTime.h"
+
+#define BatcherRayCount_          4096
+#define BatcherRaysPerKernel_     (64 * 1024)
+#define BatcherBatchCapacity_     (16 * 1024)
+// -- Kernels claim a batch every so often while adding the way path tracer kernels trace batches in between shading
+#define BatcherClaimInterval_     1024
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct BatcherBenchmarkData
+    {
+        OcclusionRay* rays;
+        PathTracingBatcher* batcher;
+        bool nodeQueues;
+
+        uint64 localEntries;
+        uint64 remoteEntries;
+    };
+
+    //=============================================================================================================================
+    static void CreateBatcherData(BatcherBenchmarkData* data)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 5);
+
+        // -- Directions over the whole sphere so every ray category gets filled
+        data->rays = AllocArray_(OcclusionRay, BatcherRayCount_);
+        for(uint scan = 0; scan < BatcherRayCount_; ++scan) {
+            float3 origin = float3(1000.0f * Random::Pcg32Float(&pcg), 200.0f * Random::Pcg32Float(&pcg),
+                                   1000.0f * Random::Pcg32Float(&pcg));
+            float3 direction = float3(Random::Pcg32Float(&pcg) - 0.5f, Random::Pcg32Float(&pcg) - 0.5f,
+                                      Random::Pcg32Float(&pcg) - 0.5f);
+
+            OcclusionRay& ray = data->rays[scan];
+            Memory::Zero(&ray, sizeof(ray));
+            ray.ray = MakeRay(origin, Normalize(direction));
+            ray.distance = 100.0f * Random::Pcg32Float(&pcg);
+            ray.value = float3::One_;
+            ray.index = (uint32)scan;
+        }
+
+        data->batcher = nullptr;
+    }
+
+    //=============================================================================================================================
+    static bool ConsumeReadyBatch(PathTracingBatcher* batcher)
+    {
+        OcclusionRay* rays;
+        uint rayCount;
+        if(batcher->GetSortedBatch(rays, rayCount) == false) {
+            return false;
+        }
+
+        // -- Stands in for tracing. Reading every ray is what pulls the batch across nodes when it came from another one.
+        float sum = 0.0f;
+        for(uint scan = 0; scan < rayCount; ++scan) {
+            sum += rays[scan].distance;
+        }
+        Benchmark_Consume(sum);
+
+        batcher->FreeRays(rays);
+        return true;
+    }
+
+    //=============================================================================================================================
+    static void BatcherKernel(BatcherBenchmarkData* data)
+    {
+        PathTracingBatcher* batcher = data->batcher;
+
+        uint offset = JobSystem_ThreadIndex() * BatcherClaimInterval_;
+        for(uint scan = 0; scan < BatcherRaysPerKernel_; ++scan) {
+            batcher->AddUnsortedOcclusionRay(data->rays[(offset + scan) % BatcherRayCount_]);
+            if((scan + 1) % BatcherClaimInterval_ == 0) {
+                ConsumeReadyBatch(batcher);
+            }
+        }
+
+        // -- Same stop condition as the deferred path tracer kernels
+        while(batcher->Empty() == false) {
+            if(ConsumeReadyBatch(batcher) == false) {
+                batcher->Flush();
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void BatcherKernels(void* userData, uint start, uint end)
+    {
+        for(uint scan = start; scan < end; ++scan) {
+            BatcherKernel((BatcherBenchmarkData*)userData);
+        }
+    }
+
+    //=============================================================================================================================
+    static uint64 BatcherTrafficBenchmark(void* userData)
+    {
+        BatcherBenchmarkData* data = (BatcherBenchmarkData*)userData;
+
+        PathTracingBatcher batcher;
+        batcher.Initialize(BatcherBatchCapacity_, BatcherBatchCapacity_, data->nodeQueues);
+        data->batcher = &batcher;
+
+        // -- One kernel per thread on the pinned job system workers like the deferred path tracer
+        uint64 start = SystemTime::Timestamp();
+        JobSystem_ParallelFor(JobSystem_ThreadCount(), 1, BatcherKernels, data);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        uint64 localEntries;
+        uint64 remoteEntries;
+        batcher.NodeTraffic(localEntries, remoteEntries);
+        data->localEntries += localEntries;
+        data->remoteEntries += remoteEntries;
+
+        data->batcher = nullptr;
+        batcher.Shutdown();
+
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static void RunBatcherTraffic(BenchmarkContext* context, BatcherBenchmarkData* data, cpointer name, bool nodeQueues)
+    {
+        data->nodeQueues = nodeQueues;
+        data->localEntries = 0;
+        data->remoteEntries = 0;
+
+        uint64 operationCount = (uint64)JobSystem_ThreadCount() * BatcherRaysPerKernel_;
+        Benchmark_Run(context, name, operationCount, BatcherTrafficBenchmark, data);
+
+        // -- Totals over every repetition including the warmups
+        BenchmarkCounter counters[] = {
+            { "nodes", JobSystem_NodeCount() },
+            { "localEntries", data->localEntries },
+            { "remoteEntries", data->remoteEntries }
+        };
+        Benchmark_Report(context, name, counters, CountOf_(counters));
+    }
+
+    //=============================================================================================================================
+    void RunBatcherBenchmarks(BenchmarkContext* context)
+    {
+        BatcherBenchmarkData data;
+        CreateBatcherData(&data);
+
+        RunBatcherTraffic(context, &data, "Batcher/Traffic/NodeQueues", true);
+        RunBatcherTraffic(context, &data, "Batcher/Traffic/SharedQueue", false);
+
+        Free_(data.rays);
+    }
+}
@@ -0,0 +1,91 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "TextureLib/Framebuffer.h"
+#include "MathLib/Random.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/SystemTime.h"
+
+#define FramebufferWidth_        1024
+#define FramebufferHeight_       429
+#define FramebufferSampleCount_  (64 * 1024)
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct FramebufferBenchmarkData
+    {
+        Framebuffer frame;
+        FramebufferWriter writer;
+        uint32* randomPixels;
+        uint32* coherentPixels;
+        uint32* pixels;
+        float3* radiances;
+    };
+
+    //=============================================================================================================================
+    static uint64 FramebufferWriteBenchmark(void* userData)
+    {
+        FramebufferBenchmarkData* data = (FramebufferBenchmarkData*)userData;
+
+        // -- Includes the flushes the writes trigger and the final one since that is where most of the work happens
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < FramebufferSampleCount_; ++scan) {
+            FramebufferWriter_Write(&data->writer, data->radiances[scan], data->pixels[scan]);
+        }
+        FramebufferWriter_Flush(&data->writer);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(data->frame.beauty[0].x);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static void RunFramebufferVariant(BenchmarkContext* context, FramebufferBenchmarkData* data, uint32 flags,
+                                      cpointer randomName, cpointer coherentName)
+    {
+        FrameBuffer_Initialize(&data->frame, FramebufferWidth_, FramebufferHeight_, flags);
+        FramebufferWriter_Initialize(&data->writer, &data->frame);
+
+        data->pixels = data->randomPixels;
+        Benchmark_Run(context, randomName, FramebufferSampleCount_, FramebufferWriteBenchmark, data);
+        data->pixels = data->coherentPixels;
+        Benchmark_Run(context, coherentName, FramebufferSampleCount_, FramebufferWriteBenchmark, data);
+
+        FramebufferWriter_Shutdown(&data->writer);
+        FrameBuffer_Shutdown(&data->frame);
+    }
+
+    //=============================================================================================================================
+    void RunFramebufferBenchmarks(BenchmarkContext* context)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 6);
+
+        FramebufferBenchmarkData data;
+        data.randomPixels = AllocArray_(uint32, FramebufferSampleCount_);
+        data.coherentPixels = AllocArray_(uint32, FramebufferSampleCount_);
+        data.radiances = AllocArray_(float3, FramebufferSampleCount_);
+
+        // -- Shaded hits come back in shading key order so their pixels are scattered over the image. Camera rays from
+        // -- consecutive pixels write a few samples each in scanline order.
+        for(uint scan = 0; scan < FramebufferSampleCount_; ++scan) {
+            data.randomPixels[scan] = Random::Pcg32Uint32(&pcg) % (FramebufferWidth_ * FramebufferHeight_);
+            data.coherentPixels[scan] = (uint32)(scan / 4) % (FramebufferWidth_ * FramebufferHeight_);
+            data.radiances[scan] = float3(Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg));
+        }
+
+        RunFramebufferVariant(context, &data, 0, "Framebuffer/FramebufferWriter_Write/Random",
+                              "Framebuffer/FramebufferWriter_Write/Coherent");
+        RunFramebufferVariant(context, &data, eFixedPointAccumulation | eVarianceAov,
+                              "Framebuffer/FramebufferWriter_Write/FixedPointRandom",
+                              "Framebuffer/FramebufferWriter_Write/FixedPointCoherent");
+
+        Free_(data.radiances);
+        Free_(data.coherentPixels);
+        Free_(data.randomPixels);
+    }
+}
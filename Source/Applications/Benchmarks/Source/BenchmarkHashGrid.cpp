@@ -0,0 +1,118 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "VCMHashGrid.h"
+#include "VCMCommon.h"
+#include "ThreadingLib/JobSystem.h"
+#include "MathLib/Random.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/SystemTime.h"
+
+#define HashGridVertexCount_  (256 * 1024)
+#define HashGridQueryCount_   (64 * 1024)
+#define HashGridRadius_       1.0f
+#define HashGridExtent_       200.0f
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct HashGridBenchmarkData
+    {
+        CArray<VCMVertex> vertices;
+        float3* queries;
+        VCMHashGrid hashGrid;
+        uint threadCount;
+    };
+
+    //=============================================================================================================================
+    struct GatherVerticesFunctor
+    {
+        float sum;
+        uint64 count;
+
+        ForceInline_ void operator()(const VCMVertex& vertex)
+        {
+            sum += vertex.throughput.x;
+            ++count;
+        }
+    };
+
+    //=============================================================================================================================
+    static float3 RandomSurfacePosition(Random::Pcg32* pcg)
+    {
+        // -- Light vertices land on surfaces so spread them over a slightly bumpy ground plane rather than through a volume
+        return float3(HashGridExtent_ * Random::Pcg32Float(pcg), 0.1f * Random::Pcg32Float(pcg),
+                      HashGridExtent_ * Random::Pcg32Float(pcg));
+    }
+
+    //=============================================================================================================================
+    static uint64 BuildHashGridBenchmark(void* userData)
+    {
+        HashGridBenchmarkData* data = (HashGridBenchmarkData*)userData;
+
+        uint64 start = SystemTime::Timestamp();
+        BuildHashGrid(&data->hashGrid, HashGridVertexCount_, HashGridRadius_, data->vertices, data->threadCount);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume((uint64)data->hashGrid.cellRangeEnds[0]);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SearchHashGridBenchmark(void* userData)
+    {
+        HashGridBenchmarkData* data = (HashGridBenchmarkData*)userData;
+
+        GatherVerticesFunctor functor = { 0.0f, 0 };
+
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < HashGridQueryCount_; ++scan) {
+            SearchHashGrid(&data->hashGrid, data->queries[scan], functor);
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(functor.sum);
+        Benchmark_Consume(functor.count);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    void RunHashGridBenchmarks(BenchmarkContext* context)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 4);
+
+        HashGridBenchmarkData data;
+        data.threadCount = Clamp<uint>(JobSystem_ThreadCount(), 1, 64);
+
+        data.vertices.Resize(HashGridVertexCount_);
+        for(uint scan = 0; scan < HashGridVertexCount_; ++scan) {
+            VCMVertex& vertex = data.vertices[scan];
+            Memory::Zero(&vertex, sizeof(vertex));
+            vertex.throughput = float3(Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg));
+            vertex.index = scan;
+            vertex.pathLength = 1 + scan % 4;
+            vertex.surface.position = RandomSurfacePosition(&pcg);
+        }
+
+        data.queries = AllocArray_(float3, HashGridQueryCount_);
+        for(uint scan = 0; scan < HashGridQueryCount_; ++scan) {
+            data.queries[scan] = RandomSurfacePosition(&pcg);
+        }
+
+        Benchmark_Run(context, "HashGrid/BuildHashGrid", HashGridVertexCount_, BuildHashGridBenchmark, &data);
+
+        // -- The search runs against whatever the build benchmark left behind so make sure there is a grid if it was skipped
+        BuildHashGrid(&data.hashGrid, HashGridVertexCount_, HashGridRadius_, data.vertices, data.threadCount);
+        Benchmark_Run(context, "HashGrid/SearchHashGrid", HashGridQueryCount_, SearchHashGridBenchmark, &data);
+
+        ShutdownHashGrid(&data.hashGrid);
+        Free_(data.queries);
+        data.vertices.Shutdown();
+    }
+}
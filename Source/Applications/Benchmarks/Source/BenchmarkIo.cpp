@@ -0,0 +1,229 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "SceneLib/ModelResource.h"
+#include "IoLib/BinaryStreamSerializer.h"
+#include "UtilityLib/MurmurHash.h"
+#include "MathLib/Random.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/CountOf.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+
+#define HashKeyCount_        4096
+#define HashKeyBufferSize_   (1024 * 1024)
+// -- Attaching rewrites the buffer in place so each repetition attaches this many fresh copies
+#define AttachCopyCount_     64
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct HashBenchmarkData
+    {
+        uint8* keys;
+        int32 keySize;
+    };
+
+    //=============================================================================================================================
+    struct AttachBenchmarkData
+    {
+        uint8* serialized;
+        uint serializedSize;
+        uint copyStride;
+        uint8* copies;
+    };
+
+    //=============================================================================================================================
+    static uint64 MurmurHash32Benchmark(void* userData)
+    {
+        HashBenchmarkData* data = (HashBenchmarkData*)userData;
+
+        uint64 sum = 0;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < HashKeyCount_; ++scan) {
+            sum += MurmurHash3_x86_32(data->keys + scan * data->keySize, data->keySize, 0);
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 MurmurHash128Benchmark(void* userData)
+    {
+        HashBenchmarkData* data = (HashBenchmarkData*)userData;
+
+        uint64 sum = 0;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < HashKeyCount_; ++scan) {
+            Hash128 hash = MurmurHash3_x64_128(data->keys + scan * data->keySize, data->keySize, 0);
+            sum += hash.h1 ^ hash.h2;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    template<typename Type_>
+    static void SerializeForAttach(Type_& object, AttachBenchmarkData* data)
+    {
+        SerializeToBinary(object, data->serialized, data->serializedSize);
+
+        // -- Copies keep the 4K alignment SerializeToBinary gives the original
+        data->copyStride = (data->serializedSize + 4095) & ~4095ull;
+        data->copies = AllocArrayAligned_(uint8, data->copyStride * AttachCopyCount_, 4096);
+    }
+
+    //=============================================================================================================================
+    static void ShutdownAttachData(AttachBenchmarkData* data)
+    {
+        FreeAligned_(data->copies);
+        FreeAligned_(data->serialized);
+    }
+
+    //=============================================================================================================================
+    template<typename Type_>
+    static uint64 AttachBenchmark(void* userData)
+    {
+        AttachBenchmarkData* data = (AttachBenchmarkData*)userData;
+
+        for(uint scan = 0; scan < AttachCopyCount_; ++scan) {
+            Memory::Copy(data->copies + scan * data->copyStride, data->serialized, data->serializedSize);
+        }
+
+        uint64 sum = 0;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < AttachCopyCount_; ++scan) {
+            Type_* object;
+            AttachToBinary(object, data->copies + scan * data->copyStride, data->serializedSize);
+            sum += (uint64)object;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static void RunHashBenchmarks(BenchmarkContext* context, Random::Pcg32* pcg)
+    {
+        HashBenchmarkData data;
+        data.keys = AllocArray_(uint8, HashKeyBufferSize_);
+        for(uint scan = 0; scan < HashKeyBufferSize_; ++scan) {
+            data.keys[scan] = (uint8)Random::Pcg32Uint32(pcg);
+        }
+
+        static const int32 keySizes[] = { 16, 64, 256 };
+        static cpointer hash32Names[] = {
+            "Io/MurmurHash3_x86_32/16B",
+            "Io/MurmurHash3_x86_32/64B",
+            "Io/MurmurHash3_x86_32/256B"
+        };
+        static cpointer hash128Names[] = {
+            "Io/MurmurHash3_x64_128/16B",
+            "Io/MurmurHash3_x64_128/64B",
+            "Io/MurmurHash3_x64_128/256B"
+        };
+
+        for(uint scan = 0; scan < CountOf_(keySizes); ++scan) {
+            data.keySize = keySizes[scan];
+            Benchmark_Run(context, hash32Names[scan], HashKeyCount_, MurmurHash32Benchmark, &data);
+            Benchmark_Run(context, hash128Names[scan], HashKeyCount_, MurmurHash128Benchmark, &data);
+        }
+
+        Free_(data.keys);
+    }
+
+    //=============================================================================================================================
+    static void RunAttachBenchmarks(BenchmarkContext* context, Random::Pcg32* pcg)
+    {
+        // -- A model with a few hundred meshes and its geometry. Attach cost depends on the number of pointers not the amount
+        // -- of data so the geometry is kept small.
+        ModelResourceData model;
+        Memory::Zero(&model.aaBox, sizeof(model.aaBox));
+        model.totalVertexCount = 0;
+        model.totalCurveVertexCount = 0;
+        model.curveModelName = 0;
+        model.pad = 0;
+        model.indexSize = model.faceIndexSize = model.positionSize = model.normalsSize = 0;
+        model.tangentsSize = model.uvsSize = model.curveIndexSize = model.curveVertexSize = 0;
+
+        model.cameras.Resize(4);
+        model.textureResourceNames.Resize(32);
+        model.materials.Resize(32);
+        model.materialHashes.Resize(32);
+        model.meshes.Resize(256);
+        model.curves.Resize(16);
+        Memory::Zero(model.cameras.DataPointer(), model.cameras.DataSize());
+        Memory::Zero(model.textureResourceNames.DataPointer(), model.textureResourceNames.DataSize());
+        Memory::Zero(model.materials.DataPointer(), model.materials.DataSize());
+        Memory::Zero(model.curves.DataPointer(), model.curves.DataSize());
+        for(uint scan = 0; scan < model.materialHashes.Count(); ++scan) {
+            model.materialHashes[scan] = Random::Pcg32Uint32(pcg);
+        }
+        for(uint scan = 0; scan < model.meshes.Count(); ++scan) {
+            Memory::Zero(&model.meshes[scan], sizeof(MeshMetaData));
+            model.meshes[scan].materialHash = model.materialHashes[scan % model.materialHashes.Count()];
+        }
+
+        const uint vertexCount = 1024;
+        ModelGeometryData geometry;
+        geometry.indexSize = 3 * vertexCount * sizeof(uint32);
+        geometry.faceIndexSize = vertexCount * sizeof(uint32);
+        geometry.positionSize = vertexCount * sizeof(float3);
+        geometry.normalsSize = vertexCount * sizeof(float3);
+        geometry.tangentsSize = vertexCount * sizeof(float4);
+        geometry.uvsSize = vertexCount * sizeof(float2);
+        geometry.curveIndexSize = 0;
+        geometry.curveVertexSize = 0;
+        geometry.indices = (uint32*)AllocAligned_(geometry.indexSize, ModelResource::kGeometryDataAlignment);
+        geometry.faceIndexCounts = (uint32*)AllocAligned_(geometry.faceIndexSize, ModelResource::kGeometryDataAlignment);
+        geometry.positions = (float3*)AllocAligned_(geometry.positionSize, ModelResource::kGeometryDataAlignment);
+        geometry.normals = (float3*)AllocAligned_(geometry.normalsSize, ModelResource::kGeometryDataAlignment);
+        geometry.tangents = (float4*)AllocAligned_(geometry.tangentsSize, ModelResource::kGeometryDataAlignment);
+        geometry.uvs = (float2*)AllocAligned_(geometry.uvsSize, ModelResource::kGeometryDataAlignment);
+        geometry.curveIndices = nullptr;
+        geometry.curveVertices = nullptr;
+        Memory::Zero(geometry.indices, geometry.indexSize);
+        Memory::Zero(geometry.faceIndexCounts, geometry.faceIndexSize);
+        Memory::Zero(geometry.positions, geometry.positionSize);
+        Memory::Zero(geometry.normals, geometry.normalsSize);
+        Memory::Zero(geometry.tangents, geometry.tangentsSize);
+        Memory::Zero(geometry.uvs, geometry.uvsSize);
+
+        AttachBenchmarkData data;
+
+        SerializeForAttach(model, &data);
+        Benchmark_Run(context, "Io/AttachToBinary/ModelResourceData", AttachCopyCount_,
+                      AttachBenchmark<ModelResourceData>, &data);
+        ShutdownAttachData(&data);
+
+        SerializeForAttach(geometry, &data);
+        Benchmark_Run(context, "Io/AttachToBinary/ModelGeometryData", AttachCopyCount_,
+                      AttachBenchmark<ModelGeometryData>, &data);
+        ShutdownAttachData(&data);
+
+        FreeAligned_(geometry.uvs);
+        FreeAligned_(geometry.tangents);
+        FreeAligned_(geometry.normals);
+        FreeAligned_(geometry.positions);
+        FreeAligned_(geometry.faceIndexCounts);
+        FreeAligned_(geometry.indices);
+    }
+
+    //=============================================================================================================================
+    void RunIoBenchmarks(BenchmarkContext* context)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 5);
+
+        RunHashBenchmarks(context, &pcg);
+        RunAttachBenchmarks(context, &pcg);
+    }
+}
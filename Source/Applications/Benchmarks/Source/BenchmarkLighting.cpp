@@ -0,0 +1,151 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "BuildCommon/BuildImageBasedLight.h"
+#include "SceneLib/ImageBasedLightResource.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+
+#define IblWidth_         2048
+#define IblHeight_        1024
+#define IblSampleCount_   8192
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct LightingBenchmarkData
+    {
+        ImageBasedLightResourceData ibl;
+        float* r0s;
+        float* r1s;
+        float3* directions;
+    };
+
+    //=============================================================================================================================
+    static void CreateIbl(Random::Pcg32* pcg, ImageBasedLightResourceData* ibl)
+    {
+        Memory::Zero(ibl, sizeof(ImageBasedLightResourceData));
+
+        // -- Dim noisy sky with a small bright sun so the tables are as skewed as a real outdoor ibl
+        float3* hdr = AllocArray_(float3, IblWidth_ * IblHeight_);
+        for(uint y = 0; y < IblHeight_; ++y) {
+            for(uint x = 0; x < IblWidth_; ++x) {
+                float sky = y < IblHeight_ / 2 ? 1.0f : 0.1f;
+                float3 texel = sky * float3(Random::Pcg32Float(pcg), Random::Pcg32Float(pcg), Random::Pcg32Float(pcg));
+
+                uint sunX = x > IblWidth_ / 3 ? x - IblWidth_ / 3 : IblWidth_ / 3 - x;
+                uint sunY = y > IblHeight_ / 4 ? y - IblHeight_ / 4 : IblHeight_ / 4 - y;
+                if(sunX * sunX + sunY * sunY < 64) {
+                    texel = float3(50000.0f, 45000.0f, 40000.0f);
+                }
+
+                hdr[y * IblWidth_ + x] = texel;
+            }
+        }
+
+        CalculateIblDensityFunctions(IblWidth_, IblHeight_, hdr, &ibl->densityfunctions);
+
+        ibl->lightData = hdr;
+        ibl->missData = nullptr;
+        ibl->rotationRadians = 0.5f;
+        ibl->exposureScale = 1.0f;
+    }
+
+    //=============================================================================================================================
+    static uint64 IblBenchmark(void* userData)
+    {
+        LightingBenchmarkData* data = (LightingBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < IblSampleCount_; ++scan) {
+            float3 direction;
+            uint x;
+            uint y;
+            float pdf;
+            Ibl(&data->ibl, data->r0s[scan], data->r1s[scan], direction, x, y, pdf);
+            float3 radiance = SampleIbl(&data->ibl, x, y);
+            sum += radiance.x + pdf;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 IblBatchBenchmark(void* userData)
+    {
+        LightingBenchmarkData* data = (LightingBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < IblSampleCount_; scan += IblBatchWidth_) {
+            IblBatchSample samples[IblBatchWidth_];
+            IblBatch(&data->ibl, data->r0s + scan, data->r1s + scan, IblBatchWidth_, samples);
+            sum += samples[0].radiance.x + samples[0].pdf;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SampleIblBenchmark(void* userData)
+    {
+        LightingBenchmarkData* data = (LightingBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < IblSampleCount_; ++scan) {
+            float pdf;
+            float3 radiance = SampleIbl(&data->ibl, data->directions[scan], pdf);
+            sum += radiance.x + pdf;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    void RunLightingBenchmarks(BenchmarkContext* context)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 2);
+
+        LightingBenchmarkData data;
+        CreateIbl(&pcg, &data.ibl);
+
+        data.r0s = AllocArray_(float, IblSampleCount_);
+        data.r1s = AllocArray_(float, IblSampleCount_);
+        data.directions = AllocArray_(float3, IblSampleCount_);
+        for(uint scan = 0; scan < IblSampleCount_; ++scan) {
+            data.r0s[scan] = Random::Pcg32Float(&pcg);
+            data.r1s[scan] = Random::Pcg32Float(&pcg);
+
+            float3 direction = float3(2.0f * Random::Pcg32Float(&pcg) - 1.0f, 2.0f * Random::Pcg32Float(&pcg) - 1.0f,
+                                      2.0f * Random::Pcg32Float(&pcg) - 1.0f);
+            data.directions[scan] = Normalize(direction);
+        }
+
+        Benchmark_Run(context, "Lighting/Ibl", IblSampleCount_, IblBenchmark, &data);
+        Benchmark_Run(context, "Lighting/IblBatch", IblSampleCount_, IblBatchBenchmark, &data);
+        Benchmark_Run(context, "Lighting/SampleIbl", IblSampleCount_, SampleIblBenchmark, &data);
+
+        Free_(data.directions);
+        Free_(data.r1s);
+        Free_(data.r0s);
+
+        ShutdownDensityFunctions(&data.ibl.densityfunctions);
+        Free_(data.ibl.lightData);
+    }
+}
@@ -0,0 +1,325 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "Shading/SurfaceScattering.h"
+#include "Shading/SurfaceParameters.h"
+#include "Shading/IntegratorContexts.h"
+#include "Shading/PathTracingBatcher.h"
+#include "Shading/Scattering.h"
+#include "TextureLib/TextureFiltering.h"
+#include "TextureLib/TextureResource.h"
+#include "MathLib/Sampler.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/SystemTime.h"
+
+#define PathShadingHitCount_           (16 * 1024)
+// -- Together the textures are far larger than the caches so the order hits are shaded in decides how often texels are reused
+#define PathShadingTextureCount_       32
+#define PathShadingTextureDimension_   256
+#define PathShadingMaterialCount_      128
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct PathShadingMaterial
+    {
+        SurfaceParameters surface;
+        uint32 texture;
+    };
+
+    //=============================================================================================================================
+    // -- Stands in for a scene. Hits find their material through geomId and their uvs in baryCoords. Everything past the
+    // -- geometry interpolation CalculateSurfaceParams does is the same work ShadeHitBatch does.
+    //=============================================================================================================================
+    struct PathShadingBenchmarkData
+    {
+        TextureResourceData textureDatas[PathShadingTextureCount_];
+        TextureResource textures[PathShadingTextureCount_];
+        PathShadingMaterial materials[PathShadingMaterialCount_];
+
+        // -- Hits in the order they were traced. Light and background directions are indexed by HitParameters::index.
+        HitParameters* hits;
+        HitParameters* sortedHits;
+        float3* lights;
+        float3* skies;
+
+        CSampler sampler;
+    };
+
+    //=============================================================================================================================
+    static float3 RandomSphereDirection(Random::Pcg32* pcg)
+    {
+        float u = 2.0f * Random::Pcg32Float(pcg) - 1.0f;
+        float norm = Math::Sqrtf(Max(0.0f, 1.0f - u * u));
+        float theta = Math::TwoPi_ * Random::Pcg32Float(pcg);
+        return float3(norm * Math::Cosf(theta), u, norm * Math::Sinf(theta));
+    }
+
+    //=============================================================================================================================
+    static void CreateMaterial(Random::Pcg32* pcg, uint32 index, PathShadingMaterial& material)
+    {
+        SurfaceParameters& surface = material.surface;
+        Memory::Zero(&surface, sizeof(surface));
+
+        // -- Mostly Disney with a few dirac surfaces that fall back to the scalar shader
+        float shader = Random::Pcg32Float(pcg);
+        surface.shader = shader < 0.4f ? eDisneyThin : (shader < 0.9f ? eDisneySolid : eDiracTransparent);
+
+        surface.worldToTangent = Matrix3x3::Identity();
+        surface.baseColor = float3(Random::Pcg32Float(pcg), Random::Pcg32Float(pcg), Random::Pcg32Float(pcg));
+        surface.transmittanceColor = float3(Random::Pcg32Float(pcg), Random::Pcg32Float(pcg), Random::Pcg32Float(pcg));
+        surface.sheen = Random::Pcg32Float(pcg);
+        surface.sheenTint = Random::Pcg32Float(pcg);
+        surface.clearcoat = Random::Pcg32Float(pcg);
+        surface.clearcoatGloss = Random::Pcg32Float(pcg);
+        surface.metallic = Random::Pcg32Float(pcg);
+        surface.specTrans = Random::Pcg32Float(pcg);
+        surface.diffTrans = Random::Pcg32Float(pcg);
+        surface.flatness = Random::Pcg32Float(pcg);
+        surface.anisotropic = Random::Pcg32Float(pcg);
+        surface.specularTint = Random::Pcg32Float(pcg);
+        surface.roughness = 0.05f + 0.95f * Random::Pcg32Float(pcg);
+        surface.scatterDistance = Random::Pcg32Float(pcg);
+        surface.ior = 1.0f + Random::Pcg32Float(pcg);
+        surface.relativeIOR = surface.ior;
+
+        material.texture = index % PathShadingTextureCount_;
+    }
+
+    //=============================================================================================================================
+    static void CreatePathShadingData(PathShadingBenchmarkData* data)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 4);
+
+        for(uint scan = 0; scan < PathShadingTextureCount_; ++scan) {
+            Benchmark_CreateTexture(TextureResourceData::Tiled4x4, PathShadingTextureDimension_, &pcg, &data->textureDatas[scan]);
+            data->textures[scan].data = &data->textureDatas[scan];
+        }
+
+        for(uint32 scan = 0; scan < PathShadingMaterialCount_; ++scan) {
+            CreateMaterial(&pcg, scan, data->materials[scan]);
+        }
+
+        data->hits = AllocArray_(HitParameters, PathShadingHitCount_);
+        data->sortedHits = AllocArray_(HitParameters, PathShadingHitCount_);
+        data->lights = AllocArray_(float3, PathShadingHitCount_);
+        data->skies = AllocArray_(float3, PathShadingHitCount_);
+
+        for(uint scan = 0; scan < PathShadingHitCount_; ++scan) {
+            uint32 material = Random::Pcg32Uint32(&pcg) % PathShadingMaterialCount_;
+
+            HitParameters& hit = data->hits[scan];
+            Memory::Zero(&hit, sizeof(hit));
+            hit.index = (uint32)scan;
+            hit.geomId = (int32)material;
+            hit.baryCoords = float2(Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg));
+            hit.view = RandomSphereDirection(&pcg);
+            hit.throughput = float3::One_;
+
+            // -- Laid out like CalculateShadingKey with the material standing in for the geometry
+            uint32 shader = (uint32)data->materials[material].surface.shader & 0x3;
+            uint32 texture = (data->materials[material].texture + 1) & 0xFFFFF;
+            hit.shadingKey = (shader << 30) | (texture << 10) | (material & 0x3FF);
+
+            data->lights[scan] = RandomSphereDirection(&pcg);
+            data->skies[scan] = RandomSphereDirection(&pcg);
+        }
+
+        SortHitsByShadingKey(data->hits, PathShadingHitCount_, data->sortedHits);
+
+        data->sampler.Initialize(0x5eed);
+    }
+
+    //=============================================================================================================================
+    static void DestroyPathShadingData(PathShadingBenchmarkData* data)
+    {
+        data->sampler.Shutdown();
+        Free_(data->skies);
+        Free_(data->lights);
+        Free_(data->sortedHits);
+        Free_(data->hits);
+
+        for(uint scan = 0; scan < PathShadingTextureCount_; ++scan) {
+            FreeAligned_(data->textureDatas[scan].texture);
+        }
+    }
+
+    //=============================================================================================================================
+    static float ShadeBatches(PathShadingBenchmarkData* data, const HitParameters* hits)
+    {
+        static_assert(PathShadingHitCount_ % TextureBatchWidth == 0, "Only full batches are shaded");
+
+        float sum = 0.0f;
+        for(uint batchStart = 0; batchStart < PathShadingHitCount_; batchStart += TextureBatchWidth) {
+            const HitParameters* batch = hits + batchStart;
+
+            SurfaceParameters surfaces[TextureBatchWidth];
+            float3 views[TextureBatchWidth];
+            float3 lights[TextureBatchWidth];
+            float3 skies[TextureBatchWidth];
+            float2 uvs[TextureBatchWidth];
+            uint32 textures[TextureBatchWidth];
+            uint32 pixelIndices[TextureBatchWidth];
+            uint32 sampleIndices[TextureBatchWidth];
+            for(uint lane = 0; lane < TextureBatchWidth; ++lane) {
+                const HitParameters& hit = batch[lane];
+                const PathShadingMaterial& material = data->materials[hit.geomId];
+
+                surfaces[lane] = material.surface;
+                surfaces[lane].view = hit.view;
+                views[lane] = hit.view;
+                lights[lane] = data->lights[hit.index];
+                skies[lane] = data->skies[hit.index];
+                uvs[lane] = hit.baryCoords;
+                textures[lane] = material.texture;
+                pixelIndices[lane] = hit.index;
+                sampleIndices[lane] = hit.sampleIndex;
+            }
+
+            // -- The same runs of a shared texture that CalculateSurfaceParams filters together
+            uint runStart = 0;
+            while(runStart < TextureBatchWidth) {
+                uint runEnd = runStart + 1;
+                while(runEnd < TextureBatchWidth && textures[runEnd] == textures[runStart]) {
+                    ++runEnd;
+                }
+
+                float3 baseColors[TextureBatchWidth];
+                SampleBaseColors(&data->textures[textures[runStart]], uvs + runStart, runEnd - runStart, baseColors);
+                for(uint lane = runStart; lane < runEnd; ++lane) {
+                    surfaces[lane].baseColor = baseColors[lane - runStart];
+                }
+                runStart = runEnd;
+            }
+
+            SurfaceParameters8 surfaces8;
+            GatherSurfaceParams8(surfaces, TextureBatchWidth, surfaces8);
+
+            float3 lightReflectances[TextureBatchWidth];
+            float3 skyReflectances[TextureBatchWidth];
+            float forwardPdfs[TextureBatchWidth];
+            float reversePdfs[TextureBatchWidth];
+            EvaluateBsdf8(surfaces8, views, lights, lightReflectances, forwardPdfs, reversePdfs);
+            EvaluateBsdf8(surfaces8, views, skies, skyReflectances, forwardPdfs, reversePdfs);
+
+            BsdfRandoms8 randoms;
+            float* randomDimensions[] = { randoms.lobe, randoms.u0, randoms.u1, randoms.u2 };
+            for(uint32 dimension = 0; dimension < 4; ++dimension) {
+                uint32 dimensions[TextureBatchWidth];
+                for(uint lane = 0; lane < TextureBatchWidth; ++lane) {
+                    dimensions[lane] = dimension;
+                }
+                CSampler::UniformFloats(pixelIndices, sampleIndices, dimensions, TextureBatchWidth, randomDimensions[dimension]);
+            }
+
+            BsdfSample samples[TextureBatchWidth];
+            bool successes[TextureBatchWidth];
+            SampleBsdfFunction8(surfaces8, views, randoms, samples, successes);
+
+            for(uint lane = 0; lane < TextureBatchWidth; ++lane) {
+                sum += lightReflectances[lane].x + skyReflectances[lane].x + (successes[lane] ? samples[lane].forwardPdfW : 0.0f);
+            }
+        }
+
+        return sum;
+    }
+
+    //=============================================================================================================================
+    static uint64 ImmediateShadingBenchmark(void* userData)
+    {
+        PathShadingBenchmarkData* data = (PathShadingBenchmarkData*)userData;
+
+        // -- One hit at a time in trace order with the scalar texture lookup and bsdfs the way hits were shaded before
+        // -- they were deferred
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < PathShadingHitCount_; ++scan) {
+            const HitParameters& hit = data->hits[scan];
+            const PathShadingMaterial& material = data->materials[hit.geomId];
+
+            SurfaceParameters surface = material.surface;
+            surface.view = hit.view;
+            surface.baseColor = SampleBaseColor(&data->textures[material.texture], hit.baryCoords, material.surface.baseColor);
+
+            float forwardPdf;
+            float reversePdf;
+            float3 lightReflectance = EvaluateBsdf(surface, hit.view, data->lights[hit.index], forwardPdf, reversePdf);
+            float3 skyReflectance = EvaluateBsdf(surface, hit.view, data->skies[hit.index], forwardPdf, reversePdf);
+
+            data->sampler.SetSample(hit.index, hit.sampleIndex, 0);
+
+            BsdfSample sample;
+            bool success = SampleBsdfFunction(&data->sampler, surface, hit.view, sample);
+            sum += lightReflectance.x + skyReflectance.x + (success ? sample.forwardPdfW : 0.0f);
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 UnsortedBatchShadingBenchmark(void* userData)
+    {
+        PathShadingBenchmarkData* data = (PathShadingBenchmarkData*)userData;
+
+        uint64 start = SystemTime::Timestamp();
+        float sum = ShadeBatches(data, data->hits);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SortedBatchShadingBenchmark(void* userData)
+    {
+        PathShadingBenchmarkData* data = (PathShadingBenchmarkData*)userData;
+
+        // -- Includes the sort the batcher does before handing hits out
+        uint64 start = SystemTime::Timestamp();
+        SortHitsByShadingKey(data->hits, PathShadingHitCount_, data->sortedHits);
+        float sum = ShadeBatches(data, data->sortedHits);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 PresortedBatchShadingBenchmark(void* userData)
+    {
+        PathShadingBenchmarkData* data = (PathShadingBenchmarkData*)userData;
+
+        uint64 start = SystemTime::Timestamp();
+        float sum = ShadeBatches(data, data->sortedHits);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    void RunPathShadingBenchmarks(BenchmarkContext* context)
+    {
+        PathShadingBenchmarkData* data = New_(PathShadingBenchmarkData);
+        CreatePathShadingData(data);
+
+        Benchmark_Run(context, "PathShading/Immediate", PathShadingHitCount_, ImmediateShadingBenchmark, data);
+        Benchmark_Run(context, "PathShading/Batched/Unsorted", PathShadingHitCount_, UnsortedBatchShadingBenchmark, data);
+        Benchmark_Run(context, "PathShading/Batched/Sorted", PathShadingHitCount_, SortedBatchShadingBenchmark, data);
+        Benchmark_Run(context, "PathShading/Batched/Presorted", PathShadingHitCount_, PresortedBatchShadingBenchmark, data);
+
+        DestroyPathShadingData(data);
+        Delete_(data);
+    }
+}
@@ -0,0 +1,237 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "Shading/Disney.h"
+#include "Shading/SurfaceParameters.h"
+#include "Shading/Scattering.h"
+#include "MathLib/Sampler.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/SimdFloat8.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+
+#define ShadingSurfaceCount_ 4096
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct ShadingBenchmarkData
+    {
+        SurfaceParameters* surfaces;
+        SurfaceParameters8* surfaces8;
+        float3* views;
+        float3* lights;
+        float* randoms;
+        CSampler sampler;
+        bool thin;
+    };
+
+    //=============================================================================================================================
+    static float3 RandomHemisphereDirection(Random::Pcg32* pcg)
+    {
+        // -- worldToTangent is the identity so y is the normal. Kept off the horizon so every direction can be shaded.
+        float3 direction = float3(2.0f * Random::Pcg32Float(pcg) - 1.0f, 0.05f + Random::Pcg32Float(pcg),
+                                  2.0f * Random::Pcg32Float(pcg) - 1.0f);
+        return Normalize(direction);
+    }
+
+    //=============================================================================================================================
+    static void CreateSurfaces(ShadingBenchmarkData* data)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 0);
+
+        data->surfaces = AllocArray_(SurfaceParameters, ShadingSurfaceCount_);
+        data->views = AllocArray_(float3, ShadingSurfaceCount_);
+        data->lights = AllocArray_(float3, ShadingSurfaceCount_);
+        data->randoms = AllocArray_(float, 4 * ShadingSurfaceCount_);
+
+        for(uint scan = 0; scan < ShadingSurfaceCount_; ++scan) {
+            SurfaceParameters& surface = data->surfaces[scan];
+            Memory::Zero(&surface, sizeof(surface));
+
+            surface.worldToTangent = Matrix3x3::Identity();
+            surface.baseColor = float3(Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg));
+            surface.transmittanceColor = float3(Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg));
+            surface.sheen = Random::Pcg32Float(&pcg);
+            surface.sheenTint = Random::Pcg32Float(&pcg);
+            surface.clearcoat = Random::Pcg32Float(&pcg);
+            surface.clearcoatGloss = Random::Pcg32Float(&pcg);
+            surface.metallic = Random::Pcg32Float(&pcg);
+            surface.specTrans = Random::Pcg32Float(&pcg);
+            surface.diffTrans = Random::Pcg32Float(&pcg);
+            surface.flatness = Random::Pcg32Float(&pcg);
+            surface.anisotropic = Random::Pcg32Float(&pcg);
+            surface.specularTint = Random::Pcg32Float(&pcg);
+            surface.roughness = 0.05f + 0.95f * Random::Pcg32Float(&pcg);
+            surface.scatterDistance = Random::Pcg32Float(&pcg);
+            surface.ior = 1.0f + Random::Pcg32Float(&pcg);
+            surface.relativeIOR = surface.ior;
+            surface.shader = eDisneySolid;
+
+            data->views[scan] = RandomHemisphereDirection(&pcg);
+            surface.view = data->views[scan];
+
+            // -- Some light directions go below the surface so transmission gets evaluated as well
+            data->lights[scan] = RandomHemisphereDirection(&pcg);
+            if(Random::Pcg32Float(&pcg) < 0.25f) {
+                data->lights[scan].y = -data->lights[scan].y;
+            }
+        }
+
+        for(uint scan = 0; scan < 4 * ShadingSurfaceCount_; ++scan) {
+            data->randoms[scan] = Random::Pcg32Float(&pcg);
+        }
+
+        // -- Eight wide copies in the same order for the batched versions
+        uint batchCount = ShadingSurfaceCount_ / Float8LaneCount_;
+        data->surfaces8 = (SurfaceParameters8*)AllocAligned_(batchCount * sizeof(SurfaceParameters8), CacheLineSize_);
+        for(uint batch = 0; batch < batchCount; ++batch) {
+            GatherSurfaceParams8(data->surfaces + batch * Float8LaneCount_, Float8LaneCount_, data->surfaces8[batch]);
+        }
+
+        data->sampler.Initialize(0x5eed);
+    }
+
+    //=============================================================================================================================
+    static void DestroySurfaces(ShadingBenchmarkData* data)
+    {
+        data->sampler.Shutdown();
+        FreeAligned_(data->surfaces8);
+        Free_(data->randoms);
+        Free_(data->lights);
+        Free_(data->views);
+        Free_(data->surfaces);
+    }
+
+    //=============================================================================================================================
+    static uint64 EvaluateDisneyBenchmark(void* userData)
+    {
+        ShadingBenchmarkData* data = (ShadingBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < ShadingSurfaceCount_; ++scan) {
+            float forwardPdf;
+            float reversePdf;
+            float3 reflectance = EvaluateDisney(data->surfaces[scan], data->views[scan], data->lights[scan], data->thin,
+                                                forwardPdf, reversePdf);
+            sum += reflectance.x + forwardPdf;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SampleDisneyBenchmark(void* userData)
+    {
+        ShadingBenchmarkData* data = (ShadingBenchmarkData*)userData;
+
+        // -- Same stream every repetition
+        data->sampler.Reseed(0x5eed);
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < ShadingSurfaceCount_; ++scan) {
+            BsdfSample sample;
+            if(SampleDisney(&data->sampler, data->surfaces[scan], data->views[scan], data->thin, sample)) {
+                sum += sample.reflectance.x + sample.forwardPdfW;
+            }
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 EvaluateDisney8Benchmark(void* userData)
+    {
+        ShadingBenchmarkData* data = (ShadingBenchmarkData*)userData;
+
+        float8 thin = data->thin ? Not(float8(0.0f)) : float8(0.0f);
+
+        float8 sum = float8(0.0f);
+        uint64 start = SystemTime::Timestamp();
+        for(uint batch = 0; batch < ShadingSurfaceCount_ / Float8LaneCount_; ++batch) {
+            uint offset = batch * Float8LaneCount_;
+            float3_8 v = Load8(data->views + offset, Float8LaneCount_);
+            float3_8 l = Load8(data->lights + offset, Float8LaneCount_);
+
+            float3_8 reflectance;
+            float8 forwardPdf;
+            float8 reversePdf;
+            EvaluateDisney8(data->surfaces8[batch], v, l, thin, reflectance, forwardPdf, reversePdf);
+            sum = sum + reflectance.x + forwardPdf;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        float lanes[Float8LaneCount_];
+        Store8(lanes, sum);
+        Benchmark_Consume(lanes[0]);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SampleDisney8Benchmark(void* userData)
+    {
+        ShadingBenchmarkData* data = (ShadingBenchmarkData*)userData;
+
+        float8 thin = data->thin ? Not(float8(0.0f)) : float8(0.0f);
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint batch = 0; batch < ShadingSurfaceCount_ / Float8LaneCount_; ++batch) {
+            uint offset = batch * Float8LaneCount_;
+            float3_8 v = Load8(data->views + offset, Float8LaneCount_);
+
+            const float* batchRandoms = data->randoms + 4 * offset;
+            float8 randoms[4] = {
+                Load8(batchRandoms),
+                Load8(batchRandoms + Float8LaneCount_),
+                Load8(batchRandoms + 2 * Float8LaneCount_),
+                Load8(batchRandoms + 3 * Float8LaneCount_)
+            };
+
+            BsdfSample samples[Float8LaneCount_];
+            bool successes[Float8LaneCount_];
+            SampleDisney8(data->surfaces8[batch], v, thin, randoms, samples, successes);
+            for(uint lane = 0; lane < Float8LaneCount_; ++lane) {
+                sum += successes[lane] ? samples[lane].forwardPdfW : 0.0f;
+            }
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    void RunShadingBenchmarks(BenchmarkContext* context)
+    {
+        ShadingBenchmarkData data;
+        CreateSurfaces(&data);
+
+        data.thin = false;
+        Benchmark_Run(context, "Shading/EvaluateDisney/Solid", ShadingSurfaceCount_, EvaluateDisneyBenchmark, &data);
+        Benchmark_Run(context, "Shading/EvaluateDisney8/Solid", ShadingSurfaceCount_, EvaluateDisney8Benchmark, &data);
+        Benchmark_Run(context, "Shading/SampleDisney/Solid", ShadingSurfaceCount_, SampleDisneyBenchmark, &data);
+        Benchmark_Run(context, "Shading/SampleDisney8/Solid", ShadingSurfaceCount_, SampleDisney8Benchmark, &data);
+
+        data.thin = true;
+        Benchmark_Run(context, "Shading/EvaluateDisney/Thin", ShadingSurfaceCount_, EvaluateDisneyBenchmark, &data);
+        Benchmark_Run(context, "Shading/EvaluateDisney8/Thin", ShadingSurfaceCount_, EvaluateDisney8Benchmark, &data);
+        Benchmark_Run(context, "Shading/SampleDisney/Thin", ShadingSurfaceCount_, SampleDisneyBenchmark, &data);
+        Benchmark_Run(context, "Shading/SampleDisney8/Thin", ShadingSurfaceCount_, SampleDisney8Benchmark, &data);
+
+        DestroySurfaces(&data);
+    }
+}
@@ -0,0 +1,173 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "Shading/PathTracingBatcher.h"
+#include "Shading/IntegratorContexts.h"
+#include "UtilityLib/QuickSort.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatFuncs.h"
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+
+#define SortEntryCount_ (64 * 1024)
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct SortingBenchmarkData
+    {
+        DeferredRay* unsortedRays;
+        DeferredRay* rays;
+        OcclusionRay* unsortedOcclusionRays;
+        OcclusionRay* occlusionRays;
+
+        HitParameters* hits;
+        HitParameters* sortedHits;
+        uint32* keys;
+        uint32* indices;
+    };
+
+    //=============================================================================================================================
+    static Ray RandomPositiveXRay(Random::Pcg32* pcg)
+    {
+        // -- Origins spread over a scene sized box and directions that all fall in the PositiveX category
+        float3 origin = float3(1000.0f * Random::Pcg32Float(pcg), 200.0f * Random::Pcg32Float(pcg),
+                               1000.0f * Random::Pcg32Float(pcg));
+        float3 direction = float3(1.0f, Random::Pcg32Float(pcg) - 0.5f, Random::Pcg32Float(pcg) - 0.5f);
+        return MakeRay(origin, Normalize(direction));
+    }
+
+    //=============================================================================================================================
+    static void CreateSortingData(SortingBenchmarkData* data)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 3);
+
+        data->unsortedRays = AllocArray_(DeferredRay, SortEntryCount_);
+        data->rays = AllocArray_(DeferredRay, SortEntryCount_);
+        data->unsortedOcclusionRays = AllocArray_(OcclusionRay, SortEntryCount_);
+        data->occlusionRays = AllocArray_(OcclusionRay, SortEntryCount_);
+        data->hits = AllocArray_(HitParameters, SortEntryCount_);
+        data->sortedHits = AllocArray_(HitParameters, SortEntryCount_);
+        data->keys = AllocArray_(uint32, SortEntryCount_);
+        data->indices = AllocArray_(uint32, SortEntryCount_);
+
+        for(uint scan = 0; scan < SortEntryCount_; ++scan) {
+            DeferredRay& ray = data->unsortedRays[scan];
+            Memory::Zero(&ray, sizeof(ray));
+            ray.ray = RandomPositiveXRay(&pcg);
+            ray.throughput = float3::One_;
+            ray.index = scan;
+
+            OcclusionRay& occlusionRay = data->unsortedOcclusionRays[scan];
+            Memory::Zero(&occlusionRay, sizeof(occlusionRay));
+            occlusionRay.ray = RandomPositiveXRay(&pcg);
+            occlusionRay.distance = 100.0f * Random::Pcg32Float(&pcg);
+            occlusionRay.value = float3::One_;
+            occlusionRay.index = (uint32)scan;
+
+            // -- Keys laid out like CalculateShadingKey with a few shaders, a few hundred textures and many geometries
+            HitParameters& hit = data->hits[scan];
+            Memory::Zero(&hit, sizeof(hit));
+            hit.index = scan;
+            uint32 shader = Random::Pcg32Uint32(&pcg) % 3;
+            uint32 texture = Random::Pcg32Uint32(&pcg) % 300;
+            uint32 geometry = Random::Pcg32Uint32(&pcg) % 20000;
+            hit.shadingKey = (shader << 30) | (texture << 16) | (geometry & 0xFFFF);
+        }
+    }
+
+    //=============================================================================================================================
+    static void DestroySortingData(SortingBenchmarkData* data)
+    {
+        Free_(data->indices);
+        Free_(data->keys);
+        Free_(data->sortedHits);
+        Free_(data->hits);
+        Free_(data->occlusionRays);
+        Free_(data->unsortedOcclusionRays);
+        Free_(data->rays);
+        Free_(data->unsortedRays);
+    }
+
+    //=============================================================================================================================
+    static uint64 SortDeferredRaysBenchmark(void* userData)
+    {
+        SortingBenchmarkData* data = (SortingBenchmarkData*)userData;
+        Memory::Copy(data->rays, data->unsortedRays, SortEntryCount_ * sizeof(DeferredRay));
+
+        uint64 start = SystemTime::Timestamp();
+        SortRays(data->rays, SortEntryCount_, PositiveX);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(data->rays[0].ray.origin.x);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SortOcclusionRaysBenchmark(void* userData)
+    {
+        SortingBenchmarkData* data = (SortingBenchmarkData*)userData;
+        Memory::Copy(data->occlusionRays, data->unsortedOcclusionRays, SortEntryCount_ * sizeof(OcclusionRay));
+
+        uint64 start = SystemTime::Timestamp();
+        SortRays(data->occlusionRays, SortEntryCount_, PositiveX);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(data->occlusionRays[0].ray.origin.x);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 SortHitsBenchmark(void* userData)
+    {
+        SortingBenchmarkData* data = (SortingBenchmarkData*)userData;
+
+        uint64 start = SystemTime::Timestamp();
+        SortHitsByShadingKey(data->hits, SortEntryCount_, data->sortedHits);
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume((uint64)data->sortedHits[0].shadingKey);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 QuickSortHitsBenchmark(void* userData)
+    {
+        SortingBenchmarkData* data = (SortingBenchmarkData*)userData;
+
+        // -- The same key and index sort followed by a gather as SortHitsByShadingKey but with the quick sort it replaced
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < SortEntryCount_; ++scan) {
+            data->keys[scan] = data->hits[scan].shadingKey;
+            data->indices[scan] = (uint32)scan;
+        }
+        QuickSortMatchingArrays(data->keys, data->indices, SortEntryCount_);
+        for(uint scan = 0; scan < SortEntryCount_; ++scan) {
+            data->sortedHits[scan] = data->hits[data->indices[scan]];
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume((uint64)data->sortedHits[0].shadingKey);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    void RunSortingBenchmarks(BenchmarkContext* context)
+    {
+        SortingBenchmarkData data;
+        CreateSortingData(&data);
+
+        Benchmark_Run(context, "Sorting/SortRays/Deferred", SortEntryCount_, SortDeferredRaysBenchmark, &data);
+        Benchmark_Run(context, "Sorting/SortRays/Occlusion", SortEntryCount_, SortOcclusionRaysBenchmark, &data);
+        Benchmark_Run(context, "Sorting/SortHitsByShadingKey", SortEntryCount_, SortHitsBenchmark, &data);
+        Benchmark_Run(context, "Sorting/QuickSortHits", SortEntryCount_, QuickSortHitsBenchmark, &data);
+
+        DestroySortingData(&data);
+    }
+}
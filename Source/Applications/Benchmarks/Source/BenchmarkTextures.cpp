@@ -0,0 +1,121 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "TextureLib/TextureFiltering.h"
+#include "TextureLib/TextureResource.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+
+#define TextureDimension_     1024
+#define TextureLookupCount_   8192
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct TextureBenchmarkData
+    {
+        TextureResourceData texture;
+        float2* sts;
+        float2* dst0s;
+        float2* dst1s;
+    };
+
+    //=============================================================================================================================
+    static uint64 TriangleBenchmark(void* userData)
+    {
+        TextureBenchmarkData* data = (TextureBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < TextureLookupCount_; ++scan) {
+            float3 result;
+            TextureFiltering::Triangle<float3>(&data->texture, 0, data->sts[scan], result);
+            sum += result.x;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 TriangleBatchBenchmark(void* userData)
+    {
+        TextureBenchmarkData* data = (TextureBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < TextureLookupCount_; scan += TextureBatchWidth) {
+            float4 results[TextureBatchWidth];
+            TextureFiltering::TriangleBatch(&data->texture, 0, data->sts + scan, TextureBatchWidth, results);
+            sum += results[0].x;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    static uint64 EWABenchmark(void* userData)
+    {
+        TextureBenchmarkData* data = (TextureBenchmarkData*)userData;
+
+        float sum = 0.0f;
+        uint64 start = SystemTime::Timestamp();
+        for(uint scan = 0; scan < TextureLookupCount_; ++scan) {
+            float3 result;
+            TextureFiltering::EWA<float3>(&data->texture, data->sts[scan], data->dst0s[scan], data->dst1s[scan], result);
+            sum += result.x;
+        }
+        uint64 elapsed = SystemTime::Timestamp() - start;
+
+        Benchmark_Consume(sum);
+        return elapsed;
+    }
+
+    //=============================================================================================================================
+    void RunTextureBenchmarks(BenchmarkContext* context)
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 1);
+
+        TextureBenchmarkData data;
+        data.sts = AllocArray_(float2, TextureLookupCount_);
+        data.dst0s = AllocArray_(float2, TextureLookupCount_);
+        data.dst1s = AllocArray_(float2, TextureLookupCount_);
+
+        // -- Footprints between a quarter texel and a few dozen texels wide with up to 4:1 anisotropy
+        for(uint scan = 0; scan < TextureLookupCount_; ++scan) {
+            data.sts[scan] = float2(Random::Pcg32Float(&pcg), Random::Pcg32Float(&pcg));
+
+            float width = (0.25f + 32.0f * Random::Pcg32Float(&pcg) * Random::Pcg32Float(&pcg)) / TextureDimension_;
+            float aspect = 1.0f + 3.0f * Random::Pcg32Float(&pcg);
+            data.dst0s[scan] = float2(width * aspect, 0.5f * width);
+            data.dst1s[scan] = float2(-0.5f * width, width);
+        }
+
+        Benchmark_CreateTexture(TextureResourceData::Linear, TextureDimension_, &pcg, &data.texture);
+        Benchmark_Run(context, "Textures/Triangle/Linear", TextureLookupCount_, TriangleBenchmark, &data);
+        Benchmark_Run(context, "Textures/TriangleBatch/Linear", TextureLookupCount_, TriangleBatchBenchmark, &data);
+        Benchmark_Run(context, "Textures/EWA/Linear", TextureLookupCount_, EWABenchmark, &data);
+        FreeAligned_(data.texture.texture);
+
+        Benchmark_CreateTexture(TextureResourceData::Tiled4x4, TextureDimension_, &pcg, &data.texture);
+        Benchmark_Run(context, "Textures/Triangle/Tiled4x4", TextureLookupCount_, TriangleBenchmark, &data);
+        Benchmark_Run(context, "Textures/TriangleBatch/Tiled4x4", TextureLookupCount_, TriangleBatchBenchmark, &data);
+        Benchmark_Run(context, "Textures/EWA/Tiled4x4", TextureLookupCount_, EWABenchmark, &data);
+        FreeAligned_(data.texture.texture);
+
+        Free_(data.dst1s);
+        Free_(data.dst0s);
+        Free_(data.sts);
+    }
+}
@@ -0,0 +1,202 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "Shading/SurfaceScattering.h"
+#include "Shading/SurfaceParameters.h"
+#include "Shading/Scattering.h"
+#include "MathLib/Sampler.h"
+#include "MathLib/Random.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "MathLib/SimdFloat8.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Logging.h"
+
+#define ValidationBatchCount_     (16 * 1024)
+#define ValidationTolerance_      1e-3f
+#define MaxReportedMismatches_    8
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct BsdfValidation
+    {
+        uint64 lanes;
+        uint64 mismatches;
+    };
+
+    //=============================================================================================================================
+    static float3 RandomSphereDirection(Random::Pcg32* pcg)
+    {
+        // -- Views and lights on both sides of the surface so transmission is covered as well as reflection
+        float u = 2.0f * Random::Pcg32Float(pcg) - 1.0f;
+        float norm = Math::Sqrtf(Max(0.0f, 1.0f - u * u));
+        float theta = Math::TwoPi_ * Random::Pcg32Float(pcg);
+        return float3(norm * Math::Cosf(theta), u, norm * Math::Sinf(theta));
+    }
+
+    //=============================================================================================================================
+    static void RandomSurface(Random::Pcg32* pcg, SurfaceParameters& surface)
+    {
+        Memory::Zero(&surface, sizeof(surface));
+
+        static const ShaderType shaders[] = { eDisneyThin, eDisneySolid, eDiracTransparent };
+
+        surface.worldToTangent = Matrix3x3::Identity();
+        surface.baseColor = float3(Random::Pcg32Float(pcg), Random::Pcg32Float(pcg), Random::Pcg32Float(pcg));
+        surface.transmittanceColor = float3(Random::Pcg32Float(pcg), Random::Pcg32Float(pcg), Random::Pcg32Float(pcg));
+        surface.sheen = Random::Pcg32Float(pcg);
+        surface.sheenTint = Random::Pcg32Float(pcg);
+        surface.clearcoat = Random::Pcg32Float(pcg);
+        surface.clearcoatGloss = Random::Pcg32Float(pcg);
+        surface.metallic = Random::Pcg32Float(pcg);
+        surface.specTrans = Random::Pcg32Float(pcg);
+        surface.diffTrans = Random::Pcg32Float(pcg);
+        surface.flatness = Random::Pcg32Float(pcg);
+        surface.anisotropic = Random::Pcg32Float(pcg);
+        surface.specularTint = Random::Pcg32Float(pcg);
+        surface.roughness = 0.05f + 0.95f * Random::Pcg32Float(pcg);
+        surface.scatterDistance = Random::Pcg32Float(pcg);
+        surface.ior = 1.0f + Random::Pcg32Float(pcg);
+        surface.relativeIOR = surface.ior;
+        surface.shader = shaders[Random::Pcg32Uint32(pcg) % 3];
+        surface.view = RandomSphereDirection(pcg);
+    }
+
+    //=============================================================================================================================
+    static bool Matches(float scalar, float batched)
+    {
+        // -- Relative for large values such as the pdfs of smooth lobes and absolute near zero
+        float scale = Max(1.0f, Max(Math::Absf(scalar), Math::Absf(batched)));
+        return Math::Absf(scalar - batched) <= ValidationTolerance_ * scale;
+    }
+
+    //=============================================================================================================================
+    static bool Matches(const float3& scalar, const float3& batched)
+    {
+        return Matches(scalar.x, batched.x) && Matches(scalar.y, batched.y) && Matches(scalar.z, batched.z);
+    }
+
+    //=============================================================================================================================
+    static void ReportMismatch(BsdfValidation* validation, cpointer function, const SurfaceParameters& surface, uint lane,
+                               uint64 batch)
+    {
+        if(validation->mismatches < MaxReportedMismatches_) {
+            WriteDebugInfo_("%s mismatch in batch %llu lane %u with shader %u", function, batch, lane, (uint32)surface.shader);
+        }
+        ++validation->mismatches;
+    }
+
+    //=============================================================================================================================
+    static void ValidateBatch(const SurfaceParameters* surfaces, const float3* views, const float3* lights, uint count,
+                              uint32 sampleIndex, uint64 batch, BsdfValidation* validation)
+    {
+        SurfaceParameters8 surfaces8;
+        GatherSurfaceParams8(surfaces, count, surfaces8);
+
+        float3 reflectances[Float8LaneCount_];
+        float forwardPdfs[Float8LaneCount_];
+        float reversePdfs[Float8LaneCount_];
+        EvaluateBsdf8(surfaces8, views, lights, reflectances, forwardPdfs, reversePdfs);
+
+        // -- The scalar samplers draw the lobe and then its randoms in order so dimensions 0 to 3 line up with the batched
+        // -- randoms
+        uint32 pixelIndices[Float8LaneCount_];
+        uint32 sampleIndices[Float8LaneCount_];
+        uint32 dimensions[Float8LaneCount_];
+        for(uint lane = 0; lane < count; ++lane) {
+            pixelIndices[lane] = (uint32)lane;
+            sampleIndices[lane] = sampleIndex;
+        }
+
+        BsdfRandoms8 randoms;
+        float* randomDimensions[] = { randoms.lobe, randoms.u0, randoms.u1, randoms.u2 };
+        for(uint32 dimension = 0; dimension < 4; ++dimension) {
+            for(uint lane = 0; lane < count; ++lane) {
+                dimensions[lane] = dimension;
+            }
+            CSampler::UniformFloats(pixelIndices, sampleIndices, dimensions, count, randomDimensions[dimension]);
+        }
+
+        BsdfSample samples[Float8LaneCount_];
+        bool successes[Float8LaneCount_];
+        SampleBsdfFunction8(surfaces8, views, randoms, samples, successes);
+
+        CSampler sampler;
+        sampler.Initialize(0);
+
+        for(uint lane = 0; lane < count; ++lane) {
+            const SurfaceParameters& surface = surfaces[lane];
+            ++validation->lanes;
+
+            float forwardPdf;
+            float reversePdf;
+            float3 reflectance = EvaluateBsdf(surface, views[lane], lights[lane], forwardPdf, reversePdf);
+            if(!Matches(reflectance, reflectances[lane]) || !Matches(forwardPdf, forwardPdfs[lane])
+               || !Matches(reversePdf, reversePdfs[lane])) {
+                ReportMismatch(validation, "EvaluateBsdf8", surface, lane, batch);
+                continue;
+            }
+
+            sampler.SetSample(pixelIndices[lane], sampleIndex, 0);
+
+            BsdfSample sample;
+            bool success = SampleBsdfFunction(&sampler, surface, views[lane], sample);
+            if(success != successes[lane]) {
+                ReportMismatch(validation, "SampleBsdfFunction8", surface, lane, batch);
+                continue;
+            }
+
+            if(success) {
+                const BsdfSample& batched = samples[lane];
+                bool matches = sample.flags == batched.flags
+                            && sample.medium.phaseFunction == batched.medium.phaseFunction
+                            && Matches(sample.medium.extinction, batched.medium.extinction)
+                            && Matches(sample.reflectance, batched.reflectance)
+                            && Matches(sample.wi, batched.wi)
+                            && Matches(sample.forwardPdfW, batched.forwardPdfW)
+                            && Matches(sample.reversePdfW, batched.reversePdfW);
+                if(!matches) {
+                    ReportMismatch(validation, "SampleBsdfFunction8", surface, lane, batch);
+                }
+            }
+        }
+
+        sampler.Shutdown();
+    }
+
+    //=============================================================================================================================
+    bool ValidateBatchedBsdfs()
+    {
+        Random::Pcg32 pcg;
+        Random::Pcg32Initialize(&pcg, 0x5eed, 7);
+
+        BsdfValidation validation;
+        validation.lanes = 0;
+        validation.mismatches = 0;
+
+        for(uint64 batch = 0; batch < ValidationBatchCount_; ++batch) {
+            // -- Mostly full batches with some partial ones so the unused lanes are covered too
+            uint count = (batch % 4 == 3) ? 1 + Random::Pcg32Uint32(&pcg) % Float8LaneCount_ : Float8LaneCount_;
+
+            SurfaceParameters surfaces[Float8LaneCount_];
+            float3 views[Float8LaneCount_];
+            float3 lights[Float8LaneCount_];
+            for(uint lane = 0; lane < count; ++lane) {
+                RandomSurface(&pcg, surfaces[lane]);
+                views[lane] = surfaces[lane].view;
+                lights[lane] = RandomSphereDirection(&pcg);
+            }
+
+            ValidateBatch(surfaces, views, lights, count, (uint32)batch, batch, &validation);
+        }
+
+        WriteDebugInfo_("Batched bsdf validation: %llu of %llu lanes differ from the scalar bsdf", validation.mismatches,
+                        validation.lanes);
+        return validation.mismatches == 0;
+    }
+}
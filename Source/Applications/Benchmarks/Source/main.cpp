@@ -0,0 +1,112 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Benchmark.h"
+
+#include "TextureLib/TextureFiltering.h"
+#include "ThreadingLib/JobSystem.h"
+#include "StringLib/StringUtil.h"
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/BasicTypes.h"
+#include "SystemLib/Logging.h"
+
+#include "xmmintrin.h"
+#include "pmmintrin.h"
+#include <stdio.h>
+
+using namespace Selas;
+
+//=================================================================================================================================
+static void ReadBenchmarkSettings(int argc, char *argv[], BenchmarkSettings& settings, cpointer& outputPath)
+{
+    // -- -filter <substring> -out <results.json> -warmup <repetitions> -repetitions <min> -maxrepetitions <max>
+    // -- -seconds <minimum measured time per benchmark>
+    for(int scan = 1; scan + 1 < argc; scan += 2) {
+        if(StringUtil::Equals(argv[scan], "-filter")) {
+            settings.filter = argv[scan + 1];
+        }
+        else if(StringUtil::Equals(argv[scan], "-out")) {
+            outputPath = argv[scan + 1];
+        }
+        else if(StringUtil::Equals(argv[scan], "-warmup")) {
+            settings.warmupRepetitions = (Selas::uint)StringUtil::ToInt32(argv[scan + 1]);
+        }
+        else if(StringUtil::Equals(argv[scan], "-repetitions")) {
+            settings.minRepetitions = (Selas::uint)StringUtil::ToInt32(argv[scan + 1]);
+        }
+        else if(StringUtil::Equals(argv[scan], "-maxrepetitions")) {
+            settings.maxRepetitions = (Selas::uint)StringUtil::ToInt32(argv[scan + 1]);
+        }
+        else if(StringUtil::Equals(argv[scan], "-seconds")) {
+            settings.minSeconds = StringUtil::ToFloat(argv[scan + 1]);
+        }
+        else {
+            WriteDebugInfo_("Ignoring unknown argument %s", argv[scan]);
+        }
+    }
+}
+
+//=================================================================================================================================
+int main(int argc, char *argv[])
+{
+    // -- Same floating point state as the renderer so denormals cost the same
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+    BenchmarkSettings settings;
+    settings.filter = nullptr;
+    settings.warmupRepetitions = 3;
+    settings.minRepetitions = 15;
+    settings.maxRepetitions = 200;
+    settings.minSeconds = 0.25f;
+
+    // -- Results go to a file rather than stdout since the summaries are logged there on some platforms
+    cpointer outputPath = "Benchmarks.json";
+    ReadBenchmarkSettings(argc, argv, settings, outputPath);
+
+    // -- Timings of batched kernels that no longer match their scalar versions are meaningless so stop before writing any
+    if(ValidateBatchedBsdfs() == false) {
+        WriteDebugInfo_("Batched bsdfs failed validation against the scalar bsdfs");
+        return -1;
+    }
+
+    FILE* output = nullptr;
+    #if IsWindows_
+        fopen_s(&output, outputPath, "w");
+    #else
+        output = fopen(outputPath, "w");
+    #endif
+    if(output == nullptr) {
+        WriteDebugInfo_("Failed to open benchmark results file %s", outputPath);
+        return -1;
+    }
+
+    JobSystem_Initialize();
+    TextureFiltering::InitializeEWAFilterWeights();
+
+    BenchmarkContext context;
+    Benchmark_Initialize(&context, settings, output);
+
+    // -- Suites measure kernels on synthetic data. Comparisons that need full renders, such as the time to equal error of VCM
+    // -- and the deferred path tracer, are run by Selas with -equalerror.
+    RunShadingBenchmarks(&context);
+    RunPathShadingBenchmarks(&context);
+    RunTextureBenchmarks(&context);
+    RunLightingBenchmarks(&context);
+    RunSortingBenchmarks(&context);
+    RunHashGridBenchmarks(&context);
+    RunIoBenchmarks(&context);
+    RunFramebufferBenchmarks(&context);
+    RunBatcherBenchmarks(&context);
+
+    Benchmark_Shutdown(&context);
+    fclose(output);
+
+    WriteDebugInfo_("Wrote %u benchmark results to %s", (uint32)context.resultCount, outputPath);
+
+    JobSystem_Shutdown();
+    ThreadArena_ShutdownAll();
+
+    return 0;
+}
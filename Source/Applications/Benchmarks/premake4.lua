@@ -0,0 +1,23 @@
+
+dofile("../../../ProjectGen/common.lua")
+
+local SolutionName = "Benchmarks"
+local Architecture = "x64"
+local ExtraLibraries = { "SceneLib", "TextureLib", "GeometryLib", "Shading", "BuildCore", "BuildCommon" }
+
+if _ARGS[1] == "osx" then
+	ExtraDefines = { "IsOsx_=1" }
+	Platform = "osx"
+else
+	ExtraDefines = { "IsWindows_=1" }
+	Platform = "Win64"
+end
+
+SetupConsoleApplication(SolutionName, Architecture, Platform, ExtraDefines, ExtraLibraries)
+
+-- The VCM hash grid is part of the renderer rather than a library so its sources are built in here as well
+configuration {}
+project "Application"
+	includedirs { "../Selas/Source" }
+	files { "../Selas/Source/VCMHashGrid.cpp", "../Selas/Source/VCMHashGrid.h", "../Selas/Source/VCMCommon.cpp",
+	        "../Selas/Source/VCMCommon.h" }
\ No newline at end of file
@@ -3,7 +3,7 @@
 // Joe Schutte
 //=================================================================================================================================
 
-#include "PathTracer.h"
+#include "DeferredPathTracer.h"
 #include "SceneLib/SceneResource.h"
 #include "SceneLib/GeometryCache.h"
 #include "Shading/SurfaceScattering.h"
@@ -12,6 +12,9 @@
 #include "Shading/IntegratorContexts.h"
 #include "Shading/AreaLighting.h"
 #include "Shading/PathTracingBatcher.h"
+#include "Shading/PathShading.h"
+#include "TextureLib/TextureFiltering.h"
+#include "StringLib/FixedString.h"
 #include "GeometryLib/Camera.h"
 #include "GeometryLib/Ray.h"
 #include "MathLib/FloatFuncs.h"
@@ -19,10 +22,13 @@
 #include "MathLib/Trigonometric.h"
 #include "MathLib/ImportanceSampling.h"
 #include "MathLib/Random.h"
-#include "ThreadingLib/Thread.h"
+#include "ThreadingLib/JobSystem.h"
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
 #include "SystemLib/Memory.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/MinMax.h"
@@ -36,10 +42,14 @@
 #define RayBatchSize_         1 Mb_
 #define HitBatchSize_         512 Kb_
 
-#define WorkerThreadCount_    15
 #define SamplesPerPixelX_     2
 #define SamplesPerPixelY_     2
-#define OutputLayers_         1
+#define SamplesPerPass_       (SamplesPerPixelX_ * SamplesPerPixelY_)
+#define FramebufferAovs_      (eAlbedoAov | eNormalAov | eDepthAov | eSampleCountAov | eVarianceAov | eHalfAovStorage)
+#define FramebufferFlags_     (FramebufferAovs_ | eFixedPointAccumulation)
+
+// -- When enabled hits are queued and shaded in batches sorted by material and texture rather than as soon as they are found
+#define SortHitsBeforeShading_    1
 
 namespace Selas
 {
@@ -52,101 +62,44 @@ namespace Selas
             Framebuffer*                 frame;
             volatile int64               kernelCounter;
             volatile int64               pixelIndex;
+            uint32                       pass;
             const SceneResource*         scene;
             GeometryCache*               geometryCache;
             TextureCache*                textureCache;
         };
 
         //=========================================================================================================================
-        static void ShadeHitPosition(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
-                                     const HitParameters& hit)
+        static void ShadeHits(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
+                              const HitParameters* hits, uint hitCount)
         {
-            SurfaceParameters surface;
-            if(CalculateSurfaceParams(context, &hit, surface) == false) {
-                return;
-            }
+            ProfileEventMarker_(0, "ShadeHits");
 
-            // -- choose a light and sample the light source
-            LightDirectSample lightSample;
-            NextEventEstimation(context, surface.lightSetIndex, hit.position, GeometricNormal(surface), lightSample);
-            if(Dot(lightSample.radiance, float3::One_) > 0) {
-                float forwardPdfW;
-                float reversePdfW;
-                float3 reflectance = EvaluateBsdf(surface, hit.view, lightSample.direction, forwardPdfW,
-                                                  reversePdfW);
-
-                float weight = 1.0f;// ImportanceSampling::BalanceHeuristic(1, lightSample.pdfW, 1, forwardPdfW);
-
-                float3 sample = weight * reflectance * lightSample.radiance * (1.0f / lightSample.pdfW);
-                if(Dot(sample, float3::One_) > 0) {
-                    float3 offset = OffsetRayOrigin(surface, lightSample.direction, 0.1f);
-
-                    OcclusionRay occlusionRay;
-                    occlusionRay.ray = MakeRay(offset, lightSample.direction);
-                    occlusionRay.distance = lightSample.distance;
-                    occlusionRay.index = hit.index;
-                    occlusionRay.value = sample * hit.throughput;
-                    ptBatcher->AddUnsortedOcclusionRay(occlusionRay);
-                }
-            }
+            for(uint batchStart = 0; batchStart < hitCount; batchStart += TextureBatchWidth) {
+                uint batchSize = Min<uint>(hitCount - batchStart, TextureBatchWidth);
+                const HitParameters* batchHits = hits + batchStart;
 
-            LightDirectSample skySample;
-            SampleBackground(context, skySample);
-            if(Dot(skySample.radiance, float3::One_) > 0) {
-                float forwardPdfW;
-                float reversePdfW;
-                float3 reflectance = EvaluateBsdf(surface, hit.view, skySample.direction, forwardPdfW, reversePdfW);
-
-                float misWeight = ImportanceSampling::BalanceHeuristic(1, skySample.pdfW, 1, forwardPdfW);
-
-                float3 sample = misWeight * reflectance * skySample.radiance * (1.0f / skySample.pdfW);
-                if(Dot(sample, float3::One_) > 0) {
-                    float3 offset = OffsetRayOrigin(surface, skySample.direction, 0.1f);
-
-                    OcclusionRay occlusionRay;
-                    occlusionRay.ray = MakeRay(offset, skySample.direction);
-                    occlusionRay.distance = skySample.distance;
-                    occlusionRay.index = hit.index;
-                    occlusionRay.value = sample * hit.throughput;
-                    ptBatcher->AddUnsortedOcclusionRay(occlusionRay);
-                }
-            }
+                ShadedHitBatch shaded;
+                ShadeHitBatch(context, batchHits, batchSize, &shaded);
 
-            {
-                // - sample the bsdf
-                BsdfSample bsdfSample;
-                if(SampleBsdfFunction(&context->sampler, surface, hit.view, bsdfSample) == false) {
-                    return;
+                for(uint scan = 0; scan < shaded.shadowRayCount; ++scan) {
+                    FramebufferWriter_BeginWork(&context->frameWriter, shaded.shadowRays[scan].index);
+                    ptBatcher->AddUnsortedOcclusionRay(shaded.shadowRays[scan]);
                 }
 
-                float skyPdfW = BackgroundLightingPdf(context, bsdfSample.wi);
-                float misWeight = ImportanceSampling::BalanceHeuristic(1, bsdfSample.forwardPdfW, 1, skyPdfW);
-
-                float3 throughput = misWeight * hit.throughput * bsdfSample.reflectance;
-                if(LengthSquared(throughput) == 0.0f) {
-                    return;
-                }
-
-                // --Russian roulette path termination
-                if(hit.trackedBounces >= MaxTrackedBounces_) {
-                    float continuationProb = Max<float>(Max<float>(throughput.x, throughput.y), throughput.z);
-                    if(context->sampler.UniformFloat() >= continuationProb) {
-                        return;
+                uint bounceCount = 0;
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    if(shaded.continued[scan]) {
+                        FramebufferWriter_BeginWork(&context->frameWriter, batchHits[scan].index);
+                        ptBatcher->AddUnsortedDeferredRay(shaded.bounceRays[scan]);
+                        ++bounceCount;
                     }
-                    Assert_(continuationProb > 0.0f);
-                    throughput = throughput * (1.0f / continuationProb);
-                }
 
-                float3 offsetOrigin = OffsetRayOrigin(surface, bsdfSample.wi, 1.0f);
+                    // -- The hit's unit of work is released once everything it queued holds one of its own
+                    FramebufferWriter_EndWork(&context->frameWriter, batchHits[scan].index);
+                }
 
-                DeferredRay bounceRay;
-                bounceRay.error = hit.error;
-                bounceRay.index = hit.index;
-                bounceRay.diracScatterOnly = hit.diracScatterOnly && bsdfSample.flags & SurfaceEventFlags::eDiracEvent;
-                bounceRay.ray = MakeRay(offsetOrigin, bsdfSample.wi);
-                bounceRay.throughput = throughput;
-                bounceRay.trackedBounces = Min<uint32>(MaxTrackedBounces_, hit.trackedBounces + 1);
-                ptBatcher->AddUnsortedDeferredRay(bounceRay);
+                RenderStats_Add(eRenderCounterShadowRays, shaded.shadowRayCount);
+                RenderStats_Add(eRenderCounterBounceRays, bounceCount);
             }
         }
 
@@ -154,6 +107,9 @@ namespace Selas
         static void TraceRayBatch(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
                                   DeferredRay* rays, uint rayCount)
         {
+            ProfileEventMarker_(0, "TraceRayBatch");
+            RenderStats_Add(eRenderCounterRaysTraced, rayCount);
+
             #define BatchSize_ 8
             uint batchCount = (rayCount + BatchSize_ - 1) / BatchSize_;
 
@@ -192,10 +148,10 @@ namespace Selas
 
                 rtcIntersect8(valid, context->rtcScene, &rtcContext, &rayhit);
 
-                for(uint scan = 0; scan < BatchSize_; ++scan) {
-                    float3 Ld[OutputLayers_];
-                    Memory::Zero(Ld, sizeof(Ld));
+                HitParameters hits[BatchSize_];
+                uint hitCount = 0;
 
+                for(uint scan = 0; scan < batchSize; ++scan) {
                     if(valid[scan] == 0 || rayhit.hit.geomID[scan] == RTC_INVALID_GEOMETRY_ID) {
 
                         float3 sample;
@@ -204,12 +160,19 @@ namespace Selas
                         else
                             sample = EvaluateBackground(context, startRay[scan].ray.direction);
 
-                        Ld[0] += sample * startRay[scan].throughput;
-                        FramebufferWriter_Write(&context->frameWriter, Ld, OutputLayers_, startRay[scan].index);
+                        if(startRay[scan].trackedBounces == 0) {
+                            FramebufferPrimarySample primary;
+                            Memory::Zero(&primary, sizeof(primary));
+                            FramebufferWriter_WritePrimary(&context->frameWriter, primary, startRay[scan].index);
+                        }
+
+                        FramebufferWriter_Write(&context->frameWriter, sample * startRay[scan].throughput,
+                                                startRay[scan].index);
+                        FramebufferWriter_EndWork(&context->frameWriter, startRay[scan].index);
                         continue;
                     }
 
-                    HitParameters hit;
+                    HitParameters& hit = hits[hitCount++];
                     hit.position.x       = rayhit.ray.org_x[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_x[scan];
                     hit.position.y       = rayhit.ray.org_y[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_y[scan];
                     hit.position.z       = rayhit.ray.org_z[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_z[scan];
@@ -226,16 +189,29 @@ namespace Selas
                     hit.diracScatterOnly = startRay[scan].diracScatterOnly;
                     hit.trackedBounces   = startRay[scan].trackedBounces;
                     hit.throughput       = startRay[scan].throughput;
-
-                    //ptBatcher->AddUnsortedHit(hit);
-                    ShadeHitPosition(context, ptBatcher, hit);
+                    hit.sampleIndex      = startRay[scan].sampleIndex;
+                    hit.bounce           = startRay[scan].bounce;
+                    hit.shadingKey       = 0;
                 }
+
+                #if SortHitsBeforeShading_
+                    // -- Each ray's unit of work passes to its queued hit and is released once that hit is shaded
+                    for(uint scan = 0; scan < hitCount; ++scan) {
+                        hits[scan].shadingKey = CalculateShadingKey(context, &hits[scan]);
+                        ptBatcher->AddUnsortedHit(hits[scan]);
+                    }
+                #else
+                    ShadeHits(context, ptBatcher, hits, hitCount);
+                #endif
             }
         }
 
         //=========================================================================================================================
         static void TraceOcclusionBatch(GIIntegratorContext* __restrict context, OcclusionRay* rays, uint rayCount)
         {
+            ProfileEventMarker_(0, "TraceOcclusionBatch");
+            RenderStats_Add(eRenderCounterRaysTraced, rayCount);
+
             #define BatchSize_ 8
             uint batchCount = (rayCount + BatchSize_ - 1) / BatchSize_;
 
@@ -268,59 +244,63 @@ namespace Selas
 
                 rtcOccluded8(valid, context->rtcScene, &rtcContext, &ray);
 
-                for(uint scan = 0; scan < BatchSize_; ++scan) {
-                    if(valid[scan] == -1 && ray.tfar[scan] >= 0.0f) {
-
-                        float3 Ld[OutputLayers_];
-                        Memory::Zero(Ld, sizeof(Ld));
-
-                        Ld[0] = startRay[scan].value;
-                        FramebufferWriter_Write(&context->frameWriter, Ld, OutputLayers_, startRay[scan].index);
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    if(ray.tfar[scan] >= 0.0f) {
+                        FramebufferWriter_Write(&context->frameWriter, startRay[scan].value, startRay[scan].index);
                     }
+                    FramebufferWriter_EndWork(&context->frameWriter, startRay[scan].index);
                 }
             }
         }
 
         //=========================================================================================================================
-        static void ShadeHitBatch(GIIntegratorContext* __restrict context, PathTracingBatcher* ptBatcher,
-                                  HitParameters* hits, uint hitCount)
+        static void GeneratePrimaryRays(CSampler* sampler, FramebufferWriter* frameWriter, KernelData* __restrict kernelData)
         {
-            for(uint scan = 0; scan < hitCount; ++scan) {
-                ShadeHitPosition(context, ptBatcher, hits[scan]);
-            }
-        }
+            ProfileEventMarker_(0, "GeneratePrimaryRays");
 
-        //=========================================================================================================================
-        static void GeneratePrimaryRays(CSampler* sampler, KernelData* __restrict kernelData)
-        {
             uint width = kernelData->camera->width;
             uint height = kernelData->camera->height;
 
             int64 endIndex = width * height;
 
+            // -- Each pass draws its samples from a different multi-jittered pattern
+            uint32 patternOffset = kernelData->pass * (uint32)endIndex;
+
             while(true) {
                 int64 index = Atomic::Increment64(&kernelData->pixelIndex);
                 if(index >= endIndex) {
                     break;
                 }
 
+                if(PixelConverged(kernelData->frame, (uint32)index, kernelData->pass)) {
+                    FramebufferWriter_EndWork(frameWriter, (uint32)index);
+                    continue;
+                }
+
                 uint y = index / width;
                 uint x = index - (y * width);
 
-                uint sampleCount = SamplesPerPixelX_ * SamplesPerPixelY_;
-
-                for(uint scan = 0; scan < sampleCount; ++scan) {
+                for(uint scan = 0; scan < SamplesPerPass_; ++scan) {
 
                     DeferredRay dr;
                     dr.ray              = JitteredCameraRay(kernelData->camera, (int32)x, (int32)y, (int32)scan,
-                                                            SamplesPerPixelX_, SamplesPerPixelY_, (int32)index);
+                                                            SamplesPerPixelX_, SamplesPerPixelY_,
+                                                            (int32)(patternOffset + (uint32)index));
                     dr.error            = 0.0f;
                     dr.index            = (uint32)(y * width + x);
                     dr.diracScatterOnly = 1;
                     dr.throughput       = float3::One_;
                     dr.trackedBounces   = 0;
+                    dr.sampleIndex      = kernelData->pass * SamplesPerPass_ + scan;
+                    dr.bounce           = 0;
+                    FramebufferWriter_BeginWork(frameWriter, dr.index);
                     kernelData->ptBatcher->AddUnsortedDeferredRay(dr);
                 }
+
+                RenderStats_Add(eRenderCounterPrimaryRays, SamplesPerPass_);
+
+                // -- Release the pixel's own unit of work now that all of its camera rays are accounted for
+                FramebufferWriter_EndWork(frameWriter, (uint32)index);
             }
         }
 
@@ -341,7 +321,7 @@ namespace Selas
             context.maxPathLength = 1;
             FramebufferWriter_Initialize(&context.frameWriter, kernelData->frame);
 
-            GeneratePrimaryRays(&context.sampler, kernelData);
+            GeneratePrimaryRays(&context.sampler, &context.frameWriter, kernelData);
 
             // JSTODO -- Change stop condition to be that this is empty and that all worker kernels report as idle
             //        -- so no threads exit when they could be useful later.
@@ -354,7 +334,7 @@ namespace Selas
                 uint hitCount;
 
                 if(kernelData->ptBatcher->GetSortedHits(hitParams, hitCount)) {
-                    ShadeHitBatch(&context, kernelData->ptBatcher, hitParams, hitCount);
+                    ShadeHits(&context, kernelData->ptBatcher, hitParams, hitCount);
                     kernelData->ptBatcher->FreeHits(hitParams);
                 }
                 else if(kernelData->ptBatcher->GetSortedBatch(occlusionRays, rayCount)) {
@@ -375,47 +355,58 @@ namespace Selas
         }
 
         //=========================================================================================================================
-        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName)
+        static void DeferredPathTracerKernels(void* userData, uint start, uint end)
         {
-            PathTracingBatcher ptBatcher;
-            ptBatcher.Initialize(RayBatchSize_, HitBatchSize_);
+            for(uint scan = start; scan < end; ++scan) {
+                DeferredPathTracerKernel(userData);
+            }
+        }
+
+        //=========================================================================================================================
+        static void RenderPass(void* userData, uint32 pass)
+        {
+            KernelData* kernelData = (KernelData*)userData;
+            kernelData->pixelIndex = 0;
+            kernelData->pass = pass;
 
+            // -- One kernel per thread. Kernels keep draining the batcher until it is empty so a thread that starts late just
+            // -- finds less to do.
+            JobSystem_ParallelFor(JobSystem_ThreadCount(), 1, DeferredPathTracerKernels, kernelData);
+        }
+
+        //=========================================================================================================================
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const ProgressiveSettings& settings, cpointer imageName)
+        {
             Framebuffer frame;
-            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, OutputLayers_);
+            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, FramebufferFlags_);
+
+            PathTracingBatcher ptBatcher;
+            ptBatcher.Initialize(RayBatchSize_, HitBatchSize_);
 
             KernelData kernelData;
             kernelData.camera = &camera;
             kernelData.kernelCounter = 0;
             kernelData.pixelIndex = 0;
+            kernelData.pass = 0;
             kernelData.ptBatcher = &ptBatcher;
             kernelData.frame = &frame;
             kernelData.geometryCache = geometryCache;
             kernelData.textureCache = textureCache;
             kernelData.scene = scene;
 
-            #if WorkerThreadCount_ > 0
-                ThreadHandle threadHandles[WorkerThreadCount_];
+            Error error = RenderProgressive(&frame, textureCache, settings, SamplesPerPass_, imageName, RenderPass, &kernelData);
 
-                // -- fork threads
-                for(uint scan = 0; scan < WorkerThreadCount_; ++scan) {
-                    threadHandles[scan] = CreateThread(DeferredPathTracerKernel, &kernelData);
-                }
-            #endif
-
-            DeferredPathTracerKernel(&kernelData);
-
-            #if WorkerThreadCount_ > 0
-                for(uint scan = 0; scan < WorkerThreadCount_; ++scan) {
-                    ShutdownThread(threadHandles[scan]);
-                }
-            #endif
+            uint64 localEntries;
+            uint64 remoteEntries;
+            ptBatcher.NodeTraffic(localEntries, remoteEntries);
+            WriteDebugInfo_("Batched entries consumed on their own node %llu, on another node %llu over %u nodes", localEntries,
+                            remoteEntries, JobSystem_NodeCount());
 
-            FrameBuffer_Scale(&frame, (1.0f / (SamplesPerPixelX_ * SamplesPerPixelY_)));
-            FrameBuffer_Save(&frame, imageName);
             FrameBuffer_Shutdown(&frame);
-
             ptBatcher.Shutdown();
+
+            return error;
         }
     }
 }
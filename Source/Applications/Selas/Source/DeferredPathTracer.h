@@ -4,8 +4,10 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "ProgressiveRender.h"
 #include "UtilityLib/Color.h"
 #include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
@@ -17,7 +19,7 @@ namespace Selas
 
     namespace DeferredPathTracer
     {
-        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName);
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const ProgressiveSettings& settings, cpointer imageName);
     }
 }
\ No newline at end of file
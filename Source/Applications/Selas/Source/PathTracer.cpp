@@ -25,7 +25,7 @@
 #include "MathLib/Projection.h"
 #include "MathLib/Quaternion.h"
 #include "ContainersLib/Rect.h"
-#include "ThreadingLib/Thread.h"
+#include "ThreadingLib/JobSystem.h"
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/MemoryAllocation.h"
@@ -41,9 +41,13 @@
 
 #define MaxBounceCount_         2048
 
-#define AdditionalThreadCount_  6
+#define TileSize_               16
 #define PathsPerPixel_          16
-#define LayerCount_             2
+#define FramebufferAovs_        (eAlbedoAov | eNormalAov | eDepthAov | eSampleCountAov | eVarianceAov)
+
+// -- Paths per pixel stop early once the pixel's relative standard error falls below the threshold
+#define AdaptiveMinPaths_       4
+#define AdaptiveErrorThreshold_ 0.02f
 
 namespace Selas
 {
@@ -52,17 +56,13 @@ namespace Selas
         //=========================================================================================================================
         struct PathTracingKernelData
         {
-            GeometryCache* geometryCache;
-            TextureCache* textureCache;
-            SceneResource* scene;
             RayCastCameraSettings camera;
             uint pathsPerPixel;
-            uint maxBounceCount;
+            uint tileCountX;
             std::chrono::high_resolution_clock::time_point integrationStartTime;
 
-            volatile uint64* pixelIndex;
-            volatile int64* completedThreads;
-            volatile int64* kernelIndices;
+            // -- One per job system thread
+            GIIntegratorContext* threadContexts;
 
             Framebuffer* frame;
         };
@@ -139,10 +139,12 @@ namespace Selas
         }
 
         //=========================================================================================================================
-        static void EvaluatePath(GIIntegratorContext* __restrict context, Ray ray, uint x, uint y)
+        static float3 EvaluatePath(GIIntegratorContext* __restrict context, Ray ray, uint x, uint y)
         {
-            float3 Ld[LayerCount_];
-            Memory::Zero(Ld, sizeof(Ld));
+            float3 Ld = float3::Zero_;
+
+            FramebufferPrimarySample primary;
+            Memory::Zero(&primary, sizeof(primary));
 
             float3 throughput = float3::One_;
 
@@ -188,7 +190,7 @@ namespace Selas
                             if(OcclusionRay(context->scene->rtcScene, surface, lightSample.direction, lightSample.distance)) {
 
                                 float3 sample = reflectance * lightSample.radiance * (1.0f / lightSample.pdfW);
-                                Ld[1] += sample * throughput;
+                                Ld += sample * throughput;
                             }
                         }
                     }
@@ -211,8 +213,8 @@ namespace Selas
                                 currentMedium = vacuum;
                         }
 
-                        float lightPdfW = LightingPdf(context, surface.lightSetIndex, lightSample, surface.position,
-                                                      bsdfSample.wi);
+                        float lightPdfW = LightingPdf(context, surface.lightSetIndex, lightSample, hit.position,
+                                                      GeometricNormal(surface), bsdfSample.wi);
                         float weight = 1.0f;// ImportanceSampling::BalanceHeuristic(1, bsdfSample.forwardPdfW, 1, lightPdfW);
 
                         throughput = weight * throughput * bsdfSample.reflectance;
@@ -221,7 +223,9 @@ namespace Selas
                         ray = MakeRay(offsetOrigin, bsdfSample.wi);
 
                         if(bounceCount == 0) {
-                            Ld[0] = bsdfSample.reflectance;
+                            primary.albedo = surface.baseColor;
+                            primary.normal = GeometricNormal(surface);
+                            primary.depth  = rayDistance;
                         }
                     }
                 }
@@ -238,7 +242,7 @@ namespace Selas
                     else
                         sample = EvaluateBackground(context, ray.direction);
 
-                    Ld[1] += sample * throughput;
+                    Ld += sample * throughput;
                     break;
                 }
 
@@ -254,99 +258,106 @@ namespace Selas
                 }
             }
 
-            FramebufferWriter_Write(&context->frameWriter, Ld, LayerCount_, (uint32)x, (uint32)y);
+            uint32 pixelIndex = (uint32)(y * context->camera->width + x);
+            FramebufferWriter_WritePrimary(&context->frameWriter, primary, pixelIndex);
+            FramebufferWriter_Write(&context->frameWriter, Ld, pixelIndex);
+
+            return Ld;
         }
 
         //=========================================================================================================================
-        static void PathTracerKernel(void* userData)
+        static void RenderPixel(GIIntegratorContext* __restrict context, PathTracingKernelData* integratorContext, uint x, uint y)
         {
-            PathTracingKernelData* integratorContext = static_cast<PathTracingKernelData*>(userData);
-            int64 kernelIndex = Atomic::Increment64(integratorContext->kernelIndices);
+            uint32 pixelIndex = (uint32)(y * integratorContext->camera.width + x);
 
-            uint pathsPerPixel = integratorContext->pathsPerPixel;
+            FramebufferMoments moments;
+            Memory::Zero(&moments, sizeof(moments));
 
-            uint width = integratorContext->camera.width;
-            uint height = integratorContext->camera.height;
-            uint64 totalPixelCount = width * height;
-
-            GIIntegratorContext context;
-            context.geometryCache    = integratorContext->geometryCache;
-            context.textureCache     = integratorContext->textureCache;
-            context.rtcScene         = integratorContext->scene->rtcScene;
-            context.scene            = integratorContext->scene;
-            context.camera           = &integratorContext->camera;
-            context.sampler.Initialize((uint32)kernelIndex);
-            context.maxPathLength    = integratorContext->maxBounceCount;
-            FramebufferWriter_Initialize(&context.frameWriter, integratorContext->frame);
-
-            while(*integratorContext->pixelIndex < totalPixelCount) {
-
-                uint64 pixelIndex = Atomic::AddU64(integratorContext->pixelIndex, 1llu) % totalPixelCount;
-                uint y = pixelIndex / width;
-                uint x = pixelIndex - y * width;
-
-                for(uint scan = 0; scan < pathsPerPixel; ++scan) {
-                    Ray ray = JitteredCameraRay(context.camera, &context.sampler, (float)x, (float)y);
-                    EvaluatePath(&context, ray, x, y);
+            for(uint scan = 0; scan < integratorContext->pathsPerPixel; ++scan) {
+                // -- Keyed by pixel and path so the image does not depend on which thread took the pixel
+                context->sampler.SetSample(pixelIndex, (uint32)scan, 0);
+
+                Ray ray = JitteredCameraRay(context->camera, &context->sampler, (float)x, (float)y);
+                FramebufferMoments_Add(&moments, EvaluatePath(context, ray, x, y));
+
+                if(scan + 1 >= AdaptiveMinPaths_ && FramebufferMoments_RelativeError(moments) < AdaptiveErrorThreshold_) {
+                    break;
                 }
             }
 
-            context.sampler.Shutdown();
+            // -- Each pixel is finished by a single thread so its moments can go straight into the framebuffer
+            FrameBuffer_AddMoments(integratorContext->frame, pixelIndex, moments);
+        }
+
+        //=========================================================================================================================
+        static void PathTracerTiles(void* userData, uint start, uint end)
+        {
+            PathTracingKernelData* integratorContext = static_cast<PathTracingKernelData*>(userData);
+            GIIntegratorContext* context = &integratorContext->threadContexts[JobSystem_ThreadIndex()];
+
+            uint width = integratorContext->camera.width;
+            uint height = integratorContext->camera.height;
+
+            for(uint tileIndex = start; tileIndex < end; ++tileIndex) {
+                uint tileY = tileIndex / integratorContext->tileCountX;
+                uint tileX = tileIndex - tileY * integratorContext->tileCountX;
+
+                uint x0 = tileX * TileSize_;
+                uint y0 = tileY * TileSize_;
+                uint x1 = Min<uint>(x0 + TileSize_, width);
+                uint y1 = Min<uint>(y0 + TileSize_, height);
 
-            FramebufferWriter_Shutdown(&context.frameWriter);
-            Atomic::Increment64(integratorContext->completedThreads);
+                for(uint y = y0; y < y1; ++y) {
+                    for(uint x = x0; x < x1; ++x) {
+                        RenderPixel(context, integratorContext, x, y);
+                    }
+                }
+            }
         }
 
         //=========================================================================================================================
-        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName)
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, cpointer imageName)
         {
             Framebuffer frame;
-            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, LayerCount_);
+            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, FramebufferAovs_);
 
-            int64 completedThreads = 0;
-            int64 kernelIndex = 0;
-            //uint64 pixelIndex = 409600;
-            uint64 pixelIndex = 0;
+            uint threadCount = JobSystem_ThreadCount();
 
             PathTracingKernelData integratorContext;
-            integratorContext.geometryCache          = geometryCache;
-            integratorContext.textureCache           = textureCache;
-            integratorContext.scene                  = scene;
             integratorContext.camera                 = camera;
-            integratorContext.maxBounceCount         = MaxBounceCount_;
             integratorContext.pathsPerPixel          = PathsPerPixel_;
+            integratorContext.tileCountX             = (camera.width + TileSize_ - 1) / TileSize_;
             integratorContext.integrationStartTime   = SystemTime::Now();
-            integratorContext.pixelIndex             = &pixelIndex;
-            integratorContext.completedThreads       = &completedThreads;
-            integratorContext.kernelIndices          = &kernelIndex;
+            integratorContext.threadContexts         = AllocArray_(GIIntegratorContext, threadCount);
             integratorContext.frame                  = &frame;
 
-            #if AdditionalThreadCount_ > 0
-                ThreadHandle threadHandles[AdditionalThreadCount_];
-
-                // -- fork threads
-                for(uint scan = 0; scan < AdditionalThreadCount_; ++scan) {
-                    threadHandles[scan] = CreateThread(PathTracerKernel, &integratorContext);
-                }
-            #endif
-
-            // -- do work on the main thread too
-            PathTracerKernel(&integratorContext);
+            for(uint scan = 0; scan < threadCount; ++scan) {
+                GIIntegratorContext& context = integratorContext.threadContexts[scan];
+                context.geometryCache    = geometryCache;
+                context.textureCache     = textureCache;
+                context.rtcScene         = scene->rtcScene;
+                context.scene            = scene;
+                context.camera           = &integratorContext.camera;
+                context.sampler.Initialize((uint32)scan);
+                context.maxPathLength    = MaxBounceCount_;
+                FramebufferWriter_Initialize(&context.frameWriter, &frame);
+            }
 
-            #if AdditionalThreadCount_ > 0
-                // -- wait for any other threads to finish
-                while(*integratorContext.completedThreads != *integratorContext.kernelIndices);
+            // -- Small tiles keep the tail short when a few pixels are much more expensive than the rest
+            uint tileCountY = (camera.height + TileSize_ - 1) / TileSize_;
+            JobSystem_ParallelFor(integratorContext.tileCountX * tileCountY, 1, PathTracerTiles, &integratorContext);
 
-                for(uint scan = 0; scan < AdditionalThreadCount_; ++scan) {
-                    ShutdownThread(threadHandles[scan]);
-                }
-            #endif
-
-            FrameBuffer_Scale(&frame, (1.0f / PathsPerPixel_));
+            for(uint scan = 0; scan < threadCount; ++scan) {
+                integratorContext.threadContexts[scan].sampler.Shutdown();
+                FramebufferWriter_Shutdown(&integratorContext.threadContexts[scan].frameWriter);
+            }
+            Free_(integratorContext.threadContexts);
 
-            FrameBuffer_Save(&frame, imageName);
+            Error error = FrameBuffer_SaveExr(&frame, imageName, 0.0f);
             FrameBuffer_Shutdown(&frame);
+
+            return error;
         }
     }
 }
@@ -6,6 +6,7 @@
 
 #include "UtilityLib/Color.h"
 #include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
@@ -17,7 +18,7 @@ namespace Selas
 
     namespace PathTracer
     {
-        void GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
-                           const RayCastCameraSettings& camera, cpointer imageName);
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, cpointer imageName);
     }
 }
\ No newline at end of file
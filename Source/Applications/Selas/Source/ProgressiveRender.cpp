@@ -0,0 +1,160 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ProgressiveRender.h"
+#include "TextureLib/TextureCache.h"
+#include "TextureLib/Framebuffer.h"
+#include "StringLib/FixedString.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/Logging.h"
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static bool WithinBudget(const ProgressiveSettings& settings, uint32 passCount, float seconds)
+    {
+        if(settings.maxPasses > 0 && passCount > settings.maxPasses) {
+            return false;
+        }
+        if(settings.integrationSeconds > 0.0f && seconds > settings.integrationSeconds) {
+            return false;
+        }
+        return true;
+    }
+
+    //=============================================================================================================================
+    void ProgressiveError_Initialize(ProgressiveErrorTracker* tracker, const Framebuffer* frame,
+                                     const ProgressiveSettings& settings)
+    {
+        tracker->scratch = nullptr;
+        tracker->measureSeconds = 0.0f;
+        tracker->error = FloatMax_;
+
+        if(settings.errorReference != nullptr) {
+            tracker->scratch = AllocArray_(float3, frame->width * frame->height);
+        }
+    }
+
+    //=============================================================================================================================
+    void ProgressiveError_Shutdown(ProgressiveErrorTracker* tracker)
+    {
+        SafeFree_(tracker->scratch);
+    }
+
+    //=============================================================================================================================
+    bool ProgressiveError_Measure(ProgressiveErrorTracker* tracker, Framebuffer* frame, const ProgressiveSettings& settings,
+                                  float beautyScale, uint32 passCount, float renderSeconds)
+    {
+        if(settings.errorReference == nullptr) {
+            return false;
+        }
+
+        auto measureStart = SystemTime::Now();
+
+        uint32 pixelCount = frame->width * frame->height;
+        FrameBuffer_ResolveBeauty(frame, beautyScale, tracker->scratch);
+
+        // -- Accumulated in double since the island renders have hundreds of thousands of pixels
+        double sum = 0.0;
+        for(uint32 scan = 0; scan < pixelCount; ++scan) {
+            float3 delta = tracker->scratch[scan] - settings.errorReference[scan];
+            sum += Dot(delta, delta);
+        }
+        tracker->error = Math::Sqrtf((float)(sum / (3.0 * pixelCount)));
+
+        tracker->measureSeconds += SystemTime::ElapsedSecondsF(measureStart);
+
+        WriteDebugInfo_("Pass %u error %f after %fs", passCount, tracker->error, renderSeconds);
+        return tracker->error <= settings.targetError;
+    }
+
+    //=============================================================================================================================
+    Error RenderProgressive(Framebuffer* frame, TextureCache* textureCache, const ProgressiveSettings& settings,
+                            uint32 samplesPerPass, cpointer imageName, RenderPassFunction renderPass, void* userData)
+    {
+        Assert_(settings.maxPasses > 0 || settings.integrationSeconds > 0.0f);
+
+        FilePathString checkpointName;
+        FixedStringSprintf(checkpointName, "%s_checkpoint", imageName);
+
+        auto integrationStart = SystemTime::Now();
+        auto lastCheckpoint = integrationStart;
+
+        ProgressiveErrorTracker errorTracker;
+        ProgressiveError_Initialize(&errorTracker, frame, settings);
+
+        Error error = Success_;
+        uint32 passCount = 0;
+        while(true) {
+            float elapsed = SystemTime::ElapsedSecondsF(integrationStart) - errorTracker.measureSeconds;
+            float passSeconds = passCount > 0 ? elapsed / passCount : 0.0f;
+
+            // -- Passes are never cut short so stop before starting one that is not expected to fit
+            if(passCount > 0 && WithinBudget(settings, passCount + 1, elapsed + passSeconds) == false) {
+                break;
+            }
+
+            // -- When there will be no room for another pass after this one its tiles are streamed out as they finish
+            bool finalPass = WithinBudget(settings, passCount + 2, elapsed + 2.0f * passSeconds) == false;
+            if(finalPass) {
+                error = FrameBuffer_BeginStream(frame, imageName, 0.0f);
+                if(Failed_(error)) {
+                    break;
+                }
+            }
+
+            renderPass(userData, passCount);
+            ThreadArena_ResetAll();
+            Profiler_FlushFrame();
+            textureCache->ReportStats();
+            RenderStats_FlushFrame(imageName, passCount);
+            ++passCount;
+
+            // -- Streamed tiles are written before this so the final pass is missing from their variance channel
+            FrameBuffer_AccumulatePassMoments(frame, samplesPerPass);
+
+            float renderSeconds = SystemTime::ElapsedSecondsF(integrationStart) - errorTracker.measureSeconds;
+            WriteDebugInfo_("Pass %u complete after %fs", passCount, renderSeconds);
+
+            bool reachedError = ProgressiveError_Measure(&errorTracker, frame, settings, 0.0f, passCount, renderSeconds);
+            if(finalPass) {
+                break;
+            }
+
+            if(reachedError) {
+                WriteDebugInfo_("Reached error %f after %fs of rendering", errorTracker.error, renderSeconds);
+                break;
+            }
+
+            if(settings.checkpointSeconds > 0.0f && SystemTime::ElapsedSecondsF(lastCheckpoint) >= settings.checkpointSeconds) {
+                error = FrameBuffer_SaveExr(frame, checkpointName.Ascii(), 0.0f);
+                if(Failed_(error)) {
+                    break;
+                }
+                lastCheckpoint = SystemTime::Now();
+            }
+        }
+
+        if(frame->stream != nullptr) {
+            error = FrameBuffer_EndStream(frame);
+        }
+        else if(Successful_(error)) {
+            error = FrameBuffer_SaveExr(frame, imageName, 0.0f);
+        }
+
+        if(settings.beautyOutput != nullptr) {
+            FrameBuffer_ResolveBeauty(frame, 0.0f, settings.beautyOutput);
+        }
+
+        ProgressiveError_Shutdown(&errorTracker);
+        return error;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    class TextureCache;
+    struct Framebuffer;
+
+    // -- Rendering runs in passes of a fixed number of samples per pixel until running another pass would exceed either
+    // -- budget. A budget of zero is unlimited but at least one of them must be set.
+    struct ProgressiveSettings
+    {
+        ProgressiveSettings()
+            : integrationSeconds(0.0f)
+            , maxPasses(1)
+            , checkpointSeconds(0.0f)
+            , errorReference(nullptr)
+            , targetError(0.0f)
+            , beautyOutput(nullptr)
+        {
+        }
+
+        float  integrationSeconds;
+        uint32 maxPasses;
+
+        // -- Minimum time between writing the accumulated image to <imageName>_checkpoint.exr. Zero disables checkpoints.
+        float  checkpointSeconds;
+
+        // -- Row major beauty image each pass is measured against. Rendering stops early once the root mean squared error
+        // -- falls to targetError so integrators can be compared by their time to equal error. Null disables measuring.
+        const float3* errorReference;
+        float         targetError;
+
+        // -- Receives the final beauty as a row major image when set
+        float3*       beautyOutput;
+    };
+
+    // -- Adds one pass of samples to the frame given to RenderProgressive
+    typedef void (*RenderPassFunction)(void* userData, uint32 pass);
+
+    // -- Tracks the error of a progressive render against settings.errorReference. Time spent measuring is kept out of the
+    // -- render time so measured and unmeasured renders spend their budgets alike.
+    struct ProgressiveErrorTracker
+    {
+        float3* scratch;
+        float   measureSeconds;
+        float   error;
+    };
+
+    void ProgressiveError_Initialize(ProgressiveErrorTracker* tracker, const Framebuffer* frame,
+                                     const ProgressiveSettings& settings);
+    void ProgressiveError_Shutdown(ProgressiveErrorTracker* tracker);
+    // -- Returns true once the frame's error is at or below the settings' target. Always false without an error reference.
+    bool ProgressiveError_Measure(ProgressiveErrorTracker* tracker, Framebuffer* frame, const ProgressiveSettings& settings,
+                                  float beautyScale, uint32 passCount, float renderSeconds);
+
+    // -- Calls renderPass until the budgets run out, writing checkpoints along the way. The final pass streams its tiles to
+    // -- imageName as they finish and the image is written before this returns.
+    Error RenderProgressive(Framebuffer* frame, TextureCache* textureCache, const ProgressiveSettings& settings,
+                            uint32 samplesPerPass, cpointer imageName, RenderPassFunction renderPass, void* userData);
+}
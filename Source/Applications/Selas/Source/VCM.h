@@ -1,20 +1,27 @@
-//#pragma once
-//
-////=================================================================================================================================
-//// Joe Schutte
-////=================================================================================================================================
-//
-//#include "UtilityLib/Color.h"
-//#include "MathLib/FloatStructs.h"
-//#include "SystemLib/BasicTypes.h"
-//
-//namespace Selas
-//{
-//    struct RayCastCameraSettings;
-//    struct SceneResource;
-//
-//    namespace VCM
-//    {
-//        void GenerateImage(SceneResource* scene, const RayCastCameraSettings& camera, cpointer imageName);
-//    }
-//}
\ No newline at end of file
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ProgressiveRender.h"
+#include "UtilityLib/Color.h"
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    class GeometryCache;
+    class TextureCache;
+    struct SceneResource;
+    struct RayCastCameraSettings;
+
+    namespace VCM
+    {
+        // -- Runs iterations of one light path and one camera path per pixel until either budget is used up. Each iteration
+        // -- counts as a pass and checkpoints are not written.
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const ProgressiveSettings& settings, cpointer imageName);
+    }
+}
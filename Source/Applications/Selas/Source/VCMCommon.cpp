@@ -9,6 +9,7 @@
 #include "Shading/SurfaceParameters.h"
 #include "Shading/IntegratorContexts.h"
 #include "Shading/AreaLighting.h"
+#include "SceneLib/SceneResource.h"
 #include "TextureLib/Framebuffer.h"
 #include "GeometryLib/Camera.h"
 #include "GeometryLib/Ray.h"
@@ -21,45 +22,88 @@
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
 
-#define MaxBounceCount_         10
-
-#define EnableMultiThreading_   1
-#define IntegrationSeconds_     30.0f
-
-#define VcmRadiusFactor_ 0.0025f
-#define VcmRadiusAlpha_ 0.75f
-
 namespace Selas
 {
     namespace VCMCommon
     {
         //=========================================================================================================================
-        void GenerateLightSample(GIIntegratorContext* context, float vcWeight, uint index, PathState& state)
+        float AreaLightSampleProbability(const SceneResource* scene)
         {
-            Assert_(index < (1 << PathStateIndexBitCount_));
+            if(AreaLightPower(scene) <= 0.0f) {
+                return 0.0f;
+            }
+
+            // -- Without an ibl or a background color every light path starts on an area light
+            if(scene->iblResource == nullptr && Dot(scene->data->backgroundIntensity.XYZ(), float3::One_) <= 0.0f) {
+                return 1.0f;
+            }
 
-            // -- right now we're just generating a sample on the ibl
-            float lightSampleWeight = 1.0f;
+            return 0.5f;
+        }
 
+        //=========================================================================================================================
+        bool GenerateLightSample(GIIntegratorContext* context, const VCMIterationConstants& constants, uint index,
+                                 PathState& state, LightPathOrigin& origin)
+        {
+            Assert_(index < (1 << PathStateIndexBitCount_));
+
+            // -- Next event estimation samples the background and the area lights separately so only the emission pdfs
+            // -- include the probability of choosing between them. The direct pdfs are left as they are.
             LightEmissionSample sample;
-            {
-                // -- JSTODO - Sample area lights and such
-                EmitIblLightSample(context, sample);
+            if(context->sampler.UniformFloat() < constants.areaLightSampleProb) {
+                if(EmitAreaLightSample(context, origin.lightSetIndex, origin.lightIndex, sample) == false) {
+                    return false;
+                }
+                sample.emissionPdfW *= constants.areaLightSampleProb;
+                origin.areaLight = 1;
+            }
+            else {
+                EmitBackgroundLightSample(context, sample);
+                sample.emissionPdfW *= 1.0f - constants.areaLightSampleProb;
+                origin.areaLight = 0;
             }
 
-            sample.emissionPdfW  *= lightSampleWeight;
-            sample.directionPdfA *= lightSampleWeight;
+            origin.emissionPdfW  = sample.emissionPdfW;
+            origin.cosThetaLight = sample.cosThetaLight;
 
             state.position        = sample.position;
             state.direction       = sample.direction;
             state.throughput      = sample.radiance * (1.0f / sample.emissionPdfW);
             state.dVCM            = sample.directionPdfA / sample.emissionPdfW;
             state.dVC             = sample.cosThetaLight / sample.emissionPdfW;
-            state.dVM             = sample.cosThetaLight / sample.emissionPdfW * vcWeight;
+            state.dVM             = sample.cosThetaLight / sample.emissionPdfW * constants.vcWeight;
             state.pathLength      = 1;
-            state.isAreaMeasure   = 0; // -- this would be true for any non infinite light source.
-                                       // -- false here since we only sample the ibl.
+            state.isAreaMeasure   = origin.areaLight; // -- only the background is an infinite light source
             state.index           = index;
+
+            return true;
+        }
+
+        //=========================================================================================================================
+        bool UpdateFirstHitWeights(GIIntegratorContext* context, const LightPathOrigin& origin, const SurfaceParameters& surface,
+                                   PathState& state)
+        {
+            if(origin.areaLight == 0) {
+                return true;
+            }
+
+            // -- Area lights only light the surfaces of their own light set
+            if(surface.lightSetIndex != origin.lightSetIndex) {
+                return false;
+            }
+
+            LightDirectSample light;
+            light.index = origin.lightIndex;
+
+            // -- Next event estimation samples the light by solid angle from the surface. Convert that to an area pdf on the
+            // -- light; UpdateHitWeights then converts the ratio over the segment the same way as for any other vertex.
+            float directPdfW = LightingPdf(context, origin.lightSetIndex, light, surface.position, GeometricNormal(surface),
+                                           -state.direction);
+            float distanceSquared = LengthSquared(surface.position - state.position);
+            float directPdfA = directPdfW * origin.cosThetaLight / distanceSquared;
+
+            state.dVCM = directPdfA / origin.emissionPdfW;
+            return true;
         }
 
         //=========================================================================================================================
@@ -70,7 +114,7 @@ namespace Selas
             Ray cameraRay = JitteredCameraRay(camera, &context->sampler, (float)x, (float)y);
 
             float cosThetaCamera = Dot(camera->forward, cameraRay.direction);
-            float imagePointToCameraDistance = camera->virtualImagePlaneDistance / cosThetaCamera;
+            float imagePointToCameraDistance = ImagePlaneDistance(camera) / cosThetaCamera;
             float invSolidAngleMeasure = imagePointToCameraDistance * imagePointToCameraDistance / cosThetaCamera;
             float revCameraPdfW = (1.0f / invSolidAngleMeasure);
 
@@ -87,6 +131,13 @@ namespace Selas
             Assert_(state.index < (1 << PathStateIndexBitCount_));
         }
 
+        //=========================================================================================================================
+        float ImagePlaneDistance(const RayCastCameraSettings* camera)
+        {
+            // -- cameraX spans half the image width at unit distance
+            return camera->viewportWidth / (2.0f * Length(camera->cameraX));
+        }
+
         //=========================================================================================================================
         float SearchRadius(float baseRadius, float radiusAlpha, float iterationIndex)
         {
@@ -107,6 +158,7 @@ namespace Selas
             constants.vmNormalization   = 1.0f / (Math::Pi_ * constants.vmSearchRadiusSqr * vmCount);
             constants.vmWeight          = Math::Pi_ * constants.vmSearchRadiusSqr * vmCount / vcCount;
             constants.vcWeight          = vcCount / (Math::Pi_ * constants.vmSearchRadiusSqr * vmCount);
+            constants.areaLightSampleProb = 0.0f;
 
             return constants;
         }
@@ -21,6 +21,7 @@
 namespace Selas
 {
     struct GIIntegratorContext;
+    struct SceneResource;
 
     struct VCMIterationConstants
     {
@@ -31,6 +32,9 @@ namespace Selas
         float vmNormalization;
         float vmWeight;
         float vcWeight;
+
+        // -- Probability of a light path starting on an area light rather than the background
+        float areaLightSampleProb;
     };
 
     struct VCMVertex
@@ -42,7 +46,9 @@ namespace Selas
         float dVC;
         float dVM;
 
-        HitParameters hit;
+        // -- Captured while the light path's geometry and textures are resident so connecting to and merging with the vertex
+        // -- never has to go back through the geometry or texture caches.
+        SurfaceParameters surface;
     };
 
     struct PathState
@@ -59,11 +65,21 @@ namespace Selas
         uint32 isAreaMeasure : PathStateIsAreaMeasureBitCount_;
     };
 
+    // -- The area light a light path left from. Light trees choose lights per shading point so the pdf of next event estimation
+    // -- choosing the path's first segment is only known once that segment hits a surface.
+    struct LightPathOrigin
+    {
+        uint32 areaLight;
+        uint32 lightSetIndex;
+        uint32 lightIndex;
+        float  emissionPdfW;
+        float  cosThetaLight;
+    };
+
     struct VertexMergingCallbackStruct
     {
         const GIIntegratorContext* context;
         const SurfaceParameters* surface;
-        const CArray<VCMVertex>* pathVertices;
         const PathState* cameraState;
         float vcWeight;
 
@@ -72,9 +88,18 @@ namespace Selas
 
     namespace VCMCommon
     {
-        void GenerateLightSample(GIIntegratorContext* context, float vcWeight, uint index, PathState& state);
+        float AreaLightSampleProbability(const SceneResource* scene);
+        bool GenerateLightSample(GIIntegratorContext* context, const VCMIterationConstants& constants, uint index,
+                                 PathState& state, LightPathOrigin& origin);
+        // -- Called at the first hit of a light path before its weights are updated. Returns false when the light does not
+        // -- reach the surface because it belongs to another light set.
+        bool UpdateFirstHitWeights(GIIntegratorContext* context, const LightPathOrigin& origin, const SurfaceParameters& surface,
+                                   PathState& state);
         void GenerateCameraSample(GIIntegratorContext* context, uint x, uint y, float lightPathCount, PathState& state);
 
+        // -- Distance from the camera at which a pixel covers an area of one
+        float ImagePlaneDistance(const RayCastCameraSettings* camera);
+
         float SearchRadius(float baseRadius, float radiusAlpha, float iterationIndex);
         VCMIterationConstants CalculateIterationConstants(uint vmCount, uint vcCount, float baseRadius, float radiusAlpha,
                                                           float iterationIndex);
@@ -7,10 +7,37 @@
 #include "MathLib/IntStructs.h"
 #include "MathLib/FloatFuncs.h"
 #include "MathLib/Trigonometric.h"
+#include "ThreadingLib/JobSystem.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/JsAssert.h"
 #include "SystemLib/Memory.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/MinMax.h"
 
 namespace Selas
 {
+    struct HashGridBuildData;
+    typedef void(*HashGridBuildPhase)(HashGridBuildData* buildData, uint thread);
+
+    struct HashGridBuildData
+    {
+        VCMHashGrid* hashGrid;
+        const VCMVertex* points;
+        uint pointCount;
+        uint threadCount;
+
+        HashGridBuildPhase phase;
+
+        // -- threadCount entries each
+        AxisAlignedBox* threadBoxes;
+        uint32* threadCellSums;
+        // -- threadCount + 1 entries. Where each thread's block of cells starts in cell order.
+        uint32* threadPointStarts;
+        // -- threadCount * threadCount entries. Row t counts how many of thread t's points fall in each thread's block of
+        // -- cells and is then turned into where thread t writes them in bucketedIndices.
+        uint32* threadBucketOffsets;
+    };
+
     //=============================================================================================================================
     static uint CalculateCellIndex(int3 xyz, uint cellCount)
     {
@@ -45,8 +72,156 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    void BuildHashGrid(VCMHashGrid* __restrict hashGrid, uint cellCount, float radius, const CArray<VCMVertex>& points)
+    static void ThreadRange(uint count, uint thread, uint threadCount, uint& start, uint& end)
+    {
+        start = (uint)((uint64)count * thread / threadCount);
+        end = (uint)((uint64)count * (thread + 1) / threadCount);
+    }
+
+    //=============================================================================================================================
+    static uint ThreadFromIndex(uint index, uint count, uint threadCount)
+    {
+        // -- Inverse of ThreadRange. The last thread whose start is at or before index.
+        return (uint)(((uint64)(index + 1) * threadCount + count - 1) / count) - 1;
+    }
+
+    //=============================================================================================================================
+    static void HashGridBuildKernel(void* userData, uint start, uint end)
+    {
+        HashGridBuildData* buildData = static_cast<HashGridBuildData*>(userData);
+        for(uint thread = start; thread < end; ++thread) {
+            buildData->phase(buildData, thread);
+        }
+    }
+
+    //=============================================================================================================================
+    static void RunBuildPhase(HashGridBuildData* buildData, HashGridBuildPhase phase)
+    {
+        buildData->phase = phase;
+        JobSystem_ParallelFor(buildData->threadCount, 1, HashGridBuildKernel, buildData);
+    }
+
+    //=============================================================================================================================
+    static void CalculateBoundsPhase(HashGridBuildData* buildData, uint thread)
+    {
+        uint start, end;
+        ThreadRange(buildData->pointCount, thread, buildData->threadCount, start, end);
+
+        AxisAlignedBox& box = buildData->threadBoxes[thread];
+        MakeInvalid(&box);
+        for(uint scan = start; scan < end; ++scan) {
+            IncludePosition(&box, buildData->points[scan].surface.position);
+        }
+    }
+
+    //=============================================================================================================================
+    static void CountCellsPhase(HashGridBuildData* buildData, uint thread)
+    {
+        VCMHashGrid* hashGrid = buildData->hashGrid;
+        uint32* pointCells = hashGrid->pointCells.DataPointer();
+        volatile uint32* cellCounts = hashGrid->cellRangeEnds.DataPointer();
+
+        uint threadCount = buildData->threadCount;
+        uint32* bucketCounts = &buildData->threadBucketOffsets[thread * threadCount];
+        Memory::Zero(bucketCounts, threadCount * sizeof(uint32));
+
+        uint start, end;
+        ThreadRange(buildData->pointCount, thread, threadCount, start, end);
+
+        for(uint scan = start; scan < end; ++scan) {
+            uint32 cellIndex = (uint32)CalculateCellIndex(hashGrid, buildData->points[scan].surface.position);
+            pointCells[scan] = cellIndex;
+            Atomic::AddU32(&cellCounts[cellIndex], 1);
+            ++bucketCounts[ThreadFromIndex(cellIndex, hashGrid->cellCount, threadCount)];
+        }
+    }
+
+    //=============================================================================================================================
+    static void SumCellsPhase(HashGridBuildData* buildData, uint thread)
+    {
+        const uint32* cellCounts = buildData->hashGrid->cellRangeEnds.DataPointer();
+
+        uint start, end;
+        ThreadRange(buildData->hashGrid->cellCount, thread, buildData->threadCount, start, end);
+
+        uint32 sum = 0;
+        for(uint scan = start; scan < end; ++scan) {
+            sum += cellCounts[scan];
+        }
+        buildData->threadCellSums[thread] = sum;
+    }
+
+    //=============================================================================================================================
+    static void ScanCellsPhase(HashGridBuildData* buildData, uint thread)
     {
+        // -- threadCellSums holds the exclusive prefix sum of the per thread sums by now. This turns each cell's count into its
+        // -- start index.
+        uint32* cellRangeEnds = buildData->hashGrid->cellRangeEnds.DataPointer();
+
+        uint start, end;
+        ThreadRange(buildData->hashGrid->cellCount, thread, buildData->threadCount, start, end);
+
+        uint32 sum = buildData->threadCellSums[thread];
+        for(uint scan = start; scan < end; ++scan) {
+            uint32 rangeCount = cellRangeEnds[scan];
+            cellRangeEnds[scan] = sum;
+            sum += rangeCount;
+        }
+    }
+
+    //=============================================================================================================================
+    static void BucketPhase(HashGridBuildData* buildData, uint thread)
+    {
+        // -- Each thread's points go to the blocks of cells they land in. Threads write in order to their own offsets in each
+        // -- block so every block ends up holding its points in point order.
+        VCMHashGrid* hashGrid = buildData->hashGrid;
+        const uint32* pointCells = hashGrid->pointCells.DataPointer();
+        uint32* bucketedIndices = hashGrid->bucketedIndices.DataPointer();
+
+        uint threadCount = buildData->threadCount;
+        uint32* bucketOffsets = &buildData->threadBucketOffsets[thread * threadCount];
+
+        uint start, end;
+        ThreadRange(buildData->pointCount, thread, threadCount, start, end);
+
+        for(uint scan = start; scan < end; ++scan) {
+            uint bucket = ThreadFromIndex(pointCells[scan], hashGrid->cellCount, threadCount);
+            bucketedIndices[bucketOffsets[bucket]++] = (uint32)scan;
+        }
+    }
+
+    //=============================================================================================================================
+    static void ScatterPhase(HashGridBuildData* buildData, uint thread)
+    {
+        // -- A counting sort of this thread's block of cells. No other thread touches these cells so the starts are bumped
+        // -- without atomics, which leaves cellRangeEnds holding the exclusive end index of every cell, and points keep their
+        // -- order within each cell.
+        VCMHashGrid* hashGrid = buildData->hashGrid;
+        const uint32* pointCells = hashGrid->pointCells.DataPointer();
+        const uint32* bucketedIndices = hashGrid->bucketedIndices.DataPointer();
+        uint32* cellRangeEnds = hashGrid->cellRangeEnds.DataPointer();
+
+        uint start = buildData->threadPointStarts[thread];
+        uint end = buildData->threadPointStarts[thread + 1];
+
+        for(uint scan = start; scan < end; ++scan) {
+            uint32 pointIndex = bucketedIndices[scan];
+            uint32 targetIndex = cellRangeEnds[pointCells[pointIndex]]++;
+
+            const VCMVertex& vertex = buildData->points[pointIndex];
+            hashGrid->vertices[targetIndex] = vertex;
+            hashGrid->positionsX[targetIndex] = vertex.surface.position.x;
+            hashGrid->positionsY[targetIndex] = vertex.surface.position.y;
+            hashGrid->positionsZ[targetIndex] = vertex.surface.position.z;
+        }
+    }
+
+    //=============================================================================================================================
+    void BuildHashGrid(VCMHashGrid* __restrict hashGrid, uint cellCount, float radius, const CArray<VCMVertex>& points,
+                       uint threadCount)
+    {
+        Assert_(threadCount > 0);
+
         float radiusSquare    = radius * radius;
         float cellSize        = 2.0f * radius;
         float inverseCellSize = 1.0f / cellSize;
@@ -59,59 +234,106 @@ namespace Selas
         uint pointCount = points.Count();
 
         hashGrid->cellRangeEnds.Resize((uint32)cellCount);
-        hashGrid->cellIndices.Resize((uint32)pointCount);
+        hashGrid->vertices.Resize((uint32)pointCount);
+        hashGrid->positionsX.Resize((uint32)(pointCount + Float8LaneCount_ - 1));
+        hashGrid->positionsY.Resize((uint32)(pointCount + Float8LaneCount_ - 1));
+        hashGrid->positionsZ.Resize((uint32)(pointCount + Float8LaneCount_ - 1));
+        hashGrid->pointCells.Resize((uint32)pointCount);
+        hashGrid->bucketedIndices.Resize((uint32)pointCount);
         Memory::Zero(hashGrid->cellRangeEnds.DataPointer(), hashGrid->cellRangeEnds.DataSize());
 
-        // -- Prep the AABox
+        // -- The padding is only ever loaded into masked off lanes but keep it initialized
+        for(uint scan = pointCount; scan < pointCount + Float8LaneCount_ - 1; ++scan) {
+            hashGrid->positionsX[scan] = 0.0f;
+            hashGrid->positionsY[scan] = 0.0f;
+            hashGrid->positionsZ[scan] = 0.0f;
+        }
+
         MakeInvalid(&hashGrid->aaBox);
-        for(uint scan = 0; scan < pointCount; ++scan) {
-            IncludePosition(&hashGrid->aaBox, points[scan].hit.position);
+        if(pointCount == 0) {
+            return;
         }
-        // JSTODO - Verify this. Seems like a bug in the original author's implementation to not do this.
-        //hashGrid->aaBox.min = hashGrid->aaBox.min - radius;
-        //hashGrid->aaBox.max = hashGrid->aaBox.max + radius;
 
-        // -- Count the number of particles that will be in each cell
-        for(uint scan = 0; scan < pointCount; ++scan) {
-            uint cellIndex = CalculateCellIndex(hashGrid, points[scan].hit.position);
-            ++hashGrid->cellRangeEnds[cellIndex];
+        HashGridBuildData buildData;
+        buildData.hashGrid = hashGrid;
+        buildData.points = points.DataPointer();
+        buildData.pointCount = pointCount;
+        buildData.threadCount = threadCount;
+        buildData.threadBoxes = AllocArray_(AxisAlignedBox, threadCount);
+        buildData.threadCellSums = AllocArray_(uint32, threadCount);
+        buildData.threadPointStarts = AllocArray_(uint32, (threadCount + 1));
+        buildData.threadBucketOffsets = AllocArray_(uint32, threadCount * threadCount);
+
+        // -- Prep the AABox
+        RunBuildPhase(&buildData, CalculateBoundsPhase);
+        for(uint scan = 0; scan < threadCount; ++scan) {
+            IncludeBox(&hashGrid->aaBox, buildData.threadBoxes[scan]);
         }
+        // -- Pad by the radius so queries just outside the points' bounds still find the points near the boundary
+        hashGrid->aaBox.min = hashGrid->aaBox.min - float3(radius, radius, radius);
+        hashGrid->aaBox.max = hashGrid->aaBox.max + float3(radius, radius, radius);
+
+        // -- Count the number of particles that will be in each cell
+        RunBuildPhase(&buildData, CountCellsPhase);
 
-        // -- prefix sum of the contents of cellRangeEnds (which is currently the count of particles per cell).
-        // -- This sets each cellRangeEnds[x] to the cell's start index.
+        // -- prefix sum of the contents of cellRangeEnds (which is currently the count of particles per cell). Each thread
+        // -- sums a block of cells, the block sums are scanned here and then each thread scans its own block.
+        RunBuildPhase(&buildData, SumCellsPhase);
         uint32 sum = 0;
-        for(uint scan = 0; scan < cellCount; ++scan) {
-            uint32 rangeCount = hashGrid->cellRangeEnds[scan];
-            hashGrid->cellRangeEnds[scan] = sum;
-            sum += rangeCount;
+        for(uint scan = 0; scan < threadCount; ++scan) {
+            uint32 threadSum = buildData.threadCellSums[scan];
+            buildData.threadCellSums[scan] = sum;
+            sum += threadSum;
         }
+        RunBuildPhase(&buildData, ScanCellsPhase);
 
-        // -- Assign each point to an index. This sums up each cell such that each cellRangeEnds[x] will now
-        // -- be the exclusive end index of that cell's range
-        for(uint scan = 0; scan < pointCount; ++scan) {
-            uint cellIndex = CalculateCellIndex(hashGrid, points[scan].hit.position);
+        // -- Each thread's block of cells starts where its first cell does. Within a block the points of lower threads come
+        // -- first.
+        const uint32* cellStarts = hashGrid->cellRangeEnds.DataPointer();
+        for(uint bucket = 0; bucket < threadCount; ++bucket) {
+            uint start, end;
+            ThreadRange(cellCount, bucket, threadCount, start, end);
 
-            uint32 targetIndex = hashGrid->cellRangeEnds[cellIndex]++;
-            hashGrid->cellIndices[targetIndex] = (uint32)scan;
+            uint32 offset = start < cellCount ? cellStarts[start] : (uint32)pointCount;
+            buildData.threadPointStarts[bucket] = offset;
+            for(uint thread = 0; thread < threadCount; ++thread) {
+                uint32 count = buildData.threadBucketOffsets[thread * threadCount + bucket];
+                buildData.threadBucketOffsets[thread * threadCount + bucket] = offset;
+                offset += count;
+            }
         }
+        buildData.threadPointStarts[threadCount] = (uint32)pointCount;
+
+        // -- Group the points by block of cells and then sort each block into cell order
+        RunBuildPhase(&buildData, BucketPhase);
+        RunBuildPhase(&buildData, ScatterPhase);
+
+        Free_(buildData.threadBoxes);
+        Free_(buildData.threadCellSums);
+        Free_(buildData.threadPointStarts);
+        Free_(buildData.threadBucketOffsets);
     }
 
     //=============================================================================================================================
     void ShutdownHashGrid(VCMHashGrid* hashGrid)
     {
-        hashGrid->cellIndices.Shutdown();
+        hashGrid->vertices.Shutdown();
+        hashGrid->positionsX.Shutdown();
+        hashGrid->positionsY.Shutdown();
+        hashGrid->positionsZ.Shutdown();
         hashGrid->cellRangeEnds.Shutdown();
+        hashGrid->pointCells.Shutdown();
+        hashGrid->bucketedIndices.Shutdown();
     }
 
     //=============================================================================================================================
-    void SearchHashGrid(const VCMHashGrid* __restrict hashGrid, const CArray<VCMVertex>& vertices, float3 position, void* userData,
-                        HashGridCallbackFunction callback)
+    uint HashGridCandidateRanges(const VCMHashGrid* __restrict hashGrid, float3 position, int2* cellRanges)
     {
         // -- Verify the given position is within the range
         float3 deltaMin = position - hashGrid->aaBox.min;
         float3 deltaMax = hashGrid->aaBox.max - position;
-        if(deltaMin.x < 0.0f || deltaMin.y < 0.0f || deltaMin.z < 0.0f) return;
-        if(deltaMax.x < 0.0f || deltaMax.y < 0.0f || deltaMax.z < 0.0f) return;
+        if(deltaMin.x < 0.0f || deltaMin.y < 0.0f || deltaMin.z < 0.0f) return 0;
+        if(deltaMax.x < 0.0f || deltaMax.y < 0.0f || deltaMax.z < 0.0f) return 0;
 
         // -- calculate xyz coordinate start indices
         float3 cellPoint = hashGrid->inverseCellSize * deltaMin;
@@ -134,23 +356,33 @@ namespace Selas
         if(fractional.z < 0.5f)
             --xyzMin.z;
 
+        uint cellIndices[HashGridNeighborCellCount_];
+        uint cellRangeCount = 0;
+        uint cellIndexCount = 0;
+
         for(int32 z = 0; z <= 1; ++z) {
             for(int32 y = 0; y <= 1; ++y) {
                 for(int32 x = 0; x <= 1; ++x) {
                     uint cellIndex = CalculateCellIndex(int3(xyzMin.x + x, xyzMin.y + y, xyzMin.z + z), hashGrid->cellCount);
-                    int2 cellRange = GetCellRange(hashGrid, cellIndex);
 
-                    for(uint scan = cellRange.x; scan < cellRange.y; ++scan) {
-                        uint particleIndex = hashGrid->cellIndices[scan];
-                        const VCMVertex& vertex = vertices[particleIndex];
+                    // -- Neighbors can hash to the same cell and searching it twice would merge its vertices twice
+                    bool duplicate = false;
+                    for(uint scan = 0; scan < cellIndexCount; ++scan) {
+                        duplicate |= (cellIndices[scan] == cellIndex);
+                    }
+                    if(duplicate) {
+                        continue;
+                    }
+                    cellIndices[cellIndexCount++] = cellIndex;
 
-                        float distSquared = LengthSquared(position - vertex.hit.position);
-                        if(distSquared <= hashGrid->radiusSquare) {
-                            callback(vertex, userData);
-                        }
+                    int2 cellRange = GetCellRange(hashGrid, cellIndex);
+                    if(cellRange.x < cellRange.y) {
+                        cellRanges[cellRangeCount++] = cellRange;
                     }
                 }
             }
         }
+
+        return cellRangeCount;
     }
-}
\ No newline at end of file
+}
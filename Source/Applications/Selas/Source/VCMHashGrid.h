@@ -4,18 +4,32 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "VCMCommon.h"
 #include "GeometryLib/AxisAlignedBox.h"
+#include "MathLib/SimdFloat8.h"
+#include "MathLib/IntStructs.h"
 #include "MathLib/FloatStructs.h"
 #include "ContainersLib/CArray.h"
 #include "SystemLib/BasicTypes.h"
 
+#if IsWindows_
+    #include <intrin.h>
+#endif
+
+#define HashGridNeighborCellCount_ 8
+#define HashGridSurvivorBatchSize_ 64
+
 namespace Selas
 {
-    struct VCMVertex;
-
     struct VCMHashGrid
     {
-        CArray<uint32> cellIndices;
+        // -- Copies of the vertices sorted by cell. A cell's vertices are contiguous and keep their original relative order.
+        // -- Positions are split by component and padded by a partial lane set so a search can load eight at a time from
+        // -- anywhere in the arrays.
+        CArray<VCMVertex> vertices;
+        CArray<float> positionsX;
+        CArray<float> positionsY;
+        CArray<float> positionsZ;
         CArray<uint32> cellRangeEnds;
         AxisAlignedBox aaBox;
 
@@ -23,13 +37,88 @@ namespace Selas
         float radius;
         float radiusSquare;
         float inverseCellSize;
-    };
 
-    typedef void(*HashGridCallbackFunction)(const VCMVertex& vertex, void* userData);
+        // -- Build scratch kept between builds so iterations do not reallocate it
+        CArray<uint32> pointCells;
+        CArray<uint32> bucketedIndices;
+    };
 
-    void BuildHashGrid(VCMHashGrid* hashGrid, uint cellCount, float radius, const CArray<VCMVertex>& points);
+    // -- Every phase of the build is split into threadCount blocks that run as job system tasks
+    void BuildHashGrid(VCMHashGrid* hashGrid, uint cellCount, float radius, const CArray<VCMVertex>& points, uint threadCount);
     void ShutdownHashGrid(VCMHashGrid* hashGrid);
 
-    void SearchHashGrid(const VCMHashGrid* hashGrid, const CArray<VCMVertex>& vertices, float3 position, void* userData,
-                        HashGridCallbackFunction callback);
-}
\ No newline at end of file
+    // -- Fills cellRanges with the distinct non-empty ranges of the cells that may hold points within radius of position
+    uint HashGridCandidateRanges(const VCMHashGrid* hashGrid, float3 position, int2* cellRanges);
+
+    //=============================================================================================================================
+    static ForceInline_ uint32 LowestSetBit(uint32 mask)
+    {
+        #if IsWindows_
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return (uint32)index;
+        #else
+            return (uint32)__builtin_ctz(mask);
+        #endif
+    }
+
+    //=============================================================================================================================
+    // -- Calls functor(const VCMVertex&) for every vertex within radius of position. Candidates are distance tested eight at a
+    // -- time and the survivors compacted into a small batch so the functor runs in a tight loop and can be inlined.
+    //=============================================================================================================================
+    template <typename Functor_>
+    void SearchHashGrid(const VCMHashGrid* __restrict hashGrid, float3 position, Functor_& functor)
+    {
+        int2 cellRanges[HashGridNeighborCellCount_];
+        uint cellRangeCount = HashGridCandidateRanges(hashGrid, position, cellRanges);
+        if(cellRangeCount == 0) {
+            return;
+        }
+
+        const float* positionsX = hashGrid->positionsX.DataPointer();
+        const float* positionsY = hashGrid->positionsY.DataPointer();
+        const float* positionsZ = hashGrid->positionsZ.DataPointer();
+        const VCMVertex* vertices = hashGrid->vertices.DataPointer();
+
+        float8 queryX = float8(position.x);
+        float8 queryY = float8(position.y);
+        float8 queryZ = float8(position.z);
+        float8 radiusSquare = float8(hashGrid->radiusSquare);
+
+        uint32 survivors[HashGridSurvivorBatchSize_];
+        uint survivorCount = 0;
+
+        for(uint rangeIndex = 0; rangeIndex < cellRangeCount; ++rangeIndex) {
+            int2 cellRange = cellRanges[rangeIndex];
+            for(int32 scan = cellRange.x; scan < cellRange.y; scan += Float8LaneCount_) {
+                float8 dx = Load8(positionsX + scan) - queryX;
+                float8 dy = Load8(positionsY + scan) - queryY;
+                float8 dz = Load8(positionsZ + scan) - queryZ;
+
+                uint32 mask = MoveMask(dx * dx + dy * dy + dz * dz <= radiusSquare);
+
+                // -- Lanes past the end of the cell belong to the next cell or the padding
+                int32 remaining = cellRange.y - scan;
+                if(remaining < Float8LaneCount_) {
+                    mask &= (1u << remaining) - 1;
+                }
+
+                while(mask != 0) {
+                    survivors[survivorCount++] = (uint32)scan + LowestSetBit(mask);
+                    mask &= mask - 1;
+                }
+
+                if(survivorCount > HashGridSurvivorBatchSize_ - Float8LaneCount_) {
+                    for(uint survivor = 0; survivor < survivorCount; ++survivor) {
+                        functor(vertices[survivors[survivor]]);
+                    }
+                    survivorCount = 0;
+                }
+            }
+        }
+
+        for(uint survivor = 0; survivor < survivorCount; ++survivor) {
+            functor(vertices[survivors[survivor]]);
+        }
+    }
+}
@@ -0,0 +1,630 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "WavefrontPathTracer.h"
+#include "SceneLib/SceneResource.h"
+#include "SceneLib/GeometryCache.h"
+#include "SceneLib/SubsceneResource.h"
+#include "SceneLib/ModelResource.h"
+#include "Shading/SurfaceScattering.h"
+#include "Shading/SurfaceParameters.h"
+#include "Shading/IntegratorContexts.h"
+#include "Shading/AreaLighting.h"
+#include "Shading/PathShading.h"
+#include "TextureLib/TextureFiltering.h"
+#include "StringLib/FixedString.h"
+#include "GeometryLib/Camera.h"
+#include "GeometryLib/Ray.h"
+#include "UtilityLib/RadixSort.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/FloatStructs.h"
+#include "MathLib/ImportanceSampling.h"
+#include "ThreadingLib/JobSystem.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/BasicTypes.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+
+#include "embree3/rtcore.h"
+#include "embree3/rtcore_ray.h"
+
+// -- Paths each thread keeps in flight
+#define PathPoolSize_         (64 * 1024)
+#define TraceWidth_           8
+
+#define SamplesPerPixelX_     2
+#define SamplesPerPixelY_     2
+#define SamplesPerPass_       (SamplesPerPixelX_ * SamplesPerPixelY_)
+#define FramebufferAovs_      (eAlbedoAov | eNormalAov | eDepthAov | eSampleCountAov | eVarianceAov | eHalfAovStorage)
+#define FramebufferFlags_     (FramebufferAovs_ | eFixedPointAccumulation)
+
+// -- When enabled each wave of hits is sorted by material and texture before it is shaded
+#define SortHitsBeforeShading_    1
+
+namespace Selas
+{
+    namespace WavefrontPathTracer
+    {
+        //=========================================================================================================================
+        // -- One thread's in flight paths. Path state lives in slots and each stage's queue holds only the work that stage has
+        // -- to do. Rays are split by component so packets are gathered from flat arrays.
+        //=========================================================================================================================
+        struct PathPool
+        {
+            // -- Per slot state of the ray each path traces next
+            float*  originX;
+            float*  originY;
+            float*  originZ;
+            float*  directionX;
+            float*  directionY;
+            float*  directionZ;
+            float3* throughputs;
+            uint32* pixelIndices;
+            uint32* sampleIndices;
+            uint8*  bounces;
+            uint8*  trackedBounces;
+            uint8*  diracScatterOnly;
+
+            uint32* freeSlots;
+            uint32  freeCount;
+
+            // -- Slots whose next ray is ready to trace
+            uint32* extendQueue;
+            uint32  extendCount;
+
+            // -- Hits waiting to be shaded, the slots they continue and the scratch used to sort them
+            HitParameters* hits;
+            HitParameters* sortedHits;
+            uint32* hitSlots;
+            uint32* sortedSlots;
+            uint32* hitKeys;
+            uint32* hitOrder;
+            uint32* scratchKeys;
+            uint32* scratchOrder;
+            uint32  hitCount;
+
+            // -- Shadow rays queued by shading
+            float*  shadowOriginX;
+            float*  shadowOriginY;
+            float*  shadowOriginZ;
+            float*  shadowDirectionX;
+            float*  shadowDirectionY;
+            float*  shadowDirectionZ;
+            float*  shadowDistances;
+            float3* shadowValues;
+            uint32* shadowPixelIndices;
+            uint32  shadowCount;
+        };
+
+        struct KernelData
+        {
+            const RayCastCameraSettings* camera;
+            Framebuffer*                 frame;
+            volatile int64               kernelCounter;
+            volatile int64               pixelIndex;
+            uint32                       pass;
+            const SceneResource*         scene;
+            GeometryCache*               geometryCache;
+            TextureCache*                textureCache;
+
+            // -- One per job system thread
+            PathPool*                    pools;
+            uint                         poolCount;
+        };
+
+        //=========================================================================================================================
+        static void InitializePathPool(PathPool* pool, uint32 node)
+        {
+            // -- Placed on the node of the thread that owns the pool since nothing else ever touches it
+            uint shadowCapacity = ShadowRaysPerHit_ * PathPoolSize_;
+
+            pool->originX            = AllocArrayOnNode_(float, PathPoolSize_, node);
+            pool->originY            = AllocArrayOnNode_(float, PathPoolSize_, node);
+            pool->originZ            = AllocArrayOnNode_(float, PathPoolSize_, node);
+            pool->directionX         = AllocArrayOnNode_(float, PathPoolSize_, node);
+            pool->directionY         = AllocArrayOnNode_(float, PathPoolSize_, node);
+            pool->directionZ         = AllocArrayOnNode_(float, PathPoolSize_, node);
+            pool->throughputs        = AllocArrayOnNode_(float3, PathPoolSize_, node);
+            pool->pixelIndices       = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->sampleIndices      = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->bounces            = AllocArrayOnNode_(uint8, PathPoolSize_, node);
+            pool->trackedBounces     = AllocArrayOnNode_(uint8, PathPoolSize_, node);
+            pool->diracScatterOnly   = AllocArrayOnNode_(uint8, PathPoolSize_, node);
+            pool->freeSlots          = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->extendQueue        = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->hits               = AllocArrayOnNode_(HitParameters, PathPoolSize_, node);
+            pool->sortedHits         = AllocArrayOnNode_(HitParameters, PathPoolSize_, node);
+            pool->hitSlots           = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->sortedSlots        = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->hitKeys            = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->hitOrder           = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->scratchKeys        = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->scratchOrder       = AllocArrayOnNode_(uint32, PathPoolSize_, node);
+            pool->shadowOriginX      = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowOriginY      = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowOriginZ      = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowDirectionX   = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowDirectionY   = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowDirectionZ   = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowDistances    = AllocArrayOnNode_(float, shadowCapacity, node);
+            pool->shadowValues       = AllocArrayOnNode_(float3, shadowCapacity, node);
+            pool->shadowPixelIndices = AllocArrayOnNode_(uint32, shadowCapacity, node);
+
+            pool->extendCount = 0;
+            pool->hitCount = 0;
+            pool->shadowCount = 0;
+
+            // -- Handed out from the back so the first paths of a pass land in the lowest slots
+            pool->freeCount = PathPoolSize_;
+            for(uint32 scan = 0; scan < PathPoolSize_; ++scan) {
+                pool->freeSlots[scan] = PathPoolSize_ - 1 - scan;
+            }
+        }
+
+        //=========================================================================================================================
+        static void ShutdownPathPool(PathPool* pool)
+        {
+            FreeOnNode_(pool->originX);
+            FreeOnNode_(pool->originY);
+            FreeOnNode_(pool->originZ);
+            FreeOnNode_(pool->directionX);
+            FreeOnNode_(pool->directionY);
+            FreeOnNode_(pool->directionZ);
+            FreeOnNode_(pool->throughputs);
+            FreeOnNode_(pool->pixelIndices);
+            FreeOnNode_(pool->sampleIndices);
+            FreeOnNode_(pool->bounces);
+            FreeOnNode_(pool->trackedBounces);
+            FreeOnNode_(pool->diracScatterOnly);
+            FreeOnNode_(pool->freeSlots);
+            FreeOnNode_(pool->extendQueue);
+            FreeOnNode_(pool->hits);
+            FreeOnNode_(pool->sortedHits);
+            FreeOnNode_(pool->hitSlots);
+            FreeOnNode_(pool->sortedSlots);
+            FreeOnNode_(pool->hitKeys);
+            FreeOnNode_(pool->hitOrder);
+            FreeOnNode_(pool->scratchKeys);
+            FreeOnNode_(pool->scratchOrder);
+            FreeOnNode_(pool->shadowOriginX);
+            FreeOnNode_(pool->shadowOriginY);
+            FreeOnNode_(pool->shadowOriginZ);
+            FreeOnNode_(pool->shadowDirectionX);
+            FreeOnNode_(pool->shadowDirectionY);
+            FreeOnNode_(pool->shadowDirectionZ);
+            FreeOnNode_(pool->shadowDistances);
+            FreeOnNode_(pool->shadowValues);
+            FreeOnNode_(pool->shadowPixelIndices);
+        }
+
+        //=========================================================================================================================
+        static void SetPathRay(PathPool* pool, uint32 slot, const Ray& ray)
+        {
+            pool->originX[slot]    = ray.origin.x;
+            pool->originY[slot]    = ray.origin.y;
+            pool->originZ[slot]    = ray.origin.z;
+            pool->directionX[slot] = ray.direction.x;
+            pool->directionY[slot] = ray.direction.y;
+            pool->directionZ[slot] = ray.direction.z;
+        }
+
+        //=========================================================================================================================
+        static void FreePath(GIIntegratorContext* __restrict context, PathPool* pool, uint32 slot)
+        {
+            FramebufferWriter_EndWork(&context->frameWriter, pool->pixelIndices[slot]);
+            pool->freeSlots[pool->freeCount++] = slot;
+        }
+
+        //=========================================================================================================================
+        static void QueueShadowRay(PathPool* pool, const OcclusionRay& occlusionRay)
+        {
+            uint32 index = pool->shadowCount++;
+            pool->shadowOriginX[index]      = occlusionRay.ray.origin.x;
+            pool->shadowOriginY[index]      = occlusionRay.ray.origin.y;
+            pool->shadowOriginZ[index]      = occlusionRay.ray.origin.z;
+            pool->shadowDirectionX[index]   = occlusionRay.ray.direction.x;
+            pool->shadowDirectionY[index]   = occlusionRay.ray.direction.y;
+            pool->shadowDirectionZ[index]   = occlusionRay.ray.direction.z;
+            pool->shadowDistances[index]    = occlusionRay.distance;
+            pool->shadowValues[index]       = occlusionRay.value;
+            pool->shadowPixelIndices[index] = occlusionRay.index;
+        }
+
+        //=========================================================================================================================
+        static void ContinuePath(PathPool* pool, uint32 slot, const DeferredRay& bounceRay)
+        {
+            // -- The slot keeps its pixel and sample so only the state that changes per bounce is written
+            SetPathRay(pool, slot, bounceRay.ray);
+
+            pool->throughputs[slot]      = bounceRay.throughput;
+            pool->diracScatterOnly[slot] = (uint8)bounceRay.diracScatterOnly;
+            pool->trackedBounces[slot]   = (uint8)bounceRay.trackedBounces;
+            pool->bounces[slot]          = (uint8)bounceRay.bounce;
+            pool->extendQueue[pool->extendCount++] = slot;
+        }
+
+        //=========================================================================================================================
+        static bool GeneratePaths(GIIntegratorContext* __restrict context, PathPool* pool, KernelData* __restrict kernelData)
+        {
+            ProfileEventMarker_(0, "GeneratePaths");
+
+            uint width = kernelData->camera->width;
+            uint height = kernelData->camera->height;
+
+            int64 endIndex = width * height;
+            uint32 patternOffset = kernelData->pass * (uint32)endIndex;
+
+            // -- A pixel's camera paths are issued together so only take a pixel when all of them fit
+            while(pool->freeCount >= SamplesPerPass_) {
+                int64 index = Atomic::Increment64(&kernelData->pixelIndex);
+                if(index >= endIndex) {
+                    return false;
+                }
+
+                if(PixelConverged(kernelData->frame, (uint32)index, kernelData->pass)) {
+                    FramebufferWriter_EndWork(&context->frameWriter, (uint32)index);
+                    continue;
+                }
+
+                uint y = index / width;
+                uint x = index - (y * width);
+
+                for(uint scan = 0; scan < SamplesPerPass_; ++scan) {
+                    uint32 slot = pool->freeSlots[--pool->freeCount];
+
+                    Ray ray = JitteredCameraRay(kernelData->camera, (int32)x, (int32)y, (int32)scan, SamplesPerPixelX_,
+                                                SamplesPerPixelY_, (int32)(patternOffset + (uint32)index));
+                    SetPathRay(pool, slot, ray);
+
+                    pool->throughputs[slot]      = float3::One_;
+                    pool->pixelIndices[slot]     = (uint32)index;
+                    pool->sampleIndices[slot]    = kernelData->pass * SamplesPerPass_ + scan;
+                    pool->bounces[slot]          = 0;
+                    pool->trackedBounces[slot]   = 0;
+                    pool->diracScatterOnly[slot] = 1;
+                    pool->extendQueue[pool->extendCount++] = slot;
+
+                    FramebufferWriter_BeginWork(&context->frameWriter, (uint32)index);
+                }
+
+                RenderStats_Add(eRenderCounterPrimaryRays, SamplesPerPass_);
+                FramebufferWriter_EndWork(&context->frameWriter, (uint32)index);
+            }
+
+            return true;
+        }
+
+        //=========================================================================================================================
+        static void ExtendPaths(GIIntegratorContext* __restrict context, PathPool* pool)
+        {
+            ProfileEventMarker_(0, "ExtendPaths");
+
+            const float kErr = 32.0f * 1.19209e-07f;
+
+            uint32 extendCount = pool->extendCount;
+            pool->extendCount = 0;
+            pool->hitCount = 0;
+            RenderStats_Add(eRenderCounterRaysTraced, extendCount);
+
+            for(uint32 start = 0; start < extendCount; start += TraceWidth_) {
+                const uint32* slots = pool->extendQueue + start;
+                uint batchSize = Min<uint>(extendCount - start, TraceWidth_);
+
+                RTCIntersectContext rtcContext;
+                rtcInitIntersectContext(&rtcContext);
+
+                Align_(64) int32 valid[TraceWidth_];
+
+                Align_(64) RTCRayHit8 rayhit;
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    uint32 slot = slots[scan];
+                    rayhit.ray.org_x[scan] = pool->originX[slot];
+                    rayhit.ray.org_y[scan] = pool->originY[slot];
+                    rayhit.ray.org_z[scan] = pool->originZ[slot];
+                    rayhit.ray.dir_x[scan] = pool->directionX[slot];
+                    rayhit.ray.dir_y[scan] = pool->directionY[slot];
+                    rayhit.ray.dir_z[scan] = pool->directionZ[slot];
+                    rayhit.ray.tnear[scan] = 0.0f;
+                    rayhit.ray.tfar[scan] = FloatMax_;
+
+                    rayhit.hit.geomID[scan] = RTC_INVALID_GEOMETRY_ID;
+                    rayhit.hit.primID[scan] = RTC_INVALID_GEOMETRY_ID;
+                    rayhit.hit.instID[0][scan] = RTC_INVALID_GEOMETRY_ID;
+                    rayhit.hit.instID[1][scan] = RTC_INVALID_GEOMETRY_ID;
+                    valid[scan] = -1;
+                }
+                for(uint scan = batchSize; scan < TraceWidth_; ++scan) {
+                    valid[scan] = 0;
+                }
+
+                rtcIntersect8(valid, context->rtcScene, &rtcContext, &rayhit);
+
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    uint32 slot = slots[scan];
+                    uint32 pixelIndex = pool->pixelIndices[slot];
+                    float3 direction = float3(rayhit.ray.dir_x[scan], rayhit.ray.dir_y[scan], rayhit.ray.dir_z[scan]);
+
+                    if(rayhit.hit.geomID[scan] == RTC_INVALID_GEOMETRY_ID) {
+                        float3 sample;
+                        if(pool->diracScatterOnly[slot])
+                            sample = EvaluateBackgroundMiss(context, direction);
+                        else
+                            sample = EvaluateBackground(context, direction);
+
+                        if(pool->trackedBounces[slot] == 0) {
+                            FramebufferPrimarySample primary;
+                            Memory::Zero(&primary, sizeof(primary));
+                            FramebufferWriter_WritePrimary(&context->frameWriter, primary, pixelIndex);
+                        }
+
+                        FramebufferWriter_Write(&context->frameWriter, sample * pool->throughputs[slot], pixelIndex);
+                        FreePath(context, pool, slot);
+                        continue;
+                    }
+
+                    uint32 hitIndex = pool->hitCount++;
+                    pool->hitSlots[hitIndex] = slot;
+
+                    HitParameters& hit = pool->hits[hitIndex];
+                    hit.position.x       = rayhit.ray.org_x[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_x[scan];
+                    hit.position.y       = rayhit.ray.org_y[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_y[scan];
+                    hit.position.z       = rayhit.ray.org_z[scan] + rayhit.ray.tfar[scan] * rayhit.ray.dir_z[scan];
+                    hit.normal           = float3(rayhit.hit.Ng_x[scan], rayhit.hit.Ng_y[scan], rayhit.hit.Ng_z[scan]);
+                    hit.view             = -direction;
+                    hit.error            = kErr * Max(Max(Math::Absf(hit.position.x), Math::Absf(hit.position.y)),
+                                                      Max(Math::Absf(hit.position.z), rayhit.ray.tfar[scan]));
+                    hit.baryCoords       = { rayhit.hit.u[scan], rayhit.hit.v[scan] };
+                    hit.geomId           = rayhit.hit.geomID[scan];
+                    hit.primId           = rayhit.hit.primID[scan];
+                    hit.instId[0]        = rayhit.hit.instID[0][scan];
+                    hit.instId[1]        = rayhit.hit.instID[1][scan];
+                    hit.index            = pixelIndex;
+                    hit.diracScatterOnly = pool->diracScatterOnly[slot];
+                    hit.trackedBounces   = pool->trackedBounces[slot];
+                    hit.throughput       = pool->throughputs[slot];
+                    hit.sampleIndex      = pool->sampleIndices[slot];
+                    hit.bounce           = pool->bounces[slot];
+                    hit.shadingKey       = 0;
+                }
+            }
+        }
+
+        //=========================================================================================================================
+        static void ShadePaths(GIIntegratorContext* __restrict context, PathPool* pool)
+        {
+            ProfileEventMarker_(0, "ShadePaths");
+
+            uint32 hitCount = pool->hitCount;
+            const HitParameters* hits = pool->hits;
+            const uint32* slots = pool->hitSlots;
+
+            #if SortHitsBeforeShading_
+                for(uint32 scan = 0; scan < hitCount; ++scan) {
+                    pool->hitKeys[scan] = CalculateShadingKey(context, &pool->hits[scan]);
+                    pool->hitOrder[scan] = scan;
+                }
+                RadixSortMatchingArrays(pool->hitKeys, pool->hitOrder, pool->scratchKeys, pool->scratchOrder, hitCount);
+
+                for(uint32 scan = 0; scan < hitCount; ++scan) {
+                    pool->sortedHits[scan] = pool->hits[pool->hitOrder[scan]];
+                    pool->sortedSlots[scan] = pool->hitSlots[pool->hitOrder[scan]];
+                }
+                hits = pool->sortedHits;
+                slots = pool->sortedSlots;
+            #endif
+
+            // -- Shading is the only thing that queues bounces and shadow rays so count them from the queue growth
+            uint32 extendCount = pool->extendCount;
+            uint32 shadowCount = pool->shadowCount;
+
+            for(uint32 start = 0; start < hitCount; start += TextureBatchWidth) {
+                uint batchSize = Min<uint>(hitCount - start, TextureBatchWidth);
+
+                ShadedHitBatch shaded;
+                ShadeHitBatch(context, hits + start, batchSize, &shaded);
+
+                for(uint scan = 0; scan < shaded.shadowRayCount; ++scan) {
+                    FramebufferWriter_BeginWork(&context->frameWriter, shaded.shadowRays[scan].index);
+                    QueueShadowRay(pool, shaded.shadowRays[scan]);
+                }
+
+                // -- A continued path keeps its slot and the unit of work its camera ray began with
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    if(shaded.continued[scan]) {
+                        ContinuePath(pool, slots[start + scan], shaded.bounceRays[scan]);
+                    }
+                    else {
+                        FreePath(context, pool, slots[start + scan]);
+                    }
+                }
+            }
+
+            RenderStats_Add(eRenderCounterBounceRays, pool->extendCount - extendCount);
+            RenderStats_Add(eRenderCounterShadowRays, pool->shadowCount - shadowCount);
+
+            pool->hitCount = 0;
+        }
+
+        //=========================================================================================================================
+        static void TraceShadowRays(GIIntegratorContext* __restrict context, PathPool* pool)
+        {
+            ProfileEventMarker_(0, "TraceShadowRays");
+
+            uint32 shadowCount = pool->shadowCount;
+            RenderStats_Add(eRenderCounterRaysTraced, shadowCount);
+
+            for(uint32 start = 0; start < shadowCount; start += TraceWidth_) {
+                uint batchSize = Min<uint>(shadowCount - start, TraceWidth_);
+
+                RTCIntersectContext rtcContext;
+                rtcInitIntersectContext(&rtcContext);
+
+                Align_(64) int32 valid[TraceWidth_];
+
+                // -- Shadow rays are queued in order so each packet is a straight copy out of the queue
+                Align_(64) RTCRay8 ray;
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    ray.org_x[scan] = pool->shadowOriginX[start + scan];
+                    ray.org_y[scan] = pool->shadowOriginY[start + scan];
+                    ray.org_z[scan] = pool->shadowOriginZ[start + scan];
+                    ray.dir_x[scan] = pool->shadowDirectionX[start + scan];
+                    ray.dir_y[scan] = pool->shadowDirectionY[start + scan];
+                    ray.dir_z[scan] = pool->shadowDirectionZ[start + scan];
+                    ray.tnear[scan] = 0.0f;
+                    ray.tfar[scan]  = pool->shadowDistances[start + scan];
+
+                    valid[scan] = -1;
+                }
+                for(uint scan = batchSize; scan < TraceWidth_; ++scan) {
+                    valid[scan] = 0;
+                }
+
+                rtcOccluded8(valid, context->rtcScene, &rtcContext, &ray);
+
+                for(uint scan = 0; scan < batchSize; ++scan) {
+                    uint32 pixelIndex = pool->shadowPixelIndices[start + scan];
+                    if(ray.tfar[scan] >= 0.0f) {
+                        FramebufferWriter_Write(&context->frameWriter, pool->shadowValues[start + scan], pixelIndex);
+                    }
+                    FramebufferWriter_EndWork(&context->frameWriter, pixelIndex);
+                }
+            }
+
+            pool->shadowCount = 0;
+        }
+
+        //=========================================================================================================================
+        static void WavefrontPathTracerKernel(void* userData)
+        {
+            KernelData* __restrict kernelData = (KernelData*)userData;
+
+            // -- Pools belong to threads rather than kernels so each is only used on the node it was allocated on. A thread can
+            // -- run more than one kernel but only one at a time and every kernel leaves its pool empty.
+            int64 kernelIndex = Atomic::Increment64(&kernelData->kernelCounter);
+            uint threadIndex = JobSystem_ThreadIndex();
+            Assert_(threadIndex < kernelData->poolCount);
+            PathPool* pool = &kernelData->pools[threadIndex];
+
+            GIIntegratorContext context;
+            context.geometryCache = kernelData->geometryCache;
+            context.textureCache  = kernelData->textureCache;
+            context.rtcScene      = kernelData->scene->rtcScene;
+            context.scene         = kernelData->scene;
+            context.camera        = kernelData->camera;
+            context.sampler.Initialize((uint32)kernelIndex);
+            context.maxPathLength = 1;
+            FramebufferWriter_Initialize(&context.frameWriter, kernelData->frame);
+
+            // -- Every path in the pool advances one bounce per wave. Finished paths return their slots to the free list and
+            // -- the next wave refills them with new camera paths until the pass runs out of pixels.
+            bool pixelsRemain = true;
+            while(true) {
+                if(pixelsRemain) {
+                    pixelsRemain = GeneratePaths(&context, pool, kernelData);
+                }
+
+                if(pool->extendCount == 0) {
+                    break;
+                }
+
+                ExtendPaths(&context, pool);
+                ShadePaths(&context, pool);
+                TraceShadowRays(&context, pool);
+            }
+
+            Assert_(pool->freeCount == PathPoolSize_);
+
+            context.sampler.Shutdown();
+            FramebufferWriter_Shutdown(&context.frameWriter);
+        }
+
+        //=========================================================================================================================
+        static void WavefrontPathTracerKernels(void* userData, uint start, uint end)
+        {
+            for(uint scan = start; scan < end; ++scan) {
+                WavefrontPathTracerKernel(userData);
+            }
+        }
+
+        //=========================================================================================================================
+        static void RenderPass(void* userData, uint32 pass)
+        {
+            KernelData* kernelData = (KernelData*)userData;
+            kernelData->pixelIndex = 0;
+            kernelData->kernelCounter = 0;
+            kernelData->pass = pass;
+
+            JobSystem_ParallelFor(kernelData->poolCount, 1, WavefrontPathTracerKernels, kernelData);
+        }
+
+        //=========================================================================================================================
+        static bool SceneHasParticipatingMedia(const SceneResource* scene)
+        {
+            // -- Transmission through a solid Disney material is what puts a path inside a medium
+            for(uint scan = 0, subsceneCount = scene->data->subsceneNames.Count(); scan < subsceneCount; ++scan) {
+                const SubsceneResource* subscene = scene->subscenes[scan];
+                for(uint model = 0, modelCount = subscene->data->modelNames.Count(); model < modelCount; ++model) {
+                    const CArray<ModelGeometryUserData>& userDatas = subscene->models[model]->userDatas;
+                    for(uint geometry = 0, geometryCount = userDatas.Count(); geometry < geometryCount; ++geometry) {
+                        const MaterialResourceData* material = userDatas[geometry].material;
+                        if(material->shader == eDisneySolid && (material->scalarAttributeValues[eSpecTrans] > 0.0f
+                                                                || material->scalarAttributeValues[eDiffuseTrans] > 0.0f)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        //=========================================================================================================================
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const ProgressiveSettings& settings, cpointer imageName)
+        {
+            bool hasMedia = SceneHasParticipatingMedia(scene);
+            Assert_(hasMedia == false);
+            if(hasMedia) {
+                return Error_("Scene %s has participating media which the wavefront path tracer does not support",
+                              scene->data->name.Ascii());
+            }
+
+            Framebuffer frame;
+            FrameBuffer_Initialize(&frame, (uint32)camera.viewportWidth, (uint32)camera.viewportHeight, FramebufferFlags_);
+
+            KernelData* kernelData = New_(KernelData);
+            kernelData->camera = &camera;
+            kernelData->kernelCounter = 0;
+            kernelData->pixelIndex = 0;
+            kernelData->pass = 0;
+            kernelData->frame = &frame;
+            kernelData->geometryCache = geometryCache;
+            kernelData->textureCache = textureCache;
+            kernelData->scene = scene;
+            kernelData->poolCount = JobSystem_ThreadCount();
+            kernelData->pools = AllocArray_(PathPool, kernelData->poolCount);
+            for(uint scan = 0; scan < kernelData->poolCount; ++scan) {
+                InitializePathPool(&kernelData->pools[scan], JobSystem_NodeId(JobSystem_ThreadNode(scan)));
+            }
+
+            Error error = RenderProgressive(&frame, textureCache, settings, SamplesPerPass_, imageName, RenderPass, kernelData);
+
+            for(uint scan = 0; scan < kernelData->poolCount; ++scan) {
+                ShutdownPathPool(&kernelData->pools[scan]);
+            }
+            Free_(kernelData->pools);
+            Delete_(kernelData);
+            FrameBuffer_Shutdown(&frame);
+
+            return error;
+        }
+    }
+}
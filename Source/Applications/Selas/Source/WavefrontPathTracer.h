@@ -0,0 +1,29 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ProgressiveRender.h"
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    class GeometryCache;
+    class TextureCache;
+    struct SceneResource;
+    struct RayCastCameraSettings;
+
+    namespace WavefrontPathTracer
+    {
+        // -- Breadth first version of the deferred path tracer that keeps every path in memory. Each thread owns a fixed pool
+        // -- of in flight paths and advances all of them one bounce at a time, refilling slots with new camera paths as old
+        // -- ones finish. Passes and budgets work the same as for the deferred path tracer.
+        // -- Participating media are not supported. Paths keep no current medium so transmission into a solid would be
+        // -- rendered as if the inside were vacuum. Scenes with transmissive solid materials assert and fail instead.
+        Error GenerateImage(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                            const RayCastCameraSettings& camera, const ProgressiveSettings& settings,
+                            cpointer imageName);
+    }
+}
@@ -5,6 +5,7 @@
 
 #include "PathTracer.h"
 #include "DeferredPathTracer.h"
+#include "WavefrontPathTracer.h"
 #include "VCM.h"
 
 #include "BuildCommon/ImageBasedLightBuildProcessor.h"
@@ -23,11 +24,18 @@
 #include "TextureLib/Framebuffer.h"
 #include "TextureLib/TextureFiltering.h"
 #include "IoLib/Environment.h"
+#include "ThreadingLib/JobSystem.h"
 #include "StringLib/FixedString.h"
+#include "StringLib/StringUtil.h"
 #include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
+#include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/SystemTime.h"
 #include "SystemLib/Logging.h"
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
+#include "SystemLib/CountOf.h"
 
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
@@ -47,6 +55,13 @@ using namespace Selas;
 static cpointer sceneName = "Scenes~island~island.json";
 static cpointer sceneType = "disneyscene";
 
+enum IntegratorType
+{
+    eDeferredPathTracer,
+    eWavefrontPathTracer,
+    eVertexConnectionAndMerging
+};
+
 //=================================================================================================================================
 static Error ValidateAssetsAreBuilt()
 {
@@ -78,6 +93,109 @@ static Error ValidateAssetsAreBuilt()
     return Success_;
 }
 
+//=================================================================================================================================
+struct EqualErrorSettings
+{
+    float referenceSeconds;
+    float targetError;
+};
+
+//=================================================================================================================================
+static void ReadProgressiveSettings(int argc, char *argv[], ProgressiveSettings& settings,
+                                    IntegratorType& integrator, cpointer& profilePath, cpointer& statsPath,
+                                    EqualErrorSettings& equalError)
+{
+    // -- -seconds <budget> -passes <budget> -checkpoint <interval> -integrator <dpt|wavefront|vcm> -profile <trace.json>
+    // -- -stats <stats.jsonl> -equalerror <reference seconds> -targeterror <rmse>. A time budget on its own leaves the pass
+    // -- count unlimited. VCM treats each of its iterations as a pass and does not write checkpoints. -equalerror replaces
+    // -- the single render with the comparison in RenderEqualErrorComparison and the budgets then cap each of its renders.
+    bool passesSet = false;
+    for(int scan = 1; scan + 1 < argc; scan += 2) {
+        if(StringUtil::Equals(argv[scan], "-integrator")) {
+            if(StringUtil::Equals(argv[scan + 1], "vcm")) {
+                integrator = eVertexConnectionAndMerging;
+            }
+            else if(StringUtil::Equals(argv[scan + 1], "wavefront")) {
+                integrator = eWavefrontPathTracer;
+            }
+            else {
+                integrator = eDeferredPathTracer;
+            }
+        }
+        else if(StringUtil::Equals(argv[scan], "-seconds")) {
+            settings.integrationSeconds = StringUtil::ToFloat(argv[scan + 1]);
+        }
+        else if(StringUtil::Equals(argv[scan], "-passes")) {
+            settings.maxPasses = (uint32)StringUtil::ToInt32(argv[scan + 1]);
+            passesSet = true;
+        }
+        else if(StringUtil::Equals(argv[scan], "-checkpoint")) {
+            settings.checkpointSeconds = StringUtil::ToFloat(argv[scan + 1]);
+        }
+        else if(StringUtil::Equals(argv[scan], "-profile")) {
+            profilePath = argv[scan + 1];
+        }
+        else if(StringUtil::Equals(argv[scan], "-stats")) {
+            statsPath = argv[scan + 1];
+        }
+        else if(StringUtil::Equals(argv[scan], "-equalerror")) {
+            equalError.referenceSeconds = StringUtil::ToFloat(argv[scan + 1]);
+        }
+        else if(StringUtil::Equals(argv[scan], "-targeterror")) {
+            equalError.targetError = StringUtil::ToFloat(argv[scan + 1]);
+        }
+        else {
+            WriteDebugInfo_("Ignoring unknown argument %s", argv[scan]);
+        }
+    }
+
+    if(settings.integrationSeconds > 0.0f && passesSet == false) {
+        settings.maxPasses = 0;
+    }
+}
+
+//=================================================================================================================================
+// -- Time to equal error of the deferred path tracer and VCM. A long deferred path tracer render is the reference and each
+// -- integrator then renders until its root mean squared error against it falls to the target. Both log the render time at
+// -- which they got there, with the time spent measuring left out.
+static Error RenderEqualErrorComparison(GeometryCache* geometryCache, TextureCache* textureCache, SceneResource* scene,
+                                        const RayCastCameraSettings& camera, const ProgressiveSettings& settings,
+                                        const EqualErrorSettings& equalError, cpointer cameraName)
+{
+    float3* reference = AllocArray_(float3, (uint32)camera.viewportWidth * (uint32)camera.viewportHeight);
+
+    FilePathString imageName;
+
+    ProgressiveSettings referenceSettings;
+    referenceSettings.integrationSeconds = equalError.referenceSeconds;
+    referenceSettings.maxPasses = 0;
+    referenceSettings.beautyOutput = reference;
+
+    FixedStringSprintf(imageName, "%s_reference", cameraName);
+    Error error = DeferredPathTracer::GenerateImage(geometryCache, textureCache, scene, camera, referenceSettings,
+                                                    imageName.Ascii());
+
+    ProgressiveSettings measuredSettings = settings;
+    measuredSettings.errorReference = reference;
+    measuredSettings.targetError = equalError.targetError;
+
+    if(Successful_(error)) {
+        WriteDebugInfo_("Equal error: deferred path tracer to rmse %f", equalError.targetError);
+        FixedStringSprintf(imageName, "%s_dpt", cameraName);
+        error = DeferredPathTracer::GenerateImage(geometryCache, textureCache, scene, camera, measuredSettings,
+                                                  imageName.Ascii());
+    }
+
+    if(Successful_(error)) {
+        WriteDebugInfo_("Equal error: vcm to rmse %f", equalError.targetError);
+        FixedStringSprintf(imageName, "%s_vcm", cameraName);
+        error = VCM::GenerateImage(geometryCache, textureCache, scene, camera, measuredSettings, imageName.Ascii());
+    }
+
+    Free_(reference);
+    return error;
+}
+
 //=================================================================================================================================
 int main(int argc, char *argv[])
 {
@@ -85,6 +203,29 @@ int main(int argc, char *argv[])
     _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
 
     Environment_Initialize(ProjectRootName_, argv[0]);
+    JobSystem_Initialize();
+
+    ProgressiveSettings progressiveSettings;
+    IntegratorType integrator = eDeferredPathTracer;
+    cpointer profilePath = nullptr;
+    cpointer statsPath = nullptr;
+    EqualErrorSettings equalError = { 0.0f, 0.0f };
+    ReadProgressiveSettings(argc, argv, progressiveSettings, integrator, profilePath, statsPath, equalError);
+
+    if(profilePath != nullptr) {
+        Profiler_Initialize(profilePath);
+    }
+
+    if(statsPath != nullptr) {
+        // -- Shading time is recorded per ShaderType
+        static cpointer shaderNames[] = {
+            "DisneyThin",
+            "DisneySolid",
+            "DiracTransparent"
+        };
+        static_assert(CountOf_(shaderNames) == eShaderCount, "Missing shader name");
+        RenderStats_Initialize(statsPath, shaderNames, CountOf_(shaderNames));
+    }
 
     TextureCache textureCache;
     textureCache.Initialize(TextureCacheSize_);
@@ -108,6 +249,16 @@ int main(int argc, char *argv[])
 
     geometryCache.RegisterSubscenes(sceneResource.subscenes, sceneResource.data->subsceneNames.Count());
 
+    Selas::uint width  = 1024;
+    Selas::uint height = 429;
+
+    // -- Displaced geometry picks its tessellation rate when loaded so set a view up before the preloads below
+    if(sceneResource.data->cameras.Count() > 0) {
+        RayCastCameraSettings camera;
+        SetupSceneCamera(&sceneResource, 0, width, height, camera);
+        SetSceneTessellationCamera(&sceneResource, camera);
+    }
+
     // -- preload these so they remain always loaded.
     geometryCache.PreloadSubscene("Scenes~island~json~isMountainA~isMountainA.json_geometry");
     geometryCache.PreloadSubscene("Scenes~island~json~isMountainA~isMountainA.json");
@@ -118,18 +269,32 @@ int main(int argc, char *argv[])
     geometryCache.PreloadSubscene("Scenes~island~json~isIronwoodA1~isIronwoodA1.json_geometry");
     geometryCache.PreloadSubscene("Scenes~island~json~isIronwoodA1~isIronwoodA1.json");
 
-    Selas::uint width  = 1024;
-    Selas::uint height = 429;
-
     for(uint scan = 0, count = sceneResource.data->cameras.Count(); scan < count; ++scan) {
         RayCastCameraSettings camera;
         SetupSceneCamera(&sceneResource, scan, width, height, camera);
+        SetSceneTessellationCamera(&sceneResource, camera);
 
         timer = SystemTime::Now();
-        //PathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera, "UnidirectionalPT");
-        DeferredPathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera,
-                                          sceneResource.data->cameras[scan].name.Ascii());
-        //VCM::GenerateImage(&sceneResource, camera, "VCM");
+        //ExitMainOnError_(PathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera, "UnidirectionalPT"));
+        if(equalError.referenceSeconds > 0.0f) {
+            ExitMainOnError_(RenderEqualErrorComparison(&geometryCache, &textureCache, &sceneResource, camera,
+                                                        progressiveSettings, equalError,
+                                                        sceneResource.data->cameras[scan].name.Ascii()));
+        }
+        else if(integrator == eVertexConnectionAndMerging) {
+            ExitMainOnError_(VCM::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera, progressiveSettings,
+                                                sceneResource.data->cameras[scan].name.Ascii()));
+        }
+        else if(integrator == eWavefrontPathTracer) {
+            ExitMainOnError_(WavefrontPathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera,
+                                                                progressiveSettings,
+                                                                sceneResource.data->cameras[scan].name.Ascii()));
+        }
+        else {
+            ExitMainOnError_(DeferredPathTracer::GenerateImage(&geometryCache, &textureCache, &sceneResource, camera,
+                                                               progressiveSettings,
+                                                               sceneResource.data->cameras[scan].name.Ascii()));
+        }
         elapsedMs = SystemTime::ElapsedMillisecondsF(timer);
         WriteDebugInfo_("Scene render time %fms", elapsedMs);
     }
@@ -140,5 +305,12 @@ int main(int argc, char *argv[])
     geometryCache.Shutdown();
     textureCache.Shutdown();
 
+    AllocationStats_Log();
+
+    JobSystem_Shutdown();
+    Profiler_Shutdown();
+    RenderStats_Shutdown();
+    ThreadArena_ShutdownAll();
+
     return 0;
 }
@@ -42,65 +42,128 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    static void CalculateStrataDistributionFunctions(uint width, uint height, float* __restrict intensities,
-                                                     IblDensityFunctions* functions)
+    static void BuildAliasTable(const float* __restrict weights, uint count, IblAliasEntry* __restrict table)
     {
-        uint mdfCount = CalculateMarginalDensityFunctionCount(width, height);
-        uint cdfCount = CalculateConditionalDensityFunctionsCount(width, height);
+        // -- Vose's alias method. See "A Linear Algorithm For Generating Random Numbers With a Given Distribution".
+        double sum = 0.0;
+        for(uint scan = 0; scan < count; ++scan) {
+            sum += weights[scan];
+        }
 
-        functions->width = width;
-        functions->height = height;
-        functions->marginalDensityFunction = AllocArray_(float, mdfCount);
-        functions->conditionalDensityFunctions = AllocArray_(float, cdfCount);
+        if(sum <= 0.0) {
+            for(uint scan = 0; scan < count; ++scan) {
+                table[scan].threshold = 1.0f;
+                table[scan].alias = (uint32)scan;
+            }
+            return;
+        }
 
-        Memory::Zero(functions->marginalDensityFunction, sizeof(float) * mdfCount);
-        Memory::Zero(functions->conditionalDensityFunctions, sizeof(float) * cdfCount);
+        double* scaled = AllocArray_(double, count);
+        uint32* small = AllocArray_(uint32, count);
+        uint32* large = AllocArray_(uint32, count);
+        uint smallCount = 0;
+        uint largeCount = 0;
+
+        double scale = (double)count / sum;
+        for(uint scan = 0; scan < count; ++scan) {
+            scaled[scan] = weights[scan] * scale;
+            if(scaled[scan] < 1.0) {
+                small[smallCount++] = (uint32)scan;
+            }
+            else {
+                large[largeCount++] = (uint32)scan;
+            }
+        }
 
-        // Calculate each of the density functions
-        float marginalSum = 0.0f;
-        for(uint y = 0; y < height; ++y) {
+        // -- Each under full entry is topped off by an over full one which then goes back into whichever list it now belongs to
+        while(smallCount > 0 && largeCount > 0) {
+            uint32 less = small[--smallCount];
+            uint32 more = large[--largeCount];
 
-            // Sum along the row to get the normalization factor
-            float conditionalSum = 0.0f;
-            for(uint x = 0; x < width; ++x) {
-                float intensity = intensities[y * width + x];
-                conditionalSum += intensity;
-            }
+            table[less].threshold = (float)scaled[less];
+            table[less].alias = more;
 
-            // Record the max for this row in the marginal density function array
-            functions->marginalDensityFunction[y] = conditionalSum;
-            marginalSum += conditionalSum;
+            scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+            if(scaled[more] < 1.0) {
+                small[smallCount++] = more;
+            }
+            else {
+                large[largeCount++] = more;
+            }
+        }
 
-            // If the row wasn't all zeros we normalize the function and integrate the results
-            if(conditionalSum > 0.0f) {
-                float ooSum = 1.0f / conditionalSum;
-                float integration = 0.0f;
-                for(uint x = 0; x < width; ++x) {
-                    uint index = y * width + x;
+        // -- Anything left over is full up to floating point imprecision
+        while(largeCount > 0) {
+            uint32 index = large[--largeCount];
+            table[index].threshold = 1.0f;
+            table[index].alias = index;
+        }
+        while(smallCount > 0) {
+            uint32 index = small[--smallCount];
+            table[index].threshold = 1.0f;
+            table[index].alias = index;
+        }
 
-                    float intensity = ooSum * intensities[index];
+        Free_(large);
+        Free_(small);
+        Free_(scaled);
+    }
 
-                    integration += intensity;
-                    functions->conditionalDensityFunctions[index] = integration;
-                }
-            }
+    //=============================================================================================================================
+    static void CalculateSamplingTables(uint width, uint height, float* __restrict intensities, IblDensityFunctions* functions)
+    {
+        uint texelCount = width * height;
 
-            // -- account for floating point imprecision
-            functions->conditionalDensityFunctions[y * width + width - 1] = 1.0f;
+        functions->width = width;
+        functions->height = height;
+        functions->aliasTable = AllocArray_(IblAliasEntry, texelCount);
+        functions->pdfs = AllocArray_(float, texelCount);
+        functions->sinThetas = AllocArray_(float, height);
+        functions->cosThetas = AllocArray_(float, height);
+        functions->sinPhis = AllocArray_(float, width);
+        functions->cosPhis = AllocArray_(float, width);
+
+        BuildAliasTable(intensities, texelCount, functions->aliasTable);
+
+        double sum = 0.0;
+        for(uint scan = 0; scan < texelCount; ++scan) {
+            sum += intensities[scan];
         }
+        float ooSum = (sum > 0.0) ? (float)(1.0 / sum) : 0.0f;
+
+        float widthf = (float)width;
+        float heightf = (float)height;
+
+        for(uint y = 0; y < height; ++y) {
+            // -- theta represents the vertical position on the sphere and varies between 0 and pi
+            float theta = (y + 0.5f) * Math::Pi_ / heightf;
+            float sinTheta = Math::Sinf(theta);
+            functions->sinThetas[y] = sinTheta;
+            functions->cosThetas[y] = Math::Cosf(theta);
 
-        // If the entire stratum wasn't all zeros we normalize the marginal density function
-        if(marginalSum > 0.0f) {
-            float ooSum = 1.0f / marginalSum;
-            float integration = 0.0f;
-            for(uint scanY = 0; scanY < height; ++scanY) {
-                integration += functions->marginalDensityFunction[scanY] * ooSum;
-                functions->marginalDensityFunction[scanY] = integration;
+            // -- A texel spans (2pi / width) * (pi / height) * sin(theta) steradians so dividing the probability of choosing
+            // -- it by that gives the solid angle pdf.
+            float toSolidAngle = (widthf * heightf) / (2.0f * Math::Pi_ * Math::Pi_ * sinTheta);
+            for(uint x = 0; x < width; ++x) {
+                uint index = y * width + x;
+                functions->pdfs[index] = intensities[index] * ooSum * toSolidAngle;
             }
         }
 
-        // -- account for floating point imprecision
-        functions->marginalDensityFunction[height - 1] = 1.0f;
+        for(uint x = 0; x < width; ++x) {
+            // -- phi represents the horizontal position on the sphere before the ibl's rotation is applied
+            float phi = (x + 0.5f) * Math::TwoPi_ / widthf;
+            functions->sinPhis[x] = Math::Sinf(phi);
+            functions->cosPhis[x] = Math::Cosf(phi);
+        }
+    }
+
+    //=============================================================================================================================
+    void CalculateIblDensityFunctions(uint width, uint height, float3* hdr, IblDensityFunctions* functions)
+    {
+        float* intensities = CalculateIntensityMap(width, height, hdr);
+        CalculateSamplingTables(width, height, intensities, functions);
+        FreeAligned_(intensities);
     }
 
     struct Rgb16
@@ -168,11 +231,8 @@ namespace Selas
         ibl->missHeight = 0;
         ibl->rotationRadians = 0.0f;
         
-        float* intensities = CalculateIntensityMap(width, height, ibl->lightData);
-
-        CalculateStrataDistributionFunctions(width, height, intensities, &ibl->densityfunctions);
+        CalculateIblDensityFunctions(width, height, ibl->lightData, &ibl->densityfunctions);
 
-        FreeAligned_(intensities);
         Free_(raw);
 
         return Success_;
@@ -193,8 +253,7 @@ namespace Selas
         ReturnError_(ReadIblTextureFile(context, missPath, missWidth, missHeight, missData));
 
         ibl->lightData = lightData;
-        float* intensities = CalculateIntensityMap(lightWidth, lightHeight, ibl->lightData);
-        CalculateStrataDistributionFunctions(lightWidth, lightHeight, intensities, &ibl->densityfunctions);
+        CalculateIblDensityFunctions(lightWidth, lightHeight, ibl->lightData, &ibl->densityfunctions);
 
         ibl->missData = missData;
         ibl->missWidth = missWidth;
@@ -202,8 +261,6 @@ namespace Selas
         ibl->rotationRadians = 0.0f;
         ibl->exposureScale = 1.0f;
 
-        FreeAligned_(intensities);
-
         return Success_;
     }
 }
\ No newline at end of file
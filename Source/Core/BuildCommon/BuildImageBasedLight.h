@@ -10,7 +10,12 @@
 namespace Selas
 {
     struct ImageBasedLightResourceData;
+    struct IblDensityFunctions;
     struct BuildProcessorContext;
+    struct float3;
+
+    // -- Builds the importance sampling tables for a width x height lat-long image
+    void CalculateIblDensityFunctions(uint width, uint height, float3* hdr, IblDensityFunctions* functions);
 
     Error ImportImageBasedLight(BuildProcessorContext* context, ImageBasedLightResourceData* ibl);
     Error ImportDualImageBasedLight(BuildProcessorContext* context, cpointer lightPath, cpointer missPath,
@@ -53,11 +53,17 @@ namespace Selas
         material.baseColor = importedMaterialData.baseColor;
         material.transmittanceColor = importedMaterialData.transmittanceColor;
         material.baseColorTexture.Copy(importedMaterialData.baseColorTexture.Ascii());
+        material.displacementTexture.Copy(importedMaterialData.scalarAttributeTextures[eDisplacement].Ascii());
 
         for(uint property = 0; property < eMaterialPropertyCount; ++property) {
             material.scalarAttributeValues[property] = importedMaterialData.scalarAttributes[property];
         }
 
+        // -- Only textured displacement changes the surface's shape so untextured materials stay on the cheaper mesh types
+        if(material.displacementTexture.Length() > 0 && material.scalarAttributeValues[eDisplacement] != 0.0f) {
+            material.flags |= eDisplacementEnabled;
+        }
+
         if(material.shader == eDisneySolid) {
             if(material.scalarAttributeValues[eDiffuseTrans] > 0.0f || material.scalarAttributeValues[eSpecTrans] > 0.0f) {
                 material.flags |= eTransparent;
@@ -210,6 +216,10 @@ namespace Selas
 
             MaterialResourceData& material = built->materials.Add();
             BuildMaterial(importedMaterialData, material);
+
+            if(material.flags & eDisplacementEnabled) {
+                built->textures.Add(material.displacementTexture);
+            }
         }
 
         QuickSortMatchingArrays(built->materialHashes.DataPointer(), built->materials.DataPointer(), built->materials.Count());
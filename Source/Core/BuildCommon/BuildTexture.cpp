@@ -6,6 +6,7 @@
 #include "BuildCore/BuildContext.h"
 #include "TextureLib/StbImage.h"
 #include "TextureLib/TextureResource.h"
+#include "TextureLib/TextureFiltering.h"
 #include "UtilityLib/Color.h"
 #include "StringLib/FixedString.h"
 #include "StringLib/StringUtil.h"
@@ -20,6 +21,8 @@
 
 #include <stdio.h>
 
+#define AlphaTestCutoff_ 0.5f
+
 namespace Selas
 {
     //=============================================================================================================================
@@ -153,9 +156,49 @@ namespace Selas
 
     //=============================================================================================================================
     template <typename Type_>
-    static bool GenerateMipMaps(TextureMipFilters prefilter, Type_* linear, uint width, uint height,
-                                uint64* mipOffsets, uint32* mipWidths, uint32* mipHeights, Type_*& mipmaps, uint32& mipCount,
-                                uint32& dataSize)
+    static void TileMipMaps(uint32 mipCount, uint64* mipOffsets, const uint32* mipWidths, const uint32* mipHeights,
+                            Type_*& mipmaps, uint32& dataSize)
+    {
+        const uint32 tileDim = TextureResourceData::TileDimension;
+
+        uint64 tiledOffsets[TextureResourceData::MaxMipCount];
+        uint totalTexelCount = 0;
+        for(uint scan = 0; scan < mipCount; ++scan) {
+            uint paddedWidth  = (mipWidths[scan] + tileDim - 1) / tileDim * tileDim;
+            uint paddedHeight = (mipHeights[scan] + tileDim - 1) / tileDim * tileDim;
+
+            tiledOffsets[scan] = sizeof(Type_) * totalTexelCount;
+            totalTexelCount += paddedWidth * paddedHeight;
+        }
+
+        Type_* tiled = AllocArray_(Type_, totalTexelCount);
+        Memory::Zero(tiled, sizeof(Type_) * totalTexelCount);
+
+        for(uint scan = 0; scan < mipCount; ++scan) {
+            uint32 mipWidth = mipWidths[scan];
+            Type_* src = mipmaps + mipOffsets[scan] / sizeof(Type_);
+            Type_* dst = tiled + tiledOffsets[scan] / sizeof(Type_);
+
+            for(uint32 y = 0; y < mipHeights[scan]; ++y) {
+                for(uint32 x = 0; x < mipWidth; ++x) {
+                    dst[TextureFiltering::TexelIndex(TextureResourceData::Tiled4x4, mipWidth, (int32)x, (int32)y)]
+                        = src[y * mipWidth + x];
+                }
+            }
+
+            mipOffsets[scan] = tiledOffsets[scan];
+        }
+
+        Free_(mipmaps);
+        mipmaps = tiled;
+        dataSize = (uint32)(sizeof(Type_) * totalTexelCount);
+    }
+
+    //=============================================================================================================================
+    template <typename Type_>
+    static bool GenerateMipMaps(TextureMipFilters prefilter, TextureResourceData::TexelLayout layout, Type_* linear,
+                                uint width, uint height, uint64* mipOffsets, uint32* mipWidths, uint32* mipHeights,
+                                Type_*& mipmaps, uint32& mipCount, uint32& dataSize)
     {
         AssertMsg_(prefilter == Box, "Only Box filter is currently implemented");
 
@@ -210,9 +253,30 @@ namespace Selas
             mipOffsets[scan] = sizeof(Type_) * indexOffset;
         }
 
+        if(layout == TextureResourceData::Tiled4x4) {
+            TileMipMaps(mipCount, mipOffsets, mipWidths, mipHeights, mipmaps, dataSize);
+        }
+
         return true;
     }
 
+    //=============================================================================================================================
+    static void GenerateCoverage(const float4* linear, uint width, uint height, TextureResourceData* texture)
+    {
+        uint texelCount = width * height;
+        uint wordCount = (texelCount + 31) / 32;
+
+        texture->coverage = AllocArray_(uint32, wordCount);
+        texture->coverageSize = (uint32)(wordCount * sizeof(uint32));
+        Memory::Zero(texture->coverage, texture->coverageSize);
+
+        for(uint scan = 0; scan < texelCount; ++scan) {
+            if(linear[scan].w > AlphaTestCutoff_) {
+                texture->coverage[scan >> 5] |= (1u << (scan & 31));
+            }
+        }
+    }
+
     //=============================================================================================================================
     bool IsNormalMapTexture(const FilePathString& str)
     {
@@ -228,7 +292,8 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    Error ImportTexture(BuildProcessorContext* context, TextureMipFilters prefilter, TextureResourceData* texture)
+    Error ImportTexture(BuildProcessorContext* context, TextureMipFilters prefilter, TextureResourceData::TexelLayout layout,
+                        TextureResourceData* texture)
     {
         FilePathString filepath;
         AssetFileUtils::ContentFilePath(context->source.name.Ascii(), filepath);
@@ -245,6 +310,10 @@ namespace Selas
         void* rawData;
         ReturnError_(StbImageRead(filepath.Ascii(), NoComponentCountRequest_, 8, width, height, channels, floatData, rawData));
 
+        texture->coverage = nullptr;
+        texture->coverageSize = 0;
+        texture->pad = 0;
+
         bool result;
         if(channels == 1) {
             float* linear = nullptr;
@@ -252,7 +321,7 @@ namespace Selas
 
             float* textureData;
             texture->dataSize = 0;
-            result = GenerateMipMaps<float>(prefilter, linear, width, height,
+            result = GenerateMipMaps<float>(prefilter, layout, linear, width, height,
                                      texture->mipOffsets, texture->mipWidths, texture->mipHeights, textureData, texture->mipCount,
                                     texture->dataSize);
             texture->texture = reinterpret_cast<uint8*>(textureData);
@@ -268,7 +337,7 @@ namespace Selas
 
             float3* textureData;
             texture->dataSize = 0;
-            result = GenerateMipMaps<float3>(prefilter, linear, width, height,
+            result = GenerateMipMaps<float3>(prefilter, layout, linear, width, height,
                                      texture->mipOffsets, texture->mipWidths, texture->mipHeights, textureData, texture->mipCount,
                                      texture->dataSize);
             texture->texture = reinterpret_cast<uint8*>(textureData);
@@ -284,17 +353,20 @@ namespace Selas
 
             float4* textureData;
             texture->dataSize = 0;
-            result = GenerateMipMaps<float4>(prefilter, linear, width, height,
+            result = GenerateMipMaps<float4>(prefilter, layout, linear, width, height,
                                              texture->mipOffsets, texture->mipWidths, texture->mipHeights, textureData,
                                              texture->mipCount, texture->dataSize);
             texture->texture = reinterpret_cast<uint8*>(textureData);
             texture->format = TextureResourceData::Float4;
+            GenerateCoverage(linear, width, height, texture);
             Free_(linear);
         }
         else {
             return Error_("NYI - Unsupported (or NYI) channel texture format for texture '%s'.", filepath.Ascii());
         }
 
+        texture->layout = layout;
+
         Free_(rawData);
 
         return Success_;
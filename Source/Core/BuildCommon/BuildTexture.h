@@ -4,13 +4,13 @@
 // Joe Schutte
 //=================================================================================================================================
 
+#include "TextureLib/TextureResource.h"
 #include "MathLib/FloatStructs.h"
 #include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
 {
-    struct TextureResourceData;
     struct BuildProcessorContext;
 
     enum TextureMipFilters
@@ -20,5 +20,6 @@ namespace Selas
         //Lanczos
     };
 
-    Error ImportTexture(BuildProcessorContext* context, TextureMipFilters prefilter, TextureResourceData* texture);
+    Error ImportTexture(BuildProcessorContext* context, TextureMipFilters prefilter, TextureResourceData::TexelLayout layout,
+                        TextureResourceData* texture);
 }
\ No newline at end of file
@@ -42,8 +42,7 @@ namespace Selas
         ReturnError_(ImportImageBasedLight(context, &iblData));
         ReturnError_(BakeImageBasedLight(context, &iblData));
 
-        SafeFree_(iblData.densityfunctions.conditionalDensityFunctions);
-        SafeFree_(iblData.densityfunctions.marginalDensityFunction);
+        ShutdownDensityFunctions(&iblData.densityfunctions);
         SafeFree_(iblData.lightData);
 
         return Success_;
@@ -111,8 +110,7 @@ namespace Selas
         iblData.exposureScale = Math::Powf(2.0f, exposure);
         ReturnError_(BakeImageBasedLight(context, &iblData));
 
-        SafeFree_(iblData.densityfunctions.conditionalDensityFunctions);
-        SafeFree_(iblData.densityfunctions.marginalDensityFunction);
+        ShutdownDensityFunctions(&iblData.densityfunctions);
         SafeFree_(iblData.lightData);
         SafeFree_(iblData.missData);
 
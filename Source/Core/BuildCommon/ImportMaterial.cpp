@@ -76,12 +76,19 @@ namespace Selas
 
             if(Json::IsStringAttribute(document, attributes[scan])) {
                 Json::ReadFixedString(document, attributes[scan], material->scalarAttributeTextures[scan]);
+                // -- Only displacement textures are sampled so any other textured attribute keeps its default value
+                material->scalarAttributes[scan] = (scan == eDisplacement) ? 1.0f : attributeDefaults[scan];
             }
             else {
                 Json::ReadFloat(document, attributes[scan], material->scalarAttributes[scan], attributeDefaults[scan]);
             }
         }
              
+        // -- Textured displacement is in texture units so it needs its own world space scale
+        if(material->scalarAttributeTextures[eDisplacement].Length() > 0) {
+            Json::ReadFloat(document, "displacementScale", material->scalarAttributes[eDisplacement], 1.0f);
+        }
+
         Json::ReadBool(document, "alphaTesting", material->alphaTested, false);
         Json::ReadBool(document, "invertDisplacement", material->invertDisplacement, false);
         Json::ReadBool(document, "usesPtex", material->usesPtex, false);
@@ -9,6 +9,9 @@
 #include "Assets/AssetFileUtils.h"
 #include "SystemLib/MemoryAllocation.h"
 
+// -- Store mips in 4x4 tiles so filtering footprints touch fewer cache lines
+#define TexelLayout_ TextureResourceData::Tiled4x4
+
 namespace Selas
 {
     //=============================================================================================================================
@@ -35,10 +38,11 @@ namespace Selas
     Error CTextureBuildProcessor::Process(BuildProcessorContext* context)
     {
         TextureResourceData textureData;
-        ReturnError_(ImportTexture(context, Box, &textureData));
+        ReturnError_(ImportTexture(context, Box, TexelLayout_, &textureData));
         ReturnError_(BakeTexture(context, &textureData));
 
         Free_(textureData.texture);
+        SafeFree_(textureData.coverage);
 
         return Success_;
     }
@@ -8,16 +8,14 @@
 #include "UtilityLib/MurmurHash.h"
 #include "StringLib/StringUtil.h"
 #include "ContainersLib/QueueList.h"
+#include "ThreadingLib/JobSystem.h"
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/JsAssert.h"
 #include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/MinMax.h"
-#include "SystemLib/Atomic.h"
 
 #include <map>
 
-#include <tbb/task.h>
-
 #define RunMultiThreaded_ true
 
 namespace Selas
@@ -40,7 +38,7 @@ namespace Selas
         QueueList completedQueue;
         QueueList failedQueue;
 
-        int64 activeTaskCount;
+        JobCounter activeTasks;
     };
 
     //=============================================================================================================================
@@ -53,36 +51,27 @@ namespace Selas
     };
 
     //=============================================================================================================================
-    class BuildCoreTask : public tbb::task
+    static void BuildCoreTask(void* userData)
     {
-    public:
-        BuildCoreTaskData* data;
-
-        tbb::task* execute()
-        {
-            Error result = data->processor->Process(&data->context);
+        BuildCoreTaskData* data = (BuildCoreTaskData*)userData;
 
-            if(Successful_(result)) {
-                EnterSpinLock(data->coreData->mtQueuesSpinlock);
-                QueueList_Push(&data->coreData->completedQueue, data);
-                LeaveSpinLock(data->coreData->mtQueuesSpinlock);
-            }
-            else {
-                EnterSpinLock(data->coreData->mtQueuesSpinlock);
-                QueueList_Push(&data->coreData->failedQueue, data);
-                LeaveSpinLock(data->coreData->mtQueuesSpinlock);
-            }
+        Error result = data->processor->Process(&data->context);
 
-            Atomic::Decrement64(&data->coreData->activeTaskCount);
-            return nullptr;
+        if(Successful_(result)) {
+            EnterSpinLock(data->coreData->mtQueuesSpinlock);
+            QueueList_Push(&data->coreData->completedQueue, data);
+            LeaveSpinLock(data->coreData->mtQueuesSpinlock);
         }
-    };
+        else {
+            EnterSpinLock(data->coreData->mtQueuesSpinlock);
+            QueueList_Push(&data->coreData->failedQueue, data);
+            LeaveSpinLock(data->coreData->mtQueuesSpinlock);
+        }
+    }
 
     //=============================================================================================================================
     static BuildCoreTaskData* AllocateTaskData(BuildCoreData* coreData)
     {
-        Atomic::Increment64(&coreData->activeTaskCount);
-
         BuildCoreTaskData* taskData = QueueList_Pop<BuildCoreTaskData*>(&coreData->taskDataFreeList);
         if(taskData) {
             return taskData;
@@ -109,7 +98,6 @@ namespace Selas
     {
         _coreData = New_(BuildCoreData);
         _coreData->depGraph = depGraph;
-        _coreData->activeTaskCount = 0;
 
         QueueList_Initialize(&_coreData->taskDataFreeList, /*maxFreeListSize=*/64);
         QueueList_Initialize(&_coreData->pendingQueue, /*maxFreeListSize=*/64);
@@ -193,6 +181,13 @@ namespace Selas
                 sleepTimeMs = MainThreadStartIdleTime_;
             }
 
+            // -- Help with the processes rather than sleep. Without this nothing runs when there are no worker threads.
+            if(JobSystem_TryRunJob()) {
+                spinningBackoff = 0;
+                sleepTimeMs = MainThreadStartIdleTime_;
+                continue;
+            }
+
             ++spinningBackoff;
             if(spinningBackoff == MainThreadIdleBackoffCount_) {
                 Sleep(sleepTimeMs);
@@ -235,7 +230,7 @@ namespace Selas
     //=============================================================================================================================
     bool CBuildCore::IsBuildComplete()
     {
-        bool hasPendingJobs = _coreData->activeTaskCount > 0;
+        bool hasPendingJobs = _coreData->activeTasks.count > 0;
         bool hasPendingWork = QueueList_Empty(&_coreData->pendingQueue) == false;
         bool hasCompletedJob = HasCompletedProcesses();
 
@@ -305,15 +300,13 @@ namespace Selas
             return true;
         }
 
-        BuildCoreTask& task = *new(tbb::task::allocate_root()) BuildCoreTask();
-        task.data = AllocateTaskData(_coreData);
-
-        task.data->processor = processor;
-        task.data->deps = next;
-        task.data->coreData = _coreData;
-        task.data->context.Initialize(next->source, next->id);
+        BuildCoreTaskData* taskData = AllocateTaskData(_coreData);
+        taskData->processor = processor;
+        taskData->deps = next;
+        taskData->coreData = _coreData;
+        taskData->context.Initialize(next->source, next->id);
 
-        tbb::task::enqueue(task);
+        JobSystem_Submit(BuildCoreTask, taskData, &_coreData->activeTasks);
 
         return true;
     }
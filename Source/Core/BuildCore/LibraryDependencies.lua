@@ -1,4 +1 @@
-
 local platform = ...
-
-loadfile(RootDirectory .. "ProjectGen\\Middlewares\\tbb.lua")(platform)
@@ -8,6 +8,7 @@
 #include "ContainersLib/Rect.h"
 #include "MathLib/CorrelatedMultiJitter.h"
 #include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
 #include "MathLib/Sampler.h"
 
 namespace Selas
@@ -85,6 +86,26 @@ namespace Selas
         return result;
     }
 
+    //=============================================================================================================================
+    int2 WorldToImage(const RayCastCameraSettings* __restrict camera, float3 position)
+    {
+        float3 toPosition = position - camera->position;
+
+        float z = Dot(toPosition, camera->cameraZ);
+        if(z <= 0.0f) {
+            return int2(-1, -1);
+        }
+
+        float2 clip;
+        clip.x = -Dot(toPosition, camera->cameraX) / (z * LengthSquared(camera->cameraX));
+        clip.y =  Dot(toPosition, camera->cameraY) / (z * LengthSquared(camera->cameraY));
+
+        float x = (clip.x + 1.0f) * 0.5f * camera->width;
+        float y = (1.0f - clip.y) * 0.5f * camera->height;
+
+        return int2((int32)Math::Floor(x), (int32)Math::Floor(y));
+    }
+
     //=============================================================================================================================
     void InitializeRayCastCamera(const CameraSettings& settings, uint width, uint height, RayCastCameraSettings& camera)
     {
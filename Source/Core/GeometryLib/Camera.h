@@ -56,5 +56,8 @@ namespace Selas
     Ray JitteredCameraRay(const RayCastCameraSettings* __restrict camera, CSampler* sampler, float viewX, float viewY);
     Ray JitteredCameraRay(const RayCastCameraSettings* __restrict camera, int32 x, int32 y, int32 s, int32 m, int32 n, int32 p);
 
+    // -- Inverse of the camera ray generation. Positions behind the camera or outside the viewport give pixels out of range.
+    int2 WorldToImage(const RayCastCameraSettings* __restrict camera, float3 position);
+
     void InitializeRayCastCamera(const CameraSettings& settings, uint width, uint height, RayCastCameraSettings& camera);
 }
\ No newline at end of file
@@ -36,6 +36,16 @@ namespace Selas
             return result;
         }
 
+        //=========================================================================================================================
+        static uint64 FileTell_(FILE* file)
+        {
+            #if IsWindows_
+                return (uint64)_ftelli64(file);
+            #elif IsOsx_
+                return (uint64)ftello(file);
+            #endif
+        }
+
         //=========================================================================================================================
         Error ReadWholeFile(const char* filepath, void** __restrict fileData, uint64* __restrict fileSize)
         {
@@ -45,7 +55,7 @@ namespace Selas
             }
 
             fseek(file, 0, SEEK_END);
-            *fileSize = _ftelli64(file);
+            *fileSize = FileTell_(file);
             fseek(file, 0, SEEK_SET);
 
             *fileData = AllocAligned_(*fileSize, 16);
@@ -62,6 +72,32 @@ namespace Selas
             return Success_;
         }
 
+        //=========================================================================================================================
+        Error ReadWholeFile(cpointer filepath, void* buffer, uint64 bufferSize, uint64* fileSize)
+        {
+            FILE* file = OpenFile_(filepath, "rb");
+            if(file == nullptr) {
+                return Error_("Failed to open file: %s", filepath);
+            }
+
+            fseek(file, 0, SEEK_END);
+            *fileSize = FileTell_(file);
+            fseek(file, 0, SEEK_SET);
+
+            if(*fileSize > bufferSize) {
+                fclose(file);
+                return Error_("File %s does not fit in a buffer of %llu bytes", filepath, bufferSize);
+            }
+
+            size_t bytesRead = fread(buffer, 1, *fileSize, file);
+            fclose(file);
+
+            Assert_(bytesRead == *fileSize);
+            Unused_(bytesRead);
+
+            return Success_;
+        }
+
         //=========================================================================================================================
         Error ReadWhileFileAsString(cpointer filepath, char** string, uint64* stringSize)
         {
@@ -71,7 +107,7 @@ namespace Selas
             }
 
             fseek(file, 0, SEEK_END);
-            uint64 fileSize = _ftelli64(file);
+            uint64 fileSize = FileTell_(file);
             fseek(file, 0, SEEK_SET);
 
             *string = (char*)AllocAligned_(fileSize + 1, 16);
@@ -118,7 +154,7 @@ namespace Selas
             }
 
             fseek(file, 0, SEEK_END);
-            size = _ftelli64(file);
+            size = FileTell_(file);
             fseek(file, 0, SEEK_SET);
 
             fclose(file);
@@ -136,5 +172,15 @@ namespace Selas
                 return res == 0;
             #endif
         }
+
+        //=========================================================================================================================
+        Error Delete(cpointer filepath)
+        {
+            if(remove(filepath) != 0) {
+                return Error_("Failed to delete file: %s", filepath);
+            }
+
+            return Success_;
+        }
     }
 }
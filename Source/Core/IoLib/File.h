@@ -15,11 +15,14 @@ namespace Selas
     namespace File
     {
         Error ReadWholeFile(cpointer filepath, void** fileData, uint64* fileSize);
+        // -- Reads into caller owned memory. Fails if the file is larger than bufferSize.
+        Error ReadWholeFile(cpointer filepath, void* buffer, uint64 bufferSize, uint64* fileSize);
         Error ReadWhileFileAsString(cpointer filepath, char** string, uint64* stringSize);
         Error WriteWholeFile(cpointer filepath, const void* data, uint64 size);
 
         Error Size(cpointer filepath, uint64& size);
 
         bool Exists(cpointer filepath);
+        Error Delete(cpointer filepath);
     };
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    //=============================================================================================================================
+    // -- A file created at a fixed size and mapped writable into memory. Writes land in the page cache and are written back
+    // -- by the OS so the memory can be handed back once the mapping is closed.
+    struct MappedFile
+    {
+        void* fileHandle;
+        void* mappingHandle;
+        void* memory;
+        uint64 size;
+    };
+
+    void MappedFile_Reset(MappedFile* file);
+    Error MappedFile_Create(cpointer filepath, uint64 size, MappedFile* file);
+    void MappedFile_Close(MappedFile* file);
+    bool MappedFile_IsOpen(const MappedFile* file);
+}
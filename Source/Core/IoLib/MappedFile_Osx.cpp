@@ -0,0 +1,78 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#if IsOsx_
+
+#include "IoLib/MappedFile.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Selas
+{
+    // -- The descriptor is stored in the handle slot offset by one so that a zeroed handle reads as closed
+    #define DescriptorToHandle_(fd) ((void*)(intptr_t)((fd) + 1))
+    #define HandleToDescriptor_(handle) ((int)((intptr_t)(handle) - 1))
+
+    //=============================================================================================================================
+    void MappedFile_Reset(MappedFile* file)
+    {
+        file->fileHandle = nullptr;
+        file->mappingHandle = nullptr;
+        file->memory = nullptr;
+        file->size = 0;
+    }
+
+    //=============================================================================================================================
+    Error MappedFile_Create(cpointer filepath, uint64 size, MappedFile* file)
+    {
+        MappedFile_Reset(file);
+
+        int fd = open(filepath, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if(fd == -1) {
+            return Error_("Failed to create file: %s", filepath);
+        }
+
+        if(ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            return Error_("Failed to size file %s to %llu bytes", filepath, size);
+        }
+
+        void* memory = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(memory == MAP_FAILED) {
+            close(fd);
+            return Error_("Failed to map file: %s", filepath);
+        }
+
+        file->fileHandle = DescriptorToHandle_(fd);
+        file->memory = memory;
+        file->size = size;
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    void MappedFile_Close(MappedFile* file)
+    {
+        if(MappedFile_IsOpen(file) == false) {
+            return;
+        }
+
+        munmap(file->memory, (size_t)file->size);
+        close(HandleToDescriptor_(file->fileHandle));
+
+        MappedFile_Reset(file);
+    }
+
+    //=============================================================================================================================
+    bool MappedFile_IsOpen(const MappedFile* file)
+    {
+        return file->fileHandle != nullptr;
+    }
+}
+
+#endif
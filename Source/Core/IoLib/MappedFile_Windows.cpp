@@ -0,0 +1,77 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#if IsWindows_
+
+#include "IoLib/MappedFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+namespace Selas
+{
+    //=============================================================================================================================
+    void MappedFile_Reset(MappedFile* file)
+    {
+        file->fileHandle = INVALID_HANDLE_VALUE;
+        file->mappingHandle = nullptr;
+        file->memory = nullptr;
+        file->size = 0;
+    }
+
+    //=============================================================================================================================
+    Error MappedFile_Create(cpointer filepath, uint64 size, MappedFile* file)
+    {
+        MappedFile_Reset(file);
+
+        HANDLE fileHandle = CreateFileA(filepath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, 0, NULL);
+        if(fileHandle == INVALID_HANDLE_VALUE) {
+            return Error_("Failed to create file: %s", filepath);
+        }
+
+        DWORD sizeHigh = (DWORD)(size >> 32);
+        DWORD sizeLow = (DWORD)(size & 0xFFFFFFFF);
+        HANDLE mappingHandle = CreateFileMapping(fileHandle, NULL, PAGE_READWRITE, sizeHigh, sizeLow, NULL);
+        if(mappingHandle == nullptr) {
+            CloseHandle(fileHandle);
+            return Error_("Failed to create a file mapping for: %s", filepath);
+        }
+
+        void* memory = MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
+        if(memory == nullptr) {
+            CloseHandle(mappingHandle);
+            CloseHandle(fileHandle);
+            return Error_("Failed to map file: %s", filepath);
+        }
+
+        file->fileHandle = fileHandle;
+        file->mappingHandle = mappingHandle;
+        file->memory = memory;
+        file->size = size;
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    void MappedFile_Close(MappedFile* file)
+    {
+        if(MappedFile_IsOpen(file) == false) {
+            return;
+        }
+
+        UnmapViewOfFile(file->memory);
+        CloseHandle((HANDLE)file->mappingHandle);
+        CloseHandle((HANDLE)file->fileHandle);
+
+        MappedFile_Reset(file);
+    }
+
+    //=============================================================================================================================
+    bool MappedFile_IsOpen(const MappedFile* file)
+    {
+        return file->fileHandle != INVALID_HANDLE_VALUE;
+    }
+}
+
+#endif
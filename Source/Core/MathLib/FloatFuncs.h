@@ -140,19 +140,19 @@ namespace Selas
 
     ForceInline_ float2 operator/(float dividend, float2 rhs)
     {
-        float2 result = { rhs.x / dividend, rhs.y / dividend };
+        float2 result = { dividend / rhs.x, dividend / rhs.y };
         return result;
     }
 
     ForceInline_ float3 operator/(float dividend, float3 rhs)
     {
-        float3 result = { rhs.x / dividend, rhs.y / dividend, rhs.z / dividend };
+        float3 result = { dividend / rhs.x, dividend / rhs.y, dividend / rhs.z };
         return result;
     }
 
     ForceInline_ float4 operator/(float dividend, float4 rhs)
     {
-        float4 result = { rhs.x / dividend, rhs.y / dividend, rhs.z / dividend, rhs.w / dividend };
+        float4 result = { dividend / rhs.x, dividend / rhs.y, dividend / rhs.z, dividend / rhs.w };
         return result;
     }
 
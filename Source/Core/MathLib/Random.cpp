@@ -12,46 +12,36 @@
 
 #include <stdlib.h>
 
-#include <random>
-
 namespace Selas
 {
     namespace Random
     {
         //=========================================================================================================================
-        struct MersenneTwisterData
+        void Pcg32Initialize(Pcg32* pcg, uint64 seed, uint64 stream)
         {
-            std::mt19937 mtEngine;
-        };
-
-        //=========================================================================================================================
-        void MersenneTwisterInitialize(MersenneTwister* twister, uint32 seed)
-        {
-            twister->data = New_(MersenneTwisterData);
-            twister->data->mtEngine.seed(seed);
+            pcg->state = 0;
+            pcg->increment = (stream << 1) | 1;
+            Pcg32Uint32(pcg);
+            pcg->state += seed;
+            Pcg32Uint32(pcg);
         }
 
         //=========================================================================================================================
-        void MersenneTwisterReseed(MersenneTwister* twister, uint32 seed)
+        uint32 Pcg32Uint32(Pcg32* pcg)
         {
-            twister->data->mtEngine.seed(seed);
-        }
+            uint64 state = pcg->state;
+            pcg->state = state * 6364136223846793005ull + pcg->increment;
 
-        //=========================================================================================================================
-        void MersenneTwisterShutdown(MersenneTwister* twister)
-        {
-            SafeDelete_(twister->data);
+            uint32 xorshifted = (uint32)(((state >> 18) ^ state) >> 27);
+            uint32 rotation = (uint32)(state >> 59);
+            return (xorshifted >> rotation) | (xorshifted << ((0u - rotation) & 31));
         }
 
         //=========================================================================================================================
-        float MersenneTwisterFloat(MersenneTwister* twister)
-        {
-            return twister->data->mtEngine() / (float)(0xFFFFFFFF);
-        }
-
-        uint32 MersenneTwisterUint32(MersenneTwister* twister)
+        float Pcg32Float(Pcg32* pcg)
         {
-            return twister->data->mtEngine();
+            // -- Only the top 24 bits fit in a float's mantissa so this can never round up to 1
+            return (Pcg32Uint32(pcg) >> 8) * (1.0f / 16777216.0f);
         }
 
         //=========================================================================================================================
@@ -12,21 +12,16 @@ namespace Selas
 {
     namespace Random
     {
-        struct MersenneTwisterData;
-        struct MersenneTwister
+        // -- O'Neill's PCG32 (XSH RR variant). The full state is two integers so it lives inline in whatever owns it.
+        struct Pcg32
         {
-            MersenneTwister() : data(nullptr) { }
-            ~MersenneTwister() { Assert_(data == nullptr); }
-
-            // this uses a pimpl implementation since it is backed by mt19937 from std
-            MersenneTwisterData* data;
+            uint64 state;
+            uint64 increment;
         };
 
-        void MersenneTwisterInitialize(MersenneTwister* twister, uint32 seed);
-        void MersenneTwisterReseed(MersenneTwister* twister, uint32 seed);
-        void MersenneTwisterShutdown(MersenneTwister* twister);
-        float MersenneTwisterFloat(MersenneTwister* twister);
-        uint32 MersenneTwisterUint32(MersenneTwister* twister);
+        void   Pcg32Initialize(Pcg32* pcg, uint64 seed, uint64 stream);
+        uint32 Pcg32Uint32(Pcg32* pcg);
+        float  Pcg32Float(Pcg32* pcg); // [0.0f, 1.0f)
 
         uint  RandUint(uint max);
         float RandFloat0_1(void); // [0.0f, 1.0f]
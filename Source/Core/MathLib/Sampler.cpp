@@ -3,39 +3,84 @@
 //=================================================================================================================================
 
 #include "MathLib/Sampler.h"
+#include "MathLib/Sobol.h"
 #include "MathLib/Trigonometric.h"
 #include "SystemLib/MinMax.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/JsAssert.h"
+
+#define MaxBatchedDraws_ 64
 
 namespace Selas
 {
     //=============================================================================================================================
     void CSampler::Initialize(uint32 seed)
     {
-        Random::MersenneTwisterInitialize(&twister, seed);
+        Reseed(seed);
     }
 
     //=============================================================================================================================
     void CSampler::Shutdown()
     {
-        Random::MersenneTwisterShutdown(&twister);
+        Memory::Zero(this, sizeof(*this));
     }
 
     //=============================================================================================================================
     void CSampler::Reseed(uint32 seed)
     {
-        Random::MersenneTwisterReseed(&twister, seed);
+        Random::Pcg32Initialize(&pcg, seed, seed);
+
+        sobol = 0;
+        pixelSeed = 0;
+        sampleIndex = 0;
+        dimension = 0;
+    }
+
+    //=============================================================================================================================
+    static uint32 PixelSeed(uint32 pixelIndex)
+    {
+        return pixelIndex * 0x9e3779b9;
+    }
+
+    //=============================================================================================================================
+    void CSampler::SetSample(uint32 pixelIndex_, uint32 sampleIndex_, uint32 dimension_)
+    {
+        sobol = 1;
+        pixelSeed = PixelSeed(pixelIndex_);
+        sampleIndex = sampleIndex_;
+        dimension = dimension_;
+    }
+
+    //=============================================================================================================================
+    void CSampler::UniformFloats(const uint32* pixelIndices, const uint32* sampleIndices, const uint32* dimensions,
+                                 uint count, float* results)
+    {
+        Assert_(count <= MaxBatchedDraws_);
+
+        uint32 seeds[MaxBatchedDraws_];
+        for(uint scan = 0; scan < count; ++scan) {
+            seeds[scan] = PixelSeed(pixelIndices[scan]);
+        }
+
+        SobolOwenFloats(sampleIndices, dimensions, seeds, count, results);
     }
 
     //=============================================================================================================================
     float CSampler::UniformFloat()
     {
-        return Random::MersenneTwisterFloat(&twister);
+        if(sobol) {
+            return SobolOwenFloat(sampleIndex, dimension++, pixelSeed);
+        }
+        return Random::Pcg32Float(&pcg);
     }
 
     //=============================================================================================================================
     uint32 CSampler::UniformUInt32()
     {
-        return Random::MersenneTwisterUint32(&twister);
+        if(sobol) {
+            return SobolOwenUint32(sampleIndex, dimension++, pixelSeed);
+        }
+        return Random::Pcg32Uint32(&pcg);
     }
 
     //=========================================================================================================================
@@ -10,19 +10,34 @@
 
 namespace Selas
 {
-    // -- Currently just a wrapper around a Mersenne Twister but will be replaced with a better PRNG
-    // -- algorithm in the not too distance future.
+    // -- Draws from either a PCG32 stream or from Owen scrambled Sobol points. After SetSample every draw is a pure function of
+    // -- (pixel, sample, dimension) so the result of a path does not depend on which thread shades it or in what order.
     class CSampler
     {
     private:
-        Random::MersenneTwister twister;
+        Random::Pcg32 pcg;
+
+        uint32 sobol;
+        uint32 pixelSeed;
+        uint32 sampleIndex;
+        uint32 dimension;
 
     public:
 
+        // -- Starts a PCG32 stream. Seeds select independent streams.
         void Initialize(uint32 seed);
         void Shutdown();
         void Reseed(uint32 seed);
 
+        // -- Switches to Sobol points for one camera sample. Each following draw consumes the next dimension.
+        void SetSample(uint32 pixelIndex, uint32 sampleIndex, uint32 dimension);
+
+        // -- results[i] is the draw SetSample(pixelIndices[i], sampleIndices[i], dimensions[i]) followed by UniformFloat
+        // -- would make. Lets a batch of paths fill one dimension at a time.
+        static void UniformFloats(const uint32* pixelIndices, const uint32* sampleIndices, const uint32* dimensions,
+                                  uint count, float* results);
+
+        // -- [0, 1)
         float   UniformFloat();
         uint32  UniformUInt32();
 
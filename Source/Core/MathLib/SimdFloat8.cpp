@@ -0,0 +1,91 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/SimdFloat8.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/JsAssert.h"
+
+namespace Selas
+{
+    //=============================================================================================================================
+    float8 Log2(float8 a)
+    {
+        Align_(32) float lanes[Float8LaneCount_];
+        Store8(lanes, a);
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            lanes[scan] = Math::Log2(lanes[scan]);
+        }
+        return Load8(lanes);
+    }
+
+    //=============================================================================================================================
+    float8 Pow(float8 a, float8 b)
+    {
+        Align_(32) float as[Float8LaneCount_];
+        Align_(32) float bs[Float8LaneCount_];
+        Store8(as, a);
+        Store8(bs, b);
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            as[scan] = Math::Powf(as[scan], bs[scan]);
+        }
+        return Load8(as);
+    }
+
+    //=============================================================================================================================
+    float8 Cos(float8 a)
+    {
+        Align_(32) float lanes[Float8LaneCount_];
+        Store8(lanes, a);
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            lanes[scan] = Math::Cosf(lanes[scan]);
+        }
+        return Load8(lanes);
+    }
+
+    //=============================================================================================================================
+    float8 Sin(float8 a)
+    {
+        Align_(32) float lanes[Float8LaneCount_];
+        Store8(lanes, a);
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            lanes[scan] = Math::Sinf(lanes[scan]);
+        }
+        return Load8(lanes);
+    }
+
+    //=============================================================================================================================
+    float3_8 Load8(const float3* values, uint count)
+    {
+        Assert_(count > 0 && count <= Float8LaneCount_);
+
+        Align_(32) float xs[Float8LaneCount_];
+        Align_(32) float ys[Float8LaneCount_];
+        Align_(32) float zs[Float8LaneCount_];
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            const float3& value = values[scan < count ? scan : 0];
+            xs[scan] = value.x;
+            ys[scan] = value.y;
+            zs[scan] = value.z;
+        }
+
+        return float3_8(Load8(xs), Load8(ys), Load8(zs));
+    }
+
+    //=============================================================================================================================
+    void Store8(const float3_8& a, float3* values, uint count)
+    {
+        Assert_(count <= Float8LaneCount_);
+
+        Align_(32) float xs[Float8LaneCount_];
+        Align_(32) float ys[Float8LaneCount_];
+        Align_(32) float zs[Float8LaneCount_];
+        Store8(xs, a.x);
+        Store8(ys, a.y);
+        Store8(zs, a.z);
+        for(uint scan = 0; scan < count; ++scan) {
+            values[scan] = float3(xs[scan], ys[scan], zs[scan]);
+        }
+    }
+}
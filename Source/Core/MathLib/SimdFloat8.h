@@ -0,0 +1,252 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/BasicTypes.h"
+
+#if defined(__AVX2__)
+    #define EnableAvxFloat8_ 1
+    #include <immintrin.h>
+#else
+    #define EnableAvxFloat8_ 0
+    #include <emmintrin.h>
+#endif
+
+namespace Selas
+{
+    //=============================================================================================================================
+    // -- Eight floats operated on together. Maps to a single AVX register when building with AVX2 and to a pair of SSE
+    // -- registers otherwise. Comparisons return masks with every bit of a passing lane set.
+    //=============================================================================================================================
+    struct float8
+    {
+        #if EnableAvxFloat8_
+            __m256 v;
+        #else
+            __m128 lo;
+            __m128 hi;
+        #endif
+
+        ForceInline_ float8() { }
+        ForceInline_ float8(float s)
+        {
+            #if EnableAvxFloat8_
+                v = _mm256_set1_ps(s);
+            #else
+                lo = _mm_set1_ps(s);
+                hi = lo;
+            #endif
+        }
+    };
+
+    #define Float8LaneCount_ 8
+
+    #if EnableAvxFloat8_
+        #define Float8Binary_(Name_, Avx_, Sse_)                                                                                \
+            ForceInline_ float8 Name_(float8 a, float8 b) { float8 r; r.v = Avx_(a.v, b.v); return r; }
+        #define Float8Compare_(Name_, Avx_, Sse_)                                                                               \
+            ForceInline_ float8 Name_(float8 a, float8 b) { float8 r; r.v = _mm256_cmp_ps(a.v, b.v, Avx_); return r; }
+    #else
+        #define Float8Binary_(Name_, Avx_, Sse_)                                                                                \
+            ForceInline_ float8 Name_(float8 a, float8 b)                                                                     \
+            { float8 r; r.lo = Sse_(a.lo, b.lo); r.hi = Sse_(a.hi, b.hi); return r; }
+        #define Float8Compare_(Name_, Avx_, Sse_) Float8Binary_(Name_, Avx_, Sse_)
+    #endif
+
+    Float8Binary_(operator+, _mm256_add_ps, _mm_add_ps)
+    Float8Binary_(operator-, _mm256_sub_ps, _mm_sub_ps)
+    Float8Binary_(operator*, _mm256_mul_ps, _mm_mul_ps)
+    Float8Binary_(operator/, _mm256_div_ps, _mm_div_ps)
+    Float8Binary_(Min, _mm256_min_ps, _mm_min_ps)
+    Float8Binary_(Max, _mm256_max_ps, _mm_max_ps)
+
+    // -- Bitwise operations are meant for masks
+    Float8Binary_(operator&, _mm256_and_ps, _mm_and_ps)
+    Float8Binary_(operator|, _mm256_or_ps, _mm_or_ps)
+    Float8Binary_(AndNot, _mm256_andnot_ps, _mm_andnot_ps)
+
+    Float8Compare_(operator<,  _CMP_LT_OQ,  _mm_cmplt_ps)
+    Float8Compare_(operator<=, _CMP_LE_OQ,  _mm_cmple_ps)
+    Float8Compare_(operator>,  _CMP_GT_OQ,  _mm_cmpgt_ps)
+    Float8Compare_(operator>=, _CMP_GE_OQ,  _mm_cmpge_ps)
+    Float8Compare_(operator==, _CMP_EQ_OQ,  _mm_cmpeq_ps)
+    Float8Compare_(operator!=, _CMP_NEQ_UQ, _mm_cmpneq_ps)
+
+    #undef Float8Binary_
+    #undef Float8Compare_
+
+    //=============================================================================================================================
+    ForceInline_ float8 operator-(float8 a)
+    {
+        return float8(0.0f) - a;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Sqrt(float8 a)
+    {
+        float8 r;
+        #if EnableAvxFloat8_
+            r.v = _mm256_sqrt_ps(a.v);
+        #else
+            r.lo = _mm_sqrt_ps(a.lo);
+            r.hi = _mm_sqrt_ps(a.hi);
+        #endif
+        return r;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Abs(float8 a)
+    {
+        return AndNot(float8(-0.0f), a);
+    }
+
+    //=============================================================================================================================
+    // -- Lanes of a where mask is set and lanes of b elsewhere
+    ForceInline_ float8 Select(float8 mask, float8 a, float8 b)
+    {
+        return (mask & a) | AndNot(mask, b);
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Not(float8 mask)
+    {
+        return AndNot(mask, float8(0.0f) == float8(0.0f));
+    }
+
+    //=============================================================================================================================
+    // -- One bit per lane with lane zero in the lowest bit
+    ForceInline_ uint32 MoveMask(float8 mask)
+    {
+        #if EnableAvxFloat8_
+            return (uint32)_mm256_movemask_ps(mask.v);
+        #else
+            return (uint32)_mm_movemask_ps(mask.lo) | ((uint32)_mm_movemask_ps(mask.hi) << 4);
+        #endif
+    }
+
+    //=============================================================================================================================
+    ForceInline_ bool Any(float8 mask)
+    {
+        return MoveMask(mask) != 0;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Load8(const float* values)
+    {
+        float8 r;
+        #if EnableAvxFloat8_
+            r.v = _mm256_loadu_ps(values);
+        #else
+            r.lo = _mm_loadu_ps(values);
+            r.hi = _mm_loadu_ps(values + 4);
+        #endif
+        return r;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ void Store8(float* values, float8 a)
+    {
+        #if EnableAvxFloat8_
+            _mm256_storeu_ps(values, a.v);
+        #else
+            _mm_storeu_ps(values, a.lo);
+            _mm_storeu_ps(values + 4, a.hi);
+        #endif
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Saturate(float8 a)
+    {
+        return Min(Max(a, float8(0.0f)), float8(1.0f));
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Clamp(float8 a, float8 low, float8 high)
+    {
+        return Min(Max(a, low), high);
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Lerp(float8 a, float8 b, float8 t)
+    {
+        return (1.0f - t) * a + t * b;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Square(float8 a)
+    {
+        return a * a;
+    }
+
+    //=============================================================================================================================
+    // -- No SIMD versions of these exist in the math library so they run lane by lane through their scalar counterparts
+    float8 Log2(float8 a);
+    float8 Pow(float8 a, float8 b);
+    float8 Cos(float8 a);
+    float8 Sin(float8 a);
+
+    //=============================================================================================================================
+    // -- Eight float3s stored as one float8 per component
+    //=============================================================================================================================
+    struct float3_8
+    {
+        float8 x;
+        float8 y;
+        float8 z;
+
+        ForceInline_ float3_8() { }
+        ForceInline_ float3_8(float8 x_, float8 y_, float8 z_) : x(x_), y(y_), z(z_) { }
+    };
+
+    ForceInline_ float3_8 operator+(const float3_8& a, const float3_8& b) { return float3_8(a.x + b.x, a.y + b.y, a.z + b.z); }
+    ForceInline_ float3_8 operator-(const float3_8& a, const float3_8& b) { return float3_8(a.x - b.x, a.y - b.y, a.z - b.z); }
+    ForceInline_ float3_8 operator*(const float3_8& a, const float3_8& b) { return float3_8(a.x * b.x, a.y * b.y, a.z * b.z); }
+    ForceInline_ float3_8 operator*(float8 s, const float3_8& a)          { return float3_8(s * a.x, s * a.y, s * a.z); }
+    ForceInline_ float3_8 operator*(const float3_8& a, float8 s)          { return float3_8(s * a.x, s * a.y, s * a.z); }
+    ForceInline_ float3_8 operator-(const float3_8& a)                    { return float3_8(-a.x, -a.y, -a.z); }
+
+    //=============================================================================================================================
+    ForceInline_ float8 Dot(const float3_8& a, const float3_8& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float3_8 Normalize(const float3_8& a)
+    {
+        return a * (1.0f / Sqrt(Dot(a, a)));
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float3_8 Cross(const float3_8& a, const float3_8& b)
+    {
+        return float3_8(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    //=============================================================================================================================
+    // -- both should face outward
+    ForceInline_ float3_8 Reflect(const float3_8& n, const float3_8& l)
+    {
+        return 2.0f * Dot(n, l) * n - l;
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float3_8 Select(float8 mask, const float3_8& a, const float3_8& b)
+    {
+        return float3_8(Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z));
+    }
+
+    //=============================================================================================================================
+    ForceInline_ float3_8 Sqrt(const float3_8& a)
+    {
+        return float3_8(Sqrt(a.x), Sqrt(a.y), Sqrt(a.z));
+    }
+
+    //=============================================================================================================================
+    // -- Moves between AoS and SoA. Loads repeat the first value into lanes past count.
+    float3_8 Load8(const float3* values, uint count);
+    void Store8(const float3_8& a, float3* values, uint count);
+}
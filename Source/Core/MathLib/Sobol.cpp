@@ -0,0 +1,186 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "MathLib/Sobol.h"
+
+#if defined(__AVX2__)
+    #define EnableAvx2Sobol_ 1
+    #include <immintrin.h>
+#else
+    #define EnableAvx2Sobol_ 0
+#endif
+
+#define SobolBatchWidth_ 8
+
+namespace Selas
+{
+    // -- Generator matrix columns for the second Sobol dimension. The first is the van der Corput sequence which is just the
+    // -- bit reversed index.
+    static const uint32 SobolDirections[32] = {
+        0x80000000, 0xc0000000, 0xa0000000, 0xf0000000, 0x88000000, 0xcc000000, 0xaa000000, 0xff000000,
+        0x80800000, 0xc0c00000, 0xa0a00000, 0xf0f00000, 0x88880000, 0xcccc0000, 0xaaaa0000, 0xffff0000,
+        0x80008000, 0xc000c000, 0xa000a000, 0xf000f000, 0x88008800, 0xcc00cc00, 0xaa00aa00, 0xff00ff00,
+        0x80808080, 0xc0c0c0c0, 0xa0a0a0a0, 0xf0f0f0f0, 0x88888888, 0xcccccccc, 0xaaaaaaaa, 0xffffffff
+    };
+
+    //=============================================================================================================================
+    static uint32 ReverseBits(uint32 x)
+    {
+        x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+        x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+        x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+        x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    //=============================================================================================================================
+    static uint32 Mix(uint32 x)
+    {
+        x ^= x >> 16; x *= 0x7feb352d;
+        x ^= x >> 15; x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+
+    //=============================================================================================================================
+    static uint32 LaineKarrasPermutation(uint32 x, uint32 seed)
+    {
+        x += seed;
+        x ^= x * 0x6c50b47c;
+        x ^= x * 0xb82f1e52;
+        x ^= x * 0xc7afe638;
+        x ^= x * 0x8d22f6e6;
+        return x;
+    }
+
+    //=============================================================================================================================
+    static uint32 NestedUniformScramble(uint32 x, uint32 seed)
+    {
+        return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+    }
+
+    //=============================================================================================================================
+    static uint32 SobolSecondDimension(uint32 index)
+    {
+        uint32 result = 0;
+        for(uint32 bit = 0; index != 0; index >>= 1, ++bit) {
+            if(index & 1) {
+                result ^= SobolDirections[bit];
+            }
+        }
+        return result;
+    }
+
+    //=============================================================================================================================
+    uint32 SobolOwenUint32(uint32 index, uint32 dimension, uint32 seed)
+    {
+        // -- Both dimensions of a pair share a shuffled index so they stay a stratified 2D point set
+        uint32 pairSeed = Mix(seed ^ Mix(dimension >> 1));
+        uint32 shuffled = NestedUniformScramble(index, pairSeed);
+
+        uint32 sobol = (dimension & 1) ? SobolSecondDimension(shuffled) : ReverseBits(shuffled);
+        return NestedUniformScramble(sobol, Mix(pairSeed + dimension));
+    }
+
+    //=============================================================================================================================
+    float SobolOwenFloat(uint32 index, uint32 dimension, uint32 seed)
+    {
+        // -- Only the top 24 bits fit in a float's mantissa so this can never round up to 1
+        return (SobolOwenUint32(index, dimension, seed) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    #if EnableAvx2Sobol_
+
+    //=============================================================================================================================
+    static __m256i ReverseBits(__m256i x)
+    {
+        #define SwapBits_(x, shift, mask)                                                                                     \
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(x, shift), _mm256_set1_epi32(mask)),                          \
+                            _mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(mask)), shift))
+
+        x = SwapBits_(x, 1, 0x55555555);
+        x = SwapBits_(x, 2, 0x33333333);
+        x = SwapBits_(x, 4, 0x0f0f0f0f);
+        x = SwapBits_(x, 8, 0x00ff00ff);
+        #undef SwapBits_
+
+        return _mm256_or_si256(_mm256_srli_epi32(x, 16), _mm256_slli_epi32(x, 16));
+    }
+
+    //=============================================================================================================================
+    static __m256i Mix(__m256i x)
+    {
+        x = _mm256_mullo_epi32(_mm256_xor_si256(x, _mm256_srli_epi32(x, 16)), _mm256_set1_epi32(0x7feb352d));
+        x = _mm256_mullo_epi32(_mm256_xor_si256(x, _mm256_srli_epi32(x, 15)), _mm256_set1_epi32((int32)0x846ca68b));
+        return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    }
+
+    //=============================================================================================================================
+    static __m256i NestedUniformScramble(__m256i x, __m256i seed)
+    {
+        x = _mm256_add_epi32(ReverseBits(x), seed);
+        x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32(0x6c50b47c)));
+        x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((int32)0xb82f1e52)));
+        x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((int32)0xc7afe638)));
+        x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((int32)0x8d22f6e6)));
+        return ReverseBits(x);
+    }
+
+    //=============================================================================================================================
+    static __m256i SobolSecondDimension(__m256i index)
+    {
+        __m256i one = _mm256_set1_epi32(1);
+        __m256i result = _mm256_setzero_si256();
+        for(uint32 bit = 0; bit < 32; ++bit) {
+            __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_srli_epi32(index, bit), one), one);
+            result = _mm256_xor_si256(result, _mm256_and_si256(set, _mm256_set1_epi32((int32)SobolDirections[bit])));
+        }
+        return result;
+    }
+
+    //=============================================================================================================================
+    void SobolOwenFloats(const uint32* indices, const uint32* dimensions, const uint32* seeds, uint count, float* results)
+    {
+        __m256i one = _mm256_set1_epi32(1);
+        __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+
+        uint scan = 0;
+        for(; scan + SobolBatchWidth_ <= count; scan += SobolBatchWidth_) {
+            __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + scan));
+            __m256i dimension = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dimensions + scan));
+            __m256i seed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seeds + scan));
+
+            __m256i pairSeed = Mix(_mm256_xor_si256(seed, Mix(_mm256_srli_epi32(dimension, 1))));
+            __m256i shuffled = NestedUniformScramble(index, pairSeed);
+
+            // -- The second dimension's generator is the expensive one so only run it when some lane needs it
+            __m256i odd = _mm256_cmpeq_epi32(_mm256_and_si256(dimension, one), one);
+            __m256i sobol = ReverseBits(shuffled);
+            if(_mm256_movemask_epi8(odd) != 0) {
+                sobol = _mm256_blendv_epi8(sobol, SobolSecondDimension(shuffled), odd);
+            }
+            __m256i bits = NestedUniformScramble(sobol, Mix(_mm256_add_epi32(pairSeed, dimension)));
+
+            // -- Top 24 bits are small enough for a signed conversion
+            __m256 value = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)), scale);
+            _mm256_storeu_ps(results + scan, value);
+        }
+
+        for(; scan < count; ++scan) {
+            results[scan] = SobolOwenFloat(indices[scan], dimensions[scan], seeds[scan]);
+        }
+    }
+
+    #else
+
+    //=============================================================================================================================
+    void SobolOwenFloats(const uint32* indices, const uint32* dimensions, const uint32* seeds, uint count, float* results)
+    {
+        for(uint scan = 0; scan < count; ++scan) {
+            results[scan] = SobolOwenFloat(indices[scan], dimensions[scan], seeds[scan]);
+        }
+    }
+
+    #endif
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    // -- Owen scrambled Sobol points using the hash based scrambling from Burley's "Practical Hash-based Owen Scrambling".
+    // -- Each pair of dimensions (2k, 2k + 1) is an independently shuffled and scrambled copy of the first two Sobol
+    // -- dimensions so every pair is well stratified in 2D no matter how many dimensions a path consumes.
+    uint32 SobolOwenUint32(uint32 index, uint32 dimension, uint32 seed);
+
+    // -- [0, 1)
+    float SobolOwenFloat(uint32 index, uint32 dimension, uint32 seed);
+
+    // -- SobolOwenFloat for count independent (index, dimension, seed) triples such as the lanes of a shading batch
+    void SobolOwenFloats(const uint32* indices, const uint32* dimensions, const uint32* seeds, uint count, float* results);
+}
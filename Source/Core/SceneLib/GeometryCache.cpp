@@ -7,6 +7,8 @@
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/Logging.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
 
 namespace Selas
 {
@@ -19,6 +21,8 @@ namespace Selas
     //=============================================================================================================================
     void GeometryCache::UnloadLruSubscene()
     {
+        ProfileEventMarker_(0, "UnloadLruSubscene");
+
         int64 lruTimestamp = GetAccessDt();
         int64 lruIndex = -1;
 
@@ -44,6 +48,9 @@ namespace Selas
             UnloadSubsceneGeometry(subscenes[lruIndex]);
 
             loadedGeometrySize -= subscenes[lruIndex]->geometrySizeEstimate;
+
+            RenderStats_Add(eRenderCounterGeometryCacheEvictedBytes, subscenes[lruIndex]->geometrySizeEstimate);
+            RenderStats_SetGauge(eRenderGaugeGeometryCacheBytes, loadedGeometrySize);
         }
     }
 
@@ -101,6 +108,7 @@ namespace Selas
     {
         Atomic::Increment64(&subscene->refCount);
 
+        bool loadedHere = false;
         if(subscene->geometryLoaded == 0 && subscene->geometryLoading == 0) {
             uint64 subsceneSizeEstimate = subscene->geometrySizeEstimate;
 
@@ -118,15 +126,24 @@ namespace Selas
                 LeaveSpinLock(spinlock);
 
                 WriteDebugInfo_("Loading subscene: %s", subscene->data->name.Ascii());
-                LoadSubsceneGeometry(subscene);
+                {
+                    ProfileEventMarker_(0, "LoadSubsceneGeometry");
+                    LoadSubsceneGeometry(subscene);
+                }
 
                 subscene->geometryLoading = 0;
+                loadedHere = true;
+
+                RenderStats_Add(eRenderCounterGeometryCacheLoadedBytes, subsceneSizeEstimate);
+                RenderStats_SetGauge(eRenderGaugeGeometryCacheBytes, loadedGeometrySize);
             }
             else {
                 LeaveSpinLock(spinlock);
             }
         }
 
+        RenderStats_Add(loadedHere ? eRenderCounterGeometryCacheMisses : eRenderCounterGeometryCacheHits, 1);
+
         while(subscene->geometryLoading == 1) { }
         Assert_(subscene->geometryLoaded == 1);
     }
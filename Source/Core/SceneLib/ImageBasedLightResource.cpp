@@ -13,11 +13,19 @@
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/MinMax.h"
 #include "SystemLib/JsAssert.h"
+#include "SystemLib/MemoryAllocation.h"
+
+#if defined(__AVX2__)
+    #define EnableAvx2Gathers_ 1
+    #include <immintrin.h>
+#else
+    #define EnableAvx2Gathers_ 0
+#endif
 
 namespace Selas
 {
     cpointer ImageBasedLightResource::kDataType = "IBL";
-    const uint64 ImageBasedLightResource::kDataVersion = 1538087123ul;
+    const uint64 ImageBasedLightResource::kDataVersion = 1539561600ul;
 
     //=============================================================================================================================
     void Serialize(CSerializer* serializer, ImageBasedLightResourceData& data)
@@ -27,10 +35,12 @@ namespace Selas
 
         uint width = data.densityfunctions.width;
         uint height = data.densityfunctions.height;
-        uint mdfSize = sizeof(float) * CalculateMarginalDensityFunctionCount(width, height);
-        uint cdfsSize= sizeof(float) * CalculateConditionalDensityFunctionsCount(width, height);
-        serializer->SerializePtr((void*&)data.densityfunctions.marginalDensityFunction, mdfSize, 0);
-        serializer->SerializePtr((void*&)data.densityfunctions.conditionalDensityFunctions, cdfsSize, 0);
+        serializer->SerializePtr((void*&)data.densityfunctions.aliasTable, sizeof(IblAliasEntry) * width * height, 0);
+        serializer->SerializePtr((void*&)data.densityfunctions.pdfs, sizeof(float) * width * height, 0);
+        serializer->SerializePtr((void*&)data.densityfunctions.sinThetas, sizeof(float) * height, 0);
+        serializer->SerializePtr((void*&)data.densityfunctions.cosThetas, sizeof(float) * height, 0);
+        serializer->SerializePtr((void*&)data.densityfunctions.sinPhis, sizeof(float) * width, 0);
+        serializer->SerializePtr((void*&)data.densityfunctions.cosPhis, sizeof(float) * width, 0);
         
         Serialize(serializer, data.missWidth);
         Serialize(serializer, data.missHeight);
@@ -78,120 +88,165 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    static void SampleDistributionFunction(float* __restrict distribution, uint count, float random01, uint& index, float& pdf)
+    static void DirectionToTexel(const ImageBasedLightResourceData* ibl, float3 wi, int32 width, int32 height, int32& x, int32& y)
     {
-        // -- binary search the cdf to find the largest sample that is lower than the given random number between 0 and 1
-        index = (uint)-1;
-
-        sint low = 0;
-        sint high = count - 1;
-
-        while(low <= high) {
-            sint mid = (low + high) / 2;
-
-            if(distribution[mid] >= random01) {
-                index = mid;
-                pdf = (mid > 0) ? distribution[mid] - distribution[mid - 1] : distribution[mid];
-                high = mid - 1;
-            }
-            else {
-                low = mid + 1;
-            }
+        float theta;
+        float phi;
+        Math::NormalizedCartesianToSpherical(wi, theta, phi);
+
+        // -- remap from [-pi, pi] to [0, 2pi] and apply our rotation
+        phi = Math::Fmodf(phi + Math::Pi_ + ibl->rotationRadians, Math::TwoPi_);
+        if(phi < 0.0f) {
+            phi += Math::TwoPi_;
         }
 
-        Assert_(index != (uint)-1);
+        x = Clamp<int32>((int32)(phi * (float)width / Math::TwoPi_), 0, width - 1);
+        y = Clamp<int32>((int32)(theta * (float)height / Math::Pi_), 0, height - 1);
     }
 
     //=============================================================================================================================
-    uint CalculateMarginalDensityFunctionCount(uint width, uint height)
+    static float3 TexelDirection(const IblDensityFunctions* functions, float cosRotation, float sinRotation, uint x, uint y)
     {
-        return height;
+        // -- The inverse of DirectionToTexel: phi = phi0 - rotation - pi so the rotation comes in through the angle difference
+        // -- identities and the extra pi flips the sign of x and z.
+        float cosPhi = functions->cosPhis[x] * cosRotation + functions->sinPhis[x] * sinRotation;
+        float sinPhi = functions->sinPhis[x] * cosRotation - functions->cosPhis[x] * sinRotation;
+        float sinTheta = functions->sinThetas[y];
+
+        return float3(-sinTheta * cosPhi, functions->cosThetas[y], -sinTheta * sinPhi);
     }
 
     //=============================================================================================================================
-    uint CalculateConditionalDensityFunctionsCount(uint width, uint height)
+    void Ibl(const ImageBasedLightResourceData* ibl, float r0, float r1, float3& direction, uint& x, uint& y, float& pdf)
     {
-        return width * height;
+        const IblDensityFunctions* functions = &ibl->densityfunctions;
+
+        uint width = functions->width;
+        uint texelCount = width * functions->height;
+
+        uint index = Min<uint>((uint)(r0 * (float)texelCount), texelCount - 1);
+        const IblAliasEntry& entry = functions->aliasTable[index];
+        uint texel = (r1 < entry.threshold) ? index : entry.alias;
+
+        y = texel / width;
+        x = texel - y * width;
+
+        direction = TexelDirection(functions, Math::Cosf(ibl->rotationRadians), Math::Sinf(ibl->rotationRadians), x, y);
+        pdf = functions->pdfs[texel];
     }
 
+    #if EnableAvx2Gathers_
+
     //=============================================================================================================================
-    void Ibl(const ImageBasedLightResourceData* ibl, float r0, float r1, float& theta, float& phi, uint& x, uint& y, float& pdf)
+    void IblBatch(const ImageBasedLightResourceData* ibl, const float* r0s, const float* r1s, uint count,
+                  IblBatchSample* samples)
     {
-        // - http://www.igorsklyar.com/system/documents/papers/4/fiscourse.comp.pdf Section 4.2
-        // - See also: Physically based rendering volume 2 section 13.6.5
-
-        const IblDensityFunctions* distributions = &ibl->densityfunctions;
-
-        uint width = distributions->width;
-        uint height = distributions->height;
-        float widthf = (float)width;
-        float heightf = (float)height;
+        Assert_(count <= IblBatchWidth_);
+
+        const IblDensityFunctions* functions = &ibl->densityfunctions;
+        int32 width = (int32)functions->width;
+        int32 texelCount = (int32)(functions->width * functions->height);
+
+        Align_(32) float u0s[IblBatchWidth_];
+        Align_(32) float u1s[IblBatchWidth_];
+        for(uint scan = 0; scan < IblBatchWidth_; ++scan) {
+            // -- Unused lanes repeat the first sample so their gathers stay within the tables
+            uint lane = scan < count ? scan : 0;
+            u0s[scan] = r0s[lane];
+            u1s[scan] = r1s[lane];
+        }
 
-        float mdf;
-        float cdf;
-        SampleDistributionFunction(distributions->marginalDensityFunction, height, r0, y, mdf);
-        SampleDistributionFunction(distributions->conditionalDensityFunctions + y * width, width, r1, x, cdf);
+        __m256 u0 = _mm256_load_ps(u0s);
+        __m256 u1 = _mm256_load_ps(u1s);
+
+        // -- Pick a texel and flip between it and its alias
+        __m256i index = _mm256_cvttps_epi32(_mm256_mul_ps(u0, _mm256_set1_ps((float)texelCount)));
+        index = _mm256_min_epi32(index, _mm256_set1_epi32(texelCount - 1));
+
+        const float* table = reinterpret_cast<const float*>(functions->aliasTable);
+        __m256i entry = _mm256_slli_epi32(index, 1);
+        __m256 threshold = _mm256_i32gather_ps(table, entry, sizeof(float));
+        __m256i alias = _mm256_i32gather_epi32(reinterpret_cast<const int32*>(table),
+                                               _mm256_add_epi32(entry, _mm256_set1_epi32(1)), sizeof(int32));
+        __m256 keep = _mm256_cmp_ps(u1, threshold, _CMP_LT_OQ);
+        __m256i texel = _mm256_blendv_epi8(alias, index, _mm256_castps_si256(keep));
+
+        // -- Split into row and column with a float divide then correct the off by one that rounding can leave behind
+        __m256i widthi = _mm256_set1_epi32(width);
+        __m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(texel), _mm256_set1_ps(1.0f / (float)width)));
+        __m256i x = _mm256_sub_epi32(texel, _mm256_mullo_epi32(y, widthi));
+        __m256i under = _mm256_cmpgt_epi32(_mm256_setzero_si256(), x);
+        y = _mm256_add_epi32(y, under);
+        x = _mm256_add_epi32(x, _mm256_and_si256(under, widthi));
+        __m256i over = _mm256_cmpgt_epi32(x, _mm256_sub_epi32(widthi, _mm256_set1_epi32(1)));
+        y = _mm256_sub_epi32(y, over);
+        x = _mm256_sub_epi32(x, _mm256_and_si256(over, widthi));
+
+        __m256 sinTheta = _mm256_i32gather_ps(functions->sinThetas, y, sizeof(float));
+        __m256 cosTheta = _mm256_i32gather_ps(functions->cosThetas, y, sizeof(float));
+        __m256 sinPhi0 = _mm256_i32gather_ps(functions->sinPhis, x, sizeof(float));
+        __m256 cosPhi0 = _mm256_i32gather_ps(functions->cosPhis, x, sizeof(float));
+
+        __m256 cosRotation = _mm256_set1_ps(Math::Cosf(ibl->rotationRadians));
+        __m256 sinRotation = _mm256_set1_ps(Math::Sinf(ibl->rotationRadians));
+        __m256 cosPhi = _mm256_add_ps(_mm256_mul_ps(cosPhi0, cosRotation), _mm256_mul_ps(sinPhi0, sinRotation));
+        __m256 sinPhi = _mm256_sub_ps(_mm256_mul_ps(sinPhi0, cosRotation), _mm256_mul_ps(cosPhi0, sinRotation));
+
+        __m256 negSinTheta = _mm256_sub_ps(_mm256_setzero_ps(), sinTheta);
+
+        Align_(32) float results[7][IblBatchWidth_];
+        _mm256_store_ps(results[0], _mm256_mul_ps(negSinTheta, cosPhi));
+        _mm256_store_ps(results[1], cosTheta);
+        _mm256_store_ps(results[2], _mm256_mul_ps(negSinTheta, sinPhi));
+        _mm256_store_ps(results[3], _mm256_i32gather_ps(functions->pdfs, texel, sizeof(float)));
+
+        const float* radiance = reinterpret_cast<const float*>(ibl->lightData);
+        __m256 exposure = _mm256_set1_ps(ibl->exposureScale);
+        __m256i radianceIndex = _mm256_mullo_epi32(texel, _mm256_set1_epi32(3));
+        for(int32 c = 0; c < 3; ++c) {
+            __m256 value = _mm256_i32gather_ps(radiance, _mm256_add_epi32(radianceIndex, _mm256_set1_epi32(c)),
+                                               sizeof(float));
+            _mm256_store_ps(results[4 + c], _mm256_mul_ps(exposure, value));
+        }
 
-        // -- theta represents the vertical position on the sphere and varies between 0 and pi
-        theta = (y + 0.5f) * Math::Pi_ / heightf;
+        for(uint scan = 0; scan < count; ++scan) {
+            samples[scan].direction = float3(results[0][scan], results[1][scan], results[2][scan]);
+            samples[scan].pdf = results[3][scan];
+            samples[scan].radiance = float3(results[4][scan], results[5][scan], results[6][scan]);
+        }
+    }
 
-        // -- phi represents the horizontal position on the sphere and varies between -pi and pi
-        // -- we also apply a rotation from the ibl first
-        phi = Math::Fmodf(((x + 0.5f) * Math::TwoPi_ / widthf) + ibl->rotationRadians, Math::TwoPi_) - Math::Pi_;
+    #else
 
-        // convert from texture space to spherical with the inverse of the Jacobian
-        float invJacobian = (widthf * heightf) / Math::TwoPi_;
+    //=============================================================================================================================
+    void IblBatch(const ImageBasedLightResourceData* ibl, const float* r0s, const float* r1s, uint count,
+                  IblBatchSample* samples)
+    {
+        Assert_(count <= IblBatchWidth_);
 
-        // -- pdf is probably of x and y sample / sin(theta) to account for the warping along the y axis
-        float sinTheta = Math::Sinf(theta);
-        if(sinTheta > 0)
-            pdf = mdf * cdf * invJacobian / sinTheta;
-        else
-            pdf = 0.0f;
+        for(uint scan = 0; scan < count; ++scan) {
+            uint x;
+            uint y;
+            Ibl(ibl, r0s[scan], r1s[scan], samples[scan].direction, x, y, samples[scan].pdf);
+            samples[scan].radiance = SampleIbl(ibl, x, y);
+        }
     }
 
+    #endif
+
     //=============================================================================================================================
     float3 SampleIbl(const ImageBasedLightResourceData* ibl, float3 wi, float& pdf)
     {
         int32 width = (int32)ibl->densityfunctions.width;
         int32 height = (int32)ibl->densityfunctions.height;
-        float widthf = (float)width;
-        float heightf = (float)height;
-
-        float theta;
-        float phi;
-        Math::NormalizedCartesianToSpherical(wi, theta, phi);
-
-        // -- remap from [-pi, pi] to [0, 2pi] and apply our rotation
-        phi = Math::Fmodf(phi + Math::Pi_ + ibl->rotationRadians, Math::TwoPi_);
-
-        int32 x = Clamp<int32>((int32)(phi * widthf / Math::TwoPi_ - 0.5f), 0, width);
-        int32 y = Clamp<int32>((int32)(theta * heightf / Math::Pi_ - 0.5f), 0, height);
-
-        float mdf;
-        float cdf;
-        if(y > 0)
-            mdf = ibl->densityfunctions.marginalDensityFunction[y] - ibl->densityfunctions.marginalDensityFunction[y - 1];
-        else
-            mdf = ibl->densityfunctions.marginalDensityFunction[y];
-
-        if(x > 0)
-            cdf = (ibl->densityfunctions.conditionalDensityFunctions + y * width)[x]
-                - (ibl->densityfunctions.conditionalDensityFunctions + y * width)[x - 1];
-        else
-            cdf = (ibl->densityfunctions.conditionalDensityFunctions + y * width)[x];
 
-        // convert from texture space to spherical with the inverse of the Jacobian
-        float invJacobian = (widthf * heightf) / Math::TwoPi_;
+        int32 x;
+        int32 y;
+        DirectionToTexel(ibl, wi, width, height, x, y);
 
-        // -- pdf is probably of x and y sample / sin(theta) to account for the warping along the y axis
-        float sinTheta = Math::Sinf(theta);
-        if(sinTheta > 0)
-            pdf = mdf * cdf * invJacobian / sinTheta;
-        else
-            pdf = 0.0f;
-
-        return ibl->exposureScale * ibl->lightData[y * ibl->densityfunctions.width + x];
+        uint texel = y * width + x;
+        pdf = ibl->densityfunctions.pdfs[texel];
+        return ibl->exposureScale * ibl->lightData[texel];
     }
 
     //=============================================================================================================================
@@ -199,20 +254,9 @@ namespace Selas
     {
         pdf = SampleIBlPdf(ibl, wi);
 
-        int32 width = (int32)ibl->missWidth;
-        int32 height = (int32)ibl->missHeight;
-        float widthf = (float)width;
-        float heightf = (float)height;
-
-        float theta;
-        float phi;
-        Math::NormalizedCartesianToSpherical(wi, theta, phi);
-
-        // -- remap from [-pi, pi] to [0, 2pi] and apply our rotation
-        phi = Math::Fmodf(phi + Math::Pi_ + ibl->rotationRadians, Math::TwoPi_);
-
-        int32 x = Clamp<int32>((int32)(phi * widthf / Math::TwoPi_ - 0.5f), 0, width);
-        int32 y = Clamp<int32>((int32)(theta * heightf / Math::Pi_ - 0.5f), 0, height);
+        int32 x;
+        int32 y;
+        DirectionToTexel(ibl, wi, (int32)ibl->missWidth, (int32)ibl->missHeight, x, y);
 
         return ibl->missData[y * ibl->missWidth + x];
     }
@@ -222,42 +266,12 @@ namespace Selas
     {
         int32 width = (int32)ibl->densityfunctions.width;
         int32 height = (int32)ibl->densityfunctions.height;
-        float widthf = (float)width;
-        float heightf = (float)height;
 
-        float theta;
-        float phi;
-        Math::NormalizedCartesianToSpherical(wi, theta, phi);
+        int32 x;
+        int32 y;
+        DirectionToTexel(ibl, wi, width, height, x, y);
 
-        // -- remap from [-pi, pi] to [0, 2pi] and apply our rotation
-        phi = Math::Fmodf(phi + Math::Pi_ + ibl->rotationRadians, Math::TwoPi_);
-
-        int32 x = Clamp<int32>((int32)(phi * widthf / Math::TwoPi_ - 0.5f), 0, width);
-        int32 y = Clamp<int32>((int32)(theta * heightf / Math::Pi_ - 0.5f), 0, height);
-
-        float mdf;
-        float cdf;
-        if(y > 0)
-            mdf = ibl->densityfunctions.marginalDensityFunction[y] - ibl->densityfunctions.marginalDensityFunction[y - 1];
-        else
-            mdf = ibl->densityfunctions.marginalDensityFunction[y];
-
-        if(x > 0) {
-            cdf = (ibl->densityfunctions.conditionalDensityFunctions + y * width)[x]
-                - (ibl->densityfunctions.conditionalDensityFunctions + y * width)[x - 1];
-        }
-        else
-            cdf = (ibl->densityfunctions.conditionalDensityFunctions + y * width)[x];
-
-        // convert from texture space to spherical with the inverse of the Jacobian
-        float invJacobian = (widthf * heightf) / Math::TwoPi_;
-
-        // -- pdf is probably of x and y sample / sin(theta) to account for the warping along the y axis
-        float sinTheta = Math::Sinf(theta);
-        if(sinTheta > 0)
-            return mdf * cdf * invJacobian / sinTheta;
-        else
-            return 0.0f;
+        return ibl->densityfunctions.pdfs[y * width + x];
     }
 
     //=============================================================================================================================
@@ -269,7 +283,11 @@ namespace Selas
     //=============================================================================================================================
     void ShutdownDensityFunctions(IblDensityFunctions* distributions)
     {
-        SafeFree_(distributions->conditionalDensityFunctions);
-        SafeFree_(distributions->marginalDensityFunction);
+        SafeFree_(distributions->aliasTable);
+        SafeFree_(distributions->pdfs);
+        SafeFree_(distributions->sinThetas);
+        SafeFree_(distributions->cosThetas);
+        SafeFree_(distributions->sinPhis);
+        SafeFree_(distributions->cosPhis);
     }
 }
\ No newline at end of file
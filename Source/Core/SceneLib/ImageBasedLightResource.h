@@ -13,12 +13,38 @@ namespace Selas
 {
     class CSerializer;
 
+    #define IblBatchWidth_ 8
+
+    struct IblAliasEntry
+    {
+        // -- A texel keeps the sample when the second random number is below threshold and otherwise defers to its alias
+        float  threshold;
+        uint32 alias;
+    };
+
     struct IblDensityFunctions
     {
         uint64 width;
         uint64 height;
-        float* marginalDensityFunction;
-        float* conditionalDensityFunctions;
+
+        // -- Vose alias table over every texel so a sample costs one lookup rather than two binary searches
+        IblAliasEntry* aliasTable;
+
+        // -- Solid angle pdf of each texel's direction
+        float* pdfs;
+
+        // -- Directions of the texel centers are built from these. Phi does not include the ibl's rotation.
+        float* sinThetas;
+        float* cosThetas;
+        float* sinPhis;
+        float* cosPhis;
+    };
+
+    struct IblBatchSample
+    {
+        float3 direction;
+        float3 radiance;
+        float  pdf;
     };
 
     struct ImageBasedLightResourceData
@@ -51,13 +77,12 @@ namespace Selas
     void ShutdownImageBasedLightResource(ImageBasedLightResource* resource);
 
     //=============================================================================================================================
-    // -- functions used in build to set up the conditional and marginal density functions
-    uint CalculateMarginalDensityFunctionCount(uint width, uint height);
-    uint CalculateConditionalDensityFunctionsCount(uint width, uint height);
+    // -- Importance sampling functions. r0 picks the texel and r1 decides between it and its alias.
+    void Ibl(const ImageBasedLightResourceData* ibl, float r0, float r1, float3& direction, uint& x, uint& y, float& pdf);
 
-    //=============================================================================================================================
-    // -- Importance sampling functions
-    void Ibl(const ImageBasedLightResourceData* ibl, float r0, float r1, float& theta, float& phi, uint& x, uint& y, float& pdf);
+    // -- Samples up to IblBatchWidth_ directions at once. Each lane matches what Ibl and SampleIbl(x, y) return for it.
+    void IblBatch(const ImageBasedLightResourceData* ibl, const float* r0s, const float* r1s, uint count,
+                  IblBatchSample* samples);
 
     //=============================================================================================================================
     // -- Sampling the ibl directly
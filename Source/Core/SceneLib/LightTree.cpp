@@ -0,0 +1,516 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SceneLib/LightTree.h"
+#include "SceneLib/SceneResource.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/JsAssert.h"
+
+#define LightTreeBucketCount_   12
+#define OneMinusEpsilon_        0.99999994f
+
+namespace Selas
+{
+    struct LightBounds
+    {
+        AxisAlignedBox bounds;
+        float3 centroid;
+        float3 axis;
+        float  cosThetaO;
+        float  cosThetaE;
+        float  power;
+        uint32 lightIndex;
+    };
+
+    //=============================================================================================================================
+    static float Component(float3 v, uint32 axis)
+    {
+        return (&v.x)[axis];
+    }
+
+    //=============================================================================================================================
+    static float SafeAcos(float value)
+    {
+        return Math::Acosf(Clamp(value, -1.0f, 1.0f));
+    }
+
+    //=============================================================================================================================
+    static float SinFromCos(float cosTheta)
+    {
+        return Math::Sqrtf(Max(0.0f, 1.0f - cosTheta * cosTheta));
+    }
+
+    //=============================================================================================================================
+    static void MergeCones(float3& axis, float& cosThetaO, float3 otherAxis, float otherCosThetaO)
+    {
+        float thetaA = SafeAcos(cosThetaO);
+        float thetaB = SafeAcos(otherCosThetaO);
+        float thetaD = SafeAcos(Dot(axis, otherAxis));
+
+        // -- One cone already contains the other
+        if(Min(thetaD + thetaB, Math::Pi_) <= thetaA) {
+            return;
+        }
+        if(Min(thetaD + thetaA, Math::Pi_) <= thetaB) {
+            axis = otherAxis;
+            cosThetaO = otherCosThetaO;
+            return;
+        }
+
+        float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+        float3 rotationAxis = Cross(axis, otherAxis);
+        if(thetaO >= Math::Pi_ || LengthSquared(rotationAxis) < SmallFloatEpsilon_) {
+            cosThetaO = -1.0f;
+            return;
+        }
+
+        // -- Rotate the first axis towards the second until the merged cone just touches the edge of the first
+        float thetaR = thetaO - thetaA;
+        rotationAxis = Normalize(rotationAxis);
+        axis = Normalize(Math::Cosf(thetaR) * axis + Math::Sinf(thetaR) * Cross(rotationAxis, axis));
+        cosThetaO = Math::Cosf(thetaO);
+    }
+
+    //=============================================================================================================================
+    static void MergeBounds(LightBounds& bounds, const LightBounds& other)
+    {
+        if(bounds.power == 0.0f) {
+            bounds = other;
+            return;
+        }
+        if(other.power == 0.0f) {
+            return;
+        }
+
+        IncludeBox(&bounds.bounds, other.bounds);
+        MergeCones(bounds.axis, bounds.cosThetaO, other.axis, other.cosThetaO);
+        bounds.cosThetaE = Min(bounds.cosThetaE, other.cosThetaE);
+        bounds.power += other.power;
+    }
+
+    //=============================================================================================================================
+    static void MakeEmptyBounds(LightBounds& bounds)
+    {
+        MakeInvalid(&bounds.bounds);
+        bounds.centroid = float3::Zero_;
+        bounds.axis = float3(0.0f, 1.0f, 0.0f);
+        bounds.cosThetaO = 1.0f;
+        bounds.cosThetaE = 1.0f;
+        bounds.power = 0.0f;
+        bounds.lightIndex = 0;
+    }
+
+    //=============================================================================================================================
+    static void QuadLightBounds(const SceneLight& light, uint32 lightIndex, LightBounds& bounds)
+    {
+        float3 eX = 0.5f * light.x;
+        float3 eZ = 0.5f * light.z;
+
+        MakeInvalid(&bounds.bounds);
+        IncludePosition(&bounds.bounds, light.position - eX - eZ);
+        IncludePosition(&bounds.bounds, light.position - eX + eZ);
+        IncludePosition(&bounds.bounds, light.position + eX - eZ);
+        IncludePosition(&bounds.bounds, light.position + eX + eZ);
+
+        float luminance = 0.2126f * light.radiance.x + 0.7152f * light.radiance.y + 0.0722f * light.radiance.z;
+
+        // -- One sided lambertian emitters so all of the light leaves within a hemisphere around the facing direction
+        bounds.centroid = light.position;
+        bounds.axis = light.direction;
+        bounds.cosThetaO = 1.0f;
+        bounds.cosThetaE = 0.0f;
+        bounds.power = Max(luminance, 0.0f) * Length(Cross(light.x, light.z)) * Math::Pi_;
+        bounds.lightIndex = lightIndex;
+    }
+
+    //=============================================================================================================================
+    static float OrientationMeasure(const LightBounds& bounds)
+    {
+        float thetaO = SafeAcos(bounds.cosThetaO);
+        float thetaE = SafeAcos(bounds.cosThetaE);
+        float thetaW = Min(thetaO + thetaE, Math::Pi_);
+        float sinThetaO = SinFromCos(bounds.cosThetaO);
+
+        return Math::TwoPi_ * (1.0f - bounds.cosThetaO)
+             + 0.5f * Math::Pi_ * (2.0f * thetaW * sinThetaO - Math::Cosf(thetaO - 2.0f * thetaW)
+                                   - 2.0f * thetaO * sinThetaO + bounds.cosThetaO);
+    }
+
+    //=============================================================================================================================
+    static float SurfaceArea(const AxisAlignedBox& box)
+    {
+        float3 d = box.max - box.min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    //=============================================================================================================================
+    static float SplitCost(const LightBounds& bounds)
+    {
+        if(bounds.power == 0.0f) {
+            return 0.0f;
+        }
+        return bounds.power * OrientationMeasure(bounds) * SurfaceArea(bounds.bounds);
+    }
+
+    //=============================================================================================================================
+    static uint32 PartitionLights(LightBounds* lights, uint32 begin, uint32 end, uint32 axis, float splitPosition)
+    {
+        uint32 mid = begin;
+        for(uint32 scan = begin; scan < end; ++scan) {
+            if(Component(lights[scan].centroid, axis) < splitPosition) {
+                LightBounds swap = lights[mid];
+                lights[mid] = lights[scan];
+                lights[scan] = swap;
+                ++mid;
+            }
+        }
+        return mid;
+    }
+
+    //=============================================================================================================================
+    static uint32 SplitLights(LightBounds* lights, uint32 begin, uint32 end)
+    {
+        AxisAlignedBox centroids;
+        MakeInvalid(&centroids);
+        for(uint32 scan = begin; scan < end; ++scan) {
+            IncludePosition(&centroids, lights[scan].centroid);
+        }
+
+        float3 extent = centroids.max - centroids.min;
+        float maxExtent = Max(Max(extent.x, extent.y), extent.z);
+
+        // -- Binned surface area orientation heuristic. The regularizer keeps thin boxes from being split along their short axis.
+        float bestCost = FloatMax_;
+        uint32 bestAxis = 0;
+        float bestSplit = 0.0f;
+        for(uint32 axis = 0; axis < 3; ++axis) {
+            float axisExtent = Component(extent, axis);
+            if(axisExtent <= 0.0f) {
+                continue;
+            }
+
+            float axisMin = Component(centroids.min, axis);
+            float bucketScale = LightTreeBucketCount_ / axisExtent;
+
+            LightBounds buckets[LightTreeBucketCount_];
+            for(uint32 bucket = 0; bucket < LightTreeBucketCount_; ++bucket) {
+                MakeEmptyBounds(buckets[bucket]);
+            }
+            for(uint32 scan = begin; scan < end; ++scan) {
+                uint32 bucket = (uint32)((Component(lights[scan].centroid, axis) - axisMin) * bucketScale);
+                MergeBounds(buckets[Min<uint32>(bucket, LightTreeBucketCount_ - 1)], lights[scan]);
+            }
+
+            float regularizer = maxExtent / axisExtent;
+            for(uint32 split = 1; split < LightTreeBucketCount_; ++split) {
+                LightBounds below;
+                LightBounds above;
+                MakeEmptyBounds(below);
+                MakeEmptyBounds(above);
+                for(uint32 bucket = 0; bucket < split; ++bucket) {
+                    MergeBounds(below, buckets[bucket]);
+                }
+                for(uint32 bucket = split; bucket < LightTreeBucketCount_; ++bucket) {
+                    MergeBounds(above, buckets[bucket]);
+                }
+
+                float cost = regularizer * (SplitCost(below) + SplitCost(above));
+                if(cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = axisMin + split / bucketScale;
+                }
+            }
+        }
+
+        uint32 mid = begin;
+        if(bestCost < FloatMax_) {
+            mid = PartitionLights(lights, begin, end, bestAxis, bestSplit);
+        }
+
+        // -- Coincident centroids or a split that left one side empty fall back to an even split
+        if(mid == begin || mid == end) {
+            mid = begin + (end - begin) / 2;
+        }
+
+        return mid;
+    }
+
+    //=============================================================================================================================
+    static uint32 BuildNode(LightTree* tree, LightBounds* lights, uint32 begin, uint32 end, uint32 parent)
+    {
+        uint32 nodeIndex = tree->nodeCount++;
+        tree->parents[nodeIndex] = parent;
+
+        LightBounds bounds = lights[begin];
+        for(uint32 scan = begin + 1; scan < end; ++scan) {
+            MergeBounds(bounds, lights[scan]);
+        }
+        // -- Lights without power are skipped by the merge but still need to be inside their node's bounds
+        for(uint32 scan = begin; scan < end; ++scan) {
+            IncludeBox(&bounds.bounds, lights[scan].bounds);
+        }
+
+        LightTreeNode& node = tree->nodes[nodeIndex];
+        node.bounds = bounds.bounds;
+        node.axis = bounds.axis;
+        node.cosThetaO = bounds.cosThetaO;
+        node.cosThetaE = bounds.cosThetaE;
+        node.power = bounds.power;
+
+        if(end - begin == 1) {
+            node.index = lights[begin].lightIndex;
+            node.leaf = 1;
+            tree->lightLeaves[lights[begin].lightIndex] = nodeIndex;
+            return nodeIndex;
+        }
+
+        uint32 mid = SplitLights(lights, begin, end);
+
+        BuildNode(tree, lights, begin, mid, nodeIndex);
+        node.index = BuildNode(tree, lights, mid, end, nodeIndex);
+        node.leaf = 0;
+
+        return nodeIndex;
+    }
+
+    //=============================================================================================================================
+    void BuildLightTree(const SceneLight* lights, uint32 lightCount, LightTree* tree)
+    {
+        tree->nodes = nullptr;
+        tree->parents = nullptr;
+        tree->lightLeaves = nullptr;
+        tree->nodeCount = 0;
+        tree->lightCount = lightCount;
+
+        if(lightCount == 0) {
+            return;
+        }
+
+        LightBounds* bounds = AllocArray_(LightBounds, lightCount);
+        for(uint32 scan = 0; scan < lightCount; ++scan) {
+            QuadLightBounds(lights[scan], scan, bounds[scan]);
+        }
+
+        uint32 maxNodeCount = 2 * lightCount - 1;
+        tree->nodes = AllocArray_(LightTreeNode, maxNodeCount);
+        tree->parents = AllocArray_(uint32, maxNodeCount);
+        tree->lightLeaves = AllocArray_(uint32, lightCount);
+
+        BuildNode(tree, bounds, 0, lightCount, 0);
+        Assert_(tree->nodeCount == maxNodeCount);
+
+        Free_(bounds);
+    }
+
+    //=============================================================================================================================
+    void ShutdownLightTree(LightTree* tree)
+    {
+        SafeFree_(tree->nodes);
+        SafeFree_(tree->parents);
+        SafeFree_(tree->lightLeaves);
+        tree->nodeCount = 0;
+        tree->lightCount = 0;
+    }
+
+    //=============================================================================================================================
+    // -- cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b
+    static float CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+    {
+        return cosA > cosB ? 1.0f : cosA * cosB + sinA * sinB;
+    }
+
+    static float SinSubClamped(float sinA, float cosA, float sinB, float cosB)
+    {
+        return cosA > cosB ? 0.0f : sinA * cosB - cosA * sinB;
+    }
+
+    //=============================================================================================================================
+    static float Importance(const LightTreeNode& node, float3 position, float3 normal)
+    {
+        if(node.power == 0.0f) {
+            return 0.0f;
+        }
+
+        float3 center = 0.5f * (node.bounds.min + node.bounds.max);
+        float radiusSquared = 0.25f * LengthSquared(node.bounds.max - node.bounds.min);
+
+        float3 toPosition = position - center;
+        float distanceSquared = LengthSquared(toPosition);
+
+        float3 w = distanceSquared > 0.0f ? toPosition * (1.0f / Math::Sqrtf(distanceSquared)) : node.axis;
+
+        // -- The cone of directions the bounds subtend from the shading point
+        float sinThetaB = 0.0f;
+        float cosThetaB = -1.0f;
+        if(distanceSquared > radiusSquared) {
+            float sin2ThetaB = radiusSquared / distanceSquared;
+            sinThetaB = Math::Sqrtf(sin2ThetaB);
+            cosThetaB = Math::Sqrtf(1.0f - sin2ThetaB);
+        }
+
+        // -- Keeps points close to or within the bounds from getting an unbounded importance. Clamping to the full radius
+        // -- squared would flatten the importance of every large node near the shading point so, as in pbrt-v4, the clamp
+        // -- is only the half diagonal.
+        distanceSquared = Max(distanceSquared, Math::Sqrtf(radiusSquared));
+
+        // -- Smallest possible angle between an emitter's facing direction and the direction to the shading point
+        float cosThetaW = Clamp(Dot(node.axis, w), -1.0f, 1.0f);
+        float sinThetaW = SinFromCos(cosThetaW);
+        float sinThetaO = SinFromCos(node.cosThetaO);
+
+        float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+        float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+        float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+        if(cosThetaP <= node.cosThetaE) {
+            return 0.0f;
+        }
+
+        // -- Smallest possible angle between the receiver's normal and a direction to a point within the bounds. The normal's
+        // -- sign says nothing about which side a transmissive surface gathers light from so, as in pbrt-v4, the cosine is
+        // -- taken as an absolute value.
+        float cosThetaI = Math::Absf(Clamp(Dot(normal, -w), -1.0f, 1.0f));
+        float cosThetaR = CosSubClamped(SinFromCos(cosThetaI), cosThetaI, sinThetaB, cosThetaB);
+        if(cosThetaR <= 0.0f) {
+            return 0.0f;
+        }
+
+        return node.power * cosThetaP * cosThetaR / distanceSquared;
+    }
+
+    //=============================================================================================================================
+    bool SampleLightTree(const LightTree* tree, float3 position, float3 normal, float u, uint32& lightIndex, float& pdf)
+    {
+        if(tree->nodeCount == 0) {
+            return false;
+        }
+
+        pdf = 1.0f;
+
+        uint32 nodeIndex = 0;
+        while(tree->nodes[nodeIndex].leaf == 0) {
+            uint32 first = nodeIndex + 1;
+            uint32 second = tree->nodes[nodeIndex].index;
+
+            float firstImportance = Importance(tree->nodes[first], position, normal);
+            float secondImportance = Importance(tree->nodes[second], position, normal);
+            if(firstImportance + secondImportance <= 0.0f) {
+                return false;
+            }
+
+            // -- The random number is rescaled at each level so a single dimension drives the whole traversal
+            float firstProb = firstImportance / (firstImportance + secondImportance);
+            if(u < firstProb) {
+                nodeIndex = first;
+                u = Min(u / firstProb, OneMinusEpsilon_);
+                pdf *= firstProb;
+            }
+            else {
+                nodeIndex = second;
+                u = Min((u - firstProb) / (1.0f - firstProb), OneMinusEpsilon_);
+                pdf *= 1.0f - firstProb;
+            }
+        }
+
+        lightIndex = tree->nodes[nodeIndex].index;
+        return true;
+    }
+
+    //=============================================================================================================================
+    float LightTreePdf(const LightTree* tree, float3 position, float3 normal, uint32 lightIndex)
+    {
+        Assert_(lightIndex < tree->lightCount);
+
+        float pdf = 1.0f;
+
+        uint32 nodeIndex = tree->lightLeaves[lightIndex];
+        while(nodeIndex != 0) {
+            uint32 parent = tree->parents[nodeIndex];
+            uint32 first = parent + 1;
+            uint32 second = tree->nodes[parent].index;
+
+            float firstImportance = Importance(tree->nodes[first], position, normal);
+            float secondImportance = Importance(tree->nodes[second], position, normal);
+            if(firstImportance + secondImportance <= 0.0f) {
+                return 0.0f;
+            }
+
+            float firstProb = firstImportance / (firstImportance + secondImportance);
+            pdf *= (nodeIndex == first) ? firstProb : 1.0f - firstProb;
+
+            nodeIndex = parent;
+        }
+
+        return pdf;
+    }
+
+    //=============================================================================================================================
+    bool SampleLightTreeEmission(const LightTree* tree, float u, uint32& lightIndex, float& pdf)
+    {
+        if(LightTreePower(tree) <= 0.0f) {
+            return false;
+        }
+
+        pdf = 1.0f;
+
+        uint32 nodeIndex = 0;
+        while(tree->nodes[nodeIndex].leaf == 0) {
+            uint32 first = nodeIndex + 1;
+            uint32 second = tree->nodes[nodeIndex].index;
+
+            float firstProb = tree->nodes[first].power / (tree->nodes[first].power + tree->nodes[second].power);
+            if(u < firstProb) {
+                nodeIndex = first;
+                u = Min(u / firstProb, OneMinusEpsilon_);
+                pdf *= firstProb;
+            }
+            else {
+                nodeIndex = second;
+                u = Min((u - firstProb) / (1.0f - firstProb), OneMinusEpsilon_);
+                pdf *= 1.0f - firstProb;
+            }
+        }
+
+        lightIndex = tree->nodes[nodeIndex].index;
+        return true;
+    }
+
+    //=============================================================================================================================
+    float LightTreeEmissionPdf(const LightTree* tree, uint32 lightIndex)
+    {
+        Assert_(lightIndex < tree->lightCount);
+
+        if(LightTreePower(tree) <= 0.0f) {
+            return 0.0f;
+        }
+
+        float pdf = 1.0f;
+
+        uint32 nodeIndex = tree->lightLeaves[lightIndex];
+        while(nodeIndex != 0) {
+            uint32 parent = tree->parents[nodeIndex];
+            uint32 first = parent + 1;
+            uint32 second = tree->nodes[parent].index;
+
+            float firstProb = tree->nodes[first].power / (tree->nodes[first].power + tree->nodes[second].power);
+            pdf *= (nodeIndex == first) ? firstProb : 1.0f - firstProb;
+
+            nodeIndex = parent;
+        }
+
+        return pdf;
+    }
+
+    //=============================================================================================================================
+    float LightTreePower(const LightTree* tree)
+    {
+        if(tree->nodeCount == 0) {
+            return 0.0f;
+        }
+        return tree->nodes[0].power;
+    }
+}
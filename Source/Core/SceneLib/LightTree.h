@@ -0,0 +1,56 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "GeometryLib/AxisAlignedBox.h"
+#include "MathLib/FloatStructs.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    struct SceneLight;
+
+    struct LightTreeNode
+    {
+        AxisAlignedBox bounds;
+
+        // -- Every light below the node faces within acos(cosThetaO) of axis and emits up to acos(cosThetaE) past that
+        float3 axis;
+        float  cosThetaO;
+        float  cosThetaE;
+        float  power;
+
+        // -- Interior nodes store their second child; the first always directly follows its parent. Leaves store their light.
+        uint32 index;
+        uint32 leaf;
+    };
+
+    //=============================================================================================================================
+    // -- Bounding volume hierarchy over a set of lights with orientation cones at each node so a light can be chosen with
+    // -- probability roughly proportional to its contribution at a shading point. See "Importance Sampling of Many Lights with
+    // -- Adaptive Tree Splitting" by Conty Estevez and Kulla.
+    struct LightTree
+    {
+        LightTreeNode* nodes;
+        uint32*        parents;
+        uint32*        lightLeaves;
+        uint32         nodeCount;
+        uint32         lightCount;
+    };
+
+    void BuildLightTree(const SceneLight* lights, uint32 lightCount, LightTree* tree);
+    void ShutdownLightTree(LightTree* tree);
+
+    // -- Walks the tree using a single uniform random number. Returns false when no light can reach the shading point.
+    bool SampleLightTree(const LightTree* tree, float3 position, float3 normal, float u, uint32& lightIndex, float& pdf);
+
+    // -- The probability that SampleLightTree picks lightIndex from the same shading point
+    float LightTreePdf(const LightTree* tree, float3 position, float3 normal, uint32 lightIndex);
+
+    // -- Same walk as SampleLightTree but by power alone for choosing the light a light path leaves from
+    bool SampleLightTreeEmission(const LightTree* tree, float u, uint32& lightIndex, float& pdf);
+    float LightTreeEmissionPdf(const LightTree* tree, uint32 lightIndex);
+    float LightTreePower(const LightTree* tree);
+}
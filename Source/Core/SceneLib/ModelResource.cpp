@@ -3,7 +3,10 @@
 //=================================================================================================================================
 
 #include "SceneLib/ModelResource.h"
+#include "SceneLib/SubsceneResource.h"
 #include "Shading/SurfaceParameters.h"
+#include "TextureLib/DisplacementTile.h"
+#include "TextureLib/TextureFiltering.h"
 #include "UtilityLib/BinarySearch.h"
 #include "Assets/AssetFileUtils.h"
 #include "MathLib/FloatFuncs.h"
@@ -11,19 +14,22 @@
 #include "IoLib/File.h"
 #include "IoLib/BinaryStreamSerializer.h"
 #include "SystemLib/BasicTypes.h"
+#include "SystemLib/MinMax.h"
 
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
 
-#define EnableDisplacement_ 0
-#define TessellationRate_ 64.0f
+#define EnableDisplacement_ 1
+#define MinTessellationRate_ 1.0f
+#define MaxTessellationRate_ 64.0f
+#define PixelsPerTessellationSegment_ 1.0f
 
 namespace Selas
 {
     cpointer ModelResource::kDataType = "ModelResource";
     cpointer ModelResource::kGeometryDataType = "ModelGeometryResource";
 
-    const uint64 ModelResource::kDataVersion = 1539464440ul;
+    const uint64 ModelResource::kDataVersion = 1539820800ul;
     const uint32 ModelResource::kGeometryDataAlignment = 16;
     static_assert(sizeof(ModelGeometryData) % ModelResource::kGeometryDataAlignment == 0, "SceneGeometryData must be aligned");
     static_assert(ModelResource::kGeometryDataAlignment % 4 == 0, "SceneGeometryData must be aligned");
@@ -116,7 +122,9 @@ namespace Selas
             }
 
             RTCHit hit = rtcGetHitFromHitN(args->hit, args->N, scan);
-            valid[scan] = CalculatePassesAlphaTest(geomData, hit.geomID, hit.primID, { hit.u, hit.v });
+            if(CalculatePassesAlphaTest(geomData, hit.geomID, hit.primID, { hit.u, hit.v }) == false) {
+                valid[scan] = 0;
+            }
         }
     }
 
@@ -138,25 +146,32 @@ namespace Selas
 
         ModelGeometryUserData* userData = (ModelGeometryUserData*)args->geometryUserPtr;
 
-        for(unsigned int i = 0; i < N; i++) {
-            //float3 position = float3(px[i], py[i], pz[i]);
-            float3 normal = float3(nx[i], ny[i], nz[i]);
-            float2 barys = float2(us[i], vs[i]);
+        // -- Vertices are displaced a batch at a time so the uv interpolation and tile lookups can run across lanes
+        for(unsigned int start = 0; start < N; start += (unsigned int)TextureBatchWidth) {
+            unsigned int batchCount = Min<unsigned int>(N - start, (unsigned int)TextureBatchWidth);
+
+            Align_(32) float displacements[TextureBatchWidth];
+            CalculateDisplacements(userData, args->geometry, args->primID, us + start, vs + start, batchCount, displacements);
 
-            float displacement = CalculateDisplacement(userData, args->geometry, args->primID, barys);
+            for(unsigned int scan = 0; scan < batchCount; ++scan) {
+                unsigned int i = start + scan;
 
-            #if CheckForNaNs_
-                Assert_(!Math::IsNaN(normal.x));
-                Assert_(!Math::IsNaN(normal.y));
-                Assert_(!Math::IsNaN(normal.z));
-                Assert_(!Math::IsNaN(displacement));
-            #endif
+                float3 normal = Normalize(float3(nx[i], ny[i], nz[i]));
+                float displacement = displacements[scan];
 
-            float3 deltaPosition = displacement * normal;
+                #if CheckForNaNs_
+                    Assert_(!Math::IsNaN(normal.x));
+                    Assert_(!Math::IsNaN(normal.y));
+                    Assert_(!Math::IsNaN(normal.z));
+                    Assert_(!Math::IsNaN(displacement));
+                #endif
 
-            px[i] += deltaPosition.x;
-            py[i] += deltaPosition.y;
-            pz[i] += deltaPosition.z;
+                float3 deltaPosition = displacement * normal;
+
+                px[i] += deltaPosition.x;
+                py[i] += deltaPosition.y;
+                pz[i] += deltaPosition.z;
+            }
         }
     }
 
@@ -232,6 +247,38 @@ namespace Selas
         return model->defaultMaterial;
     }
 
+    //=============================================================================================================================
+    static float DisplacementTessellationRate(const ModelResource* model, const MeshMetaData& meshData,
+                                              const ModelGeometryUserData& userData)
+    {
+        const float3* positions = model->geometry->positions + meshData.vertexOffset;
+
+        AxisAlignedBox meshBox;
+        MakeInvalid(&meshBox);
+        for(uint32 scan = 0; scan < meshData.vertexCount; ++scan) {
+            IncludePosition(&meshBox, positions[scan]);
+        }
+
+        // -- Treat the faces as a square grid over the mesh's extent to estimate the length of an average face edge
+        float faceCount = (float)(meshData.indexCount / meshData.indicesPerFace);
+        float facesPerSide = Max(Math::Sqrtf(faceCount), 1.0f);
+        float edgeLength = Length(meshBox.max - meshBox.min) / facesPerSide;
+
+        // -- Segments finer than the displacement tile's texels cannot add any detail. This assumes the uvs span the tile once.
+        const DisplacementTile* tile = userData.displacement;
+        float texelRate = (float)Max(tile->width, tile->height) / facesPerSide;
+
+        // -- Without a view fall back to tessellating down to the tile's resolution. Instance scales are not accounted for.
+        float rate = texelRate;
+        float pixelScale = userData.subscene->tessellationPixelScale;
+        if(pixelScale > 0.0f) {
+            float screenRate = edgeLength * pixelScale / PixelsPerTessellationSegment_;
+            rate = Min(screenRate, texelRate);
+        }
+
+        return Clamp(rate, MinTessellationRate_, MaxTessellationRate_);
+    }
+
     //=============================================================================================================================
     static Error InitializeMeshes(ModelResource* model, RTCDevice rtcDevice, RTCScene rtcScene, uint32& offset)
     {
@@ -248,7 +295,7 @@ namespace Selas
 
             const MaterialResourceData* material = userData.material;
 
-            bool hasDisplacement = material->flags & MaterialFlags::eDisplacementEnabled && EnableDisplacement_;
+            bool hasDisplacement = userData.displacement != nullptr && EnableDisplacement_;
             bool hasAlphaTesting = material->flags & MaterialFlags::eAlphaTested;
 
             uint32 indicesPerFace = meshData.indicesPerFace;
@@ -265,7 +312,7 @@ namespace Selas
                                            0, sizeof(uint32), meshData.indexCount / indicesPerFace);
 
                 rtcSetGeometryDisplacementFunction(rtcGeometry, DisplacementFunction);
-                rtcSetGeometryTessellationRate(rtcGeometry, TessellationRate_);
+                rtcSetGeometryTessellationRate(rtcGeometry, DisplacementTessellationRate(model, meshData, userData));
                 rtcSetGeometrySubdivisionMode(rtcGeometry, 0, RTC_SUBDIVISION_MODE_PIN_BOUNDARY);
             }
             else {
@@ -280,6 +327,7 @@ namespace Selas
 
             if(hasAlphaTesting) {
                 rtcSetGeometryIntersectFilterFunction(rtcGeometry, IntersectionFilter);
+                rtcSetGeometryOccludedFilterFunction(rtcGeometry, IntersectionFilter);
             }
 
             userData.rtcGeometry = rtcGeometry;
@@ -331,6 +379,36 @@ namespace Selas
         return Success_;
     }
 
+    //=============================================================================================================================
+    static Error AcquireDisplacementTile(ModelResource* model, const MaterialResourceData* material, TextureCache* cache,
+                                         const DisplacementTile*& tile)
+    {
+        // -- Meshes sharing a material share its tile
+        for(uint scan = 0, count = model->userDatas.Count(); scan < count; ++scan) {
+            if(model->userDatas[scan].material == material && model->userDatas[scan].displacement != nullptr) {
+                tile = model->userDatas[scan].displacement;
+                return Success_;
+            }
+        }
+
+        TextureHandle handle;
+        ReturnError_(cache->LoadTextureResource(material->displacementTexture, handle));
+
+        // -- The tile keeps its own copy of the heights so the texture does not need to stay resident
+        const TextureResource* texture = cache->FetchTexture(handle);
+        if(texture != nullptr) {
+            DisplacementTile* built = New_(DisplacementTile);
+            BuildDisplacementTile(texture->data, material->scalarAttributeValues[eDisplacement],
+                                  (material->flags & eInvertDisplacement) != 0, built);
+            model->displacementTiles.Add(built);
+            tile = built;
+        }
+        cache->ReleaseTexture(handle);
+        cache->UnloadTexture(handle);
+
+        return Success_;
+    }
+
     //=============================================================================================================================
     static Error InitializeGeometryUserDatas(ModelResource* model, SubsceneResource* subscene, uint lightSetIndex,
                                              const CArray<Hash32>& sceneMaterialNames,
@@ -364,6 +442,19 @@ namespace Selas
             }
             else {
                 ReturnError_(cache->LoadTextureResource(material->baseColorTexture, userData.baseColorTextureHandle));
+
+                if(material->flags & eAlphaTested) {
+                    // -- Loaded textures stay resident until unloaded so the intersection filter can hold the data directly
+                    const TextureResource* texture = cache->FetchTexture(userData.baseColorTextureHandle);
+                    if(texture != nullptr) {
+                        userData.alphaTestTexture = texture->data;
+                    }
+                    cache->ReleaseTexture(userData.baseColorTextureHandle);
+                }
+            }
+
+            if(material->flags & eDisplacementEnabled) {
+                ReturnError_(AcquireDisplacementTile(model, material, cache, userData.displacement));
             }
         }
 
@@ -514,6 +605,12 @@ namespace Selas
         }
         model->userDatas.Shutdown();
 
+        for(uint scan = 0, count = model->displacementTiles.Count(); scan < count; ++scan) {
+            ShutdownDisplacementTile(model->displacementTiles[scan]);
+            Delete_(model->displacementTiles[scan]);
+        }
+        model->displacementTiles.Shutdown();
+
         SafeDelete_(model->defaultMaterial);
         SafeFreeAligned_(model->data);
     }
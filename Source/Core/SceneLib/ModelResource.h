@@ -22,6 +22,7 @@ namespace Selas
 
     struct SubsceneResource;
     struct TextureResource;
+    struct DisplacementTile;
     struct HitParameters;
 
     enum ShaderType
@@ -79,6 +80,7 @@ namespace Selas
         }
 
         FilePathString baseColorTexture;
+        FilePathString displacementTexture;
         ShaderType shader;
         uint32 flags;
         float3 baseColor;
@@ -99,6 +101,8 @@ namespace Selas
         const MaterialResourceData* material;
         SubsceneResource* subscene;
         TextureHandle baseColorTextureHandle;
+        const TextureResourceData* alphaTestTexture;
+        const DisplacementTile* displacement;
         RTCGeometry rtcGeometry;
         uint32 flags;
         uint32 lightSetIndex;
@@ -183,6 +187,7 @@ namespace Selas
         uint64 geometrySize;
         RTCScene rtcScene;
         CArray<ModelGeometryUserData> userDatas;
+        CArray<DisplacementTile*> displacementTiles;
         MaterialResourceData* defaultMaterial;
 
         ModelResource();
@@ -11,6 +11,7 @@
 #include "MathLib/FloatFuncs.h"
 #include "IoLib/BinaryStreamSerializer.h"
 #include "SystemLib/BasicTypes.h"
+#include "SystemLib/MinMax.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/SystemTime.h"
 
@@ -211,6 +212,7 @@ namespace Selas
 
             scene->lightSets[scan].lights = scene->data->lights.DataPointer() + range.start;
             scene->lightSets[scan].count = range.count;
+            BuildLightTree(scene->lightSets[scan].lights, range.count, &scene->lightSets[scan].tree);
         }
     }
 
@@ -317,6 +319,10 @@ namespace Selas
     //=============================================================================================================================
     void ShutdownSceneResource(SceneResource* scene, TextureCache* textureCache)
     {
+        for(uint scan = 0, count = scene->lightSets.Count(); scan < count; ++scan) {
+            ShutdownLightTree(&scene->lightSets[scan].tree);
+        }
+
         if(scene->iblResource) {
             ShutdownImageBasedLightResource(scene->iblResource);
             SafeDelete_(scene->iblResource);
@@ -358,6 +364,39 @@ namespace Selas
         InitializeRayCastCamera(defaultCamera, width, height, camera);
     }
 
+    //=============================================================================================================================
+    static float DistanceToBox(const AxisAlignedBox& box, float3 position)
+    {
+        float dx = Max(Max(box.min.x - position.x, position.x - box.max.x), 0.0f);
+        float dy = Max(Max(box.min.y - position.y, position.y - box.max.y), 0.0f);
+        float dz = Max(Max(box.min.z - position.z, position.z - box.max.z), 0.0f);
+
+        return Math::Sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+
+    //=============================================================================================================================
+    void SetSceneTessellationCamera(SceneResource* scene, const RayCastCameraSettings& camera)
+    {
+        // -- Subscene geometry picks its tessellation rates when it is loaded so this only affects geometry loaded afterwards.
+        for(uint scan = 0, count = scene->data->subsceneNames.Count(); scan < count; ++scan) {
+            scene->subscenes[scan]->tessellationPixelScale = 0.0f;
+        }
+
+        for(uint scan = 0, count = scene->data->subsceneInstances.Count(); scan < count; ++scan) {
+            const Instance& instance = scene->data->subsceneInstances[scan];
+            SubsceneResource* subscene = scene->subscenes[instance.index];
+
+            AxisAlignedBox worldBox;
+            MakeInvalid(&worldBox);
+            IncludeBox(&worldBox, instance.localToWorld, subscene->aaBox);
+
+            // -- Use the nearest point of the nearest instance so no instance ends up under-tessellated
+            float distance = Max(DistanceToBox(worldBox, camera.position), Max(camera.znear, SmallFloatEpsilon_));
+            float pixelScale = camera.virtualImagePlaneDistance / distance;
+            subscene->tessellationPixelScale = Max(subscene->tessellationPixelScale, pixelScale);
+        }
+    }
+
     //=============================================================================================================================
     void ModelDataFromRayIds(const SceneResource* scene, const int32 instIds[MaxInstanceLevelCount_], int32 geomId,
                             float4x4& localToWorld, ModelGeometryUserData*& modelData)
@@ -6,6 +6,7 @@
 
 #include "SceneLib/EmbreeUtils.h"
 #include "SceneLib/SubsceneResource.h"
+#include "SceneLib/LightTree.h"
 #include "Shading/IntegratorContexts.h"
 #include "StringLib/FixedString.h"
 #include "GeometryLib/AxisAlignedBox.h"
@@ -62,6 +63,7 @@ namespace Selas
     {
         uint count;
         SceneLight* lights;
+        LightTree tree;
     };
 
     //=============================================================================================================================
@@ -93,6 +95,7 @@ namespace Selas
     void ShutdownSceneResource(SceneResource* scene, TextureCache* textureCache);
 
     void SetupSceneCamera(const SceneResource* scene, uint index, uint width, uint height, RayCastCameraSettings& camera);
+    void SetSceneTessellationCamera(SceneResource* scene, const RayCastCameraSettings& camera);
 
     void ModelDataFromRayIds(const SceneResource* scene, const int32 instIds[MaxInstanceLevelCount_], int32 geomId,
                             float4x4& localToWorld, ModelGeometryUserData*& modelData);
@@ -16,7 +16,7 @@
 namespace Selas
 {
     cpointer SubsceneResource::kDataType = "SubsceneResource";
-    const uint64 SubsceneResource::kDataVersion = 1539129606ul;
+    const uint64 SubsceneResource::kDataVersion = 1539820800ul;
 
     //=============================================================================================================================
     static uint64 EstimateSubsceneSize(SubsceneResource* subscene)
@@ -82,6 +82,7 @@ namespace Selas
     SubsceneResource::SubsceneResource()
         : data(nullptr)
         , rtcScene(nullptr)
+        , tessellationPixelScale(0.0f)
         , models(nullptr)
         , refCount(0)
         , geometryLoaded(0)
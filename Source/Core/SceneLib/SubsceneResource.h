@@ -62,6 +62,9 @@ namespace Selas
         float4 boundingSphere;
         uint64 geometrySizeEstimate;
 
+        // -- Pixels covered by one unit of length at this subscene's nearest instance. Zero when no camera has been set.
+        float tessellationPixelScale;
+
         ModelResource** models;
 
         Align_(CacheLineSize_) volatile int64 refCount;
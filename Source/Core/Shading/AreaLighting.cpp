@@ -9,6 +9,7 @@
 #include "Shading/IntegratorContexts.h"
 
 #include "SceneLib/SceneResource.h"
+#include "SceneLib/ImageBasedLightResource.h"
 #include "GeometryLib/RectangulerLightSampler.h"
 #include "GeometryLib/CoordinateSystem.h"
 #include "GeometryLib/Disc.h"
@@ -243,11 +244,30 @@ namespace Selas
     //}
 
     //=============================================================================================================================
-    void EmitIblLightSample(GIIntegratorContext* __restrict context, LightEmissionSample& sample)
+    static float EmissionPositionPdf(GIIntegratorContext* __restrict context)
+    {
+        float sceneBoundingRadius = context->scene->boundingSphere.w;
+        return ConcentricDiscPdf() * (1.0f / (sceneBoundingRadius * sceneBoundingRadius));
+    }
+
+    //=============================================================================================================================
+    static float3 EmissionPosition(GIIntegratorContext* __restrict context, float3 toLight, float r0, float r1)
     {
         // -- http://www.iliyan.com/publications/ImplementingVCM/ImplementingVCM_TechRep2012_rev2.pdf
         // -- see section 5.1 of ^ to understand the position and emission pdf calculation
+        float3 dX, dZ;
+        MakeOrthogonalCoordinateSystem(toLight, &dX, &dZ);
 
+        float sceneBoundingRadius = context->scene->boundingSphere.w;
+        float3 sceneCenter = context->scene->boundingSphere.XYZ();
+
+        float2 discSample = SampleConcentricDisc(r0, r1);
+        return sceneCenter + sceneBoundingRadius * (toLight + discSample.x * dX + discSample.y * dZ);
+    }
+
+    //=============================================================================================================================
+    void EmitIblLightSample(GIIntegratorContext* __restrict context, LightEmissionSample& sample)
+    {
         // -- choose direction to sample the ibl
         float r0 = context->sampler.UniformFloat();
         float r1 = context->sampler.UniformFloat();
@@ -256,39 +276,43 @@ namespace Selas
 
         uint x;
         uint y;
-        float dirPhi;
-        float dirTheta;
+        float3 toIbl;
 
         Assert_(context->scene->iblResource != nullptr);
         ImageBasedLightResourceData* iblData = context->scene->iblResource->data;
 
         // -- Importance sample the ibl. Note that we're cheating and treating the sample pdf as an area measure
         // -- even though it's a solid angle measure.
-        Ibl(iblData, r0, r1, dirTheta, dirPhi, x, y, sample.directionPdfA);
-        float3 toIbl = Math::SphericalToCartesian(dirTheta, dirPhi);
+        Ibl(iblData, r0, r1, toIbl, x, y, sample.directionPdfA);
         float3 radiance = SampleIbl(iblData, x, y);
 
-        float3 dX, dZ;
-        MakeOrthogonalCoordinateSystem(toIbl, &dX, &dZ);
-
-        float sceneBoundingRadius = context->scene->boundingSphere.w;
-        float3 sceneCenter = context->scene->boundingSphere.XYZ();
-
-        float2 discSample = SampleConcentricDisc(r2, r3);
-        float discPdf = ConcentricDiscPdf();
-
-        float3 position = sceneCenter + sceneBoundingRadius * (toIbl + discSample.x * dX + discSample.y * dZ);
-
-        float pdfPosition = discPdf * (1.0f / (sceneBoundingRadius * sceneBoundingRadius));
-        float pdfDirection = sample.directionPdfA;
-
-        sample.position = position;
+        sample.position = EmissionPosition(context, toIbl, r2, r3);
         sample.direction = -toIbl;
         sample.radiance = radiance;
-        sample.emissionPdfW = pdfPosition * pdfDirection;
+        sample.emissionPdfW = EmissionPositionPdf(context) * sample.directionPdfA;
         sample.cosThetaLight = 1.0f; // -- not used for ibl light sources
     }
 
+    //=============================================================================================================================
+    void EmitBackgroundLightSample(GIIntegratorContext* __restrict context, LightEmissionSample& sample)
+    {
+        if(context->scene->iblResource) {
+            EmitIblLightSample(context, sample);
+            return;
+        }
+
+        float3 toBackground = context->sampler.UniformSphere();
+        float r0 = context->sampler.UniformFloat();
+        float r1 = context->sampler.UniformFloat();
+
+        sample.position = EmissionPosition(context, toBackground, r0, r1);
+        sample.direction = -toBackground;
+        sample.radiance = context->scene->data->backgroundIntensity.XYZ();
+        sample.directionPdfA = CSampler::UniformSpherePdf();
+        sample.emissionPdfW = EmissionPositionPdf(context) * sample.directionPdfA;
+        sample.cosThetaLight = 1.0f;
+    }
+
     //=============================================================================================================================
     void DirectIblLightSample(GIIntegratorContext* __restrict context, LightDirectSample& sample)
     {
@@ -301,11 +325,9 @@ namespace Selas
 
         uint x;
         uint y;
-        float dirPhi;
-        float dirTheta;
+        float3 toIbl;
 
-        Ibl(iblData, r0, r1, dirTheta, dirPhi, x, y, sample.pdfW);
-        float3 toIbl = Math::SphericalToCartesian(dirTheta, dirPhi);
+        Ibl(iblData, r0, r1, toIbl, x, y, sample.pdfW);
         float3 radiance = SampleIbl(iblData, x, y);
 
         sample.distance = 1e36f;
@@ -322,21 +344,27 @@ namespace Selas
         float iblPdfA;
         float3 radiance = SampleIbl(iblData, direction, iblPdfA);
 
-        float sceneBoundingRadius = context->scene->boundingSphere.w;
-        float pdfPosition = ConcentricDiscPdf() * (1.0f / (sceneBoundingRadius * sceneBoundingRadius));
-
         directPdfA = iblPdfA;
-        emissionPdfW = pdfPosition * iblPdfA;
+        emissionPdfW = EmissionPositionPdf(context) * iblPdfA;
         return radiance;
     }
 
     //=============================================================================================================================
-    static void BackgroundLightSample(GIIntegratorContext* __restrict context, LightDirectSample& sample)
+    float3 BackgroundCalculateRadiance(GIIntegratorContext* __restrict context, float3 direction, float& directPdfA,
+                                       float& emissionPdfW)
     {
-        // -- choose direction to sample the ibl
-        float r0 = context->sampler.UniformFloat();
-        float r1 = context->sampler.UniformFloat();
+        if(context->scene->iblResource) {
+            return IblCalculateRadiance(context, direction, directPdfA, emissionPdfW);
+        }
+
+        directPdfA = CSampler::UniformSpherePdf();
+        emissionPdfW = EmissionPositionPdf(context) * directPdfA;
+        return context->scene->data->backgroundIntensity.XYZ();
+    }
 
+    //=============================================================================================================================
+    static void BackgroundLightSample(GIIntegratorContext* __restrict context, float r0, float r1, LightDirectSample& sample)
+    {
         float u = 2.0f * r1 - 1.0f;
         float norm = Math::Sqrtf(Max(0.0f, 1.0f - u * u));
         float theta = Math::TwoPi_ * r0;
@@ -354,6 +382,7 @@ namespace Selas
                              LightDirectSample& sample)
     {
         sample.radiance = float3::Zero_;
+        sample.index = 0;
         if(lightSetIndex >= context->scene->lightSets.Count()) {
             return;
         }
@@ -363,18 +392,22 @@ namespace Selas
             return;
         }
 
-        float perLightProb = 1.0f / lightSet.count;
-
+        // -- Choose a light in proportion to its estimated contribution at the shading point
         float p0 = context->sampler.UniformFloat();
-        uint lightIndex = (uint)(p0 * lightSet.count);
+        uint32 lightIndex;
+        float lightProb;
+        if(SampleLightTree(&lightSet.tree, position, normal, p0, lightIndex, lightProb) == false) {
+            return;
+        }
+
         SampleRectangleLightSolidAngle(context, position, normal, lightSet.lights[lightIndex], sample);
-        sample.pdfW *= perLightProb;
-        sample.index = (uint32)lightIndex;
+        sample.pdfW *= lightProb;
+        sample.index = lightIndex;
     }
 
     //=============================================================================================================================
     float LightingPdf(GIIntegratorContext* context, uint lightSetIndex, const LightDirectSample& light,
-                      const float3& position, const float3& wi)
+                      const float3& position, const float3& normal, const float3& wi)
     {
         if(lightSetIndex >= context->scene->lightSets.Count()) {
             return 0.0f;
@@ -385,8 +418,94 @@ namespace Selas
             return 0.0f;
         }
 
-        float perLightProb = 1.0f / lightSet.count;
-        return QuadLightSolidAnglePdf(lightSet.lights[light.index], position, wi) * perLightProb;
+        float lightProb = LightTreePdf(&lightSet.tree, position, normal, light.index);
+        return QuadLightSolidAnglePdf(lightSet.lights[light.index], position, wi) * lightProb;
+    }
+
+    //=============================================================================================================================
+    float AreaLightPower(const SceneResource* scene)
+    {
+        float power = 0.0f;
+        for(uint scan = 0, count = scene->lightSets.Count(); scan < count; ++scan) {
+            power += LightTreePower(&scene->lightSets[scan].tree);
+        }
+        return power;
+    }
+
+    //=============================================================================================================================
+    bool EmitAreaLightSample(GIIntegratorContext* context, uint32& lightSetIndex, uint32& lightIndex, LightEmissionSample& sample)
+    {
+        float totalPower = AreaLightPower(context->scene);
+        if(totalPower <= 0.0f) {
+            return false;
+        }
+
+        // -- Choose the light set. Round off can walk u past the last set so that falls back to the last one with power.
+        float u = context->sampler.UniformFloat() * totalPower;
+        float setPower = 0.0f;
+        for(uint scan = 0, count = context->scene->lightSets.Count(); scan < count; ++scan) {
+            float power = LightTreePower(&context->scene->lightSets[scan].tree);
+            if(power <= 0.0f) {
+                continue;
+            }
+
+            lightSetIndex = (uint32)scan;
+            setPower = power;
+            if(u < power) {
+                break;
+            }
+            u -= power;
+        }
+
+        const SceneLightSet& lightSet = context->scene->lightSets[lightSetIndex];
+
+        float lightProb;
+        if(SampleLightTreeEmission(&lightSet.tree, context->sampler.UniformFloat(), lightIndex, lightProb) == false) {
+            return false;
+        }
+
+        const SceneLight& light = lightSet.lights[lightIndex];
+
+        float r0 = context->sampler.UniformFloat();
+        float r1 = context->sampler.UniformFloat();
+        float r2 = context->sampler.UniformFloat();
+        float r3 = context->sampler.UniformFloat();
+
+        // -- Uniform position on the rectangle and a cosine weighted direction around its facing direction
+        float3 dX, dZ;
+        MakeOrthogonalCoordinateSystem(light.direction, &dX, &dZ);
+
+        float2 discSample = SampleConcentricDisc(r2, r3);
+        float cosThetaLight = Math::Sqrtf(Max(0.0f, 1.0f - discSample.x * discSample.x - discSample.y * discSample.y));
+
+        float pickProb = (setPower / totalPower) * lightProb;
+        float area = Length(Cross(light.x, light.z));
+
+        sample.position = light.position + (r0 - 0.5f) * light.x + (r1 - 0.5f) * light.z;
+        sample.direction = Normalize(discSample.x * dX + cosThetaLight * light.direction + discSample.y * dZ);
+        sample.radiance = light.radiance * cosThetaLight;
+        sample.directionPdfA = pickProb / area;
+        sample.emissionPdfW = sample.directionPdfA * cosThetaLight * Math::InvPi_;
+        sample.cosThetaLight = cosThetaLight;
+
+        return sample.emissionPdfW > 0.0f;
+    }
+
+    //=============================================================================================================================
+    float AreaLightEmissionPdfW(GIIntegratorContext* context, uint lightSetIndex, uint32 lightIndex, float cosThetaLight)
+    {
+        float totalPower = AreaLightPower(context->scene);
+        if(totalPower <= 0.0f || cosThetaLight <= 0.0f || lightSetIndex >= context->scene->lightSets.Count()) {
+            return 0.0f;
+        }
+
+        const SceneLightSet& lightSet = context->scene->lightSets[lightSetIndex];
+        const SceneLight& light = lightSet.lights[lightIndex];
+
+        float pickProb = (LightTreePower(&lightSet.tree) / totalPower) * LightTreeEmissionPdf(&lightSet.tree, lightIndex);
+        float area = Length(Cross(light.x, light.z));
+
+        return pickProb / area * cosThetaLight * Math::InvPi_;
     }
 
     //=============================================================================================================================
@@ -396,7 +515,37 @@ namespace Selas
             return DirectIblLightSample(context, sample);
         }
         else {
-            return BackgroundLightSample(context, sample);
+            float r0 = context->sampler.UniformFloat();
+            float r1 = context->sampler.UniformFloat();
+            return BackgroundLightSample(context, r0, r1, sample);
+        }
+    }
+
+    //=============================================================================================================================
+    void SampleBackgroundBatch(GIIntegratorContext* context, const float* r0s, const float* r1s, uint count,
+                               LightDirectSample* samples)
+    {
+        if(context->scene->iblResource == nullptr) {
+            for(uint scan = 0; scan < count; ++scan) {
+                BackgroundLightSample(context, r0s[scan], r1s[scan], samples[scan]);
+            }
+            return;
+        }
+
+        for(uint batchStart = 0; batchStart < count; batchStart += IblBatchWidth_) {
+            uint batchSize = Min<uint>(count - batchStart, IblBatchWidth_);
+
+            IblBatchSample iblSamples[IblBatchWidth_];
+            IblBatch(context->scene->iblResource->data, r0s + batchStart, r1s + batchStart, batchSize, iblSamples);
+
+            for(uint scan = 0; scan < batchSize; ++scan) {
+                LightDirectSample& sample = samples[batchStart + scan];
+                sample.index = 0;
+                sample.distance = 1e36f;
+                sample.direction = iblSamples[scan].direction;
+                sample.radiance = iblSamples[scan].radiance;
+                sample.pdfW = iblSamples[scan].pdf;
+            }
         }
     }
 
@@ -13,6 +13,7 @@ namespace Selas
 {
     class CSampler;
     struct GIIntegratorContext;
+    struct SceneResource;
     struct SurfaceParameters;
 
     struct SphericalAreaLight
@@ -57,12 +58,27 @@ namespace Selas
     void DirectIblLightSample(GIIntegratorContext* context, LightDirectSample& sample);
     float3 IblCalculateRadiance(GIIntegratorContext* context, float3 direction, float& directPdfA, float& emissionPdfW);
 
+    // -- Same as the ibl versions above but fall back to the scene's constant background when it has no ibl
+    void EmitBackgroundLightSample(GIIntegratorContext* context, LightEmissionSample& sample);
+    float3 BackgroundCalculateRadiance(GIIntegratorContext* context, float3 direction, float& directPdfA, float& emissionPdfW);
+
     void NextEventEstimation(GIIntegratorContext* context, uint lightSetIndex, const float3& position, const float3& normal,
                              LightDirectSample& sample);
+    // -- normal and position must match the ones given to NextEventEstimation
     float LightingPdf(GIIntegratorContext* context, uint lightSetIndex, const LightDirectSample& light,
-                      const float3& position, const float3& wi);
+                      const float3& position, const float3& normal, const float3& wi);
+
+    // -- Emission from the area lights of every light set. A light set is chosen in proportion to the power of its lights
+    // -- and a light within the set through its light tree. The pdfs include the probability of choosing the light.
+    float AreaLightPower(const SceneResource* scene);
+    bool EmitAreaLightSample(GIIntegratorContext* context, uint32& lightSetIndex, uint32& lightIndex, LightEmissionSample& sample);
+    float AreaLightEmissionPdfW(GIIntegratorContext* context, uint lightSetIndex, uint32 lightIndex, float cosThetaLight);
 
     void SampleBackground(GIIntegratorContext* context, LightDirectSample& sample);
+    // -- Same as SampleBackground for count samples with the random numbers supplied by the caller. Ibls are sampled eight
+    // -- at a time.
+    void SampleBackgroundBatch(GIIntegratorContext* context, const float* r0s, const float* r1s, uint count,
+                               LightDirectSample* samples);
     float BackgroundLightingPdf(GIIntegratorContext* context, float3 wi);
     float3 EvaluateBackground(GIIntegratorContext* context, float3 wi);
     float3 EvaluateBackgroundMiss(GIIntegratorContext* context, float3 wi);
@@ -18,6 +18,12 @@ namespace Selas
 
     //=============================================================================================================================
     bool SampleDiracTransparent(CSampler* sampler, const SurfaceParameters& surface, float3 v, BsdfSample& sample)
+    {
+        return SampleDiracTransparent(sampler->UniformFloat(), surface, v, sample);
+    }
+
+    //=============================================================================================================================
+    bool SampleDiracTransparent(float r, const SurfaceParameters& surface, float3 v, BsdfSample& sample)
     {
         float3 normal = GeometricNormal(surface);
 
@@ -31,7 +37,7 @@ namespace Selas
         float pdf;
 
         float3 wi;
-        if(sampler->UniformFloat() < F) {
+        if(r < F) {
             wi = Normalize(Reflect(normal, v));
             sample.flags = eScatterEvent;
 
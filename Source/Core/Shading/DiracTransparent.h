@@ -14,4 +14,6 @@ namespace Selas
     struct BsdfSample;
 
     bool SampleDiracTransparent(CSampler* sampler, const SurfaceParameters& surface, float3 v, BsdfSample& sample);
+    // -- r chooses between reflection and refraction
+    bool SampleDiracTransparent(float r, const SurfaceParameters& surface, float3 v, BsdfSample& sample);
 }
\ No newline at end of file
@@ -325,6 +325,7 @@ namespace Selas
 
         float fPdf = d / (4.0f * Dot(wo, wm));
 
+        sample.flags = SurfaceEventFlags::eScatterEvent;
         sample.reflectance = float3(0.25f * clearcoatWeight * g * f * d) / fPdf;
         sample.wi = Normalize(MatrixMultiply(wi, MatrixTranspose(surface.worldToTangent)));
         sample.forwardPdfW = fPdf;
@@ -5,12 +5,14 @@
 //=================================================================================================================================
 
 #include "MathLib/FloatStructs.h"
+#include "MathLib/SimdFloat8.h"
 
 namespace Selas
 {
     class CSampler;
     struct HitParameters;
     struct SurfaceParameters;
+    struct SurfaceParameters8;
     struct BsdfSample;
 
     // -- BSDF evaluation for next event estimation
@@ -18,4 +20,11 @@ namespace Selas
 
     // -- Shaders
     bool SampleDisney(CSampler* sampler, const SurfaceParameters& surface, float3 v, bool thin, BsdfSample& sample);
+
+    // -- Eight wide versions of the above for batched shading. thin is a lane mask and randoms holds the lobe selection
+    // -- followed by the three values the chosen lobe consumes.
+    void EvaluateDisney8(const SurfaceParameters8& surfaces, const float3_8& v, const float3_8& l, float8 thin,
+                         float3_8& reflectance, float8& forwardPdf, float8& reversePdf);
+    void SampleDisney8(const SurfaceParameters8& surfaces, const float3_8& v, float8 thin, const float8* randoms,
+                       BsdfSample* samples, bool* successes);
 }
\ No newline at end of file
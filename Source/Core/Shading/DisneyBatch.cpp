@@ -0,0 +1,790 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Shading/Disney.h"
+#include "Shading/Scattering.h"
+#include "Shading/SurfaceParameters.h"
+#include "MathLib/SimdFloat8.h"
+#include "MathLib/Trigonometric.h"
+#include "SystemLib/JsAssert.h"
+
+namespace Selas
+{
+    // -- Eight wide versions of the functions in Disney.cpp, Ggx.cpp and Fresnel.cpp. Each one mirrors its scalar counterpart
+    // -- line for line with branches turned into selects so the two stay easy to compare. Lanes that did not take a branch
+    // -- may compute garbage that is then discarded by the select.
+
+    //=============================================================================================================================
+    static float3_8 ToTangent(const SurfaceParameters8& surfaces, const float3_8& w)
+    {
+        return w.x * surfaces.worldToTangentR0 + w.y * surfaces.worldToTangentR1 + w.z * surfaces.worldToTangentR2;
+    }
+
+    //=============================================================================================================================
+    static float3_8 ToWorld(const SurfaceParameters8& surfaces, const float3_8& w)
+    {
+        return float3_8(Dot(w, surfaces.worldToTangentR0), Dot(w, surfaces.worldToTangentR1), Dot(w, surfaces.worldToTangentR2));
+    }
+
+    //=============================================================================================================================
+    static float3_8 Lerp(const float3_8& a, const float3_8& b, float8 t)
+    {
+        return (1.0f - t) * a + t * b;
+    }
+
+    //=============================================================================================================================
+    static float3_8 Splat(float8 s)
+    {
+        return float3_8(s, s, s);
+    }
+
+    //=============================================================================================================================
+    // Tangent space trigonometry
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static float8 AbsCosTheta(const float3_8& w)
+    {
+        return Abs(w.y);
+    }
+
+    //=============================================================================================================================
+    static float8 SinTheta(const float3_8& w)
+    {
+        return Sqrt(Max(0.0f, 1.0f - w.y * w.y));
+    }
+
+    //=============================================================================================================================
+    static float8 Cos2Phi(const float3_8& w, float8 sinTheta)
+    {
+        float8 cosPhi = Select(sinTheta == 0.0f, 1.0f, Clamp(w.x / sinTheta, -1.0f, 1.0f));
+        return cosPhi * cosPhi;
+    }
+
+    //=============================================================================================================================
+    static float8 Sin2Phi(const float3_8& w, float8 sinTheta)
+    {
+        float8 sinPhi = Select(sinTheta == 0.0f, 1.0f, Clamp(w.z / sinTheta, -1.0f, 1.0f));
+        return sinPhi * sinPhi;
+    }
+
+    //=============================================================================================================================
+    // Fresnel
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static float8 SchlickWeight(float8 u)
+    {
+        float8 m = Saturate(1.0f - u);
+        float8 m2 = m * m;
+        return m * m2 * m2;
+    }
+
+    //=============================================================================================================================
+    static float8 Schlick(float r0, float8 radians)
+    {
+        return Lerp(1.0f, SchlickWeight(radians), r0);
+    }
+
+    //=============================================================================================================================
+    static float3_8 Schlick(const float3_8& r0, float8 radians)
+    {
+        float8 x = 1.0f - radians;
+        float8 x2 = x * x;
+        float8 exponential = x2 * x2 * x;
+        return r0 + (Splat(1.0f) - r0) * exponential;
+    }
+
+    //=============================================================================================================================
+    static float8 SchlickR0FromRelativeIOR(float8 eta)
+    {
+        return Square(eta - 1.0f) / Square(eta + 1.0f);
+    }
+
+    //=============================================================================================================================
+    static float8 Dielectric(float8 cosThetaI, float8 ni, float8 nt)
+    {
+        cosThetaI = Clamp(cosThetaI, -1.0f, 1.0f);
+
+        // -- Swap index of refraction if this is coming from inside the surface
+        float8 inside = cosThetaI < 0.0f;
+        float8 n0 = Select(inside, nt, ni);
+        float8 n1 = Select(inside, ni, nt);
+        cosThetaI = Abs(cosThetaI);
+
+        float8 sinThetaI = Sqrt(Max(0.0f, 1.0f - cosThetaI * cosThetaI));
+        float8 sinThetaT = n0 / n1 * sinThetaI;
+        float8 cosThetaT = Sqrt(Max(0.0f, 1.0f - sinThetaT * sinThetaT));
+
+        float8 rParallel     = ((n1 * cosThetaI) - (n0 * cosThetaT)) / ((n1 * cosThetaI) + (n0 * cosThetaT));
+        float8 rPerpendicuar = ((n0 * cosThetaI) - (n1 * cosThetaT)) / ((n0 * cosThetaI) + (n1 * cosThetaT));
+        float8 fresnel = (rParallel * rParallel + rPerpendicuar * rPerpendicuar) * 0.5f;
+
+        // -- Total internal reflection
+        return Select(sinThetaT >= 1.0f, 1.0f, fresnel);
+    }
+
+    //=============================================================================================================================
+    // Ggx
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static float8 SeparableSmithGGXG1(const float3_8& w, float8 ax, float8 ay)
+    {
+        float8 sinTheta = SinTheta(w);
+        float8 absTanTheta = Abs(sinTheta / w.y);
+
+        float8 a = Sqrt(Cos2Phi(w, sinTheta) * ax * ax + Sin2Phi(w, sinTheta) * ay * ay);
+        float8 a2Tan2Theta = Square(a * absTanTheta);
+
+        float8 lambda = 0.5f * (-1.0f + Sqrt(1.0f + a2Tan2Theta));
+        return Select(absTanTheta > FloatMax_, 0.0f, 1.0f / (1.0f + lambda));
+    }
+
+    //=============================================================================================================================
+    static float8 SeparableSmithGGXG1(const float3_8& w, float a)
+    {
+        float a2 = a * a;
+        float8 absDotNV = AbsCosTheta(w);
+
+        return 2.0f / (1.0f + Sqrt(a2 + (1 - a2) * absDotNV * absDotNV));
+    }
+
+    //=============================================================================================================================
+    static float8 GgxAnisotropicD(const float3_8& wm, float8 ax, float8 ay)
+    {
+        float8 dotHX2 = Square(wm.x);
+        float8 dotHY2 = Square(wm.z);
+        float8 cos2Theta = Square(wm.y);
+        float8 ax2 = Square(ax);
+        float8 ay2 = Square(ay);
+
+        return 1.0f / (Math::Pi_ * ax * ay * Square(dotHX2 / ax2 + dotHY2 / ay2 + cos2Theta));
+    }
+
+    //=============================================================================================================================
+    static float3_8 SampleGgxVndfAnisotropic(const float3_8& wo, float8 ax, float8 ay, float8 u1, float8 u2)
+    {
+        // -- Stretch the view vector so we are sampling as though roughness==1
+        float3_8 v = Normalize(float3_8(wo.x * ax, wo.y, wo.z * ay));
+
+        // -- Build an orthonormal basis with v, t1, and t2. Cross(v, YAxis) is (-v.z, 0, v.x).
+        float3_8 t1 = Select(v.y < 0.9999f, Normalize(float3_8(-v.z, 0.0f, v.x)), float3_8(1.0f, 0.0f, 0.0f));
+        float3_8 t2 = Cross(t1, v);
+
+        // -- Choose a point on a disk with each half of the disk weighted proportionally to its projection onto direction v
+        float8 a = 1.0f / (1.0f + v.y);
+        float8 r = Sqrt(u1);
+        float8 lowerHalf = u2 < a;
+        float8 phi = Select(lowerHalf, (u2 / a) * Math::Pi_, Math::Pi_ + (u2 - a) / (1.0f - a) * Math::Pi_);
+        float8 p1 = r * Cos(phi);
+        float8 p2 = r * Sin(phi) * Select(lowerHalf, 1.0f, v.y);
+
+        // -- Calculate the normal in this stretched tangent space
+        float3_8 n = p1 * t1 + p2 * t2 + Sqrt(Max(0.0f, 1.0f - p1 * p1 - p2 * p2)) * v;
+
+        // -- unstretch and normalize the normal
+        return Normalize(float3_8(ax * n.x, n.y, ay * n.z));
+    }
+
+    //=============================================================================================================================
+    static void GgxVndfAnisotropicPdf(const float3_8& wi, const float3_8& wm, const float3_8& wo, float8 ax, float8 ay,
+                                      float8& forwardPdfW, float8& reversePdfW)
+    {
+        float8 D = GgxAnisotropicD(wm, ax, ay);
+
+        float8 absDotNL = AbsCosTheta(wi);
+        float8 absDotHL = Abs(Dot(wm, wi));
+        float8 G1v = SeparableSmithGGXG1(wo, ax, ay);
+        forwardPdfW = G1v * absDotHL * D / absDotNL;
+
+        float8 absDotNV = AbsCosTheta(wo);
+        float8 absDotHV = Abs(Dot(wm, wo));
+        float8 G1l = SeparableSmithGGXG1(wi, ax, ay);
+        reversePdfW = G1l * absDotHV * D / absDotNV;
+    }
+
+    //=============================================================================================================================
+    // Disney
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static void CalculateLobePdfs(const SurfaceParameters8& surfaces,
+                                  float8& pSpecular, float8& pDiffuse, float8& pClearcoat, float8& pSpecTrans)
+    {
+        float8 metallicBRDF   = surfaces.metallic;
+        float8 specularBSDF   = (1.0f - surfaces.metallic) * surfaces.specTrans;
+        float8 dielectricBRDF = (1.0f - surfaces.specTrans) * (1.0f - surfaces.metallic);
+
+        float8 specularWeight     = metallicBRDF + dielectricBRDF;
+        float8 transmissionWeight = specularBSDF;
+        float8 diffuseWeight      = dielectricBRDF;
+        float8 clearcoatWeight    = Saturate(surfaces.clearcoat);
+
+        float8 norm = 1.0f / (specularWeight + transmissionWeight + diffuseWeight + clearcoatWeight);
+
+        pSpecular  = specularWeight     * norm;
+        pSpecTrans = transmissionWeight * norm;
+        pDiffuse   = diffuseWeight      * norm;
+        pClearcoat = clearcoatWeight    * norm;
+    }
+
+    //=============================================================================================================================
+    static float8 ThinTransmissionRoughness(float8 ior, float8 roughness)
+    {
+        return Saturate((0.65f * ior - 0.35f) * roughness);
+    }
+
+    //=============================================================================================================================
+    static void CalculateAnisotropicParams(float8 roughness, float8 anisotropic, float8& ax, float8& ay)
+    {
+        float8 aspect = Sqrt(1.0f - 0.9f * anisotropic);
+        ax = Max(0.001f, Square(roughness) / aspect);
+        ay = Max(0.001f, Square(roughness) * aspect);
+    }
+
+    //=============================================================================================================================
+    static float3_8 CalculateTint(const float3_8& baseColor)
+    {
+        float8 luminance = 0.3f * baseColor.x + 0.6f * baseColor.y + 1.0f * baseColor.z;
+        return Select(luminance > 0.0f, baseColor * (1.0f / luminance), Splat(1.0f));
+    }
+
+    //=============================================================================================================================
+    static float8 GTR1(float8 absDotHL, float8 a)
+    {
+        float8 a2 = a * a;
+        float8 d = (a2 - 1.0f) / (Math::Pi_ * Log2(a2) * (1.0f + (a2 - 1.0f) * absDotHL * absDotHL));
+        return Select(a >= 1.0f, Math::InvPi_, d);
+    }
+
+    //=============================================================================================================================
+    static float8 EvaluateDisneyClearcoat(float8 clearcoat, float8 alpha, const float3_8& wo, const float3_8& wm,
+                                          const float3_8& wi, float8& fPdfW, float8& rPdfW)
+    {
+        float8 absDotNH = AbsCosTheta(wm);
+        float8 dotHL = Dot(wm, wi);
+
+        float8 d = GTR1(absDotNH, Lerp(0.1f, 0.001f, alpha));
+        float8 f = Schlick(0.04f, dotHL);
+        float8 gl = SeparableSmithGGXG1(wi, 0.25f);
+        float8 gv = SeparableSmithGGXG1(wo, 0.25f);
+
+        fPdfW = d / (4.0f * Abs(Dot(wo, wm)));
+        rPdfW = d / (4.0f * Abs(Dot(wi, wm)));
+
+        return Select(clearcoat <= 0.0f, 0.0f, 0.25f * clearcoat * d * f * gl * gv);
+    }
+
+    //=============================================================================================================================
+    static float3_8 EvaluateSheen(const SurfaceParameters8& surfaces, const float3_8& wm, const float3_8& wi)
+    {
+        float8 dotHL = Abs(Dot(wm, wi));
+
+        float3_8 tint = CalculateTint(surfaces.baseColor);
+        float3_8 sheen = (surfaces.sheen * SchlickWeight(dotHL)) * Lerp(Splat(1.0f), tint, surfaces.sheenTint);
+        return Select(surfaces.sheen <= 0.0f, Splat(0.0f), sheen);
+    }
+
+    //=============================================================================================================================
+    static float3_8 DisneyFresnel(const SurfaceParameters8& surfaces, const float3_8& wo, const float3_8& wm,
+                                  const float3_8& wi)
+    {
+        float8 dotHV = Dot(wm, wo);
+
+        float3_8 tint = CalculateTint(surfaces.baseColor);
+
+        float3_8 R0 = SchlickR0FromRelativeIOR(surfaces.relativeIOR) * Lerp(Splat(1.0f), tint, surfaces.specularTint);
+                 R0 = Lerp(R0, surfaces.baseColor, surfaces.metallic);
+
+        float8 dielectricFresnel = Dielectric(dotHV, 1.0f, surfaces.ior);
+        float3_8 metallicFresnel = Schlick(R0, Dot(wi, wm));
+
+        return Lerp(Splat(dielectricFresnel), metallicFresnel, surfaces.metallic);
+    }
+
+    //=============================================================================================================================
+    // -- Only meaningful for lanes with both vectors in the upper hemisphere
+    static float3_8 EvaluateDisneyBRDF(const SurfaceParameters8& surfaces, const float3_8& wo, const float3_8& wm,
+                                       const float3_8& wi, float8& fPdf, float8& rPdf)
+    {
+        float8 dotNL = wi.y;
+        float8 dotNV = wo.y;
+
+        float8 ax, ay;
+        CalculateAnisotropicParams(surfaces.roughness, surfaces.anisotropic, ax, ay);
+
+        float8 d = GgxAnisotropicD(wm, ax, ay);
+        float8 gl = SeparableSmithGGXG1(wi, ax, ay);
+        float8 gv = SeparableSmithGGXG1(wo, ax, ay);
+
+        float3_8 f = DisneyFresnel(surfaces, wo, wm, wi);
+
+        GgxVndfAnisotropicPdf(wi, wm, wo, ax, ay, fPdf, rPdf);
+        fPdf = fPdf * (1.0f / (4.0f * Abs(Dot(wo, wm))));
+        rPdf = rPdf * (1.0f / (4.0f * Abs(Dot(wi, wm))));
+
+        return (d * gl * gv / (4.0f * dotNL * dotNV)) * f;
+    }
+
+    //=============================================================================================================================
+    static float3_8 EvaluateDisneySpecTransmission(const SurfaceParameters8& surfaces, const float3_8& wo, const float3_8& wm,
+                                                   const float3_8& wi, float8 ax, float8 ay, float8 thin)
+    {
+        float8 relativeIor = surfaces.relativeIOR;
+        float8 n2 = relativeIor * relativeIor;
+
+        float8 absDotNL = AbsCosTheta(wi);
+        float8 absDotNV = AbsCosTheta(wo);
+        float8 dotHL = Dot(wm, wi);
+        float8 dotHV = Dot(wm, wo);
+        float8 absDotHL = Abs(dotHL);
+        float8 absDotHV = Abs(dotHV);
+
+        float8 d = GgxAnisotropicD(wm, ax, ay);
+        float8 gl = SeparableSmithGGXG1(wi, ax, ay);
+        float8 gv = SeparableSmithGGXG1(wo, ax, ay);
+
+        float8 f = Dielectric(dotHV, 1.0f, surfaces.ior);
+
+        float3_8 color = Select(thin, Sqrt(surfaces.baseColor), surfaces.baseColor);
+
+        float8 c = (absDotHL * absDotHV) / (absDotNL * absDotNV);
+        float8 t = (n2 / Square(dotHL + relativeIor * dotHV));
+        return color * (c * t * (1.0f - f) * gl * gv * d);
+    }
+
+    //=============================================================================================================================
+    static float8 EvaluateDisneyRetroDiffuse(const SurfaceParameters8& surfaces, const float3_8& wo, const float3_8& wi)
+    {
+        float8 dotNL = AbsCosTheta(wi);
+        float8 dotNV = AbsCosTheta(wo);
+
+        float8 roughness = surfaces.roughness * surfaces.roughness;
+
+        float8 rr = 0.5f + 2.0f * dotNL * dotNL * roughness;
+        float8 fl = SchlickWeight(dotNL);
+        float8 fv = SchlickWeight(dotNV);
+
+        return rr * (fl + fv + fl * fv * (rr - 1.0f));
+    }
+
+    //=============================================================================================================================
+    static float8 EvaluateDisneyDiffuse(const SurfaceParameters8& surfaces, const float3_8& wo, const float3_8& wm,
+                                        const float3_8& wi, float8 thin)
+    {
+        float8 dotNL = AbsCosTheta(wi);
+        float8 dotNV = AbsCosTheta(wo);
+
+        float8 fl = SchlickWeight(dotNL);
+        float8 fv = SchlickWeight(dotNV);
+
+        float8 roughness = surfaces.roughness * surfaces.roughness;
+        float8 dotHL = Dot(wm, wi);
+        float8 fss90 = dotHL * dotHL * roughness;
+        float8 fss = Lerp(1.0f, fss90, fl) * Lerp(1.0f, fss90, fv);
+        float8 ss = 1.25f * (fss * (1.0f / (dotNL + dotNV) - 0.5f) + 0.5f);
+        float8 hanrahanKrueger = Select(thin & (surfaces.flatness > 0.0f), ss, 0.0f);
+
+        float8 lambert = 1.0f;
+        float8 retro = EvaluateDisneyRetroDiffuse(surfaces, wo, wi);
+        float8 subsurfaceApprox = Lerp(lambert, hanrahanKrueger, thin & surfaces.flatness);
+
+        return Math::InvPi_ * (retro + subsurfaceApprox * (1.0f - 0.5f * fl) * (1.0f - 0.5f * fv));
+    }
+
+    //=============================================================================================================================
+    static float3_8 CalculateExtinction(const float3_8& apparantColor, float8 scatterDistance)
+    {
+        float3_8 a = apparantColor;
+        float3_8 s = Splat(1.9f) - a + 3.5f * (a - Splat(0.8f)) * (a - Splat(0.8f));
+
+        float3_8 denominator = s * scatterDistance;
+        return float3_8(1.0f / denominator.x, 1.0f / denominator.y, 1.0f / denominator.z);
+    }
+
+    //=============================================================================================================================
+    void EvaluateDisney8(const SurfaceParameters8& surfaces, const float3_8& v, const float3_8& l, float8 thin,
+                         float3_8& reflectance, float8& forwardPdf, float8& reversePdf)
+    {
+        float3_8 wo = Normalize(ToTangent(surfaces, v));
+        float3_8 wi = Normalize(ToTangent(surfaces, l));
+        float3_8 wm = Normalize(wo + wi);
+
+        float8 dotNV = wo.y;
+        float8 dotNL = wi.y;
+
+        reflectance = Splat(0.0f);
+        forwardPdf = 0.0f;
+        reversePdf = 0.0f;
+
+        float8 pBRDF, pDiffuse, pClearcoat, pSpecTrans;
+        CalculateLobePdfs(surfaces, pBRDF, pDiffuse, pClearcoat, pSpecTrans);
+
+        float8 diffuseWeight = (1.0f - surfaces.metallic) * (1.0f - surfaces.specTrans);
+        float8 transWeight   = (1.0f - surfaces.metallic) * surfaces.specTrans;
+
+        // -- Clearcoat
+        float8 upperHemisphere = (dotNL > 0.0f) & (dotNV > 0.0f);
+        float8 clearcoatLanes = upperHemisphere & (surfaces.clearcoat > 0.0f);
+        if(Any(clearcoatLanes)) {
+            float8 forwardClearcoatPdfW;
+            float8 reverseClearcoatPdfW;
+            float8 clearcoat = EvaluateDisneyClearcoat(surfaces.clearcoat, surfaces.clearcoatGloss, wo, wm, wi,
+                                                       forwardClearcoatPdfW, reverseClearcoatPdfW);
+
+            reflectance = reflectance + Splat(clearcoatLanes & clearcoat);
+            forwardPdf = forwardPdf + (clearcoatLanes & (pClearcoat * forwardClearcoatPdfW));
+            reversePdf = reversePdf + (clearcoatLanes & (pClearcoat * reverseClearcoatPdfW));
+        }
+
+        // -- Diffuse
+        float8 diffuseLanes = diffuseWeight > 0.0f;
+        if(Any(diffuseLanes)) {
+            float8 forwardDiffusePdfW = AbsCosTheta(wi);
+            float8 reverseDiffusePdfW = AbsCosTheta(wo);
+            float8 diffuse = EvaluateDisneyDiffuse(surfaces, wo, wm, wi, thin);
+
+            float3_8 sheen = EvaluateSheen(surfaces, wm, wi);
+
+            float3_8 lobe = diffuseWeight * (diffuse * surfaces.baseColor + sheen);
+            reflectance = reflectance + Select(diffuseLanes, lobe, Splat(0.0f));
+            forwardPdf = forwardPdf + (diffuseLanes & (pDiffuse * forwardDiffusePdfW));
+            reversePdf = reversePdf + (diffuseLanes & (pDiffuse * reverseDiffusePdfW));
+        }
+
+        // -- Transmission
+        float8 transLanes = transWeight > 0.0f;
+        if(Any(transLanes)) {
+            float8 rscaled = Select(thin, ThinTransmissionRoughness(surfaces.ior, surfaces.roughness), surfaces.roughness);
+            float8 tax, tay;
+            CalculateAnisotropicParams(rscaled, surfaces.anisotropic, tax, tay);
+
+            float3_8 transmission = EvaluateDisneySpecTransmission(surfaces, wo, wm, wi, tax, tay, thin);
+            reflectance = reflectance + Select(transLanes, transWeight * transmission, Splat(0.0f));
+
+            float8 forwardTransmissivePdfW;
+            float8 reverseTransmissivePdfW;
+            GgxVndfAnisotropicPdf(wi, wm, wo, tax, tay, forwardTransmissivePdfW, reverseTransmissivePdfW);
+
+            float8 dotLH = Dot(wm, wi);
+            float8 dotVH = Dot(wm, wo);
+            float8 forward = pSpecTrans * forwardTransmissivePdfW / Square(dotLH + surfaces.relativeIOR * dotVH);
+            float8 reverse = pSpecTrans * reverseTransmissivePdfW / Square(dotVH + surfaces.relativeIOR * dotLH);
+            forwardPdf = forwardPdf + (transLanes & forward);
+            reversePdf = reversePdf + (transLanes & reverse);
+        }
+
+        // -- Specular
+        if(Any(upperHemisphere)) {
+            float8 forwardMetallicPdfW;
+            float8 reverseMetallicPdfW;
+            float3_8 specular = EvaluateDisneyBRDF(surfaces, wo, wm, wi, forwardMetallicPdfW, reverseMetallicPdfW);
+
+            reflectance = reflectance + Select(upperHemisphere, specular, Splat(0.0f));
+            forwardPdf = forwardPdf + (upperHemisphere & (pBRDF * forwardMetallicPdfW / (4.0f * Abs(Dot(wo, wm)))));
+            reversePdf = reversePdf + (upperHemisphere & (pBRDF * reverseMetallicPdfW / (4.0f * Abs(Dot(wi, wm)))));
+        }
+
+        reflectance = reflectance * Abs(dotNL);
+    }
+
+    //=============================================================================================================================
+    // -- Sampled lobe results in tangent space. Failed lanes are cleared by the caller.
+    struct DisneyLobeSample8
+    {
+        float3_8 wi;
+        float3_8 reflectance;
+        float8   forwardPdfW;
+        float8   reversePdfW;
+        float8   flags;
+        float8   success;
+
+        // -- Lanes that entered a medium and that medium's properties
+        float8   enterMedium;
+        float8   isotropicMedium;
+        float3_8 extinction;
+    };
+
+    //=============================================================================================================================
+    static void ClearMedium(DisneyLobeSample8& sample)
+    {
+        sample.enterMedium = 0.0f;
+        sample.isotropicMedium = 0.0f;
+        sample.extinction = Splat(0.0f);
+    }
+
+    //=============================================================================================================================
+    static void SampleDisneyBRDF(const SurfaceParameters8& surfaces, const float3_8& v, float8 r0, float8 r1,
+                                 DisneyLobeSample8& sample)
+    {
+        float3_8 wo = Normalize(ToTangent(surfaces, v));
+
+        float8 ax, ay;
+        CalculateAnisotropicParams(surfaces.roughness, surfaces.anisotropic, ax, ay);
+
+        // -- Sample visible distribution of normals and reflect over wm
+        float3_8 wm = SampleGgxVndfAnisotropic(wo, ax, ay, r0, r1);
+        float3_8 wi = Normalize(Reflect(wm, wo));
+
+        float3_8 F = DisneyFresnel(surfaces, wo, wm, wi);
+        float8 G1v = SeparableSmithGGXG1(wo, ax, ay);
+
+        sample.success = wi.y > 0.0f;
+        sample.flags = (float)eScatterEvent;
+        sample.reflectance = G1v * F;
+        sample.wi = wi;
+        GgxVndfAnisotropicPdf(wi, wm, wo, ax, ay, sample.forwardPdfW, sample.reversePdfW);
+
+        sample.forwardPdfW = sample.forwardPdfW * (1.0f / (4.0f * Abs(Dot(wo, wm))));
+        sample.reversePdfW = sample.reversePdfW * (1.0f / (4.0f * Abs(Dot(wi, wm))));
+        ClearMedium(sample);
+    }
+
+    //=============================================================================================================================
+    static void SampleDisneyClearcoat(const SurfaceParameters8& surfaces, const float3_8& v, float8 r0, float8 r1,
+                                      DisneyLobeSample8& sample)
+    {
+        float3_8 wo = Normalize(ToTangent(surfaces, v));
+
+        float a = 0.25f;
+        float a2 = a * a;
+
+        float8 cosTheta = Sqrt(Max(0.0f, (1.0f - Pow(a2, 1.0f - r0)) / (1.0f - a2)));
+        float8 sinTheta = Sqrt(Max(0.0f, 1.0f - cosTheta * cosTheta));
+        float8 phi = Math::TwoPi_ * r1;
+
+        float3_8 wm = float3_8(sinTheta * Cos(phi), cosTheta, sinTheta * Sin(phi));
+        wm = Select(Dot(wm, wo) < 0.0f, -wm, wm);
+
+        float3_8 wi = Reflect(wm, wo);
+
+        float8 dotNH = wm.y;
+        float8 dotLH = Dot(wm, wi);
+
+        float8 d = GTR1(Abs(dotNH), Lerp(0.1f, 0.001f, surfaces.clearcoatGloss));
+        float8 f = Schlick(0.04f, dotLH);
+        float8 g = SeparableSmithGGXG1(wi, 0.25f) * SeparableSmithGGXG1(wo, 0.25f);
+
+        float8 fPdf = d / (4.0f * Dot(wo, wm));
+
+        sample.success = Dot(wi, wo) >= 0.0f;
+        sample.flags = (float)eScatterEvent;
+        sample.reflectance = Splat((0.25f * surfaces.clearcoat * g * f * d) / fPdf);
+        sample.wi = wi;
+        sample.forwardPdfW = fPdf;
+        sample.reversePdfW = d / (4.0f * Dot(wi, wm));
+        ClearMedium(sample);
+    }
+
+    //=============================================================================================================================
+    static void SampleDisneySpecTransmission(const SurfaceParameters8& surfaces, const float3_8& v, float8 thin,
+                                             float8 r0, float8 r1, float8 r2, DisneyLobeSample8& sample)
+    {
+        float3_8 wo = ToTangent(surfaces, v);
+
+        // -- Scale roughness based on IOR
+        float8 rscaled = Select(thin, ThinTransmissionRoughness(surfaces.ior, surfaces.roughness), surfaces.roughness);
+
+        float8 tax, tay;
+        CalculateAnisotropicParams(rscaled, surfaces.anisotropic, tax, tay);
+
+        // -- Sample visible distribution of normals
+        float3_8 wm = SampleGgxVndfAnisotropic(wo, tax, tay, r0, r1);
+
+        float8 dotVH = Dot(wo, wm);
+        dotVH = Select(wm.y < 0.0f, -dotVH, dotVH);
+
+        float8 entering = wo.y > 0.0f;
+        float8 ni = Select(entering, 1.0f, surfaces.ior);
+        float8 nt = Select(entering, surfaces.ior, 1.0f);
+        float8 relativeIOR = ni / nt;
+
+        float8 F = Dielectric(dotVH, 1.0f, surfaces.ior);
+        float8 G1v = SeparableSmithGGXG1(wo, tax, tay);
+
+        // -- Reflection
+        float8 reflect = r2 <= F;
+        float3_8 reflected = Normalize(Reflect(wm, wo));
+        float8 reflectPdf = F / (4.0f * Abs(Dot(wo, wm)));
+
+        // -- Thin surfaces refract into and then out of the surface so the ray is reflected then flipped
+        float3_8 thinWi = Reflect(wm, wo);
+        thinWi.y = -thinWi.y;
+
+        // -- Solid surfaces refract into the medium unless there is total internal reflection. See Transmit in FloatFuncs.h.
+        float8 c = Dot(wo, wm);
+        float3_8 facing = Select(c < 0.0f, -wm, wm);
+        c = Abs(c);
+        float8 root = 1.0f - relativeIOR * relativeIOR * (1.0f - c * c);
+        float8 transmits = root > 0.0f;
+        float3_8 refracted = (relativeIOR * c - Sqrt(Max(root, 0.0f))) * facing - relativeIOR * wo;
+        float3_8 solidWi = Select(transmits, refracted, Reflect(wm, wo));
+
+        float3_8 transmittedWi = Normalize(Select(thin, thinWi, solidWi));
+        float8 dotLH = Abs(Dot(transmittedWi, wm));
+        float8 jacobian = dotLH / Square(dotLH + surfaces.relativeIOR * dotVH);
+        float8 transmitPdf = (1.0f - F) / jacobian;
+
+        float8 enterMedium = AndNot(reflect, AndNot(thin, transmits));
+
+        float3_8 wi = Select(reflect, reflected, transmittedWi);
+        float3_8 color = Select(AndNot(reflect, thin), Sqrt(surfaces.baseColor), surfaces.baseColor);
+        float8 pdf = Select(reflect, reflectPdf, transmitPdf);
+
+        float8 flags = Select(enterMedium, (float)eTransmissionEvent, (float)eScatterEvent);
+        flags = Select(surfaces.roughness < 0.01f, flags + (float)eDiracEvent, flags);
+
+        sample.success = (wo.y != 0.0f) & (wi.y != 0.0f);
+        sample.flags = flags;
+        sample.reflectance = G1v * color;
+        sample.wi = wi;
+
+        GgxVndfAnisotropicPdf(wi, wm, wo, tax, tay, sample.forwardPdfW, sample.reversePdfW);
+        sample.forwardPdfW = sample.forwardPdfW * pdf;
+        sample.reversePdfW = sample.reversePdfW * pdf;
+
+        sample.enterMedium = enterMedium;
+        sample.isotropicMedium = enterMedium & (dotVH > 0.0f);
+        sample.extinction = Select(enterMedium, CalculateExtinction(surfaces.transmittanceColor, surfaces.scatterDistance),
+                                   Splat(0.0f));
+    }
+
+    //=============================================================================================================================
+    static void SampleDisneyDiffuse(const SurfaceParameters8& surfaces, const float3_8& v, float8 thin,
+                                    float8 r0, float8 r1, float8 r2, DisneyLobeSample8& sample)
+    {
+        float3_8 wo = ToTangent(surfaces, v);
+
+        float8 sign = Select(wo.y < 0.0f, -1.0f, Select(wo.y > 0.0f, 1.0f, 0.0f));
+
+        // -- Sample cosine lobe
+        float8 r = Sqrt(r0);
+        float8 theta = Math::TwoPi_ * r1;
+        float3_8 wi = sign * float3_8(r * Cos(theta), Sqrt(Max(0.0f, 1.0f - r0)), r * Sin(theta));
+        float3_8 wm = Normalize(wi + wo);
+
+        float8 dotNL = wi.y;
+        float8 dotNV = wo.y;
+
+        float8 transmit = r2 <= surfaces.diffTrans;
+        wi = Select(transmit, -wi, wi);
+        float8 pdf = Select(transmit, surfaces.diffTrans, 1.0f - surfaces.diffTrans);
+
+        float8 enterMedium = AndNot(thin, transmit);
+        float3_8 color = Select(transmit & thin, Sqrt(surfaces.baseColor), surfaces.baseColor);
+
+        float3_8 sheen = EvaluateSheen(surfaces, wm, wi);
+        float8 diffuse = EvaluateDisneyDiffuse(surfaces, wo, wm, wi, thin);
+
+        sample.success = dotNL != 0.0f;
+        sample.flags = Select(enterMedium, (float)eTransmissionEvent, (float)eScatterEvent);
+        sample.reflectance = sheen + color * (diffuse / pdf);
+        sample.wi = wi;
+        sample.forwardPdfW = Abs(dotNL) * pdf;
+        sample.reversePdfW = Abs(dotNV) * pdf;
+
+        sample.enterMedium = enterMedium;
+        sample.isotropicMedium = enterMedium;
+        sample.extinction = Select(enterMedium, CalculateExtinction(surfaces.transmittanceColor, surfaces.scatterDistance),
+                                   Splat(0.0f));
+    }
+
+    //=============================================================================================================================
+    static void MergeLobe(float8 lanes, const DisneyLobeSample8& lobe, DisneyLobeSample8& result)
+    {
+        result.wi = Select(lanes, lobe.wi, result.wi);
+        result.reflectance = Select(lanes, lobe.reflectance, result.reflectance);
+        result.forwardPdfW = Select(lanes, lobe.forwardPdfW, result.forwardPdfW);
+        result.reversePdfW = Select(lanes, lobe.reversePdfW, result.reversePdfW);
+        result.flags = Select(lanes, lobe.flags, result.flags);
+        result.success = Select(lanes, lobe.success, result.success);
+        result.enterMedium = Select(lanes, lobe.enterMedium, result.enterMedium);
+        result.isotropicMedium = Select(lanes, lobe.isotropicMedium, result.isotropicMedium);
+        result.extinction = Select(lanes, lobe.extinction, result.extinction);
+    }
+
+    //=============================================================================================================================
+    void SampleDisney8(const SurfaceParameters8& surfaces, const float3_8& v, float8 thin, const float8* randoms,
+                       BsdfSample* samples, bool* successes)
+    {
+        float8 pSpecular, pDiffuse, pClearcoat, pTransmission;
+        CalculateLobePdfs(surfaces, pSpecular, pDiffuse, pClearcoat, pTransmission);
+
+        float8 p = randoms[0];
+        float8 specularLanes = p <= pSpecular;
+        float8 clearcoatLanes = AndNot(specularLanes, p <= pSpecular + pClearcoat);
+        float8 diffuseLanes = AndNot(specularLanes | clearcoatLanes, p <= pSpecular + pClearcoat + pDiffuse);
+        float8 transmissionLanes = Not(specularLanes | clearcoatLanes | diffuseLanes);
+
+        DisneyLobeSample8 result;
+        result.wi = Splat(0.0f);
+        result.reflectance = Splat(0.0f);
+        result.forwardPdfW = 0.0f;
+        result.reversePdfW = 0.0f;
+        result.flags = 0.0f;
+        result.success = 0.0f;
+        ClearMedium(result);
+
+        // -- Each lobe is only evaluated when at least one lane chose it
+        DisneyLobeSample8 lobe;
+        if(Any(specularLanes)) {
+            SampleDisneyBRDF(surfaces, v, randoms[1], randoms[2], lobe);
+            MergeLobe(specularLanes, lobe, result);
+        }
+        if(Any(clearcoatLanes)) {
+            SampleDisneyClearcoat(surfaces, v, randoms[1], randoms[2], lobe);
+            MergeLobe(clearcoatLanes, lobe, result);
+        }
+        if(Any(diffuseLanes)) {
+            SampleDisneyDiffuse(surfaces, v, thin, randoms[1], randoms[2], randoms[3], lobe);
+            MergeLobe(diffuseLanes, lobe, result);
+        }
+        if(Any(transmissionLanes)) {
+            SampleDisneySpecTransmission(surfaces, v, thin, randoms[1], randoms[2], randoms[3], lobe);
+            MergeLobe(transmissionLanes, lobe, result);
+        }
+
+        float8 pLobe = Select(specularLanes, pSpecular,
+                              Select(clearcoatLanes, pClearcoat, Select(diffuseLanes, pDiffuse, pTransmission)));
+        float8 scaleLanes = pLobe > 0.0f;
+        result.reflectance = Select(scaleLanes, result.reflectance * (1.0f / pLobe), result.reflectance);
+        result.forwardPdfW = Select(scaleLanes, result.forwardPdfW * pLobe, result.forwardPdfW);
+        result.reversePdfW = Select(scaleLanes, result.reversePdfW * pLobe, result.reversePdfW);
+
+        // -- Failed lanes return an empty sample
+        float8 success = result.success;
+        float3_8 wi = Select(success, Normalize(ToWorld(surfaces, result.wi)), Splat(0.0f));
+        float3_8 reflectance = Select(success, result.reflectance, Splat(0.0f));
+        float3_8 extinction = Select(success & result.enterMedium, result.extinction, Splat(0.0f));
+
+        Align_(32) float forwardPdfs[Float8LaneCount_];
+        Align_(32) float reversePdfs[Float8LaneCount_];
+        Align_(32) float flags[Float8LaneCount_];
+        Align_(32) float isotropic[Float8LaneCount_];
+        float3 wis[Float8LaneCount_];
+        float3 reflectances[Float8LaneCount_];
+        float3 extinctions[Float8LaneCount_];
+        Store8(forwardPdfs, success & result.forwardPdfW);
+        Store8(reversePdfs, success & result.reversePdfW);
+        Store8(flags, result.flags);
+        Store8(isotropic, success & result.isotropicMedium);
+        Store8(wi, wis, surfaces.count);
+        Store8(reflectance, reflectances, surfaces.count);
+        Store8(extinction, extinctions, surfaces.count);
+
+        uint32 successMask = MoveMask(success);
+        for(uint scan = 0; scan < surfaces.count; ++scan) {
+            BsdfSample& sample = samples[scan];
+            sample.flags = (uint32)flags[scan];
+            sample.medium.phaseFunction = isotropic[scan] != 0.0f ? eIsotropic : eVacuum;
+            sample.medium.extinction = extinctions[scan];
+            sample.reflectance = reflectances[scan];
+            sample.wi = wis[scan];
+            sample.forwardPdfW = forwardPdfs[scan];
+            sample.reversePdfW = reversePdfs[scan];
+            successes[scan] = (successMask & (1 << scan)) != 0;
+        }
+    }
+}
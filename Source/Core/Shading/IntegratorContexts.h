@@ -57,7 +57,12 @@ namespace Selas
         uint32 trackedBounces   :  3;
         uint32 diracScatterOnly :  1;
         uint32 unused           :  2;
+        uint32 sampleIndex      : 24;
+        uint32 bounce           :  8;
         float2 baryCoords;
+
+        // -- Deferred hits are shaded in order of this key. See CalculateShadingKey.
+        uint32 shadingKey;
     };
 
     // -- generation of differential rays
@@ -45,12 +45,18 @@ namespace Selas
 
     //=============================================================================================================================
     bool SampleLambert(CSampler* sampler, const SurfaceParameters& surface, const float3& v, BsdfSample& sample)
+    {
+        float r0 = sampler->UniformFloat();
+        float r1 = sampler->UniformFloat();
+        return SampleLambert(r0, r1, surface, v, sample);
+    }
+
+    //=============================================================================================================================
+    bool SampleLambert(float r0, float r1, const SurfaceParameters& surface, const float3& v, BsdfSample& sample)
     {
         float3 wo = MatrixMultiply(v, surface.worldToTangent);
 
         // -- Sample cosine lobe
-        float r0 = sampler->UniformFloat();
-        float r1 = sampler->UniformFloat();
         float3 wi = SampleCosineWeightedHemisphere(r0, r1);
 
         float dotNL = Math::CosTheta(wi);
@@ -17,4 +17,5 @@ namespace Selas
                            float& forwardPdf, float& reversePdf);
 
     bool SampleLambert(CSampler* sampler, const SurfaceParameters& surface, const float3& v, BsdfSample& sample);
+    bool SampleLambert(float r0, float r1, const SurfaceParameters& surface, const float3& v, BsdfSample& sample);
 }
\ No newline at end of file
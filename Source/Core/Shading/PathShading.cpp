@@ -0,0 +1,264 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Shading/PathShading.h"
+#include "Shading/SurfaceScattering.h"
+#include "Shading/SurfaceParameters.h"
+#include "Shading/IntegratorContexts.h"
+#include "Shading/AreaLighting.h"
+#include "TextureLib/Framebuffer.h"
+#include "MathLib/FloatFuncs.h"
+#include "MathLib/ImportanceSampling.h"
+#include "MathLib/Sampler.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/SystemTime.h"
+
+// -- Sampler dimensions reserved for shading each hit along a path. Bounces past the bounce field's range share the last block.
+// -- Each kind of draw has a fixed offset within the block so a whole batch of hits can be drawn for before any is shaded.
+#define DimensionsPerBounce_  32
+#define BackgroundDimension_  0
+#define RouletteDimension_    2
+#define LightDimension_       4
+#define BsdfDimension_        8
+#define ContinueDimension_    12
+#define MaxKeyedBounce_       255
+
+// -- Shadow rays worth less than this fraction of their pixel's mean luminance play Russian roulette before they are queued
+#define ShadowRouletteFraction_   0.05f
+
+// -- Once a pixel has this many passes it only receives more while its relative standard error is above the threshold
+#define AdaptiveMinPasses_        2
+#define AdaptiveErrorThreshold_   0.02f
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static float ShadowRayThreshold(GIIntegratorContext* __restrict context, uint32 pixelIndex)
+    {
+        // -- Pixel means only change between passes so every thread sees the same threshold. Until a pixel has an estimate the
+        // -- threshold is zero and all of its shadow rays are traced.
+        return ShadowRouletteFraction_ * FrameBuffer_MeanLuminance(context->frameWriter.framebuffer, pixelIndex);
+    }
+
+    //=============================================================================================================================
+    static bool ShadowRayRoulette(float threshold, float u, float3& value)
+    {
+        float luminance = 0.2126f * value.x + 0.7152f * value.y + 0.0722f * value.z;
+        if(luminance >= threshold) {
+            return true;
+        }
+
+        // -- Survivors are scaled up by the inverse of their survival probability so the estimate stays unbiased
+        float survivalProb = luminance / threshold;
+        if(u >= survivalProb) {
+            return false;
+        }
+
+        value = value * (1.0f / survivalProb);
+        return true;
+    }
+
+    //=============================================================================================================================
+    static void SetHitSample(GIIntegratorContext* __restrict context, const HitParameters& hit, uint32 dimension)
+    {
+        // -- Every draw is a function of the path, bounce and dimension alone so any thread may shade any hit
+        context->sampler.SetSample(hit.index, hit.sampleIndex, hit.bounce * DimensionsPerBounce_ + dimension);
+    }
+
+    //=============================================================================================================================
+    static void AddShadowRay(const HitParameters& hit, const SurfaceParameters& surface, float3 direction, float distance,
+                             float3 value, ShadedHitBatch* shaded)
+    {
+        float3 offset = OffsetRayOrigin(surface, direction, 0.1f);
+
+        OcclusionRay& occlusionRay = shaded->shadowRays[shaded->shadowRayCount++];
+        occlusionRay.ray = MakeRay(offset, direction);
+        occlusionRay.distance = distance;
+        occlusionRay.index = hit.index;
+        occlusionRay.value = value;
+    }
+
+    //=============================================================================================================================
+    static void DrawHitBatch(const uint32* pixelIndices, const uint32* sampleIndices, const uint32* dimensionBlocks,
+                             uint hitCount, uint32 dimension, float* results)
+    {
+        uint32 dimensions[TextureBatchWidth];
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            dimensions[scan] = dimensionBlocks[scan] + dimension;
+        }
+
+        CSampler::UniformFloats(pixelIndices, sampleIndices, dimensions, hitCount, results);
+    }
+
+    //=============================================================================================================================
+    static bool ContinuePath(GIIntegratorContext* __restrict context, const HitParameters& hit,
+                             const SurfaceParameters& surface, const BsdfSample& bsdfSample, float continueRoulette,
+                             DeferredRay& bounceRay)
+    {
+        float skyPdfW = BackgroundLightingPdf(context, bsdfSample.wi);
+        float misWeight = ImportanceSampling::BalanceHeuristic(1, bsdfSample.forwardPdfW, 1, skyPdfW);
+
+        float3 throughput = misWeight * hit.throughput * bsdfSample.reflectance;
+        if(LengthSquared(throughput) == 0.0f) {
+            return false;
+        }
+
+        // --Russian roulette path termination
+        if(hit.trackedBounces >= MaxTrackedBounces_) {
+            float continuationProb = Max<float>(Max<float>(throughput.x, throughput.y), throughput.z);
+            if(continueRoulette >= continuationProb) {
+                return false;
+            }
+            Assert_(continuationProb > 0.0f);
+            throughput = throughput * (1.0f / continuationProb);
+        }
+
+        float3 offsetOrigin = OffsetRayOrigin(surface, bsdfSample.wi, 1.0f);
+
+        bounceRay.error = hit.error;
+        bounceRay.index = hit.index;
+        bounceRay.diracScatterOnly = hit.diracScatterOnly && (bsdfSample.flags & SurfaceEventFlags::eDiracEvent);
+        bounceRay.ray = MakeRay(offsetOrigin, bsdfSample.wi);
+        bounceRay.throughput = throughput;
+        bounceRay.trackedBounces = Min<uint32>(MaxTrackedBounces_, hit.trackedBounces + 1);
+        bounceRay.sampleIndex = hit.sampleIndex;
+        bounceRay.bounce = Min<uint32>(MaxKeyedBounce_, hit.bounce + 1);
+        return true;
+    }
+
+    //=============================================================================================================================
+    void ShadeHitBatch(GIIntegratorContext* context, const HitParameters* hits, uint hitCount, ShadedHitBatch* shaded)
+    {
+        static_assert(TextureBatchWidth == Float8LaneCount_, "Shading batches must match the batched bsdf width");
+        Assert_(hitCount <= TextureBatchWidth);
+
+        uint64 shadingStart = SystemTime::Timestamp();
+
+        shaded->shadowRayCount = 0;
+
+        SurfaceParameters surfaces[TextureBatchWidth];
+        CalculateSurfaceParams(context, hits, hitCount, surfaces);
+
+        SurfaceParameters8 surfaces8;
+        GatherSurfaceParams8(surfaces, hitCount, surfaces8);
+
+        // -- Make every draw and the light samples up front so the bsdf can be evaluated and sampled for the whole batch. Draws
+        // -- are made one dimension at a time across the batch. Roulette draws are made even for shadow rays and paths that
+        // -- never play it so the draws do not depend on which ones do.
+        uint32 pixelIndices[TextureBatchWidth];
+        uint32 sampleIndices[TextureBatchWidth];
+        uint32 dimensionBlocks[TextureBatchWidth];
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            pixelIndices[scan] = hits[scan].index;
+            sampleIndices[scan] = hits[scan].sampleIndex;
+            dimensionBlocks[scan] = hits[scan].bounce * DimensionsPerBounce_;
+        }
+
+        float skyR0s[TextureBatchWidth];
+        float skyR1s[TextureBatchWidth];
+        float lightRoulettes[TextureBatchWidth];
+        float skyRoulettes[TextureBatchWidth];
+        float continueRoulettes[TextureBatchWidth];
+        BsdfRandoms8 bsdfRandoms;
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, BackgroundDimension_, skyR0s);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, BackgroundDimension_ + 1, skyR1s);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, RouletteDimension_, lightRoulettes);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, RouletteDimension_ + 1, skyRoulettes);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, BsdfDimension_, bsdfRandoms.lobe);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, BsdfDimension_ + 1, bsdfRandoms.u0);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, BsdfDimension_ + 2, bsdfRandoms.u1);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, BsdfDimension_ + 3, bsdfRandoms.u2);
+        DrawHitBatch(pixelIndices, sampleIndices, dimensionBlocks, hitCount, ContinueDimension_, continueRoulettes);
+
+        float shadowThresholds[TextureBatchWidth];
+        float3 views[TextureBatchWidth];
+        float3 lightDirections[TextureBatchWidth];
+        LightDirectSample lightSamples[TextureBatchWidth];
+
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            const HitParameters& hit = hits[scan];
+            const SurfaceParameters& surface = surfaces[scan];
+
+            if(hit.trackedBounces == 0) {
+                FramebufferPrimarySample primary;
+                primary.albedo = surface.baseColor;
+                primary.normal = GeometricNormal(surface);
+                primary.depth  = Length(hit.position - context->camera->position);
+                FramebufferWriter_WritePrimary(&context->frameWriter, primary, hit.index);
+            }
+
+            shadowThresholds[scan] = ShadowRayThreshold(context, hit.index);
+
+            // -- choose a light and sample the light source. Light sampling makes its own draws through the sampler.
+            SetHitSample(context, hit, LightDimension_);
+            NextEventEstimation(context, surface.lightSetIndex, hit.position, GeometricNormal(surface), lightSamples[scan]);
+            lightDirections[scan] = lightSamples[scan].direction;
+
+            views[scan] = hit.view;
+        }
+
+        LightDirectSample skySamples[TextureBatchWidth];
+        SampleBackgroundBatch(context, skyR0s, skyR1s, hitCount, skySamples);
+
+        float3 skyDirections[TextureBatchWidth];
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            skyDirections[scan] = skySamples[scan].direction;
+        }
+
+        float3 lightReflectances[TextureBatchWidth];
+        float lightForwardPdfs[TextureBatchWidth];
+        float lightReversePdfs[TextureBatchWidth];
+        EvaluateBsdf8(surfaces8, views, lightDirections, lightReflectances, lightForwardPdfs, lightReversePdfs);
+
+        float3 skyReflectances[TextureBatchWidth];
+        float skyForwardPdfs[TextureBatchWidth];
+        float skyReversePdfs[TextureBatchWidth];
+        EvaluateBsdf8(surfaces8, views, skyDirections, skyReflectances, skyForwardPdfs, skyReversePdfs);
+
+        BsdfSample bsdfSamples[TextureBatchWidth];
+        bool sampled[TextureBatchWidth];
+        SampleBsdfFunction8(surfaces8, views, bsdfRandoms, bsdfSamples, sampled);
+
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            const HitParameters& hit = hits[scan];
+            const SurfaceParameters& surface = surfaces[scan];
+
+            const LightDirectSample& lightSample = lightSamples[scan];
+            if(Dot(lightSample.radiance, float3::One_) > 0) {
+                float weight = 1.0f;// ImportanceSampling::BalanceHeuristic(1, lightSample.pdfW, 1, forwardPdfW);
+
+                float3 sample = weight * lightReflectances[scan] * lightSample.radiance * (1.0f / lightSample.pdfW)
+                              * hit.throughput;
+                bool contributes = Dot(sample, float3::One_) > 0;
+                if(contributes && ShadowRayRoulette(shadowThresholds[scan], lightRoulettes[scan], sample)) {
+                    AddShadowRay(hit, surface, lightSample.direction, lightSample.distance, sample, shaded);
+                }
+            }
+
+            const LightDirectSample& skySample = skySamples[scan];
+            if(Dot(skySample.radiance, float3::One_) > 0) {
+                float misWeight = ImportanceSampling::BalanceHeuristic(1, skySample.pdfW, 1, skyForwardPdfs[scan]);
+
+                float3 sample = misWeight * skyReflectances[scan] * skySample.radiance * (1.0f / skySample.pdfW)
+                              * hit.throughput;
+                bool contributes = Dot(sample, float3::One_) > 0;
+                if(contributes && ShadowRayRoulette(shadowThresholds[scan], skyRoulettes[scan], sample)) {
+                    AddShadowRay(hit, surface, skySample.direction, skySample.distance, sample, shaded);
+                }
+            }
+
+            shaded->continued[scan] = sampled[scan] && ContinuePath(context, hit, surface, bsdfSamples[scan],
+                                                                    continueRoulettes[scan], shaded->bounceRays[scan]);
+        }
+
+        AddShadingStats(surfaces, hitCount, SystemTime::Timestamp() - shadingStart);
+    }
+
+    //=============================================================================================================================
+    bool PixelConverged(const Framebuffer* frame, uint32 pixelIndex, uint32 pass)
+    {
+        return pass >= AdaptiveMinPasses_ && FrameBuffer_RelativeError(frame, pixelIndex) < AdaptiveErrorThreshold_;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "Shading/PathTracingBatcher.h"
+#include "TextureLib/TextureFiltering.h"
+#include "SystemLib/BasicTypes.h"
+
+// -- Every shaded hit can queue a shadow ray toward a light and one toward the background
+#define ShadowRaysPerHit_ 2
+
+namespace Selas
+{
+    struct GIIntegratorContext;
+    struct Framebuffer;
+
+    //=============================================================================================================================
+    // -- The rays shading a batch of hits produced. Shadow rays are in hit order and bounceRays[i] is only valid when
+    // -- continued[i] is set. The integrator decides where they are queued.
+    //=============================================================================================================================
+    struct ShadedHitBatch
+    {
+        OcclusionRay shadowRays[ShadowRaysPerHit_ * TextureBatchWidth];
+        uint         shadowRayCount;
+        DeferredRay  bounceRays[TextureBatchWidth];
+        bool         continued[TextureBatchWidth];
+    };
+
+    // -- Shades up to TextureBatchWidth hits the way the deferred and wavefront path tracers do. Writes the primary aovs of
+    // -- camera hits but otherwise leaves the framebuffer alone so beginning and ending work is up to the caller.
+    void ShadeHitBatch(GIIntegratorContext* context, const HitParameters* hits, uint hitCount, ShadedHitBatch* shaded);
+
+    // -- True once the pixel's estimate is good enough that adaptive sampling skips it for the rest of the render
+    bool PixelConverged(const Framebuffer* frame, uint32 pixelIndex, uint32 pass);
+}
@@ -4,19 +4,22 @@
 //=================================================================================================================================
 
 #include "Shading/PathTracingBatcher.h"
-#include "UtilityLib/QuickSort.h"
+#include "UtilityLib/RadixSort.h"
 #include "StringLib/FixedString.h"
 #include "StringLib/StringUtil.h"
 #include "MathLib/Trigonometric.h"
 #include "MathLib/FloatFuncs.h"
 #include "IoLib/Directory.h"
+#include "IoLib/File.h"
+#include "IoLib/MappedFile.h"
 #include "IoLib/Environment.h"
+#include "ThreadingLib/JobSystem.h"
 #include "SystemLib/Atomic.h"
 #include "SystemLib/OSThreading.h"
 #include "SystemLib/MinMax.h"
-
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
+#include "SystemLib/SystemTime.h"
 
 namespace Selas
 {
@@ -68,92 +71,38 @@ namespace Selas
     //=================================================================================================================================
     struct DeferredBatch
     {
-        DeferredBatch()
-            : fileHandle(INVALID_HANDLE_VALUE)
-            , mappingHandle(INVALID_HANDLE_VALUE)
-        {
-
-        }
-
-        ~DeferredBatch()
-        {
-            if(fileHandle != INVALID_HANDLE_VALUE) {
-                UnmapViewOfFile(rays);
-                CloseHandle(fileHandle);
-                CloseHandle(mappingHandle);
-
-                FilePathString filepath = CreateBatchFilePath(batchIndex);
-                DeleteFileA(filepath.Ascii());
-            }
-        }
-
         volatile int64 batchHead;
         volatile int64 batchTail;
         int64 batchIndex;
         RayBatchCategory category;
-        HANDLE fileHandle;
-        HANDLE mappingHandle;
+        uint32 node;
+        uint64 readyTimestamp;
+        MappedFile file;
         DeferredRay* rays;
     };
 
     //=================================================================================================================================
     struct OcclusionBatch
     {
-        OcclusionBatch()
-            : fileHandle(INVALID_HANDLE_VALUE)
-            , mappingHandle(INVALID_HANDLE_VALUE)
-        {
-
-        }
-
-        ~OcclusionBatch()
-        {
-            if(fileHandle != INVALID_HANDLE_VALUE) {
-                UnmapViewOfFile(rays);
-                CloseHandle(fileHandle);
-                CloseHandle(mappingHandle);
-
-                FilePathString filepath = CreateBatchFilePath(batchIndex);
-                DeleteFileA(filepath.Ascii());
-            }
-        }
-
         volatile int64 batchHead;
         volatile int64 batchTail;
         int64 batchIndex;
         RayBatchCategory category;
-        HANDLE fileHandle;
-        HANDLE mappingHandle;
+        uint32 node;
+        uint64 readyTimestamp;
+        MappedFile file;
         OcclusionRay* rays;
     };
 
     struct HitBatch
     {
-        HitBatch()
-            : fileHandle(INVALID_HANDLE_VALUE)
-            , mappingHandle(INVALID_HANDLE_VALUE)
-        {
-
-        }
-
-        ~HitBatch()
-        {
-            if(fileHandle != INVALID_HANDLE_VALUE) {
-                UnmapViewOfFile(hits);
-                CloseHandle(fileHandle);
-                CloseHandle(mappingHandle);
-
-                FilePathString filepath = CreateBatchFilePath(batchIndex);
-                DeleteFileA(filepath.Ascii());
-            }
-        }
-
         volatile int64 batchHead;
         volatile int64 batchTail;
 
         int64 batchIndex;
-        HANDLE fileHandle;
-        HANDLE mappingHandle;
+        uint32 node;
+        uint64 readyTimestamp;
+        MappedFile file;
         HitParameters* hits;
     };
 
@@ -218,74 +167,167 @@ namespace Selas
     }
 
     //=================================================================================================================================
-    static bool operator<(const HitParameters& lhs, const HitParameters& rhs)
+    void SortRays(DeferredRay* rays, uint rayCount, RayBatchCategory category)
     {
-        for(uint scan = 0; scan < MaxInstanceLevelCount_; ++scan) {
-            if(lhs.instId[scan] < rhs.instId[scan]) {
-                return true;
-            }
+        ProfileEventMarker_(0, "SortRays");
+
+        if(category == PositiveX || category == NegativeX) {
+            SortRaysInternal((DeferredRaySortX*)rays, rayCount);
         }
-        
-        if(lhs.geomId < rhs.geomId) {
-            return true;
+        else if(category == PositiveY || category == NegativeY) {
+            SortRaysInternal((DeferredRaySortY*)rays, rayCount);
         }
-
-        if(lhs.primId < rhs.primId) {
-            return true;
+        else {
+            SortRaysInternal((DeferredRaySortZ*)rays, rayCount);
         }
+    }
 
-        return false;
+    //=================================================================================================================================
+    void SortRays(OcclusionRay* rays, uint rayCount, RayBatchCategory category)
+    {
+        ProfileEventMarker_(0, "SortRays");
+
+        if(category == PositiveX || category == NegativeX) {
+            SortRaysInternal((OcclusionRaySortX*)rays, rayCount);
+        }
+        else if(category == PositiveY || category == NegativeY) {
+            SortRaysInternal((OcclusionRaySortY*)rays, rayCount);
+        }
+        else {
+            SortRaysInternal((OcclusionRaySortZ*)rays, rayCount);
+        }
     }
 
     //=================================================================================================================================
-    static bool operator>(const HitParameters& lhs, const HitParameters& rhs)
+    void SortHitsByShadingKey(const HitParameters* hits, uint hitCount, HitParameters* sorted)
     {
-        for(uint scan = 0; scan < MaxInstanceLevelCount_; ++scan) {
-            if(lhs.instId[scan] > rhs.instId[scan]) {
-                return true;
-            }
+        ProfileEventMarker_(0, "SortHitsByShadingKey");
+
+        ThreadArenaMark mark = ThreadArena_Mark();
+
+        // -- Sort keys and indices so each hit is only moved once
+        uint32* keys = ArenaAllocArray_(uint32, 4 * hitCount, eAllocationTagSorting);
+        uint32* indices = keys + hitCount;
+        uint32* scratchKeys = indices + hitCount;
+        uint32* scratchIndices = scratchKeys + hitCount;
+
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            keys[scan] = hits[scan].shadingKey;
+            indices[scan] = (uint32)scan;
         }
 
-        if(lhs.geomId > rhs.geomId) {
-            return true;
+        RadixSortMatchingArrays(keys, indices, scratchKeys, scratchIndices, hitCount);
+
+        for(uint scan = 0; scan < hitCount; ++scan) {
+            sorted[scan] = hits[indices[scan]];
         }
 
-        if(lhs.primId > rhs.primId) {
-            return true;
+        ThreadArena_Release(mark);
+    }
+
+    //=================================================================================================================================
+    template<typename Batch_>
+    static void MarkBatchReady(Batch_* batch, int64 capacity)
+    {
+        batch->readyTimestamp = SystemTime::Timestamp();
+
+        RenderStats_Add(eRenderCounterBatchesFlushed, 1);
+        RenderStats_Add(eRenderCounterBatchEntriesFlushed, (uint64)batch->batchTail);
+        RenderStats_Add(eRenderCounterBatchCapacityFlushed, (uint64)capacity);
+    }
+
+    //=================================================================================================================================
+    template<typename Batch_>
+    static void PublishBatch(Batch_* batch, int64 capacity)
+    {
+        // -- Batch objects are recycled as soon as their entries are handed out. A writer that read the current batch just
+        // -- before it was replaced can still be looking at the object so it reads as full until everything else is set up.
+        Atomic::CompareExchange64(&batch->batchHead, 0, capacity);
+    }
+
+    //=================================================================================================================================
+    template<typename Batch_>
+    static void DiscardBatch(Batch_* batch)
+    {
+        MappedFile_Close(&batch->file);
+
+        FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
+        File::Delete(filepath.Ascii());
+    }
+
+    //=================================================================================================================================
+    static uint CurrentNode()
+    {
+        return JobSystem_ThreadNode(JobSystem_ThreadIndex());
+    }
+
+    //=================================================================================================================================
+    uint PathTracingBatcher::ReadyQueue(uint node)
+    {
+        return nodeQueues ? node : 0;
+    }
+
+    //=================================================================================================================================
+    template<typename Batch_>
+    Batch_* PathTracingBatcher::ClaimReadyBatch(CArray<Batch_*>* readyBatches, bool& remote)
+    {
+        // -- Check before locking to see if it's possible to claim a batch.
+        bool anyReady = false;
+        for(uint scan = 0; scan < queueCount; ++scan) {
+            anyReady |= readyBatches[scan].Count() > 0;
+        }
+        if(anyReady == false) {
+            return nullptr;
+        }
+
+        EnterSpinLock(lock);
+
+        // -- Check again to make sure another thread didn't claim it before we could enter the lock. Our own node goes first.
+        uint node = CurrentNode();
+        uint home = ReadyQueue(node);
+        for(uint scan = 0; scan < queueCount; ++scan) {
+            CArray<Batch_*>& ready = readyBatches[(home + scan) % queueCount];
+            if(ready.Count() > 0) {
+                Batch_* batch = ready[ready.Count() - 1];
+                ready.RemoveFast(ready.Count() - 1);
+
+                LeaveSpinLock(lock);
+
+                RenderStats_Add(eRenderCounterBatchesConsumed, 1);
+                RenderStats_Add(eRenderCounterBatchQueueTime, SystemTime::Timestamp() - batch->readyTimestamp);
+
+                remote = batch->node != node;
+                return batch;
+            }
         }
 
-        return false;
+        LeaveSpinLock(lock);
+        return nullptr;
     }
 
     //=================================================================================================================================
-    DeferredBatch* PathTracingBatcher::AllocateRayBatch(RayBatchCategory category)
+    DeferredBatch* PathTracingBatcher::AllocateRayBatch(RayBatchCategory category, uint node)
     {
-        DeferredBatch* batch = New_(DeferredBatch);
+        DeferredBatch* batch = (DeferredBatch*)BufferPool_Acquire(&deferredBatchPool);
 
+        // -- Stays full until it can take entries. See PublishBatch.
+        batch->batchHead = rayBatchCapacity;
         batch->batchIndex = Atomic::Increment64(&batchIndex);
-        batch->batchHead = 0;
         batch->batchTail = 0;
         batch->category = category;
+        batch->node = (uint32)node;
 
         FilePathString path = CreateBatchFilePath(batch->batchIndex);
 
         Directory::EnsureDirectoryExists(path.Ascii());
 
-        batch->fileHandle = CreateFileA(path.Ascii(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, 0, NULL);
-        Assert_(batch->fileHandle != INVALID_HANDLE_VALUE);
-
-        Assert_(rayBatchCapacity * sizeof(DeferredRay) < 0xFFFFFFFF);
-        DWORD size = (DWORD)(rayBatchCapacity * sizeof(DeferredRay));
-
-        batch->mappingHandle = CreateFileMapping(batch->fileHandle, NULL, PAGE_READWRITE, 0, size, NULL);
-        Assert_(batch->mappingHandle != INVALID_HANDLE_VALUE);
-
-        void* memory = MapViewOfFile(batch->mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
-        Assert_(memory != nullptr);
+        Error err = MappedFile_Create(path.Ascii(), rayBatchCapacity * sizeof(DeferredRay), &batch->file);
+        Assert_(Successful_(err));
+        Unused_(err);
 
-        batch->rays = (DeferredRay*)memory;
+        batch->rays = (DeferredRay*)batch->file.memory;
 
-        deferredBatches.Add(batch);
+        PublishBatch(batch, rayBatchCapacity);
 
         return batch;
     }
@@ -293,70 +335,64 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FlushCompletedBatch(DeferredBatch* batch)
     {
+        ProfileEventMarker_(0, "FlushCompletedBatch");
+
         if(batch->batchTail == 0) {
             // -- Flush was called on a batch that hadn't been touched at all. We can safely reset this batch here.
             batch->batchHead = 0;
             return;
         }
 
-        if(currentDeferred[batch->category] == batch) {
-            currentDeferred[batch->category] = AllocateRayBatch(batch->category);
+        if(currentDeferred[batch->node][batch->category] == batch) {
+            currentDeferred[batch->node][batch->category] = AllocateRayBatch(batch->category, batch->node);
         }
 
-        UnmapViewOfFile((void*)batch->rays);
-        CloseHandle(batch->fileHandle);
-        CloseHandle(batch->mappingHandle);
+        MappedFile_Close(&batch->file);
 
-        batch->fileHandle = INVALID_HANDLE_VALUE;
-        batch->mappingHandle = INVALID_HANDLE_VALUE;
-
-        readyDeferredBatches.Add(batch);
+        MarkBatchReady(batch, rayBatchCapacity);
+        readyDeferredBatches[ReadyQueue(batch->node)].Add(batch);
     }
 
     //=================================================================================================================================
     void PathTracingBatcher::LoadBatch(DeferredBatch* batch)
     {
+        ProfileEventMarker_(0, "LoadBatch");
+
         FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
 
-        void* fileData;
+        void* fileData = BufferPool_Acquire(&deferredRayPool);
         uint64 fileSize;
-        Error err = File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize);
+        Error err = File::ReadWholeFile(filepath.Ascii(), fileData, deferredRayPool.bufferSize, &fileSize);
         Assert_(Successful_(err));
 
-        DeleteFileA(filepath.Ascii());
+        File::Delete(filepath.Ascii());
 
         batch->rays = (DeferredRay*)fileData;
     }
 
     //=================================================================================================================================
-    OcclusionBatch* PathTracingBatcher::AllocateOcclusionBatch(RayBatchCategory category)
+    OcclusionBatch* PathTracingBatcher::AllocateOcclusionBatch(RayBatchCategory category, uint node)
     {
-        OcclusionBatch* batch = New_(OcclusionBatch);
+        OcclusionBatch* batch = (OcclusionBatch*)BufferPool_Acquire(&occlusionBatchPool);
 
+        // -- Stays full until it can take entries. See PublishBatch.
+        batch->batchHead = rayBatchCapacity;
         batch->batchIndex = Atomic::Increment64(&batchIndex);
-        batch->batchHead = 0;
         batch->batchTail = 0;
         batch->category = category;
+        batch->node = (uint32)node;
 
         FilePathString path = CreateBatchFilePath(batch->batchIndex);
 
         Directory::EnsureDirectoryExists(path.Ascii());
 
-        batch->fileHandle = CreateFileA(path.Ascii(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, 0, NULL);
-        Assert_(batch->fileHandle != INVALID_HANDLE_VALUE);
-
-        Assert_(rayBatchCapacity * sizeof(OcclusionRay) < 0xFFFFFFFF);
-        DWORD size = (DWORD)(rayBatchCapacity * sizeof(OcclusionRay));
-
-        batch->mappingHandle = CreateFileMapping(batch->fileHandle, NULL, PAGE_READWRITE, 0, size, NULL);
-        Assert_(batch->mappingHandle != INVALID_HANDLE_VALUE);
-
-        void* memory = MapViewOfFile(batch->mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
-        Assert_(memory != nullptr);
+        Error err = MappedFile_Create(path.Ascii(), rayBatchCapacity * sizeof(OcclusionRay), &batch->file);
+        Assert_(Successful_(err));
+        Unused_(err);
 
-        batch->rays = (OcclusionRay*)memory;
+        batch->rays = (OcclusionRay*)batch->file.memory;
 
-        occlusionBatches.Add(batch);
+        PublishBatch(batch, rayBatchCapacity);
 
         return batch;
     }
@@ -364,69 +400,63 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FlushCompletedBatch(OcclusionBatch* batch)
     {
+        ProfileEventMarker_(0, "FlushCompletedBatch");
+
         if(batch->batchTail == 0) {
             // -- Flush was called on a batch that hadn't been touched at all. We can safely reset this batch here.
             batch->batchHead = 0;
             return;
         }
 
-        if(currentOcclusion[batch->category] == batch) {
-            currentOcclusion[batch->category] = AllocateOcclusionBatch(batch->category);
+        if(currentOcclusion[batch->node][batch->category] == batch) {
+            currentOcclusion[batch->node][batch->category] = AllocateOcclusionBatch(batch->category, batch->node);
         }
 
-        UnmapViewOfFile((void*)batch->rays);
-        CloseHandle(batch->fileHandle);
-        CloseHandle(batch->mappingHandle);
-
-        batch->fileHandle = INVALID_HANDLE_VALUE;
-        batch->mappingHandle = INVALID_HANDLE_VALUE;
+        MappedFile_Close(&batch->file);
 
-        readyOcclusionBatches.Add(batch);
+        MarkBatchReady(batch, rayBatchCapacity);
+        readyOcclusionBatches[ReadyQueue(batch->node)].Add(batch);
     }
 
     //=================================================================================================================================
     void PathTracingBatcher::LoadBatch(OcclusionBatch* batch)
     {
+        ProfileEventMarker_(0, "LoadBatch");
+
         FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
 
-        void* fileData;
+        void* fileData = BufferPool_Acquire(&occlusionRayPool);
         uint64 fileSize;
-        Error err = File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize);
+        Error err = File::ReadWholeFile(filepath.Ascii(), fileData, occlusionRayPool.bufferSize, &fileSize);
         Assert_(Successful_(err));
 
-        DeleteFileA(filepath.Ascii());
+        File::Delete(filepath.Ascii());
 
         batch->rays = (OcclusionRay*)fileData;
     }
 
     //=================================================================================================================================
-    HitBatch* PathTracingBatcher::AllocateHitBatch()
+    HitBatch* PathTracingBatcher::AllocateHitBatch(uint node)
     {
-        HitBatch* batch = New_(HitBatch);
+        HitBatch* batch = (HitBatch*)BufferPool_Acquire(&hitBatchPool);
 
+        // -- Stays full until it can take entries. See PublishBatch.
+        batch->batchHead = hitBatchCapacity;
         batch->batchIndex = Atomic::Increment64(&batchIndex);
-        batch->batchHead = 0;
         batch->batchTail = 0;
+        batch->node = (uint32)node;
 
         FilePathString path = CreateBatchFilePath(batch->batchIndex);
 
         Directory::EnsureDirectoryExists(path.Ascii());
 
-        batch->fileHandle = CreateFileA(path.Ascii(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, 0, NULL);
-        Assert_(batch->fileHandle != INVALID_HANDLE_VALUE);
-
-        Assert_(hitBatchCapacity * sizeof(HitParameters) < 0xFFFFFFFF);
-        DWORD size = (DWORD)(hitBatchCapacity * sizeof(HitParameters));
-
-        batch->mappingHandle = CreateFileMapping(batch->fileHandle, NULL, PAGE_READWRITE, 0, size, NULL);
-        Assert_(batch->mappingHandle != INVALID_HANDLE_VALUE);
-
-        void* memory = MapViewOfFile(batch->mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
-        Assert_(memory != nullptr);
+        Error err = MappedFile_Create(path.Ascii(), hitBatchCapacity * sizeof(HitParameters), &batch->file);
+        Assert_(Successful_(err));
+        Unused_(err);
 
-        batch->hits = (HitParameters*)memory;
+        batch->hits = (HitParameters*)batch->file.memory;
 
-        hitBatches.Add(batch);
+        PublishBatch(batch, hitBatchCapacity);
 
         return batch;
     }
@@ -434,37 +464,37 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FlushCompletedBatch(HitBatch* batch)
     {
+        ProfileEventMarker_(0, "FlushCompletedBatch");
+
         if(batch->batchTail == 0) {
             // -- Flush was called on a batch that hadn't been touched at all. We can safely reset this batch here.
             batch->batchHead = 0;
             return;
         }
 
-        if(currentHits == batch) {
-            currentHits = AllocateHitBatch();
+        if(currentHits[batch->node] == batch) {
+            currentHits[batch->node] = AllocateHitBatch(batch->node);
         }
 
-        UnmapViewOfFile((void*)batch->hits);
-        CloseHandle(batch->fileHandle);
-        CloseHandle(batch->mappingHandle);
+        MappedFile_Close(&batch->file);
 
-        batch->fileHandle = INVALID_HANDLE_VALUE;
-        batch->mappingHandle = INVALID_HANDLE_VALUE;
-
-        readyHitBatches.Add(batch);
+        MarkBatchReady(batch, hitBatchCapacity);
+        readyHitBatches[ReadyQueue(batch->node)].Add(batch);
     }
 
     //=================================================================================================================================
     void PathTracingBatcher::LoadBatch(HitBatch* batch)
     {
+        ProfileEventMarker_(0, "LoadBatch");
+
         FilePathString filepath = CreateBatchFilePath(batch->batchIndex);
 
-        void* fileData;
+        void* fileData = BufferPool_Acquire(&hitPool);
         uint64 fileSize;
-        Error err = File::ReadWholeFile(filepath.Ascii(), &fileData, &fileSize);
+        Error err = File::ReadWholeFile(filepath.Ascii(), fileData, hitPool.bufferSize, &fileSize);
         Assert_(Successful_(err));
 
-        DeleteFileA(filepath.Ascii());
+        File::Delete(filepath.Ascii());
 
         batch->hits = (HitParameters*)fileData;
     }
@@ -473,10 +503,15 @@ namespace Selas
     PathTracingBatcher::PathTracingBatcher()
         : lock(nullptr)
         , batchIndex(0)
+        , nodeCount(0)
+        , queueCount(0)
+        , nodeQueues(true)
         , rayBatchCapacity(0)
         , hitBatchCapacity(0)
         , totalEntriesAdded(0)
         , totalEntriesConsumed(0)
+        , localEntriesConsumed(0)
+        , remoteEntriesConsumed(0)
     {
 
     }
@@ -488,37 +523,71 @@ namespace Selas
     }
 
     //=================================================================================================================================
-    void PathTracingBatcher::Initialize(uint rayBatchCapacity_, uint hitBatchCapacity_)
+    void PathTracingBatcher::Initialize(uint rayBatchCapacity_, uint hitBatchCapacity_, bool nodeQueues_)
     {
         rayBatchCapacity = rayBatchCapacity_;
         hitBatchCapacity = hitBatchCapacity_;
         lock = CreateSpinLock();
+        nodeCount = JobSystem_NodeCount();
+        nodeQueues = nodeQueues_;
+        queueCount = nodeQueues ? nodeCount : 1;
+
+        BufferPool_Initialize(&deferredRayPool, rayBatchCapacity * sizeof(DeferredRay), eAllocationTagBatches);
+        BufferPool_Initialize(&occlusionRayPool, rayBatchCapacity * sizeof(OcclusionRay), eAllocationTagBatches);
+        BufferPool_Initialize(&hitPool, hitBatchCapacity * sizeof(HitParameters), eAllocationTagBatches);
+        BufferPool_Initialize(&deferredBatchPool, sizeof(DeferredBatch), eAllocationTagBatches);
+        BufferPool_Initialize(&occlusionBatchPool, sizeof(OcclusionBatch), eAllocationTagBatches);
+        BufferPool_Initialize(&hitBatchPool, sizeof(HitBatch), eAllocationTagBatches);
+
+        for(uint node = 0; node < nodeCount; ++node) {
+            for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
+                currentDeferred[node][scan] = AllocateRayBatch((RayBatchCategory)scan, node);
+                currentOcclusion[node][scan] = AllocateOcclusionBatch((RayBatchCategory)scan, node);
+            }
 
-        for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
-            currentDeferred[scan] = AllocateRayBatch((RayBatchCategory)scan);
-            currentOcclusion[scan] = AllocateOcclusionBatch((RayBatchCategory)scan);
+            currentHits[node] = AllocateHitBatch(node);
         }
-
-        currentHits = AllocateHitBatch();
     }
 
     //=================================================================================================================================
     void PathTracingBatcher::Shutdown()
     {
-        for(uint scan = 0, count = deferredBatches.Count(); scan < count; ++scan) {
-            Delete_(deferredBatches[scan]);
+        // -- Only the batches being filled and any that were flushed but never handed out are left
+        for(uint node = 0; node < nodeCount; ++node) {
+            for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
+                DiscardBatch(currentDeferred[node][scan]);
+                BufferPool_Release(&deferredBatchPool, currentDeferred[node][scan]);
+                DiscardBatch(currentOcclusion[node][scan]);
+                BufferPool_Release(&occlusionBatchPool, currentOcclusion[node][scan]);
+            }
+            DiscardBatch(currentHits[node]);
+            BufferPool_Release(&hitBatchPool, currentHits[node]);
         }
-        deferredBatches.Shutdown();
 
-        for(uint scan = 0, count = occlusionBatches.Count(); scan < count; ++scan) {
-            Delete_(occlusionBatches[scan]);
+        for(uint queue = 0; queue < queueCount; ++queue) {
+            for(uint scan = 0, count = readyDeferredBatches[queue].Count(); scan < count; ++scan) {
+                DiscardBatch(readyDeferredBatches[queue][scan]);
+                BufferPool_Release(&deferredBatchPool, readyDeferredBatches[queue][scan]);
+            }
+            for(uint scan = 0, count = readyOcclusionBatches[queue].Count(); scan < count; ++scan) {
+                DiscardBatch(readyOcclusionBatches[queue][scan]);
+                BufferPool_Release(&occlusionBatchPool, readyOcclusionBatches[queue][scan]);
+            }
+            for(uint scan = 0, count = readyHitBatches[queue].Count(); scan < count; ++scan) {
+                DiscardBatch(readyHitBatches[queue][scan]);
+                BufferPool_Release(&hitBatchPool, readyHitBatches[queue][scan]);
+            }
+            readyDeferredBatches[queue].Shutdown();
+            readyOcclusionBatches[queue].Shutdown();
+            readyHitBatches[queue].Shutdown();
         }
-        occlusionBatches.Shutdown();
 
-        for(uint scan = 0, count = hitBatches.Count(); scan < count; ++scan) {
-            Delete_(hitBatches[scan]);
-        }
-        hitBatches.Shutdown();
+        BufferPool_Shutdown(&deferredRayPool);
+        BufferPool_Shutdown(&occlusionRayPool);
+        BufferPool_Shutdown(&hitPool);
+        BufferPool_Shutdown(&deferredBatchPool);
+        BufferPool_Shutdown(&occlusionBatchPool);
+        BufferPool_Shutdown(&hitBatchPool);
 
         Assert_(lock != nullptr);
         CloseSpinlock(lock);
@@ -531,9 +600,10 @@ namespace Selas
         Atomic::AddU64(&totalEntriesAdded, 1);
 
         RayBatchCategory category = DetermineRayCategory(dray);
+        uint node = CurrentNode();
 
         while(true) {
-            DeferredBatch* batch = currentDeferred[category];
+            DeferredBatch* batch = currentDeferred[node][category];
 
             int64 head = batch->batchHead;
             if(head >= rayBatchCapacity) {
@@ -563,9 +633,10 @@ namespace Selas
         Atomic::AddU64(&totalEntriesAdded, 1);
 
         RayBatchCategory category = DetermineRayCategory(oray);
+        uint node = CurrentNode();
 
         while(true) {
-            OcclusionBatch* batch = currentOcclusion[category];
+            OcclusionBatch* batch = currentOcclusion[node][category];
 
             int64 head = batch->batchHead;
             if(head >= rayBatchCapacity) {
@@ -594,8 +665,10 @@ namespace Selas
     {
         Atomic::AddU64(&totalEntriesAdded, 1);
 
+        uint node = CurrentNode();
+
         while(true) {
-            HitBatch* batch = currentHits;
+            HitBatch* batch = currentHits[node];
 
             int64 head = batch->batchHead;
             if(head >= hitBatchCapacity) {
@@ -622,44 +695,71 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::Flush()
     {
+        ProfileEventMarker_(0, "FlushBatches");
+
         EnterSpinLock(lock);
-       
-        for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
-            while(true) {
-                DeferredBatch* batch = currentDeferred[scan];
-                int64 currentHead = batch->batchHead;
-                int64 diff = rayBatchCapacity - currentHead;
 
-                if(diff == 0) {
+        for(uint node = 0; node < nodeCount; ++node) {
+            for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
+                while(true) {
+                    DeferredBatch* batch = currentDeferred[node][scan];
+                    int64 currentHead = batch->batchHead;
+                    int64 diff = rayBatchCapacity - currentHead;
 
-                    // -- Another thread has already filled this batch so we just wait for that thread to finish the copy.
-                    // -- That thread will also call FlushCompletedBatch after we release the lock
-                    while(batch->batchTail != rayBatchCapacity) {}
-                    break;
+                    if(diff == 0) {
+
+                        // -- Another thread has already filled this batch so we just wait for that thread to finish the copy.
+                        // -- That thread will also call FlushCompletedBatch after we release the lock
+                        while(batch->batchTail != rayBatchCapacity) {}
+                        break;
+                    }
+
+                    // -- Update head so this batch claims to be at capacity and we know that no other thread will claim space
+                    if(Atomic::CompareExchange64(&batch->batchHead, currentHead + diff, currentHead)) {
+
+                        // -- Wait until any other threads finish copying their rays into this batch
+                        while(batch->batchTail != rayBatchCapacity - diff) {}
+
+                        FlushCompletedBatch(batch);
+                        break;
+                    }
                 }
+            }
 
-                // -- Update head so this batch claims to be at capacity and we know that no other thread will claim space
-                if(Atomic::CompareExchange64(&batch->batchHead, currentHead + diff, currentHead)) {
+            for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
+                while(true) {
+                    OcclusionBatch* batch = currentOcclusion[node][scan];
+                    int64 currentHead = batch->batchHead;
+                    int64 diff = rayBatchCapacity - currentHead;
 
-                    // -- Wait until any other threads finish copying their rays into this batch
-                    while(batch->batchTail != rayBatchCapacity - diff) {}
+                    if(diff == 0) {
+                        // -- Another thread has already filled this batch so we just wait for that thread to finish the copy.
+                        // -- That thread will also call FlushCompletedBatch after we release the lock
+                        while(batch->batchTail != rayBatchCapacity) {}
+                        break;
+                    }
 
-                    FlushCompletedBatch(batch);
-                    break;
+                    // -- Update head so this batch claims to be at capacity and we know that no other thread will claim space
+                    if(Atomic::CompareExchange64(&batch->batchHead, currentHead + diff, currentHead)) {
+
+                        // -- Wait until any other threads finish copying their rays into this batch
+                        while(batch->batchTail != rayBatchCapacity - diff) {}
+
+                        FlushCompletedBatch(batch);
+                        break;
+                    }
                 }
             }
-        }
 
-        for(uint scan = 0; scan < RayBatchCategoryCount; ++scan) {
             while(true) {
-                OcclusionBatch* batch = currentOcclusion[scan];
+                HitBatch* batch = currentHits[node];
                 int64 currentHead = batch->batchHead;
-                int64 diff = rayBatchCapacity - currentHead;
+                int64 diff = hitBatchCapacity - currentHead;
 
                 if(diff == 0) {
                     // -- Another thread has already filled this batch so we just wait for that thread to finish the copy.
                     // -- That thread will also call FlushCompletedBatch after we release the lock
-                    while(batch->batchTail != rayBatchCapacity) {}
+                    while(batch->batchTail != hitBatchCapacity) {}
                     break;
                 }
 
@@ -667,7 +767,7 @@ namespace Selas
                 if(Atomic::CompareExchange64(&batch->batchHead, currentHead + diff, currentHead)) {
 
                     // -- Wait until any other threads finish copying their rays into this batch
-                    while(batch->batchTail != rayBatchCapacity - diff) {}
+                    while(batch->batchTail != hitBatchCapacity - diff) {}
 
                     FlushCompletedBatch(batch);
                     break;
@@ -675,69 +775,29 @@ namespace Selas
             }
         }
 
-        while(true) {
-            HitBatch* batch = currentHits;
-            int64 currentHead = batch->batchHead;
-            int64 diff = hitBatchCapacity - currentHead;
-
-            if(diff == 0) {
-                // -- Another thread has already filled this batch so we just wait for that thread to finish the copy.
-                // -- That thread will also call FlushCompletedBatch after we release the lock
-                while(batch->batchTail != hitBatchCapacity) {}
-                break;
-            }
-
-            // -- Update head so this batch claims to be at capacity and we know that no other thread will claim space
-            if(Atomic::CompareExchange64(&batch->batchHead, currentHead + diff, currentHead)) {
-
-                // -- Wait until any other threads finish copying their rays into this batch
-                while(batch->batchTail != hitBatchCapacity - diff) {}
-
-                FlushCompletedBatch(batch);
-                break;
-            }
-        }
-
         LeaveSpinLock(lock);
     }
 
     //=================================================================================================================================
     bool PathTracingBatcher::GetSortedBatch(DeferredRay*& rays, uint& rayCount)
     {
-        // -- Check before locking to see if it's possible to claim a batch.
-        if(readyDeferredBatches.Count() == 0) {
-            return false;
-        }
-        
-        EnterSpinLock(lock);
-
-        // -- Check again to make sure another thread didn't claim it before we could enter the lock
-        if(readyDeferredBatches.Count() == 0) {
-            LeaveSpinLock(lock);
+        bool remote = false;
+        DeferredBatch* batch = ClaimReadyBatch(readyDeferredBatches, remote);
+        if(batch == nullptr) {
             return false;
         }
 
-        DeferredBatch* batch = readyDeferredBatches[readyDeferredBatches.Count() - 1];
-        readyDeferredBatches.RemoveFast(readyDeferredBatches.Count() - 1);
-
-        LeaveSpinLock(lock);
-
         LoadBatch(batch);
 
         rays = batch->rays;
         rayCount = (uint)batch->batchTail;
+        RayBatchCategory category = batch->category;
+        BufferPool_Release(&deferredBatchPool, batch);
 
-        if(batch->category == PositiveX || batch->category == NegativeX) {
-            SortRaysInternal((DeferredRaySortX*)rays, rayCount);
-        }
-        else if(batch->category == PositiveY || batch->category == NegativeY) {
-            SortRaysInternal((DeferredRaySortY*)rays, rayCount);
-        }
-        else {
-            SortRaysInternal((DeferredRaySortZ*)rays, rayCount);
-        }
+        SortRays(rays, rayCount, category);
 
         Atomic::AddU64(&totalEntriesConsumed, rayCount);
+        Atomic::AddU64(remote ? &remoteEntriesConsumed : &localEntriesConsumed, rayCount);
 
         return true;
     }
@@ -745,46 +805,29 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FreeRays(DeferredRay* rays)
     {
-        FreeAligned_(rays);
+        BufferPool_Release(&deferredRayPool, rays);
     }
 
     //=================================================================================================================================
     bool PathTracingBatcher::GetSortedBatch(OcclusionRay*& rays, uint& rayCount)
     {
-        // -- Check before locking to see if it's possible to claim a batch.
-        if(readyOcclusionBatches.Count() == 0) {
-            return false;
-        }
-
-        EnterSpinLock(lock);
-
-        // -- Check again to make sure another thread didn't claim it before we could enter the lock
-        if(readyOcclusionBatches.Count() == 0) {
-            LeaveSpinLock(lock);
+        bool remote = false;
+        OcclusionBatch* batch = ClaimReadyBatch(readyOcclusionBatches, remote);
+        if(batch == nullptr) {
             return false;
         }
 
-        OcclusionBatch* batch = readyOcclusionBatches[readyOcclusionBatches.Count() - 1];
-        readyOcclusionBatches.RemoveFast(readyOcclusionBatches.Count() - 1);
-
-        LeaveSpinLock(lock);
-
         LoadBatch(batch);
 
         rays = batch->rays;
         rayCount = (uint)batch->batchTail;
+        RayBatchCategory category = batch->category;
+        BufferPool_Release(&occlusionBatchPool, batch);
 
-        if(batch->category == PositiveX || batch->category == NegativeX) {
-            SortRaysInternal((OcclusionRaySortX*)rays, rayCount);
-        }
-        else if(batch->category == PositiveY || batch->category == NegativeY) {
-            SortRaysInternal((OcclusionRaySortY*)rays, rayCount);
-        }
-        else {
-            SortRaysInternal((OcclusionRaySortZ*)rays, rayCount);
-        }
+        SortRays(rays, rayCount, category);
 
         Atomic::AddU64(&totalEntriesConsumed, rayCount);
+        Atomic::AddU64(remote ? &remoteEntriesConsumed : &localEntriesConsumed, rayCount);
 
         return true;
     }
@@ -792,38 +835,29 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FreeRays(OcclusionRay* rays)
     {
-        FreeAligned_(rays);
+        BufferPool_Release(&occlusionRayPool, rays);
     }
 
     //=================================================================================================================================
     bool PathTracingBatcher::GetSortedHits(HitParameters*& hits, uint& hitCount)
     {
-        // -- Check before locking to see if it's possible to claim a batch.
-        if(readyHitBatches.Count() == 0) {
+        bool remote = false;
+        HitBatch* batch = ClaimReadyBatch(readyHitBatches, remote);
+        if(batch == nullptr) {
             return false;
         }
 
-        EnterSpinLock(lock);
-
-        // -- Check again to make sure another thread didn't claim it before we could enter the lock
-        if(readyHitBatches.Count() == 0) {
-            LeaveSpinLock(lock);
-            return false;
-        }
-
-        HitBatch* batch = readyHitBatches[readyHitBatches.Count() - 1];
-        readyHitBatches.RemoveFast(readyHitBatches.Count() - 1);
-
-        LeaveSpinLock(lock);
-
         LoadBatch(batch);
 
-        hits = batch->hits;
         hitCount = (uint)batch->batchTail;
+        hits = (HitParameters*)BufferPool_Acquire(&hitPool);
+        SortHitsByShadingKey(batch->hits, hitCount, hits);
 
-        QuickSort(hits, hitCount);
+        BufferPool_Release(&hitPool, batch->hits);
+        BufferPool_Release(&hitBatchPool, batch);
 
         Atomic::AddU64(&totalEntriesConsumed, hitCount);
+        Atomic::AddU64(remote ? &remoteEntriesConsumed : &localEntriesConsumed, hitCount);
 
         return true;
     }
@@ -831,7 +865,7 @@ namespace Selas
     //=================================================================================================================================
     void PathTracingBatcher::FreeHits(HitParameters* hits)
     {
-        FreeAligned_(hits);
+        BufferPool_Release(&hitPool, hits);
     }
 
     //=================================================================================================================================
@@ -839,4 +873,11 @@ namespace Selas
     {
         return (totalEntriesConsumed == totalEntriesAdded);
     }
+
+    //=================================================================================================================================
+    void PathTracingBatcher::NodeTraffic(uint64& localEntries, uint64& remoteEntries)
+    {
+        localEntries = localEntriesConsumed;
+        remoteEntries = remoteEntriesConsumed;
+    }
 }
@@ -8,6 +8,8 @@
 #include "GeometryLib/Ray.h"
 #include "ContainersLib/CArray.h"
 #include "MathLib/FloatStructs.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/ArenaAllocation.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
@@ -28,6 +30,10 @@ namespace Selas
         uint32 diracScatterOnly : 1;
         uint32 unused           : 2;
 
+        // -- Together with index these key the sampler so a path's random numbers do not depend on who shades it
+        uint32 sampleIndex      : 24;
+        uint32 bounce           : 8;
+
         float  error;
     };
 
@@ -51,37 +57,64 @@ namespace Selas
         RayBatchCategoryCount
     };
 
+    // -- The sorts applied to batches as they are handed out. Rays are ordered along the axis of their category and hits by
+    // -- shading key. sorted must hold hitCount hits.
+    void SortRays(DeferredRay* rays, uint rayCount, RayBatchCategory category);
+    void SortRays(OcclusionRay* rays, uint rayCount, RayBatchCategory category);
+    void SortHitsByShadingKey(const HitParameters* hits, uint hitCount, HitParameters* sorted);
+
+    // -- Batches are filled and queued per job system NUMA node. Threads take ready batches from their own node before looking
+    // -- at the others so rays produced on one socket are mostly traced there. Without node queues batches are still filled
+    // -- per node but every ready batch goes into one queue that all threads share.
     class PathTracingBatcher
     {
     private:
         void* lock;
         int64 batchIndex;
-        Align_(64) DeferredBatch* currentDeferred[RayBatchCategoryCount];
-        Align_(64) OcclusionBatch* currentOcclusion[RayBatchCategoryCount];
-        Align_(64) HitBatch* currentHits;
+        uint  nodeCount;
+        uint  queueCount;
+        bool  nodeQueues;
+        Align_(64) DeferredBatch* currentDeferred[MaxNumaNodeCount_][RayBatchCategoryCount];
+        Align_(64) OcclusionBatch* currentOcclusion[MaxNumaNodeCount_][RayBatchCategoryCount];
+        Align_(64) HitBatch* currentHits[MaxNumaNodeCount_];
 
-        CArray<DeferredBatch*>  deferredBatches;
-        CArray<DeferredBatch*>  readyDeferredBatches;
-        CArray<OcclusionBatch*> occlusionBatches;
-        CArray<OcclusionBatch*> readyOcclusionBatches;
-        CArray<HitBatch*>       hitBatches;
-        CArray<HitBatch*>       readyHitBatches;
+        CArray<DeferredBatch*>  readyDeferredBatches[MaxNumaNodeCount_];
+        CArray<OcclusionBatch*> readyOcclusionBatches[MaxNumaNodeCount_];
+        CArray<HitBatch*>       readyHitBatches[MaxNumaNodeCount_];
 
         int64 rayBatchCapacity;
         int64 hitBatchCapacity;
+
+        // -- Batches are read back into and sorted into pooled buffers so a frame doesn't hit the system allocator
+        BufferPool deferredRayPool;
+        BufferPool occlusionRayPool;
+        BufferPool hitPool;
+
+        // -- Batch objects are recycled once their entries are handed out so a frame only creates new ones while the number
+        // -- in flight grows
+        BufferPool deferredBatchPool;
+        BufferPool occlusionBatchPool;
+        BufferPool hitBatchPool;
         
         uint64 totalEntriesAdded;
         uint64 totalEntriesConsumed;
+        uint64 localEntriesConsumed;
+        uint64 remoteEntriesConsumed;
 
-        DeferredBatch* AllocateRayBatch(RayBatchCategory category);
+        uint ReadyQueue(uint node);
+
+        template<typename Batch_>
+        Batch_* ClaimReadyBatch(CArray<Batch_*>* readyBatches, bool& remote);
+
+        DeferredBatch* AllocateRayBatch(RayBatchCategory category, uint node);
         void FlushCompletedBatch(DeferredBatch* batch);
         void LoadBatch(DeferredBatch* batch);
 
-        OcclusionBatch* AllocateOcclusionBatch(RayBatchCategory category);
+        OcclusionBatch* AllocateOcclusionBatch(RayBatchCategory category, uint node);
         void FlushCompletedBatch(OcclusionBatch* batch);
         void LoadBatch(OcclusionBatch* batch);
 
-        HitBatch* AllocateHitBatch();
+        HitBatch* AllocateHitBatch(uint node);
         void FlushCompletedBatch(HitBatch* batch);
         void LoadBatch(HitBatch* batch);
 
@@ -90,7 +123,7 @@ namespace Selas
         PathTracingBatcher();
         ~PathTracingBatcher();
 
-        void Initialize(uint rayBatchCapacity, uint hitBatchCapacity);
+        void Initialize(uint rayBatchCapacity, uint hitBatchCapacity, bool nodeQueues = true);
         void Shutdown();
 
         void AddUnsortedDeferredRay(const DeferredRay& ray);
@@ -109,5 +142,8 @@ namespace Selas
         void FreeHits(HitParameters* hits);
 
         bool Empty();
+
+        // -- Entries consumed on the node that produced them and on some other node
+        void NodeTraffic(uint64& localEntries, uint64& remoteEntries);
     };
 }
\ No newline at end of file
@@ -9,11 +9,14 @@
 #include "SceneLib/ModelResource.h"
 #include "SceneLib/GeometryCache.h"
 #include "TextureLib/TextureFiltering.h"
+#include "TextureLib/DisplacementTile.h"
 #include "TextureLib/TextureResource.h"
 #include "GeometryLib/Ray.h"
 #include "GeometryLib/CoordinateSystem.h"
 #include "MathLib/FloatFuncs.h"
 #include "MathLib/ColorSpace.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/RenderStats.h"
 
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
@@ -141,15 +144,14 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    bool CalculateSurfaceParams(const GIIntegratorContext* context, const HitParameters* __restrict hit,
-                                SurfaceParameters& surface)
+    static const ModelGeometryUserData* CalculateSurfaceGeometry(const GIIntegratorContext* context,
+                                                                 const HitParameters* __restrict hit,
+                                                                 SurfaceParameters& surface, float2& uvs)
     {
         float4x4 localToWorld;
         ModelGeometryUserData* modelData;
         ModelDataFromRayIds(context->scene, hit->instId, hit->geomId, localToWorld, modelData);
 
-        TextureCache* textureCache = context->textureCache;
-        GeometryCache* geometryCache = context->geometryCache;
         const MaterialResourceData* materialResource = modelData->material;
 
         bool needsGeometry = modelData->flags & (HasNormals | HasTangents | HasUvs);
@@ -183,36 +185,17 @@ namespace Selas
             MakeOrthogonalCoordinateSystem(n, &t, &b);
         }
 
-        Align_(16) float2 uvs = float2(0.0f, 0.0f);
+        Align_(16) float2 interpolatedUvs = float2(0.0f, 0.0f);
         if(modelData->flags & HasUvs) {
             rtcInterpolate0(modelData->rtcGeometry, hit->primId, hit->baryCoords.x, hit->baryCoords.y,
-                            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 2, &uvs.x, 2);
+                            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 2, &interpolatedUvs.x, 2);
         }
+        uvs = interpolatedUvs;
 
         if(needsGeometry) {
             context->geometryCache->FinishUsingSubceneGeometry(modelData->subscene);
         }
 
-        if(materialResource->flags & eUsesPtex) {
-            PtexTexture* texture = textureCache->FetchPtex(modelData->baseColorTextureHandle);
-
-            Ptex::PtexFilter::Options opts(Ptex::PtexFilter::FilterType::f_bspline);
-            Ptex::PtexFilter* filter = Ptex::PtexFilter::getFilter(texture, opts);
-
-            float3 sample;
-            filter->eval(&sample.x, 0, 3, hit->primId, hit->baryCoords.x, hit->baryCoords.y, 0, 0, 0, 0);
-            surface.baseColor = Pow(sample, 2.2f);
-
-            filter->release();
-            texture->release();
-        }
-        else {
-            const TextureResource* baseColorTexture = textureCache->FetchTexture(modelData->baseColorTextureHandle);
-            surface.baseColor = SampleTextureFloat3(baseColorTexture, uvs, true, materialResource->baseColor);
-            surface.baseColor = Pow(surface.baseColor, 2.2f);
-            textureCache->ReleaseTexture(modelData->baseColorTextureHandle);
-        }
-
         // -- Calculate tangent space transforms
         float3x3 tangentToWorld = MakeFloat3x3(t, n, b);
 
@@ -243,47 +226,313 @@ namespace Selas
         surface.relativeIOR = ((materialResource->flags & eTransparent) && Dot(hit->view, n) < 0.0f) 
                             ? surface.ior : 1.0f / surface.ior;
 
+        return modelData;
+    }
+
+    //=============================================================================================================================
+    static float3 SamplePtexBaseColor(const GIIntegratorContext* context, const ModelGeometryUserData* modelData,
+                                      const HitParameters* __restrict hit)
+    {
+        PtexTexture* texture = context->textureCache->FetchPtex(modelData->baseColorTextureHandle);
+
+        Ptex::PtexFilter::Options opts(Ptex::PtexFilter::FilterType::f_bspline);
+        Ptex::PtexFilter* filter = Ptex::PtexFilter::getFilter(texture, opts);
+
+        float3 sample;
+        filter->eval(&sample.x, 0, 3, hit->primId, hit->baryCoords.x, hit->baryCoords.y, 0, 0, 0, 0);
+
+        filter->release();
+        texture->release();
+
+        return Pow(sample, 2.2f);
+    }
+
+    //=============================================================================================================================
+    static float3 BaseColorFromFilteredSample(TextureResourceData::TextureDataType format, float4 sample)
+    {
+        // -- Matches SampleTextureFloat3 with sRGB conversion enabled
+        if(format == TextureResourceData::Float) {
+            float value = Math::SrgbToLinearPrecise(sample.x);
+            return float3(value, value, value);
+        }
+        else if(format == TextureResourceData::Float3 || format == TextureResourceData::Float4) {
+            return Math::SrgbToLinearPrecise(sample.XYZ());
+        }
+
+        Assert_(false);
+        return float3(0.0f);
+    }
+
+    //=============================================================================================================================
+    float3 SampleBaseColor(const TextureResource* texture, float2 uvs, float3 defaultColor)
+    {
+        return Pow(SampleTextureFloat3(texture, uvs, true, defaultColor), 2.2f);
+    }
+
+    //=============================================================================================================================
+    void SampleBaseColors(const TextureResource* texture, const float2* uvs, uint count, float3* baseColors)
+    {
+        float4 samples[TextureBatchWidth];
+        TextureFiltering::TriangleBatch(texture->data, 0, uvs, count, samples);
+
+        for(uint scan = 0; scan < count; ++scan) {
+            baseColors[scan] = Pow(BaseColorFromFilteredSample(texture->data->format, samples[scan]), 2.2f);
+        }
+    }
+
+    //=============================================================================================================================
+    static void SampleBaseColorBatch(const GIIntegratorContext* context, const ModelGeometryUserData* const* modelDatas,
+                                     const float2* uvs, uint count, SurfaceParameters* surfaces)
+    {
+        // -- All entries share the same base color texture handle
+        TextureCache* textureCache = context->textureCache;
+        TextureHandle handle = modelDatas[0]->baseColorTextureHandle;
+
+        const TextureResource* texture = textureCache->FetchTexture(handle);
+        if(texture == nullptr) {
+            for(uint scan = 0; scan < count; ++scan) {
+                surfaces[scan].baseColor = Pow(modelDatas[scan]->material->baseColor, 2.2f);
+            }
+            return;
+        }
+
+        float3 baseColors[TextureBatchWidth];
+        SampleBaseColors(texture, uvs, count, baseColors);
+        for(uint scan = 0; scan < count; ++scan) {
+            surfaces[scan].baseColor = baseColors[scan];
+        }
+
+        textureCache->ReleaseTexture(handle);
+    }
+
+    //=============================================================================================================================
+    bool CalculateSurfaceParams(const GIIntegratorContext* context, const HitParameters* __restrict hit,
+                                SurfaceParameters& surface)
+    {
+        float2 uvs;
+        const ModelGeometryUserData* modelData = CalculateSurfaceGeometry(context, hit, surface, uvs);
+        const MaterialResourceData* materialResource = modelData->material;
+
+        if(materialResource->flags & eUsesPtex) {
+            surface.baseColor = SamplePtexBaseColor(context, modelData, hit);
+        }
+        else {
+            TextureCache* textureCache = context->textureCache;
+
+            const TextureResource* baseColorTexture = textureCache->FetchTexture(modelData->baseColorTextureHandle);
+            surface.baseColor = SampleBaseColor(baseColorTexture, uvs, materialResource->baseColor);
+            textureCache->ReleaseTexture(modelData->baseColorTextureHandle);
+        }
+
         return true;
     }
 
+    //=============================================================================================================================
+    void CalculateSurfaceParams(const GIIntegratorContext* context, const HitParameters* __restrict hits, uint hitCount,
+                                SurfaceParameters* surfaces)
+    {
+        for(uint batchStart = 0; batchStart < hitCount; batchStart += TextureBatchWidth) {
+            uint batchSize = Min<uint>(hitCount - batchStart, TextureBatchWidth);
+
+            const HitParameters* batchHits = hits + batchStart;
+            SurfaceParameters* batchSurfaces = surfaces + batchStart;
+
+            const ModelGeometryUserData* modelDatas[TextureBatchWidth];
+            float2 uvs[TextureBatchWidth];
+            for(uint scan = 0; scan < batchSize; ++scan) {
+                modelDatas[scan] = CalculateSurfaceGeometry(context, &batchHits[scan], batchSurfaces[scan], uvs[scan]);
+            }
+
+            // -- Sorted hit batches tend to produce runs that sample the same texture so filter each run together
+            uint runStart = 0;
+            while(runStart < batchSize) {
+                const ModelGeometryUserData* runData = modelDatas[runStart];
+
+                if(runData->material->flags & eUsesPtex) {
+                    batchSurfaces[runStart].baseColor = SamplePtexBaseColor(context, runData, &batchHits[runStart]);
+                    ++runStart;
+                    continue;
+                }
+
+                uint runEnd = runStart + 1;
+                while(runEnd < batchSize && (modelDatas[runEnd]->material->flags & eUsesPtex) == 0
+                      && modelDatas[runEnd]->baseColorTextureHandle == runData->baseColorTextureHandle) {
+                    ++runEnd;
+                }
+
+                SampleBaseColorBatch(context, modelDatas + runStart, uvs + runStart, runEnd - runStart,
+                                     batchSurfaces + runStart);
+                runStart = runEnd;
+            }
+        }
+    }
+
     //=============================================================================================================================
     bool CalculatePassesAlphaTest(const ModelGeometryUserData* geomData, uint32 geomId, uint32 primId, float2 baryCoords)
     {
-        // JSTODO - Need access to the cache
-        return true;
+        Unused_(geomId);
 
-        //const Material* material = geomData->material;
-        //Assert_(material->resource->flags & MaterialFlags::eAlphaTested);
+        if(geomData->alphaTestTexture == nullptr) {
+            return true;
+        }
 
-        //Align_(16) float2 uvs = float2::Zero_;
-        //if(geomData->flags & HasUvs) {
-        //    rtcInterpolate0(geomData->rtcGeometry, primId, baryCoords.x, baryCoords.y,
-        //                    RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 2, &uvs.x, 2);
-        //}
+        Align_(16) float2 uvs = float2::Zero_;
+        if(geomData->flags & HasUvs) {
+            rtcInterpolate0(geomData->rtcGeometry, primId, baryCoords.x, baryCoords.y,
+                            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 2, &uvs.x, 2);
+        }
 
-        //static const float kAlphaTestCutoff = 0.5f;
-        //return SampleTextureOpacity(nullptr, uvs, material->baseColorTextureIndex) > kAlphaTestCutoff;
+        return TextureFiltering::CoverageTest(geomData->alphaTestTexture, uvs);
     }
 
     //=============================================================================================================================
-    float CalculateDisplacement(const ModelGeometryUserData* userData, RTCGeometry rtcGeometry, uint32 primId, float2 barys)
+    void CalculateDisplacements(const ModelGeometryUserData* geomData, RTCGeometry rtcGeometry, uint32 primId, const float* us,
+                                const float* vs, uint count, float* displacements)
     {
-        // JSTODO - Need access to the cache
-        return 0.0f;
+        Assert_(count <= TextureBatchWidth);
 
-        //Align_(16) float2 uvs = float2::Zero_;
-        //if(userData->flags & HasUvs) {
-        //    rtcInterpolate0(rtcGeometry, primId, barys.x, barys.y, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 2, &uvs.x, 2);
-        //}
+        if(geomData->displacement == nullptr || (geomData->flags & HasUvs) == 0) {
+            Memory::Zero(displacements, count * sizeof(float));
+            return;
+        }
 
-        //const MaterialResource* material = userData->material;
+        Align_(32) int32 valid[TextureBatchWidth];
+        Align_(32) uint32 primIds[TextureBatchWidth];
+        for(uint scan = 0; scan < count; ++scan) {
+            valid[scan] = -1;
+            primIds[scan] = primId;
+        }
+
+        // -- rtcInterpolateN writes SoA so the us land in the first count entries and the vs in the next count
+        Align_(32) float uvs[2 * TextureBatchWidth];
+
+        RTCInterpolateNArguments args;
+        Memory::Zero(&args, sizeof(args));
+        args.geometry = rtcGeometry;
+        args.valid = valid;
+        args.primIDs = primIds;
+        args.u = us;
+        args.v = vs;
+        args.N = (uint32)count;
+        args.bufferType = RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE;
+        args.bufferSlot = 2;
+        args.P = uvs;
+        args.valueCount = 2;
+        rtcInterpolateN(&args);
+
+        SampleDisplacementTile(geomData->displacement, uvs, uvs + count, count, displacements);
+    }
 
-        //float displacement = SampleTextureFloat(nullptr, uvs, material->scalarAttributeTextureIndices[eDisplacement], false, 0.0f);
-        //if(material->flags & eInvertDisplacement) {
-        //    displacement = 1.0f - displacement;
-        //}
+    //=============================================================================================================================
+    uint32 CalculateShadingKey(const GIIntegratorContext* context, const HitParameters* hit)
+    {
+        float4x4 localToWorld;
+        ModelGeometryUserData* modelData;
+        ModelDataFromRayIds(context->scene, hit->instId, hit->geomId, localToWorld, modelData);
+
+        // -- shader:2 | base color texture:20 | geometry:10. Ptex materials have no texture handle and are grouped by
+        // -- geometry instead.
+        uint32 shader = (uint32)modelData->material->shader & 0x3;
+        uint32 texture = modelData->baseColorTextureHandle.Hash() & 0xFFFFF;
+        uint32 geometry = (uint32)hit->geomId & 0x3FF;
+
+        return (shader << 30) | (texture << 10) | geometry;
+    }
+
+    //=============================================================================================================================
+    void AddShadingStats(const SurfaceParameters* surfaces, uint count, uint64 elapsedTimestamps)
+    {
+        static_assert(eShaderCount <= MaxShadingStatSlots_, "Shaders need a render stats slot each");
+
+        if(count == 0) {
+            return;
+        }
+
+        uint shaderHits[eShaderCount] = { 0 };
+        for(uint scan = 0; scan < count; ++scan) {
+            ++shaderHits[surfaces[scan].shader];
+        }
+
+        for(uint scan = 0; scan < eShaderCount; ++scan) {
+            if(shaderHits[scan] > 0) {
+                RenderStats_AddShading(scan, shaderHits[scan], elapsedTimestamps * shaderHits[scan] / count);
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    void GatherSurfaceParams8(const SurfaceParameters* surfaces, uint count, SurfaceParameters8& batch)
+    {
+        Assert_(count > 0 && count <= Float8LaneCount_);
+
+        enum
+        {
+            eR0X, eR0Y, eR0Z, eR1X, eR1Y, eR1Z, eR2X, eR2Y, eR2Z,
+            eBaseR, eBaseG, eBaseB, eTransR, eTransG, eTransB,
+            eSheen, eSheenTint, eClearcoat, eClearcoatGloss, eMetallic, eSpecTrans, eDiffTrans, eFlatness, eAnisotropic,
+            eRelativeIor, eSpecularTint, eRoughness, eScatterDistance, eIor,
+
+            eFieldCount
+        };
+
+        Align_(32) float fields[eFieldCount][Float8LaneCount_];
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            const SurfaceParameters& surface = surfaces[scan < count ? scan : 0];
+
+            fields[eR0X][scan] = surface.worldToTangent.r0.x;
+            fields[eR0Y][scan] = surface.worldToTangent.r0.y;
+            fields[eR0Z][scan] = surface.worldToTangent.r0.z;
+            fields[eR1X][scan] = surface.worldToTangent.r1.x;
+            fields[eR1Y][scan] = surface.worldToTangent.r1.y;
+            fields[eR1Z][scan] = surface.worldToTangent.r1.z;
+            fields[eR2X][scan] = surface.worldToTangent.r2.x;
+            fields[eR2Y][scan] = surface.worldToTangent.r2.y;
+            fields[eR2Z][scan] = surface.worldToTangent.r2.z;
+            fields[eBaseR][scan] = surface.baseColor.x;
+            fields[eBaseG][scan] = surface.baseColor.y;
+            fields[eBaseB][scan] = surface.baseColor.z;
+            fields[eTransR][scan] = surface.transmittanceColor.x;
+            fields[eTransG][scan] = surface.transmittanceColor.y;
+            fields[eTransB][scan] = surface.transmittanceColor.z;
+            fields[eSheen][scan] = surface.sheen;
+            fields[eSheenTint][scan] = surface.sheenTint;
+            fields[eClearcoat][scan] = surface.clearcoat;
+            fields[eClearcoatGloss][scan] = surface.clearcoatGloss;
+            fields[eMetallic][scan] = surface.metallic;
+            fields[eSpecTrans][scan] = surface.specTrans;
+            fields[eDiffTrans][scan] = surface.diffTrans;
+            fields[eFlatness][scan] = surface.flatness;
+            fields[eAnisotropic][scan] = surface.anisotropic;
+            fields[eRelativeIor][scan] = surface.relativeIOR;
+            fields[eSpecularTint][scan] = surface.specularTint;
+            fields[eRoughness][scan] = surface.roughness;
+            fields[eScatterDistance][scan] = surface.scatterDistance;
+            fields[eIor][scan] = surface.ior;
+
+            batch.shaders[scan] = surface.shader;
+        }
 
-        //return material->scalarAttributeValues[eDisplacement] * displacement;
+        batch.worldToTangentR0   = float3_8(Load8(fields[eR0X]), Load8(fields[eR0Y]), Load8(fields[eR0Z]));
+        batch.worldToTangentR1   = float3_8(Load8(fields[eR1X]), Load8(fields[eR1Y]), Load8(fields[eR1Z]));
+        batch.worldToTangentR2   = float3_8(Load8(fields[eR2X]), Load8(fields[eR2Y]), Load8(fields[eR2Z]));
+        batch.baseColor          = float3_8(Load8(fields[eBaseR]), Load8(fields[eBaseG]), Load8(fields[eBaseB]));
+        batch.transmittanceColor = float3_8(Load8(fields[eTransR]), Load8(fields[eTransG]), Load8(fields[eTransB]));
+        batch.sheen              = Load8(fields[eSheen]);
+        batch.sheenTint          = Load8(fields[eSheenTint]);
+        batch.clearcoat          = Load8(fields[eClearcoat]);
+        batch.clearcoatGloss     = Load8(fields[eClearcoatGloss]);
+        batch.metallic           = Load8(fields[eMetallic]);
+        batch.specTrans          = Load8(fields[eSpecTrans]);
+        batch.diffTrans          = Load8(fields[eDiffTrans]);
+        batch.flatness           = Load8(fields[eFlatness]);
+        batch.anisotropic        = Load8(fields[eAnisotropic]);
+        batch.relativeIOR        = Load8(fields[eRelativeIor]);
+        batch.specularTint       = Load8(fields[eSpecularTint]);
+        batch.roughness          = Load8(fields[eRoughness]);
+        batch.scatterDistance    = Load8(fields[eScatterDistance]);
+        batch.ior                = Load8(fields[eIor]);
+        batch.surfaces           = surfaces;
+        batch.count              = (uint32)count;
     }
 
     //=============================================================================================================================
@@ -6,6 +6,7 @@
 
 #include "SceneLib/ModelResource.h"
 #include "MathLib/FloatStructs.h"
+#include "MathLib/SimdFloat8.h"
 #include "SystemLib/BasicTypes.h"
 
 namespace Selas
@@ -14,6 +15,7 @@ namespace Selas
     struct HitParameters;
     struct ModelResource;
     struct MaterialResourceData;
+    struct TextureResource;
 
     struct SurfaceParameters
     {
@@ -48,9 +50,58 @@ namespace Selas
         uint32 lightSetIndex;
     };
 
+    //=============================================================================================================================
+    // -- Structure of arrays copy of up to eight SurfaceParameters holding what the batched bsdf functions read. Lanes past
+    // -- count repeat the first surface.
+    struct SurfaceParameters8
+    {
+        // -- Rows of worldToTangent
+        float3_8 worldToTangentR0;
+        float3_8 worldToTangentR1;
+        float3_8 worldToTangentR2;
+
+        float3_8 baseColor;
+        float3_8 transmittanceColor;
+        float8 sheen;
+        float8 sheenTint;
+        float8 clearcoat;
+        float8 clearcoatGloss;
+        float8 metallic;
+        float8 specTrans;
+        float8 diffTrans;
+        float8 flatness;
+        float8 anisotropic;
+        float8 relativeIOR;
+        float8 specularTint;
+        float8 roughness;
+        float8 scatterDistance;
+        float8 ior;
+
+        // -- The surfaces the batch was gathered from for shaders without a batched implementation
+        const SurfaceParameters* surfaces;
+        uint32 count;
+        ShaderType shaders[Float8LaneCount_];
+    };
+
     bool CalculateSurfaceParams(const GIIntegratorContext* context, const HitParameters* hit, SurfaceParameters& surface);
+    void CalculateSurfaceParams(const GIIntegratorContext* context, const HitParameters* hits, uint hitCount,
+                                SurfaceParameters* surfaces);
     bool CalculatePassesAlphaTest(const ModelGeometryUserData* geomData, uint32 geomId, uint32 primitiveId, float2 baryCoords);
-    float CalculateDisplacement(const ModelGeometryUserData* geomData, RTCGeometry rtcGeometry, uint32 primId, float2 barys);
+    void CalculateDisplacements(const ModelGeometryUserData* geomData, RTCGeometry rtcGeometry, uint32 primId, const float* us,
+                                const float* vs, uint count, float* displacements);
+
+    // -- Linear base colors from a base color texture. The batched version filters up to TextureBatchWidth lookups into the
+    // -- same texture together and the texture must not be null.
+    float3 SampleBaseColor(const TextureResource* texture, float2 uvs, float3 defaultColor);
+    void SampleBaseColors(const TextureResource* texture, const float2* uvs, uint count, float3* baseColors);
+
+    // -- Packs the shader, base color texture and geometry of a hit so sorting on it groups hits that shade alike
+    uint32 CalculateShadingKey(const GIIntegratorContext* context, const HitParameters* hit);
+
+    void GatherSurfaceParams8(const SurfaceParameters* surfaces, uint count, SurfaceParameters8& batch);
+
+    // -- Splits the time spent shading a batch between the shaders of its surfaces for the render stats
+    void AddShadingStats(const SurfaceParameters* surfaces, uint count, uint64 elapsedTimestamps);
 
     float3 GeometricTangent(const SurfaceParameters& surface);
     float3 GeometricNormal(const SurfaceParameters& surface);
@@ -50,6 +50,9 @@ namespace Selas
                 return EvaluateDisney(surface, v, l, false, forwardPdfW, reversePdfW);
             }
             else if (surface.shader == eDiracTransparent) {
+                // -- A dirac lobe is never hit by an arbitrary direction
+                forwardPdfW = 0.0f;
+                reversePdfW = 0.0f;
                 return float3::Zero_;
             }
             else {
@@ -59,4 +62,96 @@ namespace Selas
 
         return float3::Zero_;
     }
-}
\ No newline at end of file
+
+    //=============================================================================================================================
+    static float8 ThinLanes(const SurfaceParameters8& surfaces)
+    {
+        Align_(32) float thin[Float8LaneCount_];
+        for(uint scan = 0; scan < Float8LaneCount_; ++scan) {
+            thin[scan] = 0.0f;
+        }
+        for(uint scan = 0; scan < surfaces.count; ++scan) {
+            thin[scan] = surfaces.shaders[scan] == eDisneyThin ? 1.0f : 0.0f;
+        }
+
+        return Load8(thin) != 0.0f;
+    }
+
+    //=============================================================================================================================
+    static bool AnyDisney(const SurfaceParameters8& surfaces)
+    {
+        for(uint scan = 0; scan < surfaces.count; ++scan) {
+            if(surfaces.shaders[scan] == eDisneyThin || surfaces.shaders[scan] == eDisneySolid) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //=============================================================================================================================
+    void SampleBsdfFunction8(const SurfaceParameters8& surfaces, const float3* v, const BsdfRandoms8& randoms,
+                             BsdfSample* samples, bool* successes)
+    {
+        #if LambertAllTheThings_
+            for(uint scan = 0; scan < surfaces.count; ++scan) {
+                successes[scan] = SampleLambert(randoms.u0[scan], randoms.u1[scan], surfaces.surfaces[scan], v[scan],
+                                                samples[scan]);
+            }
+        #else
+            if(AnyDisney(surfaces)) {
+                float8 laneRandoms[] = { Load8(randoms.lobe), Load8(randoms.u0), Load8(randoms.u1), Load8(randoms.u2) };
+                SampleDisney8(surfaces, Load8(v, surfaces.count), ThinLanes(surfaces), laneRandoms, samples, successes);
+            }
+
+            // -- Shaders without a batched implementation overwrite their lanes
+            for(uint scan = 0; scan < surfaces.count; ++scan) {
+                if(surfaces.shaders[scan] == eDiracTransparent) {
+                    samples[scan] = BsdfSample();
+                    successes[scan] = SampleDiracTransparent(randoms.lobe[scan], surfaces.surfaces[scan], v[scan],
+                                                             samples[scan]);
+                }
+                else {
+                    Assert_(surfaces.shaders[scan] == eDisneyThin || surfaces.shaders[scan] == eDisneySolid);
+                }
+            }
+        #endif
+    }
+
+    //=============================================================================================================================
+    void EvaluateBsdf8(const SurfaceParameters8& surfaces, const float3* v, const float3* l, float3* reflectances,
+                       float* forwardPdfs, float* reversePdfs)
+    {
+        #if LambertAllTheThings_
+            for(uint scan = 0; scan < surfaces.count; ++scan) {
+                reflectances[scan] = EvaluateLambert(surfaces.surfaces[scan], v[scan], l[scan], forwardPdfs[scan],
+                                                     reversePdfs[scan]);
+            }
+        #else
+            if(AnyDisney(surfaces)) {
+                float3_8 reflectance;
+                float8 forwardPdf;
+                float8 reversePdf;
+                EvaluateDisney8(surfaces, Load8(v, surfaces.count), Load8(l, surfaces.count), ThinLanes(surfaces),
+                                reflectance, forwardPdf, reversePdf);
+
+                Align_(32) float forward[Float8LaneCount_];
+                Align_(32) float reverse[Float8LaneCount_];
+                Store8(forward, forwardPdf);
+                Store8(reverse, reversePdf);
+                Store8(reflectance, reflectances, surfaces.count);
+                for(uint scan = 0; scan < surfaces.count; ++scan) {
+                    forwardPdfs[scan] = forward[scan];
+                    reversePdfs[scan] = reverse[scan];
+                }
+            }
+
+            for(uint scan = 0; scan < surfaces.count; ++scan) {
+                if(surfaces.shaders[scan] == eDiracTransparent) {
+                    reflectances[scan] = float3::Zero_;
+                    forwardPdfs[scan] = 0.0f;
+                    reversePdfs[scan] = 0.0f;
+                }
+            }
+        #endif
+    }
+}
@@ -11,7 +11,24 @@ namespace Selas
 {
     class CSampler;
     struct SurfaceParameters;
+    struct SurfaceParameters8;
 
     bool SampleBsdfFunction(CSampler* sampler, const SurfaceParameters& surface, float3 v, BsdfSample& sample);
     float3 EvaluateBsdf(const SurfaceParameters& surface, float3 v, float3 l, float& forwardPdf, float& reversePdf);
+
+    //=============================================================================================================================
+    // -- Random numbers for one batched bsdf sample per lane. lobe picks the lobe and the u values are consumed by it in order.
+    struct BsdfRandoms8
+    {
+        float lobe[8];
+        float u0[8];
+        float u1[8];
+        float u2[8];
+    };
+
+    // -- Batched versions of the above that shade surfaces.count lanes at once. Lanes may use different shaders.
+    void SampleBsdfFunction8(const SurfaceParameters8& surfaces, const float3* v, const BsdfRandoms8& randoms,
+                             BsdfSample* samples, bool* successes);
+    void EvaluateBsdf8(const SurfaceParameters8& surfaces, const float3* v, const float3* l, float3* reflectances,
+                       float* forwardPdfs, float* reversePdfs);
 }
\ No newline at end of file
@@ -0,0 +1,326 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/ArenaAllocation.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/MinMax.h"
+
+#define ArenaBlockSize_         (1024 * 1024)
+#define ArenaBlockHeaderSize_   CacheLineSize_
+
+namespace Selas
+{
+    static cpointer AllocationTagNames[] = {
+        "General",
+        "Batches",
+        "Sorting",
+        "Framebuffer"
+    };
+    static_assert(sizeof(AllocationTagNames) / sizeof(AllocationTagNames[0]) == AllocationTagCount,
+                  "Missing allocation tag name");
+
+    //=============================================================================================================================
+    struct ArenaBlock
+    {
+        ArenaBlock* next;
+        uint64      size;
+        uint64      used;
+    };
+
+    //=============================================================================================================================
+    struct ThreadArena
+    {
+        ArenaBlock*        first;
+        // -- Null until the first allocation and after a reset or a release to a mark taken before the first block
+        ArenaBlock*        current;
+        int64              openMarks;
+        ThreadArena*       nextArena;
+
+        // -- Only written by the owning thread. Gathering stats while threads are running gives approximate totals.
+        AllocationTagStats tags[AllocationTagCount];
+    };
+
+    static thread_local ThreadArena* threadArena = nullptr;
+
+    // -- Zero is unlocked so these are usable before anything has been initialized
+    static Align_(CacheLineSize_) uint8 registrySpinlock[CacheLineSize_];
+    static ThreadArena*       arenaList = nullptr;
+    static BufferPool*        poolList = nullptr;
+    static AllocationTagStats retiredPoolStats[AllocationTagCount];
+
+    //=============================================================================================================================
+    cpointer AllocationTagName(AllocationTag tag)
+    {
+        Assert_(tag < AllocationTagCount);
+        return AllocationTagNames[tag];
+    }
+
+    //=============================================================================================================================
+    static ThreadArena* GetThreadArena()
+    {
+        if(threadArena == nullptr) {
+            threadArena = New_(ThreadArena);
+            Memory::Zero(threadArena, sizeof(ThreadArena));
+
+            EnterSpinLock(registrySpinlock);
+            threadArena->nextArena = arenaList;
+            arenaList = threadArena;
+            LeaveSpinLock(registrySpinlock);
+        }
+
+        return threadArena;
+    }
+
+    //=============================================================================================================================
+    static ArenaBlock* NextBlock(ThreadArena* arena, uint64 size, AllocationTag tag)
+    {
+        // -- Blocks after the current one are unused after a release or reset so take the next one if the allocation fits
+        ArenaBlock* next = arena->current != nullptr ? arena->current->next : arena->first;
+        if(next != nullptr && next->size >= size) {
+            next->used = 0;
+            arena->current = next;
+            return next;
+        }
+
+        uint64 blockSize = Max<uint64>(ArenaBlockSize_, size);
+        ArenaBlock* block = (ArenaBlock*)AllocOnNode_((uint)(ArenaBlockHeaderSize_ + blockSize), CurrentNumaNode());
+        block->size = blockSize;
+        block->used = 0;
+
+        // -- Linked in after the current block so a smaller one that was skipped stays around for later
+        block->next = next;
+        if(arena->current != nullptr) {
+            arena->current->next = block;
+        }
+        else {
+            arena->first = block;
+        }
+        arena->current = block;
+
+        ++arena->tags[tag].globalAllocationCount;
+        arena->tags[tag].reservedBytes += blockSize;
+
+        return block;
+    }
+
+    //=============================================================================================================================
+    void* ThreadArena_Allocate(uint64 size, AllocationTag tag)
+    {
+        Assert_(tag < AllocationTagCount);
+
+        ThreadArena* arena = GetThreadArena();
+        uint64 alignedSize = (size + CacheLineSize_ - 1) & ~(uint64)(CacheLineSize_ - 1);
+
+        ArenaBlock* block = arena->current;
+        if(block == nullptr || block->used + alignedSize > block->size) {
+            block = NextBlock(arena, alignedSize, tag);
+        }
+
+        void* address = (uint8*)block + ArenaBlockHeaderSize_ + block->used;
+        block->used += alignedSize;
+
+        ++arena->tags[tag].allocationCount;
+        arena->tags[tag].allocatedBytes += size;
+
+        return address;
+    }
+
+    //=============================================================================================================================
+    ThreadArenaMark ThreadArena_Mark()
+    {
+        ThreadArena* arena = GetThreadArena();
+        ++arena->openMarks;
+
+        ThreadArenaMark mark;
+        mark.block = arena->current;
+        mark.used = arena->current != nullptr ? arena->current->used : 0;
+        return mark;
+    }
+
+    //=============================================================================================================================
+    void ThreadArena_Release(const ThreadArenaMark& mark)
+    {
+        ThreadArena* arena = threadArena;
+        Assert_(arena != nullptr);
+        Assert_(arena->openMarks > 0);
+
+        --arena->openMarks;
+        arena->current = (ArenaBlock*)mark.block;
+        if(arena->current != nullptr) {
+            Assert_(arena->current->used >= mark.used);
+            arena->current->used = mark.used;
+        }
+    }
+
+    //=============================================================================================================================
+    void ThreadArena_ResetAll()
+    {
+        EnterSpinLock(registrySpinlock);
+        for(ThreadArena* arena = arenaList; arena != nullptr; arena = arena->nextArena) {
+            Assert_(arena->openMarks == 0);
+            arena->current = nullptr;
+        }
+        LeaveSpinLock(registrySpinlock);
+    }
+
+    //=============================================================================================================================
+    void ThreadArena_ShutdownAll()
+    {
+        EnterSpinLock(registrySpinlock);
+        ThreadArena* arena = arenaList;
+        arenaList = nullptr;
+        LeaveSpinLock(registrySpinlock);
+
+        while(arena != nullptr) {
+            ThreadArena* nextArena = arena->nextArena;
+
+            ArenaBlock* block = arena->first;
+            while(block != nullptr) {
+                ArenaBlock* next = block->next;
+                FreeOnNode_(block);
+                block = next;
+            }
+
+            Delete_(arena);
+            arena = nextArena;
+        }
+
+        threadArena = nullptr;
+    }
+
+    //=============================================================================================================================
+    void BufferPool_Initialize(BufferPool* pool, uint64 bufferSize, AllocationTag tag)
+    {
+        Assert_(bufferSize >= sizeof(void*));
+        Assert_(tag < AllocationTagCount);
+
+        pool->bufferSize = bufferSize;
+        pool->tag = tag;
+        pool->freeBuffers = nullptr;
+        pool->outstanding = 0;
+        pool->acquireCount = 0;
+        pool->globalAllocationCount = 0;
+        CreateSpinLock(pool->spinlock);
+
+        EnterSpinLock(registrySpinlock);
+        pool->nextPool = poolList;
+        poolList = pool;
+        LeaveSpinLock(registrySpinlock);
+    }
+
+    //=============================================================================================================================
+    void BufferPool_Shutdown(BufferPool* pool)
+    {
+        AssertMsg_(pool->outstanding == 0, "Buffers were not returned to their pool");
+
+        EnterSpinLock(registrySpinlock);
+        for(BufferPool** link = &poolList; *link != nullptr; link = &(*link)->nextPool) {
+            if(*link == pool) {
+                *link = pool->nextPool;
+                break;
+            }
+        }
+
+        // -- Keep the pool's totals so the stats still cover it after it is gone
+        AllocationTagStats& retired = retiredPoolStats[pool->tag];
+        retired.allocationCount += pool->acquireCount;
+        retired.allocatedBytes += pool->acquireCount * pool->bufferSize;
+        retired.globalAllocationCount += pool->globalAllocationCount;
+        retired.reservedBytes += pool->globalAllocationCount * pool->bufferSize;
+        LeaveSpinLock(registrySpinlock);
+
+        void* buffer = pool->freeBuffers;
+        while(buffer != nullptr) {
+            void* next = *(void**)buffer;
+            FreeAligned_(buffer);
+            buffer = next;
+        }
+        pool->freeBuffers = nullptr;
+    }
+
+    //=============================================================================================================================
+    void* BufferPool_Acquire(BufferPool* pool)
+    {
+        EnterSpinLock(pool->spinlock);
+        ++pool->acquireCount;
+        ++pool->outstanding;
+
+        void* buffer = pool->freeBuffers;
+        if(buffer != nullptr) {
+            pool->freeBuffers = *(void**)buffer;
+            LeaveSpinLock(pool->spinlock);
+            return buffer;
+        }
+
+        ++pool->globalAllocationCount;
+        LeaveSpinLock(pool->spinlock);
+
+        return AllocAligned_((uint)pool->bufferSize, CacheLineSize_);
+    }
+
+    //=============================================================================================================================
+    void BufferPool_Release(BufferPool* pool, void* buffer)
+    {
+        Assert_(buffer != nullptr);
+
+        // -- Free buffers link through their first bytes
+        EnterSpinLock(pool->spinlock);
+        *(void**)buffer = pool->freeBuffers;
+        pool->freeBuffers = buffer;
+        --pool->outstanding;
+        LeaveSpinLock(pool->spinlock);
+    }
+
+    //=============================================================================================================================
+    static void AddTagStats(AllocationTagStats& total, const AllocationTagStats& stats)
+    {
+        total.allocationCount += stats.allocationCount;
+        total.allocatedBytes += stats.allocatedBytes;
+        total.globalAllocationCount += stats.globalAllocationCount;
+        total.reservedBytes += stats.reservedBytes;
+    }
+
+    //=============================================================================================================================
+    void AllocationStats_Gather(AllocationStats* stats)
+    {
+        Memory::Zero(stats, sizeof(AllocationStats));
+
+        EnterSpinLock(registrySpinlock);
+        for(uint scan = 0; scan < AllocationTagCount; ++scan) {
+            AddTagStats(stats->tags[scan], retiredPoolStats[scan]);
+        }
+
+        for(ThreadArena* arena = arenaList; arena != nullptr; arena = arena->nextArena) {
+            for(uint scan = 0; scan < AllocationTagCount; ++scan) {
+                AddTagStats(stats->tags[scan], arena->tags[scan]);
+            }
+        }
+
+        for(BufferPool* pool = poolList; pool != nullptr; pool = pool->nextPool) {
+            AllocationTagStats& tagStats = stats->tags[pool->tag];
+            tagStats.allocationCount += pool->acquireCount;
+            tagStats.allocatedBytes += pool->acquireCount * pool->bufferSize;
+            tagStats.globalAllocationCount += pool->globalAllocationCount;
+            tagStats.reservedBytes += pool->globalAllocationCount * pool->bufferSize;
+        }
+        LeaveSpinLock(registrySpinlock);
+    }
+
+    //=============================================================================================================================
+    void AllocationStats_Log()
+    {
+        AllocationStats stats;
+        AllocationStats_Gather(&stats);
+
+        for(uint scan = 0; scan < AllocationTagCount; ++scan) {
+            const AllocationTagStats& tagStats = stats.tags[scan];
+            WriteDebugInfo_("%s scratch: %llu allocations (%llu bytes) served by %llu global allocations (%llu bytes)",
+                            AllocationTagName((AllocationTag)scan), tagStats.allocationCount, tagStats.allocatedBytes,
+                            tagStats.globalAllocationCount, tagStats.reservedBytes);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    //=============================================================================================================================
+    // -- Tags only exist for the stats. Add new ones before the count and give them a name in ArenaAllocation.cpp.
+    //=============================================================================================================================
+    enum AllocationTag
+    {
+        eAllocationTagGeneral,
+        eAllocationTagBatches,
+        eAllocationTagSorting,
+        eAllocationTagFramebuffer,
+
+        AllocationTagCount
+    };
+
+    cpointer AllocationTagName(AllocationTag tag);
+
+    //=============================================================================================================================
+    // Thread arenas
+    // -- Every thread bumps allocations out of its own list of blocks. Blocks are taken from the node the thread runs on and
+    // -- are never returned until shutdown so once a thread has seen its largest frame it makes no more global allocations.
+    // -- Memory is given back either by releasing to a mark, which must be done in stack order on the thread that made the
+    // -- mark, or for every thread at once with ThreadArena_ResetAll between frames.
+    //=============================================================================================================================
+    #define ArenaAlloc_(AllocSize_, Tag_)          Selas::ThreadArena_Allocate(AllocSize_, Tag_)
+    #define ArenaAllocArray_(Type_, Count_, Tag_)  static_cast<Type_*>(Selas::ThreadArena_Allocate((Count_) * sizeof(Type_), Tag_))
+
+    struct ThreadArenaMark
+    {
+        void*  block;
+        uint64 used;
+    };
+
+    // -- Addresses are cache line aligned
+    void*           ThreadArena_Allocate(uint64 size, AllocationTag tag);
+    ThreadArenaMark ThreadArena_Mark();
+    void            ThreadArena_Release(const ThreadArenaMark& mark);
+
+    // -- Only while no thread is using its arena. Asserts every mark has been released.
+    void            ThreadArena_ResetAll();
+    // -- Frees every arena. Threads other than the caller must have exited.
+    void            ThreadArena_ShutdownAll();
+
+    //=============================================================================================================================
+    // Buffer pools
+    // -- Fixed size buffers that are handed back to a free list instead of the system allocator. Safe to use from any thread
+    // -- and a buffer may be released on a different thread than the one that acquired it.
+    //=============================================================================================================================
+    struct BufferPool
+    {
+        uint64        bufferSize;
+        AllocationTag tag;
+        void*         freeBuffers;
+        int64         outstanding;
+        uint64        acquireCount;
+        uint64        globalAllocationCount;
+        BufferPool*   nextPool;
+        uint8         spinlock[CacheLineSize_];
+    };
+
+    void  BufferPool_Initialize(BufferPool* pool, uint64 bufferSize, AllocationTag tag);
+    void  BufferPool_Shutdown(BufferPool* pool);
+    void* BufferPool_Acquire(BufferPool* pool);
+    void  BufferPool_Release(BufferPool* pool, void* buffer);
+
+    //=============================================================================================================================
+    // Stats
+    //=============================================================================================================================
+    struct AllocationTagStats
+    {
+        // -- Requests served by arenas and pools
+        uint64 allocationCount;
+        uint64 allocatedBytes;
+        // -- Requests that had to go to the system allocator
+        uint64 globalAllocationCount;
+        uint64 reservedBytes;
+    };
+
+    struct AllocationStats
+    {
+        AllocationTagStats tags[AllocationTagCount];
+    };
+
+    // -- Totals since startup over every arena and live pool. Arena blocks are counted against the tag of the allocation that
+    // -- needed them.
+    void AllocationStats_Gather(AllocationStats* stats);
+    void AllocationStats_Log();
+}
@@ -11,11 +11,19 @@
 #include "SystemLib/JsAssert.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <map>
 #include <memory>
 
 #if IsWindows_
 #include <windows.h>
+#elif IsOsx_
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
 #endif
 
 // -- allocation tracking
@@ -24,6 +32,10 @@
 #define EnableVerboseLogging_           IsWindows_ && 0
 // #define BreakOnAllocation_              61
 
+// -- Node allocations keep their size in front of the returned address so they can be unmapped
+#define NodeAllocationHeaderSize_       64
+#define MemoryPolicyPreferred_          1
+
 namespace Selas
 {
 
@@ -259,6 +271,63 @@ namespace Selas
 
         free(address);
     }
+
+    //=============================================================================================================================
+    void* SelasNodeMalloc(uint size, uint32 node, const char* name, const char* file, int line)
+    {
+        uint totalSize = size + NodeAllocationHeaderSize_;
+
+        #if IsWindows_
+            void* base = VirtualAllocExNuma(GetCurrentProcess(), nullptr, totalSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                                            node);
+            if(base == nullptr) {
+                return nullptr;
+            }
+        #elif IsOsx_
+            void* base = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(base == MAP_FAILED) {
+                return nullptr;
+            }
+
+            #if defined(__linux__)
+                // -- Preferred rather than bound so a full node spills over instead of failing. Done through syscall so we
+                // -- don't need libnuma. Pages only get placed when first touched so this has to happen before the header write.
+                unsigned long nodeMask = 1ul << node;
+                syscall(SYS_mbind, base, totalSize, MemoryPolicyPreferred_, &nodeMask, sizeof(nodeMask) * 8, 0);
+            #else
+                Unused_(node);
+            #endif
+        #endif
+
+        *(uint64*)base = totalSize;
+        void* address = (uint8*)base + NodeAllocationHeaderSize_;
+
+        #if EnableManualAllocationTracking_
+            tracker.AddAllocation(address, size, name, file, line);
+        #endif
+
+        return address;
+    }
+
+    //=============================================================================================================================
+    void SelasNodeFree(void* address)
+    {
+        if(address == nullptr) {
+            return;
+        }
+
+        #if EnableManualAllocationTracking_
+            tracker.RemoveAllocation(address);
+        #endif
+
+        void* base = (uint8*)address - NodeAllocationHeaderSize_;
+
+        #if IsWindows_
+            VirtualFree(base, 0, MEM_RELEASE);
+        #elif IsOsx_
+            munmap(base, *(uint64*)base);
+        #endif
+    }
 }
 
 //#endif
@@ -28,11 +28,19 @@ namespace Selas
     #define FreeAligned_(Var_)                             Selas::SelasAlignedFree(Var_)
     #define SafeFreeAligned_(Var_)                         if(Var_) { Selas::SelasAlignedFree(Var_); Var_ = nullptr; }
 
+    // -- Whole pages placed on one NUMA node. Meant for large buffers owned by the threads pinned to that node, not for small
+    // -- objects. Addresses are cache line aligned.
+    #define AllocOnNode_(AllocSize_, Node_)                Selas::SelasNodeMalloc(AllocSize_, Node_, __FUNCTION__, __FILE__, __LINE__)
+    #define AllocArrayOnNode_(Type_, Count_, Node_)        static_cast<Type_*>(Selas::SelasNodeMalloc((Count_) * sizeof(Type_), Node_, __FUNCTION__, __FILE__, __LINE__))
+    #define FreeOnNode_(Var_)                              Selas::SelasNodeFree(Var_)
+
     extern void* SelasAlignedMalloc(uint size, uint alignment, const char* name, const char* file, int line);
     extern void* SelasMalloc(uint size, const char* name, const char* file, int line);
     extern void* SelasRealloc(void* address, uint size, const char* name, const char* file, int line);
     extern void  SelasAlignedFree(void* address);
     extern void  SelasFree(void* address);
+    extern void* SelasNodeMalloc(uint size, uint32 node, const char* name, const char* file, int line);
+    extern void  SelasNodeFree(void* address);
 
     //=============================================================================================================================
     template <typename Type_>
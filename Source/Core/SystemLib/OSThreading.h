@@ -35,4 +35,19 @@ namespace Selas
 
     // Sleep
     void     Sleep(uint sleepTimeMs);
+
+    // Hardware
+    // -- Logical processors the process is allowed to run on
+    uint32   HardwareThreadCount(void);
+
+    // NUMA
+    // -- Nodes use the OS numbering and are capped at MaxNumaNodeCount_. Systems without NUMA report a single node zero.
+    #define MaxNumaNodeCount_ 8
+
+    uint32   NumaNodeCount(void);
+    // -- Processors on the node that the process is allowed to run on
+    uint32   NumaNodeProcessorCount(uint32 node);
+    // -- Restricts the calling thread to the node's processors. Returns false and leaves the thread alone when it can not.
+    bool     PinThreadToNumaNode(uint32 node);
+    uint32   CurrentNumaNode(void);
 }
\ No newline at end of file
@@ -9,8 +9,15 @@
 #include "SystemLib/Memory.h"
 
 #include <pthread.h>
-#include <dispatch/dispatch.h>
 #include <unistd.h>
+#if defined(__linux__)
+    #include <semaphore.h>
+    #include <sched.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+#else
+    #include <dispatch/dispatch.h>
+#endif
 
 namespace Selas
 {
@@ -61,28 +68,48 @@ namespace Selas
     //=============================================================================================================================
     void* CreateOSSemaphore(uint32 initialCount, uint32 maxCount)
     {
-    	dispatch_semaphore_t semaphore = dispatch_semaphore_create(initialCount);
-    	return semaphore;
+        #if defined(__linux__)
+            // -- libdispatch is not part of a Linux install so the posix semaphores stand in for it there
+            sem_t* semaphore = New_(sem_t);
+            sem_init(semaphore, 0, initialCount);
+            return semaphore;
+        #else
+        	dispatch_semaphore_t semaphore = dispatch_semaphore_create(initialCount);
+        	return semaphore;
+        #endif
     }
 
     //=============================================================================================================================
     void CloseOSSemaphore(void* semaphore)
     {
-        dispatch_release((dispatch_semaphore_t)semaphore);
+        #if defined(__linux__)
+            sem_destroy((sem_t*)semaphore);
+            Delete_((sem_t*)semaphore);
+        #else
+            dispatch_release((dispatch_semaphore_t)semaphore);
+        #endif
     }
 
     //=============================================================================================================================
     void PostSemaphore(void* semaphore, uint32 count)
     {
         for(uint scan = 0; scan < count; ++scan) {
-        	dispatch_semaphore_signal((dispatch_semaphore_t)semaphore);
+            #if defined(__linux__)
+                sem_post((sem_t*)semaphore);
+            #else
+            	dispatch_semaphore_signal((dispatch_semaphore_t)semaphore);
+            #endif
         }
     }
 
     //=============================================================================================================================
     bool WaitForSemaphore(void* semaphore, uint32 milliseconds)
     {
-        return (dispatch_semaphore_wait((dispatch_semaphore_t)semaphore, DISPATCH_TIME_FOREVER) == 0);
+        #if defined(__linux__)
+            return (sem_wait((sem_t*)semaphore) == 0);
+        #else
+            return (dispatch_semaphore_wait((dispatch_semaphore_t)semaphore, DISPATCH_TIME_FOREVER) == 0);
+        #endif
     }
 
     //=============================================================================================================================
@@ -134,6 +161,196 @@ namespace Selas
     {
         usleep((useconds_t)(sleepTimeMs * 1000));
     }
+
+    //=============================================================================================================================
+    // Hardware
+    //=============================================================================================================================
+    uint32 HardwareThreadCount(void)
+    {
+        #if defined(__linux__)
+            cpu_set_t affinity;
+            if(sched_getaffinity(0, sizeof(affinity), &affinity) == 0) {
+                return (uint32)CPU_COUNT(&affinity);
+            }
+        #endif
+
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        return count > 0 ? (uint32)count : 1;
+    }
+
+    //=============================================================================================================================
+    // NUMA
+    //=============================================================================================================================
+    #if defined(__linux__)
+
+    struct NumaTopology
+    {
+        uint32    nodeCount;
+        cpu_set_t nodeProcessors[MaxNumaNodeCount_];
+    };
+
+    //=============================================================================================================================
+    static bool ReadNodeProcessors(uint32 node, cpu_set_t* processors)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+        FILE* file = fopen(path, "r");
+        if(file == nullptr) {
+            return false;
+        }
+
+        char list[1024];
+        bool read = fgets(list, sizeof(list), file) != nullptr;
+        fclose(file);
+        if(read == false) {
+            return false;
+        }
+
+        // -- Comma separated ranges such as "0-7,16-23"
+        CPU_ZERO(processors);
+        char* cursor = list;
+        while(*cursor >= '0' && *cursor <= '9') {
+            uint32 first = (uint32)strtoul(cursor, &cursor, 10);
+            uint32 last = first;
+            if(*cursor == '-') {
+                last = (uint32)strtoul(cursor + 1, &cursor, 10);
+            }
+
+            for(uint32 processor = first; processor <= last && processor < CPU_SETSIZE; ++processor) {
+                CPU_SET(processor, processors);
+            }
+
+            if(*cursor == ',') {
+                ++cursor;
+            }
+        }
+
+        return true;
+    }
+
+    //=============================================================================================================================
+    static NumaTopology LoadNumaTopology()
+    {
+        NumaTopology topology;
+        topology.nodeCount = 0;
+        while(topology.nodeCount < MaxNumaNodeCount_
+              && ReadNodeProcessors(topology.nodeCount, &topology.nodeProcessors[topology.nodeCount])) {
+            ++topology.nodeCount;
+        }
+
+        // -- Kernels built without NUMA have no node directory so treat the whole machine as node zero
+        if(topology.nodeCount == 0) {
+            topology.nodeCount = 1;
+            CPU_ZERO(&topology.nodeProcessors[0]);
+            for(uint32 processor = 0; processor < CPU_SETSIZE; ++processor) {
+                CPU_SET(processor, &topology.nodeProcessors[0]);
+            }
+        }
+
+        return topology;
+    }
+
+    //=============================================================================================================================
+    static const NumaTopology& GetNumaTopology()
+    {
+        static NumaTopology topology = LoadNumaTopology();
+        return topology;
+    }
+
+    //=============================================================================================================================
+    static bool AllowedNodeProcessors(uint32 node, cpu_set_t* processors)
+    {
+        const NumaTopology& topology = GetNumaTopology();
+        if(node >= topology.nodeCount) {
+            return false;
+        }
+
+        cpu_set_t allowed;
+        if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return false;
+        }
+
+        CPU_AND(processors, &allowed, &topology.nodeProcessors[node]);
+        return CPU_COUNT(processors) > 0;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeCount(void)
+    {
+        return GetNumaTopology().nodeCount;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeProcessorCount(uint32 node)
+    {
+        cpu_set_t processors;
+        if(AllowedNodeProcessors(node, &processors) == false) {
+            return 0;
+        }
+
+        return (uint32)CPU_COUNT(&processors);
+    }
+
+    //=============================================================================================================================
+    bool PinThreadToNumaNode(uint32 node)
+    {
+        cpu_set_t processors;
+        if(AllowedNodeProcessors(node, &processors) == false) {
+            return false;
+        }
+
+        return sched_setaffinity(0, sizeof(processors), &processors) == 0;
+    }
+
+    //=============================================================================================================================
+    uint32 CurrentNumaNode(void)
+    {
+        int processor = sched_getcpu();
+        if(processor < 0) {
+            return 0;
+        }
+
+        const NumaTopology& topology = GetNumaTopology();
+        for(uint32 scan = 0; scan < topology.nodeCount; ++scan) {
+            if(CPU_ISSET(processor, &topology.nodeProcessors[scan])) {
+                return scan;
+            }
+        }
+
+        return 0;
+    }
+
+    #else
+
+    //=============================================================================================================================
+    uint32 NumaNodeCount(void)
+    {
+        return 1;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeProcessorCount(uint32 node)
+    {
+        return node == 0 ? HardwareThreadCount() : 0;
+    }
+
+    //=============================================================================================================================
+    bool PinThreadToNumaNode(uint32 node)
+    {
+        Unused_(node);
+
+        // -- OSX has no way to pin threads. With a single node there is nothing to gain from it anyway.
+        return false;
+    }
+
+    //=============================================================================================================================
+    uint32 CurrentNumaNode(void)
+    {
+        return 0;
+    }
+
+    #endif
 }
 
 #endif
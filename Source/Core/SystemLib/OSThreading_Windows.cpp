@@ -132,6 +132,137 @@ namespace Selas
     {
         ::Sleep((DWORD)sleepTimeMs);
     }
+
+    //=============================================================================================================================
+    // Hardware
+    //=============================================================================================================================
+    //=============================================================================================================================
+    static uint32 CountProcessors(KAFFINITY mask)
+    {
+        uint32 count = 0;
+        for(; mask != 0; mask &= mask - 1) {
+            ++count;
+        }
+        return count;
+    }
+
+    //=============================================================================================================================
+    uint32 HardwareThreadCount(void)
+    {
+        // -- Machines with more than 64 logical processors split them into groups and the process affinity mask only describes
+        // -- the primary one so every active group is counted here. The mask still restricts the group it covers.
+        DWORD_PTR processMask = 0;
+        DWORD_PTR systemMask = 0;
+        ::GetProcessAffinityMask(::GetCurrentProcess(), &processMask, &systemMask);
+
+        PROCESSOR_NUMBER processor;
+        ::GetCurrentProcessorNumberEx(&processor);
+
+        DWORD length = 0;
+        ::GetLogicalProcessorInformationEx(RelationGroup, nullptr, &length);
+        if(length > 0) {
+            SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)Alloc_(length);
+            if(::GetLogicalProcessorInformationEx(RelationGroup, info, &length) && info->Relationship == RelationGroup) {
+                uint32 count = 0;
+                for(WORD group = 0; group < info->Group.ActiveGroupCount; ++group) {
+                    KAFFINITY mask = info->Group.GroupInfo[group].ActiveProcessorMask;
+                    if(group == processor.Group && processMask != 0) {
+                        mask &= processMask;
+                    }
+                    count += CountProcessors(mask);
+                }
+                Free_(info);
+
+                if(count > 0) {
+                    return count;
+                }
+            }
+            else {
+                Free_(info);
+            }
+        }
+
+        if(processMask != 0) {
+            return CountProcessors(processMask);
+        }
+
+        SYSTEM_INFO systemInfo;
+        ::GetSystemInfo(&systemInfo);
+        return (uint32)systemInfo.dwNumberOfProcessors;
+    }
+
+    //=============================================================================================================================
+    // NUMA
+    //=============================================================================================================================
+    uint32 NumaNodeCount(void)
+    {
+        ULONG highestNode = 0;
+        if(::GetNumaHighestNodeNumber(&highestNode) == 0) {
+            return 1;
+        }
+
+        return highestNode + 1 < MaxNumaNodeCount_ ? highestNode + 1 : MaxNumaNodeCount_;
+    }
+
+    //=============================================================================================================================
+    static bool AllowedNodeProcessors(uint32 node, GROUP_AFFINITY* affinity)
+    {
+        if(node >= NumaNodeCount()) {
+            return false;
+        }
+
+        if(::GetNumaNodeProcessorMaskEx((USHORT)node, affinity) == 0) {
+            return false;
+        }
+
+        // -- The process mask only covers the primary processor group so leave nodes in other groups unrestricted
+        DWORD_PTR processMask;
+        DWORD_PTR systemMask;
+        PROCESSOR_NUMBER processor;
+        ::GetCurrentProcessorNumberEx(&processor);
+        if(affinity->Group == processor.Group
+           && ::GetProcessAffinityMask(::GetCurrentProcess(), &processMask, &systemMask) && processMask != 0) {
+            affinity->Mask &= processMask;
+        }
+
+        return affinity->Mask != 0;
+    }
+
+    //=============================================================================================================================
+    uint32 NumaNodeProcessorCount(uint32 node)
+    {
+        GROUP_AFFINITY affinity;
+        if(AllowedNodeProcessors(node, &affinity) == false) {
+            return 0;
+        }
+
+        return CountProcessors(affinity.Mask);
+    }
+
+    //=============================================================================================================================
+    bool PinThreadToNumaNode(uint32 node)
+    {
+        GROUP_AFFINITY affinity;
+        if(AllowedNodeProcessors(node, &affinity) == false) {
+            return false;
+        }
+
+        return ::SetThreadGroupAffinity(::GetCurrentThread(), &affinity, nullptr) != 0;
+    }
+
+    //=============================================================================================================================
+    uint32 CurrentNumaNode(void)
+    {
+        PROCESSOR_NUMBER processor;
+        ::GetCurrentProcessorNumberEx(&processor);
+
+        USHORT node = 0;
+        if(::GetNumaProcessorNodeEx(&processor, &node) == 0 || node >= MaxNumaNodeCount_) {
+            return 0;
+        }
+
+        return node;
+    }
 }
 
 #endif
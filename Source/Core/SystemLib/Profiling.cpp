@@ -3,6 +3,14 @@
 //=================================================================================================================================
 
 #include "SystemLib/Profiling.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/JsAssert.h"
+
+#include <stdio.h>
+#include <atomic>
 
 #if USE_PIX
     #define WIN32_LEAN_AND_MEAN
@@ -10,21 +18,244 @@
     #include <WinPixEventRuntime/pix3.h>
 #endif
 
+// -- 64K events is 1MB per thread which covers a frame of the busiest markers with plenty to spare
+#define ProfileEventCapacity_ (64 * 1024)
+
 namespace Selas
 {
+    //=============================================================================================================================
+    struct ProfileEvent
+    {
+        uint64   timestamp;
+        // -- Null for end events. Chrome pairs them with the innermost open begin on the same thread.
+        cpointer name;
+    };
+
+    //=============================================================================================================================
+    struct ProfileThread
+    {
+        ProfileEvent    events[ProfileEventCapacity_];
+
+        // -- Only the owning thread writes head and only the flush touches tail so recording needs no locks
+        volatile uint64 head;
+        uint64          tail;
+        uint32          threadId;
+        ProfileThread*  next;
+    };
+
+    //=============================================================================================================================
+    struct ProfilerData
+    {
+        FILE*          file;
+        bool           firstEvent;
+        uint64         startTicks;
+        double         ticksPerMicrosecond;
+        uint64         droppedEvents;
+
+        uint8          threadsSpinlock[CacheLineSize_];
+        ProfileThread* threads;
+        uint32         threadCount;
+    };
+
+    volatile bool profilerRecording = false;
+
+    static ProfilerData* profiler = nullptr;
+    static thread_local ProfileThread* profileThread = nullptr;
+
+    //=============================================================================================================================
+    static ProfileThread* RegisterThread()
+    {
+        // -- The only lock taken while recording and only once per thread
+        ProfileThread* thread = (ProfileThread*)AllocAligned_(sizeof(ProfileThread), CacheLineSize_);
+        thread->head = 0;
+        thread->tail = 0;
+
+        EnterSpinLock(profiler->threadsSpinlock);
+        thread->threadId = profiler->threadCount++;
+        thread->next = profiler->threads;
+        profiler->threads = thread;
+        LeaveSpinLock(profiler->threadsSpinlock);
+
+        return thread;
+    }
+
+    //=============================================================================================================================
+    static ForceInline_ void RecordEvent(cpointer name)
+    {
+        ProfileThread* thread = profileThread;
+        if(thread == nullptr) {
+            thread = profileThread = RegisterThread();
+        }
+
+        uint64 head = thread->head;
+        ProfileEvent& event = thread->events[head % ProfileEventCapacity_];
+        event.timestamp = SystemTime::Timestamp();
+        event.name = name;
+
+        // -- The event has to be visible before the head that publishes it
+        std::atomic_thread_fence(std::memory_order_release);
+        thread->head = head + 1;
+    }
+
+    //=============================================================================================================================
+    void Profiler_BeginEvent(cpointer name)
+    {
+        RecordEvent(name);
+    }
+
+    //=============================================================================================================================
+    void Profiler_EndEvent()
+    {
+        RecordEvent(nullptr);
+    }
+
+    //=============================================================================================================================
+    static void WriteTraceEvent(cpointer name, cpointer phase, double timestamp, uint32 threadId)
+    {
+        fprintf(profiler->file, "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                profiler->firstEvent ? "" : ",\n", name, phase, timestamp, threadId);
+        profiler->firstEvent = false;
+    }
+
+    //=============================================================================================================================
+    static double TimestampToMicroseconds(uint64 timestamp)
+    {
+        return (double)(int64)(timestamp - profiler->startTicks) / profiler->ticksPerMicrosecond;
+    }
+
+    //=============================================================================================================================
+    static void FlushThread(ProfileThread* thread)
+    {
+        uint64 head = thread->head;
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        uint64 start = thread->tail;
+        if(head - start > ProfileEventCapacity_) {
+            start = head - ProfileEventCapacity_;
+        }
+        profiler->droppedEvents += start - thread->tail;
+
+        for(uint64 scan = start; scan < head; ++scan) {
+            ProfileEvent event = thread->events[scan % ProfileEventCapacity_];
+
+            // -- Skip anything the owning thread may have lapped while we were writing
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(thread->head - scan > ProfileEventCapacity_) {
+                ++profiler->droppedEvents;
+                continue;
+            }
+
+            if(event.name != nullptr) {
+                WriteTraceEvent(event.name, "B", TimestampToMicroseconds(event.timestamp), thread->threadId);
+            }
+            else {
+                WriteTraceEvent("", "E", TimestampToMicroseconds(event.timestamp), thread->threadId);
+            }
+        }
+
+        thread->tail = head;
+    }
+
+    //=============================================================================================================================
+    void Profiler_Initialize(cpointer traceFilePath)
+    {
+        Assert_(profiler == nullptr);
+
+        FILE* file = nullptr;
+        #if IsWindows_
+            fopen_s(&file, traceFilePath, "w");
+        #else
+            file = fopen(traceFilePath, "w");
+        #endif
+
+        if(file == nullptr) {
+            WriteDebugInfo_("Failed to open profiler trace %s. Profiling is disabled.", traceFilePath);
+            return;
+        }
+
+        profiler = New_(ProfilerData);
+        profiler->file = file;
+        profiler->firstEvent = true;
+        profiler->ticksPerMicrosecond = SystemTime::TimestampsPerMicrosecond();
+        profiler->startTicks = SystemTime::Timestamp();
+        profiler->droppedEvents = 0;
+        profiler->threads = nullptr;
+        profiler->threadCount = 0;
+        CreateSpinLock(profiler->threadsSpinlock);
+
+        fprintf(profiler->file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        profilerRecording = true;
+    }
+
+    //=============================================================================================================================
+    void Profiler_FlushFrame()
+    {
+        if(profiler == nullptr) {
+            return;
+        }
+
+        EnterSpinLock(profiler->threadsSpinlock);
+        ProfileThread* threads = profiler->threads;
+        LeaveSpinLock(profiler->threadsSpinlock);
+
+        // -- Threads are only ever pushed on the front so walking from a snapshot of the head is safe
+        for(ProfileThread* thread = threads; thread != nullptr; thread = thread->next) {
+            FlushThread(thread);
+        }
+
+        // -- Global instant event so frame boundaries show as a line across every thread
+        fprintf(profiler->file, "%s{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                profiler->firstEvent ? "" : ",\n", TimestampToMicroseconds(SystemTime::Timestamp()));
+        profiler->firstEvent = false;
+        fflush(profiler->file);
+    }
+
+    //=============================================================================================================================
+    void Profiler_Shutdown()
+    {
+        if(profiler == nullptr) {
+            return;
+        }
+
+        Profiler_FlushFrame();
+        profilerRecording = false;
+
+        for(ProfileThread* thread = profiler->threads; thread != nullptr; thread = thread->next) {
+            fprintf(profiler->file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                                    "\"args\":{\"name\":\"Thread %u\"}}", thread->threadId, thread->threadId);
+        }
+        fprintf(profiler->file, "\n]}\n");
+        fclose(profiler->file);
+
+        if(profiler->droppedEvents > 0) {
+            WriteDebugInfo_("Profiler dropped %llu events that were overwritten before they were written out",
+                            profiler->droppedEvents);
+        }
+
+        ProfileThread* thread = profiler->threads;
+        while(thread != nullptr) {
+            ProfileThread* next = thread->next;
+            FreeAligned_(thread);
+            thread = next;
+        }
+
+        Delete_(profiler);
+        profiler = nullptr;
+        profileThread = nullptr;
+    }
+
 #if USE_PIX
     //=============================================================================================================================
-    ScopedProfileEvent::ScopedProfileEvent(uint64 color, const char* name)
+    void PixBeginEvent(uint64 color, cpointer name)
     {
         PIXBeginEvent(color, name);
     }
 
     //=============================================================================================================================
-    ScopedProfileEvent::~ScopedProfileEvent()
+    void PixEndEvent()
     {
         PIXEndEvent();
     }
-#else
-
 #endif
 }
@@ -8,17 +8,66 @@
 
 namespace Selas
 {
+    //=============================================================================================================================
+    // -- Scoped CPU events recorded into a ring buffer per thread and written out as a Chrome trace that chrome://tracing and
+    // -- Perfetto can open. Recording is off until Profiler_Initialize is called so release builds carry it at the cost of one
+    // -- branch per marker. Names must be string literals or otherwise outlive the profiler.
+    //=============================================================================================================================
+    #define EnableProfiling_ 1
+
+    extern volatile bool profilerRecording;
+
+    void Profiler_Initialize(cpointer traceFilePath);
+    void Profiler_Shutdown();
+
+    // -- Writes out everything recorded since the last flush. Meant to run between frames; threads that are still recording
+    // -- can overwrite events that have not been written yet and those are skipped.
+    void Profiler_FlushFrame();
+
+    void Profiler_BeginEvent(cpointer name);
+    void Profiler_EndEvent();
+
     #if USE_PIX
-        class ScopedProfileEvent
+        void PixBeginEvent(uint64 color, cpointer name);
+        void PixEndEvent();
+    #endif
+
+    //=============================================================================================================================
+    class ScopedProfileEvent
+    {
+    public:
+        ForceInline_ ScopedProfileEvent(uint64 color, cpointer name)
+            : recording(profilerRecording)
+        {
+            #if USE_PIX
+                PixBeginEvent(color, name);
+            #else
+                Unused_(color);
+            #endif
+
+            if(recording) {
+                Profiler_BeginEvent(name);
+            }
+        }
+
+        ForceInline_ ~ScopedProfileEvent()
         {
-        public:
-            ScopedProfileEvent(uint64 color, const char* name);
-            ~ScopedProfileEvent();
-        };
+            if(recording) {
+                Profiler_EndEvent();
+            }
+
+            #if USE_PIX
+                PixEndEvent();
+            #endif
+        }
+
+    private:
+        bool recording;
+    };
 
+    #if EnableProfiling_ || USE_PIX
         #define ProfileEventMarker_(color, name) ScopedProfileEvent __profileEventMarker(color, name)
     #else
         #define ProfileEventMarker_(color, name)
     #endif
-    
-}
\ No newline at end of file
+}
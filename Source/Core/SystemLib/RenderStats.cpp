@@ -0,0 +1,269 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/RenderStats.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/SystemTime.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/MinMax.h"
+
+#include <stdio.h>
+
+namespace Selas
+{
+    static cpointer RenderCounterNames[] = {
+        "PrimaryRays",
+        "BounceRays",
+        "ShadowRays",
+        "RaysTraced",
+        "BatchesFlushed",
+        "BatchEntriesFlushed",
+        "BatchCapacityFlushed",
+        "BatchesConsumed",
+        "BatchQueueTime",
+        "GeometryCacheHits",
+        "GeometryCacheMisses",
+        "GeometryCacheLoadedBytes",
+        "GeometryCacheEvictedBytes",
+        "TextureCacheFetches",
+        "TextureCacheHits",
+        "TextureCacheMisses"
+    };
+    static_assert(sizeof(RenderCounterNames) / sizeof(RenderCounterNames[0]) == RenderCounterCount,
+                  "Missing render counter name");
+
+    static cpointer RenderGaugeNames[] = {
+        "GeometryCacheBytes",
+        "TextureCacheBytes"
+    };
+    static_assert(sizeof(RenderGaugeNames) / sizeof(RenderGaugeNames[0]) == RenderGaugeCount, "Missing render gauge name");
+
+    //=============================================================================================================================
+    struct ThreadStats
+    {
+        // -- Only written by the owning thread
+        uint64       counters[RenderCounterCount];
+        uint64       shadingHits[MaxShadingStatSlots_];
+        uint64       shadingTime[MaxShadingStatSlots_];
+
+        // -- Only touched by the flush
+        uint64       reportedCounters[RenderCounterCount];
+        uint64       reportedShadingHits[MaxShadingStatSlots_];
+        uint64       reportedShadingTime[MaxShadingStatSlots_];
+
+        uint32       threadId;
+        ThreadStats* next;
+    };
+
+    //=============================================================================================================================
+    struct FrameTotals
+    {
+        uint64 counters[RenderCounterCount];
+        uint64 shadingHits[MaxShadingStatSlots_];
+        uint64 shadingTime[MaxShadingStatSlots_];
+    };
+
+    static thread_local ThreadStats* threadStats = nullptr;
+
+    // -- Zero is unlocked so counting works before anything has been initialized
+    static Align_(CacheLineSize_) uint8 registrySpinlock[CacheLineSize_];
+    static ThreadStats* threadList = nullptr;
+    static uint32       threadCount = 0;
+
+    static volatile uint64 gauges[RenderGaugeCount];
+
+    static FILE*    statsFile = nullptr;
+    static cpointer shadingSlotNames[MaxShadingStatSlots_];
+    static uint     shadingSlotCount = 0;
+    static std::chrono::high_resolution_clock::time_point lastFrameTime;
+
+    //=============================================================================================================================
+    cpointer RenderCounterName(RenderCounter counter)
+    {
+        Assert_(counter < RenderCounterCount);
+        return RenderCounterNames[counter];
+    }
+
+    //=============================================================================================================================
+    cpointer RenderGaugeName(RenderGauge gauge)
+    {
+        Assert_(gauge < RenderGaugeCount);
+        return RenderGaugeNames[gauge];
+    }
+
+    //=============================================================================================================================
+    static ThreadStats* GetThreadStats()
+    {
+        if(threadStats == nullptr) {
+            threadStats = New_(ThreadStats);
+            Memory::Zero(threadStats, sizeof(ThreadStats));
+
+            EnterSpinLock(registrySpinlock);
+            threadStats->threadId = threadCount++;
+            threadStats->next = threadList;
+            threadList = threadStats;
+            LeaveSpinLock(registrySpinlock);
+        }
+
+        return threadStats;
+    }
+
+    //=============================================================================================================================
+    void RenderStats_Add(RenderCounter counter, uint64 value)
+    {
+        Assert_(counter < RenderCounterCount);
+        GetThreadStats()->counters[counter] += value;
+    }
+
+    //=============================================================================================================================
+    void RenderStats_SetGauge(RenderGauge gauge, uint64 value)
+    {
+        Assert_(gauge < RenderGaugeCount);
+        gauges[gauge] = value;
+    }
+
+    //=============================================================================================================================
+    void RenderStats_AddShading(uint slot, uint64 hitCount, uint64 elapsedTimestamps)
+    {
+        Assert_(slot < MaxShadingStatSlots_);
+
+        ThreadStats* stats = GetThreadStats();
+        stats->shadingHits[slot] += hitCount;
+        stats->shadingTime[slot] += elapsedTimestamps;
+    }
+
+    //=============================================================================================================================
+    void RenderStats_Initialize(cpointer statsFilePath, cpointer const* slotNames, uint slotCount)
+    {
+        Assert_(statsFile == nullptr);
+        Assert_(slotCount <= MaxShadingStatSlots_);
+
+        #if IsWindows_
+            fopen_s(&statsFile, statsFilePath, "w");
+        #else
+            statsFile = fopen(statsFilePath, "w");
+        #endif
+
+        if(statsFile == nullptr) {
+            WriteDebugInfo_("Failed to open render stats file %s. Stats will not be written.", statsFilePath);
+            return;
+        }
+
+        shadingSlotCount = slotCount;
+        for(uint scan = 0; scan < slotCount; ++scan) {
+            shadingSlotNames[scan] = slotNames[scan];
+        }
+
+        // -- Calibrate now so the first frame does not pay for it
+        SystemTime::TimestampsPerMicrosecond();
+        lastFrameTime = SystemTime::Now();
+    }
+
+    //=============================================================================================================================
+    static double Ratio(double numerator, uint64 denominator)
+    {
+        return denominator > 0 ? numerator / (double)denominator : 0.0;
+    }
+
+    //=============================================================================================================================
+    static double TimestampsToMs(uint64 timestamps)
+    {
+        return (double)timestamps / (1000.0 * SystemTime::TimestampsPerMicrosecond());
+    }
+
+    //=============================================================================================================================
+    void RenderStats_FlushFrame(cpointer frameName, uint32 frameIndex)
+    {
+        if(statsFile == nullptr) {
+            return;
+        }
+
+        double seconds = Max<double>(SystemTime::ElapsedSecondsF(lastFrameTime), 1e-6);
+        lastFrameTime = SystemTime::Now();
+
+        FrameTotals totals;
+        Memory::Zero(&totals, sizeof(totals));
+
+        fprintf(statsFile, "{\"frame\":\"%s\",\"index\":%u,\"seconds\":%.6f,\"threads\":[", frameName, frameIndex, seconds);
+
+        EnterSpinLock(registrySpinlock);
+        for(ThreadStats* stats = threadList; stats != nullptr; stats = stats->next) {
+            uint64 threadRays = stats->counters[eRenderCounterRaysTraced] - stats->reportedCounters[eRenderCounterRaysTraced];
+            fprintf(statsFile, "%s{\"thread\":%u,\"raysTraced\":%llu,\"raysPerSecond\":%.1f}", stats == threadList ? "" : ",",
+                    stats->threadId, threadRays, threadRays / seconds);
+
+            for(uint scan = 0; scan < RenderCounterCount; ++scan) {
+                uint64 value = stats->counters[scan];
+                totals.counters[scan] += value - stats->reportedCounters[scan];
+                stats->reportedCounters[scan] = value;
+            }
+            for(uint scan = 0; scan < MaxShadingStatSlots_; ++scan) {
+                uint64 hits = stats->shadingHits[scan];
+                uint64 time = stats->shadingTime[scan];
+                totals.shadingHits[scan] += hits - stats->reportedShadingHits[scan];
+                totals.shadingTime[scan] += time - stats->reportedShadingTime[scan];
+                stats->reportedShadingHits[scan] = hits;
+                stats->reportedShadingTime[scan] = time;
+            }
+        }
+        LeaveSpinLock(registrySpinlock);
+
+        fprintf(statsFile, "],\"counters\":{");
+        for(uint scan = 0; scan < RenderCounterCount; ++scan) {
+            fprintf(statsFile, "%s\"%s\":%llu", scan == 0 ? "" : ",", RenderCounterNames[scan], totals.counters[scan]);
+        }
+
+        fprintf(statsFile, "},\"gauges\":{");
+        for(uint scan = 0; scan < RenderGaugeCount; ++scan) {
+            fprintf(statsFile, "%s\"%s\":%llu", scan == 0 ? "" : ",", RenderGaugeNames[scan], (uint64)gauges[scan]);
+        }
+
+        const uint64* counters = totals.counters;
+        fprintf(statsFile, "},\"raysPerSecond\":%.1f", counters[eRenderCounterRaysTraced] / seconds);
+        fprintf(statsFile, ",\"batchFillRatio\":%.4f",
+                Ratio((double)counters[eRenderCounterBatchEntriesFlushed], counters[eRenderCounterBatchCapacityFlushed]));
+        fprintf(statsFile, ",\"batchQueueMs\":%.4f",
+                Ratio(TimestampsToMs(counters[eRenderCounterBatchQueueTime]), counters[eRenderCounterBatchesConsumed]));
+        uint64 geometryLookups = counters[eRenderCounterGeometryCacheHits] + counters[eRenderCounterGeometryCacheMisses];
+        fprintf(statsFile, ",\"geometryCacheHitRate\":%.4f",
+                Ratio((double)counters[eRenderCounterGeometryCacheHits], geometryLookups));
+        uint64 textureLookups = counters[eRenderCounterTextureCacheHits] + counters[eRenderCounterTextureCacheMisses];
+        fprintf(statsFile, ",\"textureCacheHitRate\":%.4f",
+                Ratio((double)counters[eRenderCounterTextureCacheHits], textureLookups));
+
+        fprintf(statsFile, ",\"shading\":[");
+        for(uint scan = 0; scan < shadingSlotCount; ++scan) {
+            fprintf(statsFile, "%s{\"shader\":\"%s\",\"hits\":%llu,\"ms\":%.3f}", scan == 0 ? "" : ",",
+                    shadingSlotNames[scan], totals.shadingHits[scan], TimestampsToMs(totals.shadingTime[scan]));
+        }
+        fprintf(statsFile, "]}\n");
+        fflush(statsFile);
+    }
+
+    //=============================================================================================================================
+    void RenderStats_Shutdown()
+    {
+        if(statsFile != nullptr) {
+            fclose(statsFile);
+            statsFile = nullptr;
+        }
+
+        EnterSpinLock(registrySpinlock);
+        ThreadStats* stats = threadList;
+        threadList = nullptr;
+        threadCount = 0;
+        LeaveSpinLock(registrySpinlock);
+
+        while(stats != nullptr) {
+            ThreadStats* next = stats->next;
+            Delete_(stats);
+            stats = next;
+        }
+
+        threadStats = nullptr;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    //=============================================================================================================================
+    // -- Counters are summed over every thread and reported as the change since the previous frame. Add new ones before the
+    // -- count and give them a name in RenderStats.cpp.
+    //=============================================================================================================================
+    enum RenderCounter
+    {
+        eRenderCounterPrimaryRays,
+        eRenderCounterBounceRays,
+        eRenderCounterShadowRays,
+        // -- Rays handed to embree. Also kept per thread for rays per second.
+        eRenderCounterRaysTraced,
+
+        eRenderCounterBatchesFlushed,
+        eRenderCounterBatchEntriesFlushed,
+        eRenderCounterBatchCapacityFlushed,
+        eRenderCounterBatchesConsumed,
+        // -- Timestamps between a batch being flushed and a thread claiming it
+        eRenderCounterBatchQueueTime,
+
+        eRenderCounterGeometryCacheHits,
+        eRenderCounterGeometryCacheMisses,
+        eRenderCounterGeometryCacheLoadedBytes,
+        eRenderCounterGeometryCacheEvictedBytes,
+
+        eRenderCounterTextureCacheFetches,
+        eRenderCounterTextureCacheHits,
+        // -- Blocks Ptex had to read from disk
+        eRenderCounterTextureCacheMisses,
+
+        RenderCounterCount
+    };
+
+    // -- Values that are sampled rather than accumulated. Reported as the latest value set.
+    enum RenderGauge
+    {
+        eRenderGaugeGeometryCacheBytes,
+        eRenderGaugeTextureCacheBytes,
+
+        RenderGaugeCount
+    };
+
+    #define MaxShadingStatSlots_ 8
+
+    cpointer RenderCounterName(RenderCounter counter);
+    cpointer RenderGaugeName(RenderGauge gauge);
+
+    //=============================================================================================================================
+    // -- Frames are appended to the file as one JSON object per line. Shading slots are whatever the integrators pass to
+    // -- RenderStats_AddShading; their names are only used for the output. Nothing is written until this is called but the
+    // -- counters are always kept.
+    void RenderStats_Initialize(cpointer statsFilePath, cpointer const* shadingSlotNames, uint shadingSlotCount);
+    void RenderStats_Shutdown();
+
+    // -- Writes a frame with everything counted since the previous one. Only while no other thread is counting.
+    void RenderStats_FlushFrame(cpointer frameName, uint32 frameIndex);
+
+    void RenderStats_Add(RenderCounter counter, uint64 value);
+    void RenderStats_SetGauge(RenderGauge gauge, uint64 value);
+    void RenderStats_AddShading(uint slot, uint64 hitCount, uint64 elapsedTimestamps);
+}
@@ -7,6 +7,14 @@
 #include <chrono>
 #include <ctime>
 
+#if IsWindows_
+    #include <intrin.h>
+#else
+    #include <x86intrin.h>
+#endif
+
+#define TimestampCalibrationMs_ 10.0f
+
 namespace Selas
 {
     //=============================================================================================================================
@@ -16,7 +24,7 @@ namespace Selas
     }
 
     //=============================================================================================================================
-    float ElapsedMicrosecondsF(std::chrono::high_resolution_clock::time_point& since)
+    float SystemTime::ElapsedMicrosecondsF(std::chrono::high_resolution_clock::time_point& since)
     {
         auto current = std::chrono::high_resolution_clock::now();
 
@@ -41,4 +49,32 @@ namespace Selas
         std::chrono::duration<float> elapsed = current - since;
         return elapsed.count();
     }
+
+    //=============================================================================================================================
+    uint64 SystemTime::Timestamp()
+    {
+        return __rdtsc();
+    }
+
+    //=============================================================================================================================
+    static double CalibrateTimestamps()
+    {
+        // -- The counter rate is fixed on anything made in the last decade but not reported anywhere so measure it
+        auto start = SystemTime::Now();
+        uint64 startTimestamp = SystemTime::Timestamp();
+
+        float elapsedMs = 0.0f;
+        while(elapsedMs < TimestampCalibrationMs_) {
+            elapsedMs = SystemTime::ElapsedMillisecondsF(start);
+        }
+
+        return (double)(SystemTime::Timestamp() - startTimestamp) / (1000.0 * elapsedMs);
+    }
+
+    //=============================================================================================================================
+    double SystemTime::TimestampsPerMicrosecond()
+    {
+        static double timestampsPerMicrosecond = CalibrateTimestamps();
+        return timestampsPerMicrosecond;
+    }
 }
\ No newline at end of file
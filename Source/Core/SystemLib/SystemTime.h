@@ -18,6 +18,11 @@ namespace Selas
         float ElapsedMicrosecondsF(std::chrono::high_resolution_clock::time_point& since);
         float ElapsedMillisecondsF(std::chrono::high_resolution_clock::time_point& since);
         float ElapsedSecondsF(std::chrono::high_resolution_clock::time_point& since);
+
+        // -- Cycle counter for timing short spans on hot paths. Only differences between timestamps mean anything.
+        uint64 Timestamp();
+        // -- Measured against the clock above the first time it is called which takes about 10ms
+        double TimestampsPerMicrosecond();
     }
 
     // std::micro, std::milli, etc...
@@ -0,0 +1,194 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/DisplacementTile.h"
+#include "TextureLib/TextureFiltering.h"
+#include "TextureLib/TextureResource.h"
+#include "MathLib/FloatFuncs.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/JsAssert.h"
+
+#if defined(__AVX2__)
+    #define EnableAvx2Gathers_ 1
+    #include <immintrin.h>
+#else
+    #define EnableAvx2Gathers_ 0
+#endif
+
+#define DisplacementTileMaxDimension_ 1024
+#define QuantizedHeightMax_ 65535.0f
+
+namespace Selas
+{
+    //=============================================================================================================================
+    static float TexelHeight(const TextureResourceData* texture, const float* mip, uint32 width, uint32 s, uint32 t)
+    {
+        uint32 channels = (uint32)texture->format + 1;
+        return mip[TextureFiltering::TexelIndex(texture->layout, width, (int32)s, (int32)t) * channels];
+    }
+
+    //=============================================================================================================================
+    void BuildDisplacementTile(const TextureResourceData* texture, float amount, bool invert, DisplacementTile* tile)
+    {
+        // -- Tessellation never gets fine enough to resolve the top mips of large displacement textures so start from the
+        // -- first mip that fits within the tile budget.
+        uint32 level = 0;
+        while(level + 1 < texture->mipCount
+              && Max(texture->mipWidths[level], texture->mipHeights[level]) > DisplacementTileMaxDimension_) {
+            ++level;
+        }
+
+        uint32 width = texture->mipWidths[level];
+        uint32 height = texture->mipHeights[level];
+        const float* mip = reinterpret_cast<const float*>(&texture->texture[texture->mipOffsets[level]]);
+
+        float minHeight = FloatMax_;
+        float maxHeight = -FloatMax_;
+        for(uint32 t = 0; t < height; ++t) {
+            for(uint32 s = 0; s < width; ++s) {
+                float value = TexelHeight(texture, mip, width, s, t);
+                minHeight = Min(minHeight, value);
+                maxHeight = Max(maxHeight, value);
+            }
+        }
+
+        float range = maxHeight - minHeight;
+        float quantize = range > 0.0f ? QuantizedHeightMax_ / range : 0.0f;
+
+        // -- One extra entry so 32 bit gathers of the last texel stay within the allocation
+        uint32 texelCount = width * height;
+        tile->heights = AllocArray_(uint16, (texelCount + 1));
+        tile->heights[texelCount] = 0;
+
+        for(uint32 t = 0; t < height; ++t) {
+            for(uint32 s = 0; s < width; ++s) {
+                float value = TexelHeight(texture, mip, width, s, t);
+                tile->heights[t * width + s] = (uint16)((value - minHeight) * quantize + 0.5f);
+            }
+        }
+
+        float step = range / QuantizedHeightMax_;
+
+        tile->width = width;
+        tile->height = height;
+        tile->offset = invert ? amount * (1.0f - minHeight) : amount * minHeight;
+        tile->scale = invert ? -amount * step : amount * step;
+    }
+
+    //=============================================================================================================================
+    void ShutdownDisplacementTile(DisplacementTile* tile)
+    {
+        SafeFree_(tile->heights);
+        tile->width = 0;
+        tile->height = 0;
+    }
+
+    //=============================================================================================================================
+    static float SampleDisplacementTile(const DisplacementTile* tile, float u, float v)
+    {
+        int32 w = (int32)tile->width;
+        int32 h = (int32)tile->height;
+
+        // -- With the coordinates wrapped into [0, 1) the bilinear footprint can only leave the tile by a single texel
+        float s = (u - Math::Floor(u)) * w - 0.5f;
+        float t = (v - Math::Floor(v)) * h - 0.5f;
+        float s0f = Math::Floor(s);
+        float t0f = Math::Floor(t);
+        float ds = s - s0f;
+        float dt = t - t0f;
+
+        int32 s0 = (int32)s0f;
+        int32 t0 = (int32)t0f;
+        int32 s1 = s0 + 1 >= w ? 0 : s0 + 1;
+        int32 t1 = t0 + 1 >= h ? 0 : t0 + 1;
+        s0 = s0 < 0 ? w - 1 : s0;
+        t0 = t0 < 0 ? h - 1 : t0;
+
+        const uint16* heights = tile->heights;
+        float height = (1 - ds) * (1 - dt) * heights[t0 * w + s0]
+                     + (1 - ds) *      dt  * heights[t1 * w + s0]
+                     +      ds  * (1 - dt) * heights[t0 * w + s1]
+                     +      ds  *      dt  * heights[t1 * w + s1];
+
+        return tile->offset + tile->scale * height;
+    }
+
+    #if EnableAvx2Gathers_
+
+    //=============================================================================================================================
+    static __m256 GatherHeights(const uint16* heights, __m256i indices)
+    {
+        __m256i values = _mm256_i32gather_epi32(reinterpret_cast<const int*>(heights), indices, sizeof(uint16));
+        return _mm256_cvtepi32_ps(_mm256_and_si256(values, _mm256_set1_epi32(0xFFFF)));
+    }
+
+    //=============================================================================================================================
+    static void WrapCorners(__m256 coord, __m256 sizef, __m256i size, __m256& delta, __m256i& c0, __m256i& c1)
+    {
+        __m256 scaled = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(coord, _mm256_floor_ps(coord)), sizef), _mm256_set1_ps(0.5f));
+        __m256 c0f = _mm256_floor_ps(scaled);
+        delta = _mm256_sub_ps(scaled, c0f);
+
+        __m256i lower = _mm256_cvttps_epi32(c0f);
+        __m256i upper = _mm256_add_epi32(lower, _mm256_set1_epi32(1));
+
+        c0 = _mm256_add_epi32(lower, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), lower), size));
+        c1 = _mm256_sub_epi32(upper, _mm256_and_si256(_mm256_cmpgt_epi32(upper, _mm256_sub_epi32(size, _mm256_set1_epi32(1))),
+                                                      size));
+    }
+
+    //=============================================================================================================================
+    void SampleDisplacementTile(const DisplacementTile* tile, const float* us, const float* vs, uint count, float* results)
+    {
+        __m256 one = _mm256_set1_ps(1.0f);
+        __m256 widthf = _mm256_set1_ps((float)tile->width);
+        __m256 heightf = _mm256_set1_ps((float)tile->height);
+        __m256i width = _mm256_set1_epi32((int32)tile->width);
+        __m256i height = _mm256_set1_epi32((int32)tile->height);
+        __m256 offset = _mm256_set1_ps(tile->offset);
+        __m256 scale = _mm256_set1_ps(tile->scale);
+
+        uint scan = 0;
+        for(; scan + TextureBatchWidth <= count; scan += TextureBatchWidth) {
+            __m256 ds, dt;
+            __m256i s0, s1, t0, t1;
+            WrapCorners(_mm256_loadu_ps(us + scan), widthf, width, ds, s0, s1);
+            WrapCorners(_mm256_loadu_ps(vs + scan), heightf, height, dt, t0, t1);
+
+            __m256i row0 = _mm256_mullo_epi32(t0, width);
+            __m256i row1 = _mm256_mullo_epi32(t1, width);
+
+            __m256 h00 = GatherHeights(tile->heights, _mm256_add_epi32(row0, s0));
+            __m256 h01 = GatherHeights(tile->heights, _mm256_add_epi32(row1, s0));
+            __m256 h10 = GatherHeights(tile->heights, _mm256_add_epi32(row0, s1));
+            __m256 h11 = GatherHeights(tile->heights, _mm256_add_epi32(row1, s1));
+
+            __m256 w00 = _mm256_mul_ps(_mm256_sub_ps(one, ds), _mm256_sub_ps(one, dt));
+            __m256 w01 = _mm256_mul_ps(_mm256_sub_ps(one, ds), dt);
+            __m256 w10 = _mm256_mul_ps(ds, _mm256_sub_ps(one, dt));
+            __m256 w11 = _mm256_mul_ps(ds, dt);
+
+            __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w00, h00), _mm256_mul_ps(w01, h01)),
+                                       _mm256_add_ps(_mm256_mul_ps(w10, h10), _mm256_mul_ps(w11, h11)));
+            _mm256_storeu_ps(results + scan, _mm256_add_ps(offset, _mm256_mul_ps(scale, sum)));
+        }
+
+        for(; scan < count; ++scan) {
+            results[scan] = SampleDisplacementTile(tile, us[scan], vs[scan]);
+        }
+    }
+
+    #else
+
+    //=============================================================================================================================
+    void SampleDisplacementTile(const DisplacementTile* tile, const float* us, const float* vs, uint count, float* results)
+    {
+        for(uint scan = 0; scan < count; ++scan) {
+            results[scan] = SampleDisplacementTile(tile, us[scan], vs[scan]);
+        }
+    }
+
+    #endif
+}
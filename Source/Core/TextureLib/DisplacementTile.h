@@ -0,0 +1,33 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    struct TextureResourceData;
+
+    //=============================================================================================================================
+    // -- A displacement texture pre-sampled down to a single quantized channel so displacement callbacks do not have to go
+    // -- through the texture cache or filter full color mips.
+    struct DisplacementTile
+    {
+        uint32 width;
+        uint32 height;
+
+        // -- displacement = offset + scale * heights[i]. The material's displacement amount and inversion are folded in here.
+        float offset;
+        float scale;
+
+        uint16* heights;
+    };
+
+    void BuildDisplacementTile(const TextureResourceData* texture, float amount, bool invert, DisplacementTile* tile);
+    void ShutdownDisplacementTile(DisplacementTile* tile);
+
+    // -- Bilinearly filters count displacements with repeat wrapping
+    void SampleDisplacementTile(const DisplacementTile* tile, const float* us, const float* vs, uint count, float* results);
+}
@@ -0,0 +1,501 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "TextureLib/ExrWriter.h"
+#include "StringLib/StringUtil.h"
+#include "UtilityLib/FloatingPoint.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/JsAssert.h"
+
+#include <stdio.h>
+
+#define ExrMagic_               20000630
+#define ExrVersion_             2
+#define ExrTiledFlag_           0x200
+#define ExrMaxNameLength_       31
+#define ExrMaxHeaderSize_       4096
+#define ExrRandomLineOrder_     2
+#define ExrOneLevelTiles_       0
+
+#define ExrRleMinRunLength_     3
+#define ExrRleMaxRunLength_     127
+
+#define ExrStopJob_             0xFFFFFFFF
+#define ExrInfiniteWait_        0xFFFFFFFF
+
+namespace Selas
+{
+    struct ExrTileJob
+    {
+        ExrTileJob* next;
+        uint32      tileX;
+        uint32      tileY;
+        float*      pixels;
+    };
+
+    struct ExrHeader
+    {
+        uint8  data[ExrMaxHeaderSize_];
+        uint32 size;
+    };
+
+    //=============================================================================================================================
+    // Header
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static void Append(ExrHeader* header, const void* data, uint32 size)
+    {
+        Assert_(header->size + size <= ExrMaxHeaderSize_);
+        Memory::Copy(header->data + header->size, data, size);
+        header->size += size;
+    }
+
+    //=============================================================================================================================
+    static void AppendString(ExrHeader* header, cpointer string)
+    {
+        Append(header, string, (uint32)StringUtil::Length(string) + 1);
+    }
+
+    //=============================================================================================================================
+    static void AppendInt32(ExrHeader* header, int32 value)
+    {
+        Append(header, &value, sizeof(value));
+    }
+
+    //=============================================================================================================================
+    static void AppendUint8(ExrHeader* header, uint8 value)
+    {
+        Append(header, &value, sizeof(value));
+    }
+
+    //=============================================================================================================================
+    static void AppendFloat(ExrHeader* header, float value)
+    {
+        Append(header, &value, sizeof(value));
+    }
+
+    //=============================================================================================================================
+    static void AppendAttribute(ExrHeader* header, cpointer name, cpointer type, uint32 size)
+    {
+        // -- The attribute value is expected to be appended immediately after this
+        AppendString(header, name);
+        AppendString(header, type);
+        AppendInt32(header, (int32)size);
+    }
+
+    //=============================================================================================================================
+    static void AppendBox(ExrHeader* header, cpointer name, uint32 width, uint32 height)
+    {
+        AppendAttribute(header, name, "box2i", 4 * sizeof(int32));
+        AppendInt32(header, 0);
+        AppendInt32(header, 0);
+        AppendInt32(header, (int32)width - 1);
+        AppendInt32(header, (int32)height - 1);
+    }
+
+    //=============================================================================================================================
+    static void BuildHeader(const ExrWriter* writer, ExrHeader* header)
+    {
+        header->size = 0;
+
+        AppendInt32(header, ExrMagic_);
+        AppendInt32(header, ExrVersion_ | ExrTiledFlag_);
+
+        // -- Each channel is its null terminated name followed by pixel type, pLinear + 3 reserved bytes and x/y sampling
+        uint32 channelListSize = 1;
+        for(uint32 scan = 0; scan < writer->channelCount; ++scan) {
+            channelListSize += (uint32)StringUtil::Length(writer->channels[scan].name) + 1 + 4 * sizeof(int32);
+        }
+
+        AppendAttribute(header, "channels", "chlist", channelListSize);
+        for(uint32 scan = 0; scan < writer->channelCount; ++scan) {
+            AppendString(header, writer->channels[scan].name);
+            AppendInt32(header, (int32)writer->channels[scan].type);
+            AppendInt32(header, 0);
+            AppendInt32(header, 1);
+            AppendInt32(header, 1);
+        }
+        AppendUint8(header, 0);
+
+        AppendAttribute(header, "compression", "compression", sizeof(uint8));
+        AppendUint8(header, (uint8)writer->compression);
+
+        AppendBox(header, "dataWindow", writer->width, writer->height);
+        AppendBox(header, "displayWindow", writer->width, writer->height);
+
+        // -- Tiles land in the file in whatever order they finish rendering
+        AppendAttribute(header, "lineOrder", "lineOrder", sizeof(uint8));
+        AppendUint8(header, ExrRandomLineOrder_);
+
+        AppendAttribute(header, "pixelAspectRatio", "float", sizeof(float));
+        AppendFloat(header, 1.0f);
+
+        AppendAttribute(header, "screenWindowCenter", "v2f", 2 * sizeof(float));
+        AppendFloat(header, 0.0f);
+        AppendFloat(header, 0.0f);
+
+        AppendAttribute(header, "screenWindowWidth", "float", sizeof(float));
+        AppendFloat(header, 1.0f);
+
+        AppendAttribute(header, "tiles", "tiledesc", 2 * sizeof(uint32) + sizeof(uint8));
+        AppendInt32(header, (int32)writer->tileSize);
+        AppendInt32(header, (int32)writer->tileSize);
+        AppendUint8(header, ExrOneLevelTiles_);
+
+        AppendUint8(header, 0);
+    }
+
+    //=============================================================================================================================
+    // Compression
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static uint32 RunLengthEncode(const uint8* input, uint32 inputSize, uint8* output)
+    {
+        const uint8* end = input + inputSize;
+        const uint8* runStart = input;
+        const uint8* runEnd = input + 1;
+        uint8* cursor = output;
+
+        while(runStart < end) {
+            while(runEnd < end && *runStart == *runEnd && runEnd - runStart - 1 < ExrRleMaxRunLength_) {
+                ++runEnd;
+            }
+
+            if(runEnd - runStart >= ExrRleMinRunLength_) {
+                // -- Repeated run: count - 1 followed by the value
+                *cursor++ = (uint8)((runEnd - runStart) - 1);
+                *cursor++ = *runStart;
+                runStart = runEnd;
+            }
+            else {
+                // -- Literal run: negated count followed by the values. Extend until the next repeated run starts.
+                while(runEnd < end
+                      && ((runEnd + 1 >= end || *runEnd != *(runEnd + 1)) || (runEnd + 2 >= end || *(runEnd + 1) != *(runEnd + 2)))
+                      && runEnd - runStart < ExrRleMaxRunLength_) {
+                    ++runEnd;
+                }
+
+                *cursor++ = (uint8)(runStart - runEnd);
+                while(runStart < runEnd) {
+                    *cursor++ = *runStart++;
+                }
+            }
+
+            ++runEnd;
+        }
+
+        return (uint32)(cursor - output);
+    }
+
+    //=============================================================================================================================
+    static uint32 RleCompress(const uint8* input, uint32 inputSize, uint8* scratch, uint8* output)
+    {
+        // -- Split the low and high bytes of each value into separate halves so similar bytes end up next to each other
+        uint8* low = scratch;
+        uint8* high = scratch + (inputSize + 1) / 2;
+        for(uint32 scan = 0; scan < inputSize; ++scan) {
+            if(scan & 1) {
+                *high++ = input[scan];
+            }
+            else {
+                *low++ = input[scan];
+            }
+        }
+
+        // -- Delta encode so smooth gradients become runs
+        int32 previous = scratch[0];
+        for(uint32 scan = 1; scan < inputSize; ++scan) {
+            int32 current = scratch[scan];
+            scratch[scan] = (uint8)(current - previous + (128 + 256));
+            previous = current;
+        }
+
+        return RunLengthEncode(scratch, inputSize, output);
+    }
+
+    //=============================================================================================================================
+    // Background writer
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static uint32 MaxTileDataSize(const ExrWriter* writer)
+    {
+        return writer->tileSize * writer->tileSize * writer->channelCount * sizeof(float);
+    }
+
+    //=============================================================================================================================
+    static uint32 PackTile(const ExrWriter* writer, const ExrTileJob* job, uint8* output)
+    {
+        uint32 width = Min(writer->tileSize, writer->width - job->tileX * writer->tileSize);
+        uint32 height = Min(writer->tileSize, writer->height - job->tileY * writer->tileSize);
+
+        // -- Tile data is stored a scanline at a time with each channel's values for that scanline stored contiguously
+        uint8* cursor = output;
+        for(uint32 y = 0; y < height; ++y) {
+            for(uint32 channel = 0; channel < writer->channelCount; ++channel) {
+                const float* source = job->pixels + y * writer->tileSize * writer->channelCount + writer->sourceIndices[channel];
+
+                for(uint32 x = 0; x < width; ++x) {
+                    float value = source[x * writer->channelCount];
+
+                    switch(writer->channels[channel].type) {
+                    case eExrPixelHalf:
+                    {
+                        uint16 half = FloatToHalf(value);
+                        Memory::Copy(cursor, &half, sizeof(half));
+                        cursor += sizeof(half);
+                        break;
+                    }
+                    case eExrPixelFloat:
+                        Memory::Copy(cursor, &value, sizeof(value));
+                        cursor += sizeof(value);
+                        break;
+                    case eExrPixelUint:
+                    {
+                        uint32 integer = (uint32)(Max(value, 0.0f) + 0.5f);
+                        Memory::Copy(cursor, &integer, sizeof(integer));
+                        cursor += sizeof(integer);
+                        break;
+                    }
+                    }
+                }
+            }
+        }
+
+        return (uint32)(cursor - output);
+    }
+
+    //=============================================================================================================================
+    static void WriteChunk(ExrWriter* writer, const ExrTileJob* job, const uint8* data, uint32 dataSize)
+    {
+        int32 chunkHeader[5] = { (int32)job->tileX, (int32)job->tileY, 0, 0, (int32)dataSize };
+
+        FILE* file = static_cast<FILE*>(writer->file);
+        bool success = fwrite(chunkHeader, sizeof(chunkHeader), 1, file) == 1;
+        success = success && fwrite(data, dataSize, 1, file) == 1;
+        if(success == false) {
+            writer->writeFailed = true;
+            return;
+        }
+
+        writer->tileOffsets[job->tileY * writer->tileCountX + job->tileX] = writer->filePosition;
+        writer->filePosition += sizeof(chunkHeader) + dataSize;
+    }
+
+    //=============================================================================================================================
+    static ExrTileJob* PopJob(ExrWriter* writer)
+    {
+        WaitForSemaphore(writer->queueSemaphore, ExrInfiniteWait_);
+
+        EnterSpinLock(writer->queueLock);
+        ExrTileJob* job = writer->queueHead;
+        writer->queueHead = job->next;
+        if(writer->queueHead == nullptr) {
+            writer->queueTail = nullptr;
+        }
+        LeaveSpinLock(writer->queueLock);
+
+        return job;
+    }
+
+    //=============================================================================================================================
+    static void PushJob(ExrWriter* writer, ExrTileJob* job)
+    {
+        job->next = nullptr;
+
+        EnterSpinLock(writer->queueLock);
+        if(writer->queueTail) {
+            writer->queueTail->next = job;
+        }
+        else {
+            writer->queueHead = job;
+        }
+        writer->queueTail = job;
+        LeaveSpinLock(writer->queueLock);
+
+        PostSemaphore(writer->queueSemaphore, 1);
+    }
+
+    //=============================================================================================================================
+    static void ExrWriterThread(void* userData)
+    {
+        ExrWriter* writer = static_cast<ExrWriter*>(userData);
+
+        uint32 maxSize = MaxTileDataSize(writer);
+        uint8* raw = AllocArray_(uint8, maxSize);
+        uint8* scratch = AllocArray_(uint8, maxSize);
+        uint8* compressed = AllocArray_(uint8, (2 * maxSize + 16));
+
+        while(true) {
+            ExrTileJob* job = PopJob(writer);
+            if(job->tileX == ExrStopJob_) {
+                Free_(job);
+                break;
+            }
+
+            uint32 rawSize = PackTile(writer, job, raw);
+
+            // -- Readers detect uncompressed chunks by their size so chunks that do not shrink are stored as is
+            uint32 compressedSize = rawSize;
+            if(writer->compression == eExrRleCompression) {
+                compressedSize = RleCompress(raw, rawSize, scratch, compressed);
+            }
+
+            if(compressedSize < rawSize) {
+                WriteChunk(writer, job, compressed, compressedSize);
+            }
+            else {
+                WriteChunk(writer, job, raw, rawSize);
+            }
+
+            Free_(job);
+        }
+
+        Free_(compressed);
+        Free_(scratch);
+        Free_(raw);
+    }
+
+    //=============================================================================================================================
+    // ExrWriter
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static FILE* OpenFile(cpointer filepath)
+    {
+        FILE* result = nullptr;
+
+        #if IsWindows_
+            fopen_s(&result, filepath, "wb");
+        #else
+            result = fopen(filepath, "wb");
+        #endif
+
+        return result;
+    }
+
+    //=============================================================================================================================
+    Error ExrWriter_Open(ExrWriter* writer, cpointer filepath, uint32 width, uint32 height, uint32 tileSize,
+                         const ExrChannel* channels, uint32 channelCount, ExrCompression compression)
+    {
+        Assert_(channelCount > 0 && channelCount <= MaxExrChannels_);
+
+        writer->width = width;
+        writer->height = height;
+        writer->tileSize = tileSize;
+        writer->tileCountX = (width + tileSize - 1) / tileSize;
+        writer->tileCountY = (height + tileSize - 1) / tileSize;
+        writer->channelCount = channelCount;
+        writer->compression = (uint32)compression;
+        writer->writeFailed = false;
+
+        // -- The channel list must be sorted by name. Insertion sort while remembering where each came from.
+        for(uint32 scan = 0; scan < channelCount; ++scan) {
+            Assert_(StringUtil::Length(channels[scan].name) <= ExrMaxNameLength_);
+
+            uint32 insert = scan;
+            while(insert > 0 && StringUtil::Compare(writer->channels[insert - 1].name, channels[scan].name) > 0) {
+                writer->channels[insert] = writer->channels[insert - 1];
+                writer->sourceIndices[insert] = writer->sourceIndices[insert - 1];
+                --insert;
+            }
+            writer->channels[insert] = channels[scan];
+            writer->sourceIndices[insert] = scan;
+        }
+
+        FILE* file = OpenFile(filepath);
+        if(file == nullptr) {
+            return Error_("Failed to open file: %s", filepath);
+        }
+
+        ExrHeader header;
+        BuildHeader(writer, &header);
+
+        uint32 tileCount = writer->tileCountX * writer->tileCountY;
+        writer->tileOffsets = AllocArray_(uint64, tileCount);
+        Memory::Zero(writer->tileOffsets, tileCount * sizeof(uint64));
+
+        // -- The offset table is written now as a placeholder and again once every tile's position is known
+        bool success = fwrite(header.data, header.size, 1, file) == 1;
+        success = success && fwrite(writer->tileOffsets, tileCount * sizeof(uint64), 1, file) == 1;
+        if(success == false) {
+            fclose(file);
+            SafeFree_(writer->tileOffsets);
+            return Error_("Failed to write exr header to %s", filepath);
+        }
+
+        writer->file = file;
+        writer->offsetTablePosition = header.size;
+        writer->filePosition = header.size + tileCount * sizeof(uint64);
+
+        writer->queueHead = nullptr;
+        writer->queueTail = nullptr;
+        CreateSpinLock(writer->queueLock);
+        writer->queueSemaphore = CreateOSSemaphore(0, tileCount + 1);
+
+        writer->thread = CreateThread(ExrWriterThread, writer);
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    void ExrWriter_QueueTile(ExrWriter* writer, uint32 tileX, uint32 tileY, const float* pixels)
+    {
+        Assert_(tileX < writer->tileCountX && tileY < writer->tileCountY);
+
+        uint32 pixelsSize = writer->tileSize * writer->tileSize * writer->channelCount * sizeof(float);
+
+        // -- Job and pixel copy share one allocation which the background thread frees once the tile is written
+        ExrTileJob* job = static_cast<ExrTileJob*>(Alloc_(sizeof(ExrTileJob) + pixelsSize));
+        job->tileX = tileX;
+        job->tileY = tileY;
+        job->pixels = reinterpret_cast<float*>(job + 1);
+        Memory::Copy(job->pixels, pixels, pixelsSize);
+
+        PushJob(writer, job);
+    }
+
+    //=============================================================================================================================
+    Error ExrWriter_Close(ExrWriter* writer)
+    {
+        ExrTileJob* stop = static_cast<ExrTileJob*>(Alloc_(sizeof(ExrTileJob)));
+        stop->tileX = ExrStopJob_;
+        stop->tileY = ExrStopJob_;
+        stop->pixels = nullptr;
+        PushJob(writer, stop);
+
+        ShutdownThread(writer->thread);
+        CloseOSSemaphore(writer->queueSemaphore);
+
+        FILE* file = static_cast<FILE*>(writer->file);
+
+        Error error = Success_;
+        uint32 tileCount = writer->tileCountX * writer->tileCountY;
+        for(uint32 scan = 0; scan < tileCount; ++scan) {
+            if(writer->tileOffsets[scan] == 0) {
+                error = Error_("Exr tile %u was never written", scan);
+                break;
+            }
+        }
+
+        if(writer->writeFailed) {
+            error = Error_("Failed to write exr tile data");
+        }
+
+        if(fseek(file, (long)writer->offsetTablePosition, SEEK_SET) != 0
+           || fwrite(writer->tileOffsets, tileCount * sizeof(uint64), 1, file) != 1) {
+            error = Error_("Failed to write exr tile offsets");
+        }
+
+        fclose(file);
+        writer->file = nullptr;
+        SafeFree_(writer->tileOffsets);
+
+        return error;
+    }
+}
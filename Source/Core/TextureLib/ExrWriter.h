@@ -0,0 +1,79 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/Error.h"
+#include "SystemLib/BasicTypes.h"
+#include "SystemLib/OSThreading.h"
+#include "ThreadingLib/Thread.h"
+
+namespace Selas
+{
+    #define MaxExrChannels_ 16
+
+    // -- Values match the OpenEXR pixel type and compression enums and are written to the file as is
+    enum ExrPixelType
+    {
+        eExrPixelUint  = 0,
+        eExrPixelHalf  = 1,
+        eExrPixelFloat = 2
+    };
+
+    enum ExrCompression
+    {
+        eExrNoCompression  = 0,
+        eExrRleCompression = 1
+    };
+
+    struct ExrChannel
+    {
+        cpointer     name;
+        ExrPixelType type;
+    };
+
+    struct ExrTileJob;
+
+    //=============================================================================================================================
+    // -- Writes a single part, single level, tiled OpenEXR file. Tiles may be queued in any order from any thread; they are
+    // -- converted, compressed and appended to the file on a background thread and the tile offset table is patched in
+    // -- when the writer is closed.
+    struct ExrWriter
+    {
+        void*  file;
+        uint32 width;
+        uint32 height;
+        uint32 tileSize;
+        uint32 tileCountX;
+        uint32 tileCountY;
+        uint32 channelCount;
+        uint32 compression;
+
+        // -- Channels in file order (sorted by name) and the index of each within the caller's pixel layout
+        ExrChannel channels[MaxExrChannels_];
+        uint32     sourceIndices[MaxExrChannels_];
+
+        uint64  offsetTablePosition;
+        uint64  filePosition;
+        uint64* tileOffsets;
+        bool    writeFailed;
+
+        ExrTileJob* queueHead;
+        ExrTileJob* queueTail;
+        uint8       queueLock[CacheLineSize_];
+        void*       queueSemaphore;
+
+        ThreadHandle thread;
+    };
+
+    Error ExrWriter_Open(ExrWriter* writer, cpointer filepath, uint32 width, uint32 height, uint32 tileSize,
+                         const ExrChannel* channels, uint32 channelCount, ExrCompression compression);
+
+    // -- pixels holds tileSize * tileSize pixels, each with one float per channel in the order the channels were passed to
+    // -- ExrWriter_Open. Pixels outside of the image are ignored. The data is copied before this returns.
+    void ExrWriter_QueueTile(ExrWriter* writer, uint32 tileX, uint32 tileY, const float* pixels);
+
+    // -- Waits for the queued tiles to be written. Fails if any tile was never queued.
+    Error ExrWriter_Close(ExrWriter* writer);
+}
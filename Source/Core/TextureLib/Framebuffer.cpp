@@ -4,149 +4,969 @@
 
 #include "TextureLib/Framebuffer.h"
 #include "TextureLib/StbImage.h"
+#include "TextureLib/ExrWriter.h"
 #include "StringLib/FixedString.h"
 #include "StringLib/StringUtil.h"
+#include "UtilityLib/FloatingPoint.h"
 #include "MathLib/FloatFuncs.h"
+#include "MathLib/Trigonometric.h"
 #include "IoLib/Environment.h"
 #include "IoLib/Directory.h"
 #include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/Memory.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/CountOf.h"
+
+#define MinRelativeErrorLuminance_ 0.01f
+
+// -- Fixed point sums keep 24 fractional bits. Single contributions are clamped so even a very long render of bright samples
+// -- stays far from the int64 limit.
+#define FixedPointFractionBits_    24
+#define FixedPointMaxValue_        1.0e7
 
 namespace Selas
 {
     //=============================================================================================================================
-    void FrameBuffer_Initialize(Framebuffer* frame, uint32 width, uint32 height, uint32 layerCount)
+    // Aov storage
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static void InitializeAov(FramebufferAov* aov, uint32 components, bool half, uint32 pixelCount)
+    {
+        uint32 componentSize = half ? sizeof(uint16) : sizeof(float);
+        uint64 size = (uint64)pixelCount * components * componentSize;
+
+        aov->components = components;
+        aov->half = half ? 1 : 0;
+        aov->data = AllocAligned_(size, 16);
+        Memory::Zero(aov->data, size);
+    }
+
+    //=============================================================================================================================
+    static float ReadAov(const FramebufferAov* aov, uint32 index, uint32 component)
+    {
+        uint32 offset = index * aov->components + component;
+        if(aov->half) {
+            return HalfToFloat(static_cast<const uint16*>(aov->data)[offset]);
+        }
+        return static_cast<const float*>(aov->data)[offset];
+    }
+
+    //=============================================================================================================================
+    static void WriteAov(FramebufferAov* aov, uint32 index, uint32 component, float value)
+    {
+        uint32 offset = index * aov->components + component;
+        if(aov->half) {
+            static_cast<uint16*>(aov->data)[offset] = FloatToHalf(value);
+        }
+        else {
+            static_cast<float*>(aov->data)[offset] = value;
+        }
+    }
+
+    //=============================================================================================================================
+    static void AccumulateAovMean(FramebufferAov* aov, uint32 index, const float* values, float sampleCount)
+    {
+        if(aov->data == nullptr) {
+            return;
+        }
+
+        // -- Running mean so half storage never has to hold a large sum
+        float weight = 1.0f / sampleCount;
+        for(uint32 component = 0; component < aov->components; ++component) {
+            float mean = ReadAov(aov, index, component);
+            WriteAov(aov, index, component, mean + (values[component] - mean) * weight);
+        }
+    }
+
+    //=============================================================================================================================
+    // Fixed point accumulation
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static int64 ToFixedPoint(float value)
+    {
+        // -- A NaN would poison every later sum of the pixel so it is dropped
+        if(Math::IsNaN(value)) {
+            return 0;
+        }
+
+        double scaled = Clamp<double>(value, -FixedPointMaxValue_, FixedPointMaxValue_) * (double)(1ll << FixedPointFractionBits_);
+        return (int64)(scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+    }
+
+    //=============================================================================================================================
+    static double FromFixedPoint(int64 value)
+    {
+        return (double)value * (1.0 / (double)(1ll << FixedPointFractionBits_));
+    }
+
+    //=============================================================================================================================
+    static void AddFixedPoint(int64* sums, const float* values, uint32 count)
+    {
+        for(uint32 scan = 0; scan < count; ++scan) {
+            sums[scan] += ToFixedPoint(values[scan]);
+        }
+    }
+
+    //=============================================================================================================================
+    static void ResolveFixedPointTile(Framebuffer* __restrict frame, uint32 tile)
+    {
+        FramebufferAov* aovs[] = { &frame->albedo, &frame->normal, &frame->depth };
+
+        uint32 start = tile * FramebufferTilePixelCount_;
+        for(uint32 index = start; index < start + FramebufferTilePixelCount_; ++index) {
+            const int64* sums = frame->fixedSums + (uint64)index * frame->fixedStride;
+
+            frame->beauty[index] = float3((float)FromFixedPoint(sums[0]), (float)FromFixedPoint(sums[1]),
+                                          (float)FromFixedPoint(sums[2]));
+            sums += 3;
+
+            uint32 sampleCount = frame->sampleCounts[index];
+            double weight = sampleCount > 0 ? 1.0 / sampleCount : 0.0;
+            for(uint32 aov = 0; aov < CountOf_(aovs); ++aov) {
+                if(aovs[aov]->data == nullptr) {
+                    continue;
+                }
+                for(uint32 component = 0; component < aovs[aov]->components; ++component) {
+                    WriteAov(aovs[aov], index, component, (float)(FromFixedPoint(*sums++) * weight));
+                }
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void ResolveFixedPoint(Framebuffer* frame)
     {
-        CreateSpinLock(frame->spinlock);
+        if(frame->fixedSums == nullptr) {
+            return;
+        }
+
+        uint32 tileCount = FrameBuffer_TileCount(frame);
+        for(uint32 tile = 0; tile < tileCount; ++tile) {
+            ResolveFixedPointTile(frame, tile);
+        }
+    }
+
+    //=============================================================================================================================
+    // Moments
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static float Luminance(float3 rgb)
+    {
+        return 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
+    }
+
+    //=============================================================================================================================
+    static float SampleVariance(const FramebufferMoments& moments)
+    {
+        if(moments.count < 2.0f) {
+            return 0.0f;
+        }
+
+        float mean = moments.sum / moments.count;
+        return Max((moments.sumSquares - moments.sum * mean) / (moments.count - 1.0f), 0.0f);
+    }
+
+    //=============================================================================================================================
+    static float VarianceOfMean(const FramebufferMoments& moments)
+    {
+        return moments.count > 0.0f ? SampleVariance(moments) / moments.count : 0.0f;
+    }
+
+    //=============================================================================================================================
+    void FramebufferMoments_Add(FramebufferMoments* moments, float3 estimate)
+    {
+        float luminance = Luminance(estimate);
+
+        moments->count += 1.0f;
+        moments->sum += luminance;
+        moments->sumSquares += luminance * luminance;
+    }
+
+    //=============================================================================================================================
+    float FramebufferMoments_RelativeError(const FramebufferMoments& moments)
+    {
+        if(moments.count < 2.0f) {
+            return FloatMax_;
+        }
+
+        // -- Clamp the denominator so dark pixels are not held to an impossible standard
+        float mean = moments.sum / moments.count;
+        return Math::Sqrtf(VarianceOfMean(moments)) / Max(mean, MinRelativeErrorLuminance_);
+    }
+
+    //=============================================================================================================================
+    // Framebuffer
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static void* CarveWriterStorage(uint8* storage, uint64& offset, uint64 size)
+    {
+        void* address = storage + offset;
+        offset += (size + 15) & ~(uint64)15;
+        return address;
+    }
+
+    //=============================================================================================================================
+    static uint64 LayoutWriterStorage(FramebufferWriter* writer, uint8* storage, uint32 capacity, uint32 tileCount)
+    {
+        // -- Called with null storage to size the block
+        uint64 offset = 0;
+        writer->sampleIndices     = (uint32*)CarveWriterStorage(storage, offset, capacity * sizeof(uint32));
+        writer->samples           = (float3*)CarveWriterStorage(storage, offset, capacity * sizeof(float3));
+        writer->primaryIndices    = (uint32*)CarveWriterStorage(storage, offset, capacity * sizeof(uint32));
+        writer->primarySamples    = (FramebufferPrimarySample*)CarveWriterStorage(storage, offset,
+                                                                                  capacity * sizeof(FramebufferPrimarySample));
+        writer->tileStarts        = (uint32*)CarveWriterStorage(storage, offset, (tileCount + 1) * sizeof(uint32));
+        writer->primaryTileStarts = (uint32*)CarveWriterStorage(storage, offset, (tileCount + 1) * sizeof(uint32));
+        writer->tileCursors       = (uint32*)CarveWriterStorage(storage, offset, tileCount * sizeof(uint32));
+        writer->sampleOrder       = (uint32*)CarveWriterStorage(storage, offset, capacity * sizeof(uint32));
+        writer->primaryOrder      = (uint32*)CarveWriterStorage(storage, offset, capacity * sizeof(uint32));
+        writer->tileEndCounts     = (uint32*)CarveWriterStorage(storage, offset, tileCount * sizeof(uint32));
+
+        return offset;
+    }
+
+    //=============================================================================================================================
+    void FrameBuffer_Initialize(Framebuffer* frame, uint32 width, uint32 height, uint32 flags)
+    {
+        if(flags & (eAlbedoAov | eNormalAov | eDepthAov | eVarianceAov | eFixedPointAccumulation)) {
+            flags |= eSampleCountAov;
+        }
 
         frame->width = width;
         frame->height = height;
-        frame->layerCount = layerCount;
-        
-        frame->buffers = AllocArray_(float3*, layerCount);
-        for(uint scan = 0; scan < layerCount; ++scan) {
-            frame->buffers[scan] = AllocArrayAligned_(float3, width * height, 16);
-            Memory::Zero(frame->buffers[scan], sizeof(float3) * width * height);
+        frame->tileCountX = (width + FramebufferTileSize_ - 1) / FramebufferTileSize_;
+        frame->tileCountY = (height + FramebufferTileSize_ - 1) / FramebufferTileSize_;
+        frame->flags = flags;
+        frame->fixedStride = 0;
+
+        // -- Storage is padded out to whole tiles so edge tiles need no special casing
+        uint32 tileCount = FrameBuffer_TileCount(frame);
+        uint32 pixelCount = tileCount * FramebufferTilePixelCount_;
+
+        frame->beauty = AllocArrayAligned_(float3, pixelCount, 16);
+        Memory::Zero(frame->beauty, sizeof(float3) * pixelCount);
+
+        Memory::Zero(&frame->albedo, sizeof(frame->albedo));
+        Memory::Zero(&frame->normal, sizeof(frame->normal));
+        Memory::Zero(&frame->depth, sizeof(frame->depth));
+
+        bool half = (flags & eHalfAovStorage) != 0;
+        if(flags & eAlbedoAov) {
+            InitializeAov(&frame->albedo, 3, half, pixelCount);
+        }
+        if(flags & eNormalAov) {
+            InitializeAov(&frame->normal, 3, half, pixelCount);
         }
+        if(flags & eDepthAov) {
+            InitializeAov(&frame->depth, 1, half, pixelCount);
+        }
+
+        frame->sampleCounts = nullptr;
+        if(flags & eSampleCountAov) {
+            frame->sampleCounts = AllocArrayAligned_(uint32, pixelCount, 16);
+            Memory::Zero(frame->sampleCounts, sizeof(uint32) * pixelCount);
+        }
+
+        frame->moments = nullptr;
+        if(flags & eVarianceAov) {
+            frame->moments = AllocArrayAligned_(FramebufferMoments, pixelCount, 16);
+            Memory::Zero(frame->moments, sizeof(FramebufferMoments) * pixelCount);
+        }
+
+        frame->fixedSums = nullptr;
+        if(flags & eFixedPointAccumulation) {
+            frame->fixedStride = 3 + frame->albedo.components + frame->normal.components + frame->depth.components;
+
+            uint64 size = (uint64)pixelCount * frame->fixedStride * sizeof(int64);
+            frame->fixedSums = (int64*)AllocAligned_(size, 16);
+            Memory::Zero(frame->fixedSums, size);
+        }
+
+        frame->tileLocks = AllocArrayAligned_(FramebufferTileLock, tileCount, CacheLineSize_);
+        for(uint32 scan = 0; scan < tileCount; ++scan) {
+            CreateSpinLock(frame->tileLocks[scan].spinlock);
+        }
+
+        frame->tilePendingWork = nullptr;
+        frame->tileStreamed = nullptr;
+        frame->stream = nullptr;
+        frame->streamBeautyScale = 1.0f;
+
+        FramebufferWriter layout;
+        uint64 writerSize = LayoutWriterStorage(&layout, nullptr, DefaultFrameWriterCapacity_, tileCount);
+        BufferPool_Initialize(&frame->writerPool, writerSize, eAllocationTagFramebuffer);
     }
 
     //=============================================================================================================================
     void FrameBuffer_Shutdown(Framebuffer* frame)
     {
-        for(uint scan = 0; scan < frame->layerCount; ++scan) {
-            FreeAligned_(frame->buffers[scan]);
+        Assert_(frame->stream == nullptr);
+
+        SafeFreeAligned_(frame->beauty);
+        SafeFreeAligned_(frame->albedo.data);
+        SafeFreeAligned_(frame->normal.data);
+        SafeFreeAligned_(frame->depth.data);
+        SafeFreeAligned_(frame->sampleCounts);
+        SafeFreeAligned_(frame->moments);
+        SafeFreeAligned_(frame->fixedSums);
+        SafeFreeAligned_(frame->tileLocks);
+
+        BufferPool_Shutdown(&frame->writerPool);
+    }
+
+    //=============================================================================================================================
+    uint32 FrameBuffer_TileCount(const Framebuffer* frame)
+    {
+        return frame->tileCountX * frame->tileCountY;
+    }
+
+    //=============================================================================================================================
+    uint32 FrameBuffer_StorageIndex(const Framebuffer* frame, uint32 x, uint32 y)
+    {
+        uint32 tile = (y >> FramebufferTileShift_) * frame->tileCountX + (x >> FramebufferTileShift_);
+        uint32 inner = ((y & (FramebufferTileSize_ - 1)) << FramebufferTileShift_) + (x & (FramebufferTileSize_ - 1));
+
+        return tile * FramebufferTilePixelCount_ + inner;
+    }
+
+    //=============================================================================================================================
+    uint32 FrameBuffer_StorageIndex(const Framebuffer* frame, uint32 pixelIndex)
+    {
+        uint32 y = pixelIndex / frame->width;
+        uint32 x = pixelIndex - y * frame->width;
+
+        return FrameBuffer_StorageIndex(frame, x, y);
+    }
+
+    //=============================================================================================================================
+    void FrameBuffer_AccumulatePassMoments(Framebuffer* frame, uint32 samplesPerPass)
+    {
+        Assert_(frame->moments != nullptr);
+
+        ResolveFixedPoint(frame);
+
+        float invSamplesPerPass = 1.0f / samplesPerPass;
+
+        uint32 pixelCount = FrameBuffer_TileCount(frame) * FramebufferTilePixelCount_;
+        for(uint32 index = 0; index < pixelCount; ++index) {
+            FramebufferMoments& moments = frame->moments[index];
+            if(frame->sampleCounts[index] <= (uint32)moments.count * samplesPerPass) {
+                continue;
+            }
+
+            // -- Beauty holds samplesPerPass times the sum of all earlier estimates so the difference is this pass's estimate
+            float estimate = Luminance(frame->beauty[index]) * invSamplesPerPass - moments.sum;
+
+            moments.count += 1.0f;
+            moments.sum += estimate;
+            moments.sumSquares += estimate * estimate;
         }
-        Free_(frame->buffers);
     }
 
     //=============================================================================================================================
-    void FrameBuffer_Save(Framebuffer* frame, cpointer name)
+    void FrameBuffer_AddMoments(Framebuffer* frame, uint32 pixelIndex, const FramebufferMoments& moments)
+    {
+        FramebufferMoments& pixel = frame->moments[FrameBuffer_StorageIndex(frame, pixelIndex)];
+        pixel.count += moments.count;
+        pixel.sum += moments.sum;
+        pixel.sumSquares += moments.sumSquares;
+    }
+
+    //=============================================================================================================================
+    float FrameBuffer_RelativeError(const Framebuffer* frame, uint32 pixelIndex)
+    {
+        return FramebufferMoments_RelativeError(frame->moments[FrameBuffer_StorageIndex(frame, pixelIndex)]);
+    }
+
+    //=============================================================================================================================
+    float FrameBuffer_MeanLuminance(const Framebuffer* frame, uint32 pixelIndex)
+    {
+        const FramebufferMoments& moments = frame->moments[FrameBuffer_StorageIndex(frame, pixelIndex)];
+        if(moments.count == 0.0f) {
+            return 0.0f;
+        }
+
+        return moments.sum / moments.count;
+    }
+
+    //=============================================================================================================================
+    void FrameBuffer_Resolve(const Framebuffer* frame, FramebufferChannel channel, float3* image)
+    {
+        for(uint32 y = 0; y < frame->height; ++y) {
+            for(uint32 x = 0; x < frame->width; ++x) {
+                uint32 index = FrameBuffer_StorageIndex(frame, x, y);
+                float3& pixel = image[y * frame->width + x];
+
+                switch(channel) {
+                case eBeautyChannel:
+                    pixel = frame->beauty[index];
+                    break;
+                case eAlbedoChannel:
+                    pixel = float3(ReadAov(&frame->albedo, index, 0), ReadAov(&frame->albedo, index, 1),
+                                   ReadAov(&frame->albedo, index, 2));
+                    break;
+                case eNormalChannel:
+                    pixel = float3(ReadAov(&frame->normal, index, 0), ReadAov(&frame->normal, index, 1),
+                                   ReadAov(&frame->normal, index, 2));
+                    break;
+                case eDepthChannel:
+                    pixel = float3(ReadAov(&frame->depth, index, 0));
+                    break;
+                case eSampleCountChannel:
+                    pixel = float3((float)frame->sampleCounts[index]);
+                    break;
+                case eVarianceChannel:
+                    pixel = float3(VarianceOfMean(frame->moments[index]));
+                    break;
+                default:
+                    Assert_(false);
+                }
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static bool ChannelEnabled(const Framebuffer* frame, FramebufferChannel channel)
+    {
+        switch(channel) {
+        case eBeautyChannel:
+            return true;
+        case eAlbedoChannel:
+            return (frame->flags & eAlbedoAov) != 0;
+        case eNormalChannel:
+            return (frame->flags & eNormalAov) != 0;
+        case eDepthChannel:
+            return (frame->flags & eDepthAov) != 0;
+        case eSampleCountChannel:
+            return (frame->flags & eSampleCountAov) != 0;
+        case eVarianceChannel:
+            return (frame->flags & eVarianceAov) != 0;
+        default:
+            return false;
+        }
+    }
+
+    //=============================================================================================================================
+    static void ImageDirectory(FilePathString& dirpath)
     {
         FixedString128 root = Environment_Root();
         uint8 pathsep = StringUtil::PathSeperator();
 
-        FilePathString dirpath;
         FixedStringSprintf(dirpath, "%s_Images%c", root.Ascii(), pathsep);
 
         Directory::EnsureDirectoryExists(dirpath.Ascii());
+    }
+
+    //=============================================================================================================================
+    void FrameBuffer_Save(Framebuffer* frame, cpointer name)
+    {
+        static cpointer channelNames[eFramebufferChannelCount] = { "beauty", "albedo", "normal", "depth", "samples",
+                                                                   "variance" };
+
+        ResolveFixedPoint(frame);
+
+        FilePathString dirpath;
+        ImageDirectory(dirpath);
+
+        float3* image = AllocArray_(float3, frame->width * frame->height);
+
+        for(uint32 channel = 0; channel < eFramebufferChannelCount; ++channel) {
+            if(ChannelEnabled(frame, (FramebufferChannel)channel) == false) {
+                continue;
+            }
+
+            FrameBuffer_Resolve(frame, (FramebufferChannel)channel, image);
+
+            // -- Radiance .hdr files cannot hold negative values so normals are remapped into [0, 1]
+            if(channel == eNormalChannel) {
+                for(uint32 scan = 0, count = frame->width * frame->height; scan < count; ++scan) {
+                    image[scan] = 0.5f * image[scan] + float3(0.5f);
+                }
+            }
 
-        for(uint32 scan = 0, count = frame->layerCount; scan < count; ++scan) {
             FilePathString filepath;
-            FixedStringSprintf(filepath, "%s%s_%u.hdr", dirpath.Ascii(), name, scan);
+            FixedStringSprintf(filepath, "%s%s_%s.hdr", dirpath.Ascii(), name, channelNames[channel]);
 
-            StbImageWrite(filepath.Ascii(), frame->width, frame->height, 3, HDR, frame->buffers[scan]);
+            StbImageWrite(filepath.Ascii(), frame->width, frame->height, 3, HDR, image);
         }
+
+        Free_(image);
     }
 
     //=============================================================================================================================
     void FrameBuffer_Scale(Framebuffer* __restrict frame, float term)
     {
-        uint indexcount = frame->width * frame->height;
-        for(uint layer = 0; layer < frame->layerCount; ++layer) {
-            for(uint scan = 0; scan < indexcount; ++scan) {
-                frame->buffers[layer][scan] = frame->buffers[layer][scan] * term;
+        // -- Only beauty is a sum. The feature aovs are already means.
+        uint pixelCount = FrameBuffer_TileCount(frame) * FramebufferTilePixelCount_;
+        for(uint scan = 0; scan < pixelCount; ++scan) {
+            frame->beauty[scan] = frame->beauty[scan] * term;
+        }
+
+        if(frame->fixedSums) {
+            for(uint scan = 0; scan < pixelCount; ++scan) {
+                int64* sums = frame->fixedSums + (uint64)scan * frame->fixedStride;
+                for(uint32 component = 0; component < 3; ++component) {
+                    sums[component] = ToFixedPoint((float)(FromFixedPoint(sums[component]) * term));
+                }
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    // Exr streaming
+    //=============================================================================================================================
+
+    //=============================================================================================================================
+    static uint32 ExrChannels(const Framebuffer* frame, ExrChannel* channels)
+    {
+        // -- This is the packing order used by PackExrTile. The exr writer sorts them by name for the file.
+        ExrPixelType aovType = (frame->flags & eHalfAovStorage) ? eExrPixelHalf : eExrPixelFloat;
+
+        uint32 count = 0;
+        channels[count++] = { "R", eExrPixelFloat };
+        channels[count++] = { "G", eExrPixelFloat };
+        channels[count++] = { "B", eExrPixelFloat };
+        if(frame->flags & eAlbedoAov) {
+            channels[count++] = { "albedo.R", aovType };
+            channels[count++] = { "albedo.G", aovType };
+            channels[count++] = { "albedo.B", aovType };
+        }
+        if(frame->flags & eNormalAov) {
+            channels[count++] = { "normal.X", aovType };
+            channels[count++] = { "normal.Y", aovType };
+            channels[count++] = { "normal.Z", aovType };
+        }
+        if(frame->flags & eDepthAov) {
+            channels[count++] = { "Z", aovType };
+        }
+        if(frame->flags & eSampleCountAov) {
+            channels[count++] = { "sampleCount", eExrPixelUint };
+        }
+        if(frame->flags & eVarianceAov) {
+            channels[count++] = { "variance", eExrPixelFloat };
+        }
+
+        return count;
+    }
+
+    //=============================================================================================================================
+    static void PackExrTile(const Framebuffer* frame, uint32 tile, uint32 channelCount, float* pixels)
+    {
+        const FramebufferAov* aovs[] = { &frame->albedo, &frame->normal, &frame->depth };
+
+        // -- Storage within a tile is already row major so it maps directly onto exr tile pixels
+        uint32 start = tile * FramebufferTilePixelCount_;
+        for(uint32 pixel = 0; pixel < FramebufferTilePixelCount_; ++pixel) {
+            uint32 index = start + pixel;
+            float* cursor = pixels + pixel * channelCount;
+
+            float scale = frame->streamBeautyScale;
+            if(scale == 0.0f) {
+                scale = frame->sampleCounts[index] > 0 ? 1.0f / frame->sampleCounts[index] : 0.0f;
+            }
+
+            float3 beauty = frame->beauty[index] * scale;
+            *cursor++ = beauty.x;
+            *cursor++ = beauty.y;
+            *cursor++ = beauty.z;
+
+            for(uint32 aov = 0; aov < CountOf_(aovs); ++aov) {
+                if(aovs[aov]->data == nullptr) {
+                    continue;
+                }
+                for(uint32 component = 0; component < aovs[aov]->components; ++component) {
+                    *cursor++ = ReadAov(aovs[aov], index, component);
+                }
+            }
+
+            if(frame->sampleCounts) {
+                *cursor++ = (float)frame->sampleCounts[index];
+            }
+
+            if(frame->moments) {
+                *cursor++ = VarianceOfMean(frame->moments[index]);
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void StreamTile(Framebuffer* frame, uint32 tile)
+    {
+        ExrWriter* stream = frame->stream;
+
+        if(frame->fixedSums) {
+            ResolveFixedPointTile(frame, tile);
+        }
+
+        float pixels[FramebufferTilePixelCount_ * MaxExrChannels_];
+        PackExrTile(frame, tile, stream->channelCount, pixels);
+
+        frame->tileStreamed[tile] = 1;
+        ExrWriter_QueueTile(stream, tile % frame->tileCountX, tile / frame->tileCountX, pixels);
+    }
+
+    //=============================================================================================================================
+    Error FrameBuffer_BeginStream(Framebuffer* frame, cpointer name, float beautyScale)
+    {
+        Assert_(frame->stream == nullptr);
+        Assert_(beautyScale > 0.0f || frame->sampleCounts != nullptr);
+
+        FilePathString dirpath;
+        ImageDirectory(dirpath);
+
+        FilePathString filepath;
+        FixedStringSprintf(filepath, "%s%s.exr", dirpath.Ascii(), name);
+
+        ExrChannel channels[MaxExrChannels_];
+        uint32 channelCount = ExrChannels(frame, channels);
+
+        ExrWriter* stream = New_(ExrWriter);
+        Error error = ExrWriter_Open(stream, filepath.Ascii(), frame->width, frame->height, FramebufferTileSize_, channels,
+                                     channelCount, eExrRleCompression);
+        if(Failed_(error)) {
+            Delete_(stream);
+            return error;
+        }
+
+        uint32 tileCount = FrameBuffer_TileCount(frame);
+        frame->tilePendingWork = AllocArrayAligned_(FramebufferTileWork, tileCount, CacheLineSize_);
+        frame->tileStreamed = AllocArray_(uint8, tileCount);
+        Memory::Zero(frame->tileStreamed, tileCount);
+
+        // -- One unit of work per pixel that is released once the integrator has issued all of the pixel's samples
+        for(uint32 tile = 0; tile < tileCount; ++tile) {
+            uint32 tileX = tile % frame->tileCountX;
+            uint32 tileY = tile / frame->tileCountX;
+            uint32 width = Min<uint32>(FramebufferTileSize_, frame->width - tileX * FramebufferTileSize_);
+            uint32 height = Min<uint32>(FramebufferTileSize_, frame->height - tileY * FramebufferTileSize_);
+
+            frame->tilePendingWork[tile].pending = width * height;
+        }
+
+        frame->streamBeautyScale = beautyScale;
+        frame->stream = stream;
+
+        return Success_;
+    }
+
+    //=============================================================================================================================
+    Error FrameBuffer_EndStream(Framebuffer* frame)
+    {
+        Assert_(frame->stream != nullptr);
+
+        // -- Anything that never reported as finished goes out as it is now
+        uint32 tileCount = FrameBuffer_TileCount(frame);
+        for(uint32 tile = 0; tile < tileCount; ++tile) {
+            if(frame->tileStreamed[tile] == 0) {
+                StreamTile(frame, tile);
             }
         }
+
+        Error error = ExrWriter_Close(frame->stream);
+
+        Delete_(frame->stream);
+        frame->stream = nullptr;
+        FreeAligned_(frame->tilePendingWork);
+        frame->tilePendingWork = nullptr;
+        SafeFree_(frame->tileStreamed);
+
+        return error;
     }
 
+    //=============================================================================================================================
+    void FrameBuffer_ResolveBeauty(Framebuffer* frame, float beautyScale, float3* image)
+    {
+        ResolveFixedPoint(frame);
+
+        for(uint32 y = 0; y < frame->height; ++y) {
+            for(uint32 x = 0; x < frame->width; ++x) {
+                uint32 index = FrameBuffer_StorageIndex(frame, x, y);
+
+                float scale = beautyScale;
+                if(scale == 0.0f) {
+                    scale = frame->sampleCounts[index] > 0 ? 1.0f / frame->sampleCounts[index] : 0.0f;
+                }
+
+                image[y * frame->width + x] = frame->beauty[index] * scale;
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    Error FrameBuffer_SaveExr(Framebuffer* frame, cpointer name, float beautyScale)
+    {
+        ReturnError_(FrameBuffer_BeginStream(frame, name, beautyScale));
+        return FrameBuffer_EndStream(frame);
+    }
+
+    //=============================================================================================================================
+    // FramebufferWriter
+    //=============================================================================================================================
+
     //=============================================================================================================================
     void FramebufferWriter_Initialize(FramebufferWriter* writer, Framebuffer* frame, uint32 capacity, uint32 softCapacity)
     {
+        uint32 tileCount = FrameBuffer_TileCount(frame);
+
         writer->count = 0;
+        writer->primaryCount = 0;
         writer->capacity = capacity;
         writer->softCapacity = softCapacity;
         writer->framebuffer = frame;
 
-        writer->sampleIndices = AllocArrayAligned_(uint32, capacity, 16);
-        writer->samples = AllocArrayAligned_(float3, frame->layerCount * capacity, 16);
+        uint64 storageSize = LayoutWriterStorage(writer, nullptr, capacity, tileCount);
+        writer->pooledStorage = storageSize <= frame->writerPool.bufferSize;
+        if(writer->pooledStorage) {
+            writer->storage = BufferPool_Acquire(&frame->writerPool);
+        }
+        else {
+            writer->storage = AllocAligned_((uint)storageSize, CacheLineSize_);
+        }
+        LayoutWriterStorage(writer, (uint8*)writer->storage, capacity, tileCount);
+
+        writer->endCount = 0;
+        Memory::Zero(writer->tileEndCounts, tileCount * sizeof(uint32));
     }
 
     //=============================================================================================================================
-    static void FlushInternal(FramebufferWriter* __restrict writer)
+    static void BucketByTile(const uint32* storageIndices, uint32 count, uint32 tileCount, uint32* tileStarts, uint32* cursors,
+                             uint32* order)
     {
-        Assert_(*writer->framebuffer->spinlock == 1);
+        Memory::Zero(tileStarts, (tileCount + 1) * sizeof(uint32));
+        for(uint32 scan = 0; scan < count; ++scan) {
+            ++tileStarts[(storageIndices[scan] / FramebufferTilePixelCount_) + 1];
+        }
+
+        for(uint32 tile = 0; tile < tileCount; ++tile) {
+            tileStarts[tile + 1] += tileStarts[tile];
+            cursors[tile] = tileStarts[tile];
+        }
 
-        uint layerCount = writer->framebuffer->layerCount;
+        for(uint32 scan = 0; scan < count; ++scan) {
+            uint32 tile = storageIndices[scan] / FramebufferTilePixelCount_;
+            order[cursors[tile]++] = scan;
+        }
+    }
 
+    //=============================================================================================================================
+    static void AccumulatePrimary(Framebuffer* __restrict frame, uint32 index, const FramebufferPrimarySample& sample)
+    {
+        float sampleCount = (float)(++frame->sampleCounts[index]);
+
+        if(frame->fixedSums) {
+            // -- Means are only formed when the sums are resolved
+            int64* sums = frame->fixedSums + (uint64)index * frame->fixedStride + 3;
+            AddFixedPoint(sums, &sample.albedo.x, frame->albedo.components);
+            sums += frame->albedo.components;
+            AddFixedPoint(sums, &sample.normal.x, frame->normal.components);
+            sums += frame->normal.components;
+            AddFixedPoint(sums, &sample.depth, frame->depth.components);
+            return;
+        }
+
+        AccumulateAovMean(&frame->albedo, index, &sample.albedo.x, sampleCount);
+        AccumulateAovMean(&frame->normal, index, &sample.normal.x, sampleCount);
+        AccumulateAovMean(&frame->depth, index, &sample.depth, sampleCount);
+    }
+
+    //=============================================================================================================================
+    static void FlushInternal(FramebufferWriter* __restrict writer, bool blocking)
+    {
         Framebuffer* frame = writer->framebuffer;
-        for(uint scan = 0, count = writer->count; scan < count; ++scan) {
-            uint32 index = writer->sampleIndices[scan];
+        uint32 tileCount = FrameBuffer_TileCount(frame);
+
+        BucketByTile(writer->sampleIndices, writer->count, tileCount, writer->tileStarts, writer->tileCursors,
+                     writer->sampleOrder);
+        BucketByTile(writer->primaryIndices, writer->primaryCount, tileCount, writer->primaryTileStarts, writer->tileCursors,
+                     writer->primaryOrder);
+
+        // -- tileCursors is reused to mark the tiles whose lock we failed to take
+        bool keptAny = false;
+        uint32 keptEndCount = 0;
+        for(uint32 tile = 0; tile < tileCount; ++tile) {
+            uint32 sampleStart = writer->tileStarts[tile];
+            uint32 sampleEnd = writer->tileStarts[tile + 1];
+            uint32 primaryStart = writer->primaryTileStarts[tile];
+            uint32 primaryEnd = writer->primaryTileStarts[tile + 1];
+            uint32 endCount = writer->tileEndCounts[tile];
+
+            writer->tileCursors[tile] = 0;
+            if(sampleStart == sampleEnd && primaryStart == primaryEnd && endCount == 0) {
+                continue;
+            }
+
+            void* spinlock = frame->tileLocks[tile].spinlock;
+            if(blocking) {
+                EnterSpinLock(spinlock);
+            }
+            else if(TryEnterSpinLock(spinlock) == false) {
+                writer->tileCursors[tile] = 1;
+                keptAny = true;
+                keptEndCount += endCount;
+                continue;
+            }
+
+            if(frame->fixedSums) {
+                for(uint32 scan = sampleStart; scan < sampleEnd; ++scan) {
+                    uint32 sample = writer->sampleOrder[scan];
+                    AddFixedPoint(frame->fixedSums + (uint64)writer->sampleIndices[sample] * frame->fixedStride,
+                                  &writer->samples[sample].x, 3);
+                }
+            }
+            else {
+                for(uint32 scan = sampleStart; scan < sampleEnd; ++scan) {
+                    uint32 sample = writer->sampleOrder[scan];
+                    frame->beauty[writer->sampleIndices[sample]] += writer->samples[sample];
+                }
+            }
+
+            for(uint32 scan = primaryStart; scan < primaryEnd; ++scan) {
+                uint32 sample = writer->primaryOrder[scan];
+                AccumulatePrimary(frame, writer->primaryIndices[sample], writer->primarySamples[sample]);
+            }
 
-            for(uint layer = 0; layer < layerCount; ++layer) {
-                frame->buffers[layer][index] += writer->samples[layerCount * scan + layer];
+            // -- Work is only released after its samples land so the last release sees the finished tile
+            bool finished = false;
+            if(endCount > 0) {
+                writer->tileEndCounts[tile] = 0;
+                finished = Atomic::Add64(&frame->tilePendingWork[tile].pending, -(int64)endCount) == (int64)endCount;
+            }
+
+            LeaveSpinLock(spinlock);
+
+            if(finished) {
+                StreamTile(frame, tile);
             }
         }
-        
-        writer->count = 0;
+
+        writer->endCount = keptEndCount;
+        if(keptAny == false) {
+            writer->count = 0;
+            writer->primaryCount = 0;
+            return;
+        }
+
+        // -- Compact whatever landed in contended tiles to the front of the queues for the next flush
+        uint32 keptCount = 0;
+        for(uint32 scan = 0; scan < writer->count; ++scan) {
+            if(writer->tileCursors[writer->sampleIndices[scan] / FramebufferTilePixelCount_]) {
+                writer->sampleIndices[keptCount] = writer->sampleIndices[scan];
+                writer->samples[keptCount] = writer->samples[scan];
+                ++keptCount;
+            }
+        }
+        writer->count = keptCount;
+
+        uint32 keptPrimaryCount = 0;
+        for(uint32 scan = 0; scan < writer->primaryCount; ++scan) {
+            if(writer->tileCursors[writer->primaryIndices[scan] / FramebufferTilePixelCount_]) {
+                writer->primaryIndices[keptPrimaryCount] = writer->primaryIndices[scan];
+                writer->primarySamples[keptPrimaryCount] = writer->primarySamples[scan];
+                ++keptPrimaryCount;
+            }
+        }
+        writer->primaryCount = keptPrimaryCount;
+    }
+
+    //=============================================================================================================================
+    static void FlushIfNeeded(FramebufferWriter* __restrict writer)
+    {
+        if(writer->count == writer->capacity || writer->primaryCount == writer->capacity) {
+            FlushInternal(writer, true);
+        }
+        else if(writer->count > writer->softCapacity || writer->primaryCount > writer->softCapacity
+                || writer->endCount > writer->softCapacity) {
+            FlushInternal(writer, false);
+        }
     }
 
     //=============================================================================================================================
-    void FramebufferWriter_Write(FramebufferWriter* __restrict writer, float3* samples, uint32 layerCount, uint32 x, uint32 y)
+    void FramebufferWriter_Write(FramebufferWriter* __restrict writer, float3 radiance, uint32 x, uint32 y)
     {
         uint32 index = writer->framebuffer->width * y + x;
-        FramebufferWriter_Write(writer, samples, layerCount, index);
+        FramebufferWriter_Write(writer, radiance, index);
+    }
+
+    //=============================================================================================================================
+    void FramebufferWriter_Write(FramebufferWriter* __restrict writer, float3 radiance, uint32 pixelIndex)
+    {
+        Assert_(writer->count < writer->capacity);
+
+        writer->sampleIndices[writer->count] = FrameBuffer_StorageIndex(writer->framebuffer, pixelIndex);
+        writer->samples[writer->count] = radiance;
+        ++writer->count;
+
+        FlushIfNeeded(writer);
     }
 
     //=============================================================================================================================
-    void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 index)
+    void FramebufferWriter_WritePrimary(FramebufferWriter* __restrict writer, const FramebufferPrimarySample& sample,
+                                        uint32 pixelIndex)
     {
-        if(writer->count == writer->capacity) {
-            FramebufferWriter_Flush(writer);
+        if((writer->framebuffer->flags & eSampleCountAov) == 0) {
+            return;
         }
 
-        Assert_(layerCount == writer->framebuffer->layerCount);
+        Assert_(writer->primaryCount < writer->capacity);
+
+        writer->primaryIndices[writer->primaryCount] = FrameBuffer_StorageIndex(writer->framebuffer, pixelIndex);
+        writer->primarySamples[writer->primaryCount] = sample;
+        ++writer->primaryCount;
 
-        writer->sampleIndices[writer->count] = index;
-        for(uint layer = 0; layer < layerCount; ++layer) {
-            writer->samples[layerCount * writer->count + layer] = samples[layer];
+        FlushIfNeeded(writer);
+    }
+
+    //=============================================================================================================================
+    void FramebufferWriter_BeginWork(FramebufferWriter* __restrict writer, uint32 pixelIndex)
+    {
+        Framebuffer* frame = writer->framebuffer;
+        if(frame->tilePendingWork == nullptr) {
+            return;
         }
-        
-        ++writer->count;
 
-        if(writer->count > writer->softCapacity) {
-            bool locked = TryEnterSpinLock(writer->framebuffer->spinlock);
-            if(!locked) {
-                return;
-            }
+        // -- Applied immediately rather than queued so a tile can never look finished while this work is in flight
+        uint32 tile = FrameBuffer_StorageIndex(frame, pixelIndex) / FramebufferTilePixelCount_;
+        Atomic::Increment64(&frame->tilePendingWork[tile].pending);
+    }
 
-            FlushInternal(writer);
-            LeaveSpinLock(writer->framebuffer->spinlock);
+    //=============================================================================================================================
+    void FramebufferWriter_EndWork(FramebufferWriter* __restrict writer, uint32 pixelIndex)
+    {
+        Framebuffer* frame = writer->framebuffer;
+        if(frame->tilePendingWork == nullptr) {
+            return;
         }
+
+        uint32 tile = FrameBuffer_StorageIndex(frame, pixelIndex) / FramebufferTilePixelCount_;
+        ++writer->tileEndCounts[tile];
+        ++writer->endCount;
+
+        FlushIfNeeded(writer);
     }
 
     //=============================================================================================================================
     void FramebufferWriter_Flush(FramebufferWriter* writer)
     {
-        EnterSpinLock(writer->framebuffer->spinlock);
-        FlushInternal(writer);
-        LeaveSpinLock(writer->framebuffer->spinlock);
+        FlushInternal(writer, true);
     }
 
     //=============================================================================================================================
     void FramebufferWriter_Shutdown(FramebufferWriter* writer)
     {
         FramebufferWriter_Flush(writer);
-        FreeAligned_(writer->samples);
-        FreeAligned_(writer->sampleIndices);
+
+        if(writer->pooledStorage) {
+            BufferPool_Release(&writer->framebuffer->writerPool, writer->storage);
+        }
+        else {
+            FreeAligned_(writer->storage);
+        }
+        writer->storage = nullptr;
     }
-}
\ No newline at end of file
+}
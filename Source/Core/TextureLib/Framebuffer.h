@@ -8,42 +8,199 @@
 #include "SystemLib/Error.h"
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/OSThreading.h"
+#include "SystemLib/ArenaAllocation.h"
 
 namespace Selas
 {
     #define DefaultFrameWriterCapacity_     4096
     #define DefaultFrameWriterSoftCapacity_ 3840
 
-    struct Framebuffer
+    // -- Pixels are stored in square tiles with one lock per tile so writers only contend when flushing into the same tile
+    #define FramebufferTileShift_           4
+    #define FramebufferTileSize_            (1 << FramebufferTileShift_)
+    #define FramebufferTilePixelCount_      (FramebufferTileSize_ * FramebufferTileSize_)
+
+    enum FramebufferFlags
+    {
+        // -- Beauty is always stored. The feature aovs hold per pixel means and so imply eSampleCountAov.
+        eAlbedoAov       = 1 << 0,
+        eNormalAov       = 1 << 1,
+        eDepthAov        = 1 << 2,
+        eSampleCountAov  = 1 << 3,
+
+        // -- Store the feature aovs as halfs. Beauty is a running sum of path contributions so it always stays float.
+        eHalfAovStorage  = 1 << 4,
+
+        // -- Luminance moments used to estimate each pixel's error. Implies eSampleCountAov.
+        eVarianceAov     = 1 << 5,
+
+        // -- Accumulate beauty and the feature aovs as 64 bit fixed point sums. Integer adds are associative so the image no
+        // -- longer depends on the order in which threads flush their samples. Implies eSampleCountAov.
+        eFixedPointAccumulation = 1 << 6
+    };
+
+    enum FramebufferChannel
+    {
+        eBeautyChannel,
+        eAlbedoChannel,
+        eNormalChannel,
+        eDepthChannel,
+        eSampleCountChannel,
+        eVarianceChannel,
+
+        eFramebufferChannelCount
+    };
+
+    struct ExrWriter;
+
+    struct FramebufferTileLock
     {
-        uint32  width;
-        uint32  height;
-        uint32  layerCount;
-        float3** buffers;
         uint8 spinlock[CacheLineSize_];
     };
 
+    // -- Neighboring tiles finish on different threads so each counter gets its own cache line
+    struct FramebufferTileWork
+    {
+        Align_(CacheLineSize_) volatile int64 pending;
+    };
+
+    struct FramebufferAov
+    {
+        uint32 components;
+        uint32 half;
+        void*  data;
+    };
+
+    // -- Luminance statistics over independent estimates of a pixel's value. Depending on the integrator an estimate is a
+    // -- single path or the mean of all of a pixel's samples from one pass.
+    struct FramebufferMoments
+    {
+        float count;
+        float sum;
+        float sumSquares;
+    };
+
+    struct Framebuffer
+    {
+        uint32 width;
+        uint32 height;
+        uint32 tileCountX;
+        uint32 tileCountY;
+        uint32 flags;
+        uint32 fixedStride;
+
+        // -- All channels are indexed by storage index. See FrameBuffer_StorageIndex.
+        float3* beauty;
+        FramebufferAov albedo;
+        FramebufferAov normal;
+        FramebufferAov depth;
+        uint32* sampleCounts;
+        FramebufferMoments* moments;
+
+        // -- Only with eFixedPointAccumulation. Writers add into these and the channels above are resolved from them on
+        // -- demand. Each pixel holds fixedStride sums: beauty followed by the enabled feature aovs in channel order.
+        int64* fixedSums;
+
+        FramebufferTileLock* tileLocks;
+
+        // -- Only used while streaming. Each tile counts its outstanding work and is written out when that reaches zero.
+        FramebufferTileWork* tilePendingWork;
+        uint8*          tileStreamed;
+        ExrWriter*      stream;
+        float           streamBeautyScale;
+
+        // -- Storage for writers created with the default capacities so starting a writer every pass costs no allocations
+        BufferPool      writerPool;
+    };
+
+    // -- Written once per camera sample at the sample's first intersection. Misses write zeros.
+    struct FramebufferPrimarySample
+    {
+        float3 albedo;
+        float3 normal;
+        float  depth;
+    };
+
     struct FramebufferWriter
     {
         uint32  count;
+        uint32  primaryCount;
         uint32  capacity;
         uint32  softCapacity;
-        uint32  pad;
+
         uint32* sampleIndices;
         float3* samples;
+        uint32* primaryIndices;
+        FramebufferPrimarySample* primarySamples;
+
+        // -- Flush scratch used to bucket both queues by tile
+        uint32* tileStarts;
+        uint32* primaryTileStarts;
+        uint32* tileCursors;
+        uint32* sampleOrder;
+        uint32* primaryOrder;
+
+        // -- Per tile count of EndWork calls that have not been applied yet
+        uint32* tileEndCounts;
+        uint32  endCount;
+
+        // -- Every array above is carved from this. It comes from the framebuffer's pool unless the capacity does not fit.
+        void*   storage;
+        bool    pooledStorage;
+
         Framebuffer* framebuffer;
     };
 
-    void FrameBuffer_Initialize(Framebuffer* frame, uint32 width, uint32 height, uint32 layerCount);
+    void FrameBuffer_Initialize(Framebuffer* frame, uint32 width, uint32 height, uint32 flags);
     void FrameBuffer_Shutdown(Framebuffer* frame);
     void FrameBuffer_Save(Framebuffer* frame, cpointer name);
+    Error FrameBuffer_SaveExr(Framebuffer* frame, cpointer name, float beautyScale);
     void FrameBuffer_Scale(Framebuffer* frame, float value);
 
+    uint32 FrameBuffer_TileCount(const Framebuffer* frame);
+    uint32 FrameBuffer_StorageIndex(const Framebuffer* frame, uint32 x, uint32 y);
+    uint32 FrameBuffer_StorageIndex(const Framebuffer* frame, uint32 pixelIndex);
+
+    // -- Adds one estimate per pixel that received samples since the last call. Each estimate is the mean of the pixel's new
+    // -- samples so this expects every pass to give a pixel either zero or samplesPerPass samples. Not thread safe.
+    void FrameBuffer_AccumulatePassMoments(Framebuffer* frame, uint32 samplesPerPass);
+
+    // -- For integrators that finish a pixel on a single thread and so can track its moments locally
+    void FrameBuffer_AddMoments(Framebuffer* frame, uint32 pixelIndex, const FramebufferMoments& moments);
+
+    // -- Standard error of the pixel's mean relative to its luminance. Pixels with fewer than two estimates return FloatMax_.
+    float FrameBuffer_RelativeError(const Framebuffer* frame, uint32 pixelIndex);
+
+    // -- Mean luminance of the pixel's estimates so far or zero when it has none. Requires eVarianceAov.
+    float FrameBuffer_MeanLuminance(const Framebuffer* frame, uint32 pixelIndex);
+
+    void  FramebufferMoments_Add(FramebufferMoments* moments, float3 estimate);
+    float FramebufferMoments_RelativeError(const FramebufferMoments& moments);
+
+    // -- Copies one channel out into a row major image. Scalar channels are splatted across all three components. Fixed point
+    // -- sums are only resolved by saves, streamed tiles, FrameBuffer_AccumulatePassMoments and FrameBuffer_ResolveBeauty.
+    void FrameBuffer_Resolve(const Framebuffer* frame, FramebufferChannel channel, float3* image);
+
+    // -- Resolves beauty, including fixed point sums, into a row major image. beautyScale is applied as it is by
+    // -- FrameBuffer_BeginStream. Not thread safe.
+    void FrameBuffer_ResolveBeauty(Framebuffer* frame, float beautyScale, float3* image);
+
+    // -- Writes tiles to a single multi-channel exr as soon as they are finished. Every tile starts with one unit of work per
+    // -- pixel which the integrator releases with FramebufferWriter_EndWork once it has issued all of that pixel's camera
+    // -- samples. Any work that can still write to a pixel must be bracketed by FramebufferWriter_BeginWork/EndWork.
+    // -- beautyScale is applied to beauty as tiles are written since the final FrameBuffer_Scale comes too late. A scale of
+    // -- zero divides each pixel by its own sample count instead, which requires eSampleCountAov.
+    Error FrameBuffer_BeginStream(Framebuffer* frame, cpointer name, float beautyScale);
+    Error FrameBuffer_EndStream(Framebuffer* frame);
+
     void FramebufferWriter_Initialize(FramebufferWriter* writer, Framebuffer* frame,
                                       uint32 capacity = DefaultFrameWriterCapacity_,
                                       uint32 softCapacity = DefaultFrameWriterSoftCapacity_);
-    void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 x, uint32 y);
-    void FramebufferWriter_Write(FramebufferWriter* writer, float3* samples, uint32 layerCount, uint32 index);
+    void FramebufferWriter_Write(FramebufferWriter* writer, float3 radiance, uint32 x, uint32 y);
+    void FramebufferWriter_Write(FramebufferWriter* writer, float3 radiance, uint32 pixelIndex);
+    void FramebufferWriter_WritePrimary(FramebufferWriter* writer, const FramebufferPrimarySample& sample, uint32 pixelIndex);
+    void FramebufferWriter_BeginWork(FramebufferWriter* writer, uint32 pixelIndex);
+    void FramebufferWriter_EndWork(FramebufferWriter* writer, uint32 pixelIndex);
     void FramebufferWriter_Flush(FramebufferWriter* writer);
     void FramebufferWriter_Shutdown(FramebufferWriter* writer);
-}
\ No newline at end of file
+}
@@ -7,6 +7,10 @@
 #include "SystemLib/JsAssert.h"
 #include "SystemLib/MemoryAllocation.h"
 #include "SystemLib/Atomic.h"
+#include "SystemLib/MinMax.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Profiling.h"
+#include "SystemLib/RenderStats.h"
 
 #include <map>
 
@@ -30,6 +34,12 @@ namespace Selas
         uint64 capacity;
 
         Ptex::PtexCache* ptexCache;
+        uint64 reportedFetches;
+        uint64 reportedHits;
+        uint64 reportedMisses;
+
+        // -- Kept here rather than in the per thread stats since hits can only be worked out against Ptex's block reads
+        Align_(CacheLineSize_) volatile int64 fetches;
     };
 
     //=============================================================================================================================
@@ -53,6 +63,10 @@ namespace Selas
         cacheData = New_(TextureCacheData);
         cacheData->capacity = cacheSize;
         cacheData->ptexCache = Ptex::PtexCache::create(maxFiles, cacheSize, true, nullptr, nullptr);
+        cacheData->reportedFetches = 0;
+        cacheData->reportedHits = 0;
+        cacheData->reportedMisses = 0;
+        cacheData->fetches = 0;
     }
 
     //=============================================================================================================================
@@ -167,6 +181,10 @@ namespace Selas
     //=============================================================================================================================
     Ptex::PtexTexture* TextureCache::FetchPtex(TextureHandle handle)
     {
+        ProfileEventMarker_(0, "FetchPtex");
+
+        Atomic::Increment64(&cacheData->fetches);
+
         if(handle.Valid() == false) {
             return nullptr;
         }
@@ -200,4 +218,27 @@ namespace Selas
         Assert_(obj->second->usageRefCount != 0);
         Atomic::Decrement64(&obj->second->usageRefCount);
     }
+
+    //=============================================================================================================================
+    void TextureCache::ReportStats()
+    {
+        Ptex::PtexCache::Stats stats;
+        cacheData->ptexCache->getStats(stats);
+
+        // -- Every block Ptex reads is a miss and every other fetch is a hit. A fetch can read more than one block so hits are
+        // -- kept from going backwards when block reads briefly outpace fetches.
+        uint64 fetches = (uint64)cacheData->fetches;
+        uint64 misses = stats.blockReads;
+        uint64 hits = fetches > misses ? fetches - misses : 0;
+        hits = Max(hits, cacheData->reportedHits);
+
+        RenderStats_Add(eRenderCounterTextureCacheFetches, fetches - cacheData->reportedFetches);
+        RenderStats_Add(eRenderCounterTextureCacheHits, hits - cacheData->reportedHits);
+        RenderStats_Add(eRenderCounterTextureCacheMisses, misses - cacheData->reportedMisses);
+        RenderStats_SetGauge(eRenderGaugeTextureCacheBytes, stats.memUsed);
+
+        cacheData->reportedFetches = fetches;
+        cacheData->reportedHits = hits;
+        cacheData->reportedMisses = misses;
+    }
 }
\ No newline at end of file
@@ -25,6 +25,8 @@ namespace Selas
 
         bool Valid() { return hash != InvalidTextureHandle_;  }
         bool Invalid() { return hash == InvalidTextureHandle_; }
+        bool operator==(const TextureHandle& rhs) const { return hash == rhs.hash; }
+        Hash32 Hash() const { return hash; }
 
     private:
         friend class TextureCache;
@@ -50,5 +52,8 @@ namespace Selas
         const TextureResource* FetchTexture(TextureHandle handle);
         Ptex::PtexTexture* FetchPtex(TextureHandle handle);
         void ReleaseTexture(TextureHandle handle);
+
+        // -- Pushes the Ptex cache's memory use and block reads since the last call into the render stats
+        void ReportStats();
    };
 }
\ No newline at end of file
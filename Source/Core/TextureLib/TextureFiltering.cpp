@@ -5,8 +5,17 @@
 #include "TextureLib/TextureFiltering.h"
 #include "MathLib/Trigonometric.h"
 
+#if defined(__AVX2__)
+    #define EnableAvx2Gathers_ 1
+    #include <immintrin.h>
+#else
+    #define EnableAvx2Gathers_ 0
+#endif
+
 namespace Selas
 {
+    float EWAFilterLut[EwaLutSize];
+
     //=============================================================================================================================
     namespace TextureFiltering
     {
@@ -19,5 +28,155 @@ namespace Selas
                 EWAFilterLut[i] = Math::Expf(-alpha * r2) - Math::Expf(-alpha);
             }
         }
+
+        #if EnableAvx2Gathers_
+
+        //=========================================================================================================================
+        static __m256i WrapRepeat(__m256 coord, __m256 sizef, __m256i size)
+        {
+            // -- coord - size * floor(coord / size) so that negative coordinates wrap the same way positive ones do
+            __m256 wraps = _mm256_floor_ps(_mm256_div_ps(coord, sizef));
+            __m256i wrapped = _mm256_cvttps_epi32(_mm256_sub_ps(coord, _mm256_mul_ps(sizef, wraps)));
+
+            // -- Guard against the division rounding across a wrap boundary
+            __m256i tooLarge = _mm256_cmpgt_epi32(wrapped, _mm256_sub_epi32(size, _mm256_set1_epi32(1)));
+            __m256i negative = _mm256_cmpgt_epi32(_mm256_setzero_si256(), wrapped);
+            wrapped = _mm256_sub_epi32(wrapped, _mm256_and_si256(tooLarge, size));
+            wrapped = _mm256_add_epi32(wrapped, _mm256_and_si256(negative, size));
+
+            return wrapped;
+        }
+
+        //=========================================================================================================================
+        static __m256i TexelIndices(TextureResourceData::TexelLayout layout, uint32 w, __m256i s, __m256i t)
+        {
+            if(layout == TextureResourceData::Tiled4x4) {
+                uint32 tilesX = (w + TextureResourceData::TileDimension - 1) / TextureResourceData::TileDimension;
+
+                __m256i three = _mm256_set1_epi32(3);
+                __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(t, 2), _mm256_set1_epi32((int32)tilesX)),
+                                                _mm256_srli_epi32(s, 2));
+                __m256i inner = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(t, three), 2), _mm256_and_si256(s, three));
+                return _mm256_or_si256(_mm256_slli_epi32(tile, 4), inner);
+            }
+
+            return _mm256_add_epi32(_mm256_mullo_epi32(t, _mm256_set1_epi32((int32)w)), s);
+        }
+
+        //=========================================================================================================================
+        void TriangleBatch(TextureResourceData* texture, int32 level, const float2* st, uint count, float4* results)
+        {
+            Assert_(count <= TextureBatchWidth);
+
+            level = Min<int32>(level, (int32)texture->mipCount - 1);
+
+            uint32 mipWidth = texture->mipWidths[level];
+            uint32 mipHeight = texture->mipHeights[level];
+            const float* mip = reinterpret_cast<const float*>(&texture->texture[texture->mipOffsets[level]]);
+            int32 channels = (int32)texture->format + 1;
+
+            Align_(32) float ss[TextureBatchWidth];
+            Align_(32) float ts[TextureBatchWidth];
+            for(uint scan = 0; scan < TextureBatchWidth; ++scan) {
+                // -- Unused lanes repeat the first lookup so their gathers stay within the mip
+                float2 uv = st[scan < count ? scan : 0];
+                ss[scan] = uv.x;
+                ts[scan] = uv.y;
+            }
+
+            __m256 half = _mm256_set1_ps(0.5f);
+            __m256 one = _mm256_set1_ps(1.0f);
+            __m256 widthf = _mm256_set1_ps((float)mipWidth);
+            __m256 heightf = _mm256_set1_ps((float)mipHeight);
+            __m256i width = _mm256_set1_epi32((int32)mipWidth);
+            __m256i height = _mm256_set1_epi32((int32)mipHeight);
+
+            __m256 s = _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(ss), widthf), half);
+            __m256 t = _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(ts), heightf), half);
+            __m256 s0f = _mm256_floor_ps(s);
+            __m256 t0f = _mm256_floor_ps(t);
+            __m256 ds = _mm256_sub_ps(s, s0f);
+            __m256 dt = _mm256_sub_ps(t, t0f);
+
+            // -- Wrap all four corners of every lane together
+            __m256i s0 = WrapRepeat(s0f, widthf, width);
+            __m256i s1 = WrapRepeat(_mm256_add_ps(s0f, one), widthf, width);
+            __m256i t0 = WrapRepeat(t0f, heightf, height);
+            __m256i t1 = WrapRepeat(_mm256_add_ps(t0f, one), heightf, height);
+
+            __m256i channelCount = _mm256_set1_epi32(channels);
+            __m256i i00 = _mm256_mullo_epi32(TexelIndices(texture->layout, mipWidth, s0, t0), channelCount);
+            __m256i i01 = _mm256_mullo_epi32(TexelIndices(texture->layout, mipWidth, s0, t1), channelCount);
+            __m256i i10 = _mm256_mullo_epi32(TexelIndices(texture->layout, mipWidth, s1, t0), channelCount);
+            __m256i i11 = _mm256_mullo_epi32(TexelIndices(texture->layout, mipWidth, s1, t1), channelCount);
+
+            __m256 w00 = _mm256_mul_ps(_mm256_sub_ps(one, ds), _mm256_sub_ps(one, dt));
+            __m256 w01 = _mm256_mul_ps(_mm256_sub_ps(one, ds), dt);
+            __m256 w10 = _mm256_mul_ps(ds, _mm256_sub_ps(one, dt));
+            __m256 w11 = _mm256_mul_ps(ds, dt);
+
+            Align_(32) float filtered[4][TextureBatchWidth];
+            for(int32 c = 0; c < 4; ++c) {
+                if(c >= channels) {
+                    _mm256_store_ps(filtered[c], _mm256_setzero_ps());
+                    continue;
+                }
+
+                __m256i offset = _mm256_set1_epi32(c);
+                __m256 v00 = _mm256_i32gather_ps(mip, _mm256_add_epi32(i00, offset), sizeof(float));
+                __m256 v01 = _mm256_i32gather_ps(mip, _mm256_add_epi32(i01, offset), sizeof(float));
+                __m256 v10 = _mm256_i32gather_ps(mip, _mm256_add_epi32(i10, offset), sizeof(float));
+                __m256 v11 = _mm256_i32gather_ps(mip, _mm256_add_epi32(i11, offset), sizeof(float));
+
+                __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w00, v00), _mm256_mul_ps(w01, v01)),
+                                           _mm256_add_ps(_mm256_mul_ps(w10, v10), _mm256_mul_ps(w11, v11)));
+                _mm256_store_ps(filtered[c], sum);
+            }
+
+            for(uint scan = 0; scan < count; ++scan) {
+                results[scan] = float4(filtered[0][scan], filtered[1][scan], filtered[2][scan], filtered[3][scan]);
+            }
+        }
+
+        #else
+
+        //=========================================================================================================================
+        void TriangleBatch(TextureResourceData* texture, int32 level, const float2* st, uint count, float4* results)
+        {
+            Assert_(count <= TextureBatchWidth);
+
+            for(uint scan = 0; scan < count; ++scan) {
+                switch(texture->format) {
+                case TextureResourceData::Float:
+                {
+                    float sample;
+                    Triangle(texture, level, st[scan], sample);
+                    results[scan] = float4(sample, 0.0f, 0.0f, 0.0f);
+                    break;
+                }
+                case TextureResourceData::Float2:
+                {
+                    float2 sample;
+                    Triangle(texture, level, st[scan], sample);
+                    results[scan] = float4(sample.x, sample.y, 0.0f, 0.0f);
+                    break;
+                }
+                case TextureResourceData::Float3:
+                {
+                    float3 sample;
+                    Triangle(texture, level, st[scan], sample);
+                    results[scan] = float4(sample, 0.0f);
+                    break;
+                }
+                case TextureResourceData::Float4:
+                    Triangle(texture, level, st[scan], results[scan]);
+                    break;
+                default:
+                    Assert_(false);
+                }
+            }
+        }
+
+        #endif
     }
-}
\ No newline at end of file
+}
@@ -16,7 +16,9 @@
 namespace Selas
 {
     const uint EwaLutSize = 128;
-    static float EWAFilterLut[EwaLutSize];
+    const uint TextureBatchWidth = 8;
+    // -- Filled by InitializeEWAFilterWeights
+    extern float EWAFilterLut[EwaLutSize];
         
     struct TextureResourceData;
 
@@ -30,9 +32,27 @@ namespace Selas
 
         void InitializeEWAFilterWeights();
 
+        // -- Bilinearly filters up to TextureBatchWidth lookups into the same level of one texture at once. Each result holds
+        // -- the texture's channels in xyzw order with any channels the format lacks set to zero.
+        void TriangleBatch(TextureResourceData* texture, int32 level, const float2* st, uint count, float4* results);
+
+        //=========================================================================================================================
+        inline uint TexelIndex(TextureResourceData::TexelLayout layout, uint32 w, int32 s, int32 t)
+        {
+            if(layout == TextureResourceData::Tiled4x4) {
+                // -- 4x4 tiles keep a bilinear footprint within one or two tiles rather than two full rows of the mip
+                uint32 tilesX = (w + TextureResourceData::TileDimension - 1) / TextureResourceData::TileDimension;
+                uint32 tile = (uint32)(t >> 2) * tilesX + (uint32)(s >> 2);
+                return (tile << 4) + ((t & 3) << 2) + (s & 3);
+            }
+
+            return t * w + s;
+        }
+
         //=========================================================================================================================
         template <typename Type_>
-        static Type_ Sample(Type_* mip, WrapMode wrapMode, uint32 w, uint32 h, int32 s, int32 t)
+        static Type_ Sample(Type_* mip, TextureResourceData::TexelLayout layout, WrapMode wrapMode, uint32 w, uint32 h,
+                            int32 s, int32 t)
         {
             switch(wrapMode) {
             case WrapMode::Clamp:
@@ -40,14 +60,16 @@ namespace Selas
                 t = Selas::Clamp<int32>(t, 0, h - 1);
                 break;
             case WrapMode::Repeat:
-                s = s % w;
-                t = t % h;
+                s = s % (int32)w;
+                t = t % (int32)h;
+                s = s < 0 ? s + (int32)w : s;
+                t = t < 0 ? t + (int32)h : t;
                 break;
             default:
                 Assert_(false);
             }
 
-            return mip[t * w + s];
+            return mip[TexelIndex(layout, w, s, t)];
         }
 
         //=========================================================================================================================
@@ -69,7 +91,26 @@ namespace Selas
             int32 s0 = (int32)Math::Floor(s);
             int32 t0 = (int32)Math::Floor(t);
 
-            result = Sample<Type_>(mip, wrapMode, mipWidth, mipHeight, s0, t0);
+            result = Sample<Type_>(mip, texture->layout, wrapMode, mipWidth, mipHeight, s0, t0);
+        }
+
+        //=========================================================================================================================
+        inline bool CoverageTest(const TextureResourceData* texture, float2 st)
+        {
+            if(texture->coverageSize == 0) {
+                return true;
+            }
+
+            int32 w = (int32)texture->mipWidths[0];
+            int32 h = (int32)texture->mipHeights[0];
+
+            int32 s = (int32)Math::Floor(st.x * w) % w;
+            int32 t = (int32)Math::Floor(st.y * h) % h;
+            s = s < 0 ? s + w : s;
+            t = t < 0 ? t + h : t;
+
+            uint32 index = (uint32)(t * w + s);
+            return (texture->coverage[index >> 5] & (1u << (index & 31))) != 0;
         }
 
         //=========================================================================================================================
@@ -93,10 +134,11 @@ namespace Selas
             int32 t0 = (int32)Math::Floor(t);
             float ds = s - s0;
             float dt = t - t0;
-            result = (1 - ds) * (1 - dt) * Sample<Type_>(mip, wrapMode, mipWidth, mipHeight, s0, t0) +
-                (1 - ds) *      dt  * Sample<Type_>(mip, wrapMode, mipWidth, mipHeight, s0, t0 + 1) +
-                ds * (1 - dt) * Sample<Type_>(mip, wrapMode, mipWidth, mipHeight, s0 + 1, t0) +
-                ds * dt  * Sample<Type_>(mip, wrapMode, mipWidth, mipHeight, s0 + 1, t0 + 1);
+            TextureResourceData::TexelLayout layout = texture->layout;
+            result = (1 - ds) * (1 - dt) * Sample<Type_>(mip, layout, wrapMode, mipWidth, mipHeight, s0, t0) +
+                (1 - ds) *      dt  * Sample<Type_>(mip, layout, wrapMode, mipWidth, mipHeight, s0, t0 + 1) +
+                ds * (1 - dt) * Sample<Type_>(mip, layout, wrapMode, mipWidth, mipHeight, s0 + 1, t0) +
+                ds * dt  * Sample<Type_>(mip, layout, wrapMode, mipWidth, mipHeight, s0 + 1, t0 + 1);
         }
 
         //=========================================================================================================================
@@ -111,7 +153,7 @@ namespace Selas
             if(reqLevel >= (int32)texture->mipCount) {
                 uint64 mipOffset = texture->mipOffsets[texture->mipCount - 1];
                 Type_* mip = reinterpret_cast<Type_*>(&texture->texture[mipOffset]);
-                result = Sample<Type_>(mip, wrapMode, 1, 1, 0, 0);
+                result = Sample<Type_>(mip, texture->layout, wrapMode, 1, 1, 0, 0);
                 return;
             }
 
@@ -159,7 +201,7 @@ namespace Selas
                     if(r2 < 1) {
                         int32 index = Min<int32>((int32)(r2 * EwaLutSize), EwaLutSize - 1);
                         float weight = EWAFilterLut[index];
-                        sum += Sample<Type_>(mip, wrapMode, mipWidth, mipHeight, is, it) * weight;
+                        sum += Sample<Type_>(mip, texture->layout, wrapMode, mipWidth, mipHeight, is, it) * weight;
                         sumWts += weight;
                     }
                 }
@@ -3,6 +3,7 @@
 //=================================================================================================================================
 
 #include "TextureLib/TextureResource.h"
+#include "TextureLib/TextureFiltering.h"
 #include "TextureLib/StbImage.h"
 #include "Assets/AssetFileUtils.h"
 #include "StringLib/FixedString.h"
@@ -10,6 +11,8 @@
 #include "IoLib/BinaryStreamSerializer.h"
 #include "IoLib/File.h"
 #include "IoLib/Directory.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/Memory.h"
 #include "SystemLib/BasicTypes.h"
 
 #include <stdio.h>
@@ -17,7 +20,7 @@
 namespace Selas
 {
     cpointer TextureResource::kDataType = "Textures";
-    const uint64 TextureResource::kDataVersion = 1534887410ul;
+    const uint64 TextureResource::kDataVersion = 1539648000ul;
 
     //=============================================================================================================================
     void Serialize(CSerializer* serializer, TextureResourceData& data)
@@ -36,9 +39,12 @@ namespace Selas
         }
 
         Serialize(serializer, (uint32&)data.format);
+        Serialize(serializer, (uint32&)data.layout);
+        Serialize(serializer, data.coverageSize);
         Serialize(serializer, data.pad);
 
         serializer->SerializePtr((void*&)data.texture, data.dataSize, 0);
+        serializer->SerializePtr((void*&)data.coverage, data.coverageSize, 0);
     }
 
     //=============================================================================================================================
@@ -82,8 +88,25 @@ namespace Selas
         uint64 mipOffset = texture->data->mipOffsets[level];
         uint32 mipWidth  = texture->data->mipWidths[level];
         uint32 mipHeight = texture->data->mipHeights[level];
-        void*  mip       = &texture->data->texture[mipOffset];
-        StbImageWrite(filepath, mipWidth, mipHeight, channels, HDR, (void*)mip);
+        uint8* mip       = &texture->data->texture[mipOffset];
+
+        if(texture->data->layout == TextureResourceData::Linear) {
+            StbImageWrite(filepath, mipWidth, mipHeight, channels, HDR, (void*)mip);
+            return;
+        }
+
+        // -- Untile into a temporary row-major copy for the image writer
+        uint texelSize = channels * sizeof(float);
+        uint8* linear = AllocArray_(uint8, mipWidth * mipHeight * texelSize);
+        for(uint32 y = 0; y < mipHeight; ++y) {
+            for(uint32 x = 0; x < mipWidth; ++x) {
+                uint index = TextureFiltering::TexelIndex(texture->data->layout, mipWidth, (int32)x, (int32)y);
+                Memory::Copy(linear + (y * mipWidth + x) * texelSize, mip + index * texelSize, texelSize);
+            }
+        }
+
+        StbImageWrite(filepath, mipWidth, mipHeight, channels, HDR, (void*)linear);
+        Free_(linear);
     }
 
     //=============================================================================================================================
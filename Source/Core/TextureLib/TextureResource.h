@@ -23,7 +23,16 @@ namespace Selas
             Float4
         };
 
+        enum TexelLayout
+        {
+            // -- Row-major texels within each mip
+            Linear,
+            // -- Row-major 4x4 texel tiles with row-major texels inside each tile. Mip storage is padded up to whole tiles.
+            Tiled4x4
+        };
+
         static const uint MaxMipCount = 16;
+        static const uint32 TileDimension = 4;
 
         uint32 mipCount;
         uint32 dataSize;
@@ -33,9 +42,14 @@ namespace Selas
         uint64 mipOffsets[MaxMipCount];
 
         TextureDataType format;
+        TexelLayout layout;
+
+        // -- One bit per top mip texel set when alpha passes the alpha test cutoff. Empty for textures without alpha.
+        uint32 coverageSize;
         uint32 pad;
 
         uint8* texture;
+        uint32* coverage;
     };
     void Serialize(CSerializer* serializer, TextureResourceData& data);
 
@@ -0,0 +1,517 @@
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "ThreadingLib/JobSystem.h"
+#include "ThreadingLib/Thread.h"
+#include "ContainersLib/CArray.h"
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/Atomic.h"
+#include "SystemLib/JsAssert.h"
+#include "SystemLib/Logging.h"
+#include "SystemLib/MemoryAllocation.h"
+#include "SystemLib/MinMax.h"
+
+#define JobQueueCapacity_    4096
+#define JobBlockSize_        256
+#define InfiniteWait_        0xFFFFFFFF
+
+namespace Selas
+{
+    //=============================================================================================================================
+    struct Job
+    {
+        JobFunction         function;
+        ParallelForFunction rangeFunction;
+        void*               userData;
+        uint                start;
+        uint                end;
+        uint                grainSize;
+        JobCounter*         counter;
+
+        // -- Links the free list and the jobs waiting on a counter
+        Job*                next;
+    };
+
+    //=============================================================================================================================
+    struct JobQueue
+    {
+        uint8  spinlock[CacheLineSize_];
+        uint64 head;
+        uint64 tail;
+        Job*   jobs[JobQueueCapacity_];
+    };
+
+    //=============================================================================================================================
+    struct JobSystemData
+    {
+        // -- Sized to the thread count at initialization
+        uint           threadCount;
+        ThreadHandle*  threads;
+        JobQueue**     queues;
+
+        // -- Threads are split into contiguous runs per node. Nodes are numbered densely over the ones in use.
+        uint           nodeCount;
+        uint32         nodeIds[MaxNumaNodeCount_];
+        uint32*        threadNodes;
+
+        // -- Posted once per queued job so sleeping workers wake for each one
+        void*          semaphore;
+        volatile int64 nextThreadIndex;
+        volatile int64 shutdown;
+
+        uint8          freeListSpinlock[CacheLineSize_];
+        Job*           freeJobs;
+        CArray<Job*>   jobBlocks;
+    };
+
+    static JobSystemData* jobSystem = nullptr;
+    static thread_local uint32 jobThreadIndex = InvalidIndex32;
+
+    //=============================================================================================================================
+    static Job* AllocateJob()
+    {
+        EnterSpinLock(jobSystem->freeListSpinlock);
+        if(jobSystem->freeJobs == nullptr) {
+            Job* block = AllocArray_(Job, JobBlockSize_);
+            jobSystem->jobBlocks.Add(block);
+            for(uint scan = 0; scan < JobBlockSize_; ++scan) {
+                block[scan].next = jobSystem->freeJobs;
+                jobSystem->freeJobs = &block[scan];
+            }
+        }
+
+        Job* job = jobSystem->freeJobs;
+        jobSystem->freeJobs = job->next;
+        LeaveSpinLock(jobSystem->freeListSpinlock);
+
+        job->function = nullptr;
+        job->rangeFunction = nullptr;
+        job->userData = nullptr;
+        job->start = 0;
+        job->end = 0;
+        job->grainSize = 1;
+        job->counter = nullptr;
+        job->next = nullptr;
+
+        return job;
+    }
+
+    //=============================================================================================================================
+    static void FreeJob(Job* job)
+    {
+        EnterSpinLock(jobSystem->freeListSpinlock);
+        job->next = jobSystem->freeJobs;
+        jobSystem->freeJobs = job;
+        LeaveSpinLock(jobSystem->freeListSpinlock);
+    }
+
+    //=============================================================================================================================
+    static uint QueueIndex()
+    {
+        // -- Threads outside the system share thread zero's queue. Queues are locked so that is safe, just not as fast.
+        return jobThreadIndex == InvalidIndex32 ? 0 : jobThreadIndex;
+    }
+
+    static void ExecuteJob(Job* job);
+
+    //=============================================================================================================================
+    static void PushJob(Job* job)
+    {
+        JobQueue* queue = jobSystem->queues[QueueIndex()];
+
+        EnterSpinLock(queue->spinlock);
+        if(queue->tail - queue->head == JobQueueCapacity_) {
+            LeaveSpinLock(queue->spinlock);
+
+            // -- A full queue already has plenty to steal so run this one right away
+            ExecuteJob(job);
+            return;
+        }
+
+        queue->jobs[queue->tail % JobQueueCapacity_] = job;
+        ++queue->tail;
+        LeaveSpinLock(queue->spinlock);
+
+        PostSemaphore(jobSystem->semaphore, 1);
+    }
+
+    //=============================================================================================================================
+    static Job* FindJob(uint threadIndex)
+    {
+        // -- Newest first from our own queue while it is still warm in cache
+        JobQueue* queue = jobSystem->queues[threadIndex];
+        EnterSpinLock(queue->spinlock);
+        if(queue->tail > queue->head) {
+            --queue->tail;
+            Job* job = queue->jobs[queue->tail % JobQueueCapacity_];
+            LeaveSpinLock(queue->spinlock);
+            return job;
+        }
+        LeaveSpinLock(queue->spinlock);
+
+        // -- Oldest first from everyone else since those are the largest pieces of split ranges. Threads on our own node are
+        // -- tried first so the data a job touches is more likely to be in memory close by.
+        for(uint pass = 0; pass < 2; ++pass) {
+            for(uint scan = 1; scan < jobSystem->threadCount; ++scan) {
+                uint victimIndex = (threadIndex + scan) % jobSystem->threadCount;
+                bool sameNode = jobSystem->threadNodes[victimIndex] == jobSystem->threadNodes[threadIndex];
+                if(sameNode != (pass == 0)) {
+                    continue;
+                }
+
+                JobQueue* victim = jobSystem->queues[victimIndex];
+                if(victim->tail == victim->head) {
+                    continue;
+                }
+
+                EnterSpinLock(victim->spinlock);
+                if(victim->tail > victim->head) {
+                    Job* job = victim->jobs[victim->head % JobQueueCapacity_];
+                    ++victim->head;
+                    LeaveSpinLock(victim->spinlock);
+                    return job;
+                }
+                LeaveSpinLock(victim->spinlock);
+            }
+        }
+
+        return nullptr;
+    }
+
+    //=============================================================================================================================
+    static void DecrementCounter(JobCounter* counter)
+    {
+        // -- Done under the lock so a waiter can not return and release the counter while it is still being touched here
+        EnterSpinLock(counter->spinlock);
+        int64 remaining = Atomic::Decrement64(&counter->count) - 1;
+        Job* released = nullptr;
+        if(remaining == 0) {
+            released = counter->waiters;
+            counter->waiters = nullptr;
+        }
+        LeaveSpinLock(counter->spinlock);
+
+        while(released != nullptr) {
+            Job* next = released->next;
+            PushJob(released);
+            released = next;
+        }
+    }
+
+    //=============================================================================================================================
+    static void ExecuteJob(Job* job)
+    {
+        if(job->function != nullptr) {
+            job->function(job->userData);
+        }
+        else {
+            // -- Keep the lower half and queue the upper half until the range is down to the grain size
+            while(job->end - job->start > job->grainSize) {
+                uint middle = job->start + (job->end - job->start) / 2;
+
+                Job* split = AllocateJob();
+                split->rangeFunction = job->rangeFunction;
+                split->userData = job->userData;
+                split->start = middle;
+                split->end = job->end;
+                split->grainSize = job->grainSize;
+                split->counter = job->counter;
+                Atomic::Increment64(&job->counter->count);
+                PushJob(split);
+
+                job->end = middle;
+            }
+
+            job->rangeFunction(job->userData, job->start, job->end);
+        }
+
+        JobCounter* counter = job->counter;
+        FreeJob(job);
+
+        if(counter != nullptr) {
+            DecrementCounter(counter);
+        }
+    }
+
+    //=============================================================================================================================
+    static void JobWorkerThread(void* userData)
+    {
+        Unused_(userData);
+
+        jobThreadIndex = (uint32)Atomic::Increment64(&jobSystem->nextThreadIndex);
+        if(jobSystem->nodeCount > 1) {
+            PinThreadToNumaNode(jobSystem->nodeIds[jobSystem->threadNodes[jobThreadIndex]]);
+        }
+
+        while(true) {
+            WaitForSemaphore(jobSystem->semaphore, InfiniteWait_);
+            if(jobSystem->shutdown != 0) {
+                break;
+            }
+
+            // -- Another thread may have taken the job this wake up was for
+            Job* job = FindJob(jobThreadIndex);
+            if(job != nullptr) {
+                ExecuteJob(job);
+            }
+        }
+    }
+
+    //=============================================================================================================================
+    static void AssignThreadNodes(JobSystemData* system)
+    {
+        // -- Only nodes with processors we may run on are used. Memory only nodes and ones outside the affinity mask are skipped.
+        uint32 nodeProcessors[MaxNumaNodeCount_];
+        uint32 totalProcessors = 0;
+
+        system->nodeCount = 0;
+        for(uint32 node = 0, count = NumaNodeCount(); node < count; ++node) {
+            uint32 processors = NumaNodeProcessorCount(node);
+            if(processors > 0) {
+                system->nodeIds[system->nodeCount] = node;
+                nodeProcessors[system->nodeCount] = processors;
+                totalProcessors += processors;
+                ++system->nodeCount;
+            }
+        }
+
+        if(system->nodeCount == 0) {
+            system->nodeCount = 1;
+            system->nodeIds[0] = 0;
+            nodeProcessors[0] = 1;
+            totalProcessors = 1;
+        }
+
+        // -- Threads go to nodes in proportion to how many processors each has. The initializing thread is never pinned but it
+        // -- is counted on the first node.
+        uint thread = 0;
+        uint32 processorsSoFar = 0;
+        for(uint node = 0; node < system->nodeCount; ++node) {
+            processorsSoFar += nodeProcessors[node];
+            uint end = (uint)(((uint64)system->threadCount * processorsSoFar) / totalProcessors);
+            for(; thread < end; ++thread) {
+                system->threadNodes[thread] = (uint32)node;
+            }
+        }
+
+        // -- Drop nodes that ended up without threads when there are fewer threads than nodes
+        uint usedCount = 0;
+        for(uint node = 0; node < system->nodeCount; ++node) {
+            bool used = false;
+            for(uint scan = 0; scan < system->threadCount; ++scan) {
+                if(system->threadNodes[scan] == node) {
+                    system->threadNodes[scan] = (uint32)usedCount;
+                    used = true;
+                }
+            }
+
+            if(used) {
+                system->nodeIds[usedCount] = system->nodeIds[node];
+                ++usedCount;
+            }
+        }
+        system->nodeCount = usedCount;
+    }
+
+    //=============================================================================================================================
+    void JobSystem_Initialize(uint threadCount)
+    {
+        Assert_(jobSystem == nullptr);
+
+        if(threadCount == 0) {
+            threadCount = HardwareThreadCount();
+        }
+        if(threadCount == 0) {
+            WriteDebugInfo_("Job system: no hardware threads reported. Running with a single thread.");
+            threadCount = 1;
+        }
+
+        jobSystem = New_(JobSystemData);
+        jobSystem->threadCount = threadCount;
+        jobSystem->threads = AllocArray_(ThreadHandle, threadCount);
+        jobSystem->queues = AllocArray_(JobQueue*, threadCount);
+        jobSystem->threadNodes = AllocArray_(uint32, threadCount);
+        AssignThreadNodes(jobSystem);
+
+        WriteDebugInfo_("Job system: %u threads over %u NUMA nodes", threadCount, jobSystem->nodeCount);
+
+        jobSystem->semaphore = CreateOSSemaphore(0, 0x7FFFFFFF);
+        jobSystem->nextThreadIndex = 1;
+        jobSystem->shutdown = 0;
+        jobSystem->freeJobs = nullptr;
+        CreateSpinLock(jobSystem->freeListSpinlock);
+
+        for(uint scan = 0; scan < threadCount; ++scan) {
+            uint32 node = jobSystem->nodeIds[jobSystem->threadNodes[scan]];
+            jobSystem->queues[scan] = (JobQueue*)AllocOnNode_(sizeof(JobQueue), node);
+            CreateSpinLock(jobSystem->queues[scan]->spinlock);
+            jobSystem->queues[scan]->head = 0;
+            jobSystem->queues[scan]->tail = 0;
+        }
+
+        jobThreadIndex = 0;
+        for(uint scan = 1; scan < threadCount; ++scan) {
+            jobSystem->threads[scan] = CreateThread(JobWorkerThread, nullptr);
+        }
+    }
+
+    //=============================================================================================================================
+    void JobSystem_Shutdown()
+    {
+        Assert_(jobSystem != nullptr);
+
+        jobSystem->shutdown = 1;
+        PostSemaphore(jobSystem->semaphore, jobSystem->threadCount);
+        for(uint scan = 1; scan < jobSystem->threadCount; ++scan) {
+            ShutdownThread(jobSystem->threads[scan]);
+        }
+
+        for(uint scan = 0, count = jobSystem->jobBlocks.Count(); scan < count; ++scan) {
+            Free_(jobSystem->jobBlocks[scan]);
+        }
+        jobSystem->jobBlocks.Shutdown();
+
+        CloseOSSemaphore(jobSystem->semaphore);
+        for(uint scan = 0; scan < jobSystem->threadCount; ++scan) {
+            FreeOnNode_(jobSystem->queues[scan]);
+        }
+        Free_(jobSystem->threads);
+        Free_(jobSystem->queues);
+        Free_(jobSystem->threadNodes);
+        Delete_(jobSystem);
+
+        jobSystem = nullptr;
+        jobThreadIndex = InvalidIndex32;
+    }
+
+    //=============================================================================================================================
+    uint JobSystem_ThreadCount()
+    {
+        return jobSystem != nullptr ? jobSystem->threadCount : 1;
+    }
+
+    //=============================================================================================================================
+    uint JobSystem_ThreadIndex()
+    {
+        return QueueIndex();
+    }
+
+    //=============================================================================================================================
+    uint JobSystem_NodeCount()
+    {
+        return jobSystem != nullptr ? jobSystem->nodeCount : 1;
+    }
+
+    //=============================================================================================================================
+    uint JobSystem_ThreadNode(uint threadIndex)
+    {
+        if(jobSystem == nullptr) {
+            return 0;
+        }
+
+        Assert_(threadIndex < jobSystem->threadCount);
+        return jobSystem->threadNodes[threadIndex];
+    }
+
+    //=============================================================================================================================
+    uint32 JobSystem_NodeId(uint node)
+    {
+        if(jobSystem == nullptr) {
+            return 0;
+        }
+
+        Assert_(node < jobSystem->nodeCount);
+        return jobSystem->nodeIds[node];
+    }
+
+    //=============================================================================================================================
+    void JobSystem_Submit(JobFunction function, void* userData, JobCounter* counter, JobCounter* dependency)
+    {
+        Assert_(jobSystem != nullptr);
+
+        Job* job = AllocateJob();
+        job->function = function;
+        job->userData = userData;
+        job->counter = counter;
+
+        if(counter != nullptr) {
+            Atomic::Increment64(&counter->count);
+        }
+
+        if(dependency != nullptr) {
+            EnterSpinLock(dependency->spinlock);
+            if(dependency->count > 0) {
+                job->next = dependency->waiters;
+                dependency->waiters = job;
+                LeaveSpinLock(dependency->spinlock);
+                return;
+            }
+            LeaveSpinLock(dependency->spinlock);
+        }
+
+        PushJob(job);
+    }
+
+    //=============================================================================================================================
+    void JobSystem_Wait(JobCounter* counter)
+    {
+        uint threadIndex = QueueIndex();
+
+        while(counter->count > 0) {
+            Job* job = FindJob(threadIndex);
+            if(job != nullptr) {
+                ExecuteJob(job);
+            }
+            else {
+                Sleep(0);
+            }
+        }
+
+        // -- The last decrement may still hold the lock
+        EnterSpinLock(counter->spinlock);
+        LeaveSpinLock(counter->spinlock);
+    }
+
+    //=============================================================================================================================
+    bool JobSystem_TryRunJob()
+    {
+        Assert_(jobSystem != nullptr);
+
+        Job* job = FindJob(QueueIndex());
+        if(job == nullptr) {
+            return false;
+        }
+
+        ExecuteJob(job);
+        return true;
+    }
+
+    //=============================================================================================================================
+    void JobSystem_ParallelFor(uint count, uint grainSize, ParallelForFunction function, void* userData)
+    {
+        if(count == 0) {
+            return;
+        }
+
+        if(jobSystem == nullptr) {
+            function(userData, 0, count);
+            return;
+        }
+
+        JobCounter counter;
+        counter.count = 1;
+
+        Job* job = AllocateJob();
+        job->rangeFunction = function;
+        job->userData = userData;
+        job->start = 0;
+        job->end = count;
+        job->grainSize = Max<uint>(grainSize, 1);
+        job->counter = &counter;
+
+        // -- The calling thread starts splitting right away and then helps with whatever is left
+        ExecuteJob(job);
+        JobSystem_Wait(&counter);
+    }
+}
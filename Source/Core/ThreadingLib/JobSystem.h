@@ -0,0 +1,65 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/OSThreading.h"
+#include "SystemLib/BasicTypes.h"
+
+namespace Selas
+{
+    struct Job;
+
+    typedef void(*JobFunction)(void* userData);
+    typedef void(*ParallelForFunction)(void* userData, uint start, uint end);
+
+    //=============================================================================================================================
+    // -- Number of unfinished jobs in a group. Jobs can be held until a counter reaches zero and threads waiting on one run other
+    // -- jobs in the meantime.
+    //=============================================================================================================================
+    struct JobCounter
+    {
+        JobCounter()
+            : count(0)
+            , waiters(nullptr)
+        {
+            CreateSpinLock(spinlock);
+        }
+
+        volatile int64 count;
+        Job*           waiters;
+        uint8          spinlock[CacheLineSize_];
+    };
+
+    // -- Each thread owns a queue it pushes to and pops from at one end while idle threads steal from the other end. A thread
+    // -- count of zero uses every hardware thread the process may run on. The calling thread becomes thread zero and only runs
+    // -- jobs while it waits.
+    void JobSystem_Initialize(uint threadCount = 0);
+    void JobSystem_Shutdown();
+
+    // -- Thread count includes the thread that initialized the system. Indices are only meaningful on those threads and are
+    // -- meant for picking per thread state.
+    uint JobSystem_ThreadCount();
+    uint JobSystem_ThreadIndex();
+
+    // -- With more than one NUMA node in use each worker is pinned to one and steals from threads on its own node first. Nodes
+    // -- here are numbered densely over the nodes in use; JobSystem_NodeId gives the OS number for AllocOnNode_.
+    uint   JobSystem_NodeCount();
+    uint   JobSystem_ThreadNode(uint threadIndex);
+    uint32 JobSystem_NodeId(uint node);
+
+    // -- counter is incremented now and decremented once the job finishes. When dependency is set the job is held until that
+    // -- counter reaches zero.
+    void JobSystem_Submit(JobFunction function, void* userData, JobCounter* counter, JobCounter* dependency = nullptr);
+
+    // -- Runs queued jobs until the counter reaches zero
+    void JobSystem_Wait(JobCounter* counter);
+
+    // -- Runs one queued job on the calling thread if there is one. For loops that poll for results instead of waiting.
+    bool JobSystem_TryRunJob();
+
+    // -- Calls function over [0, count) in ranges no larger than grainSize and returns once all are done. Ranges are split in
+    // -- halves so most of the work is taken by stealing large pieces. Runs serially when the system is not initialized.
+    void JobSystem_ParallelFor(uint count, uint grainSize, ParallelForFunction function, void* userData);
+}
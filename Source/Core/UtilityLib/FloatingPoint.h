@@ -7,6 +7,13 @@
 #include "SystemLib/BasicTypes.h"
 #include "SystemLib/Memory.h"
 
+#if defined(__F16C__)
+    #define EnableF16C_ 1
+    #include <immintrin.h>
+#else
+    #define EnableF16C_ 0
+#endif
+
 namespace Selas
 {
     //=============================================================================================================================
@@ -87,4 +94,75 @@ namespace Selas
 
         return x;
     }
-}
\ No newline at end of file
+
+    //=============================================================================================================================
+    inline uint16 FloatToHalf(float value)
+    {
+        #if EnableF16C_
+            return (uint16)_cvtss_sh(value, 0);
+        #else
+            uint32 bits = FloatToBits(value);
+            uint32 sign = (bits >> 16) & 0x8000;
+            uint32 floatExponent = (bits >> 23) & 0xFF;
+            uint32 mantissa = bits & 0x007FFFFF;
+
+            // -- Infinity stays infinity and NaN stays NaN
+            if(floatExponent == 0xFF) {
+                return (uint16)(sign | 0x7C00 | (mantissa != 0 ? 0x0200 : 0));
+            }
+
+            int32 exponent = (int32)floatExponent - 127 + 15;
+            if(exponent >= 0x1F) {
+                return (uint16)(sign | 0x7C00);
+            }
+
+            if(exponent <= 0) {
+                // -- Too small for a half denormal
+                if(exponent < -10) {
+                    return (uint16)sign;
+                }
+
+                mantissa |= 0x00800000;
+                uint32 shift = (uint32)(14 - exponent);
+                uint32 half = mantissa >> shift;
+                uint32 remainder = mantissa & ((1u << shift) - 1);
+                uint32 halfway = 1u << (shift - 1);
+                if(remainder > halfway || (remainder == halfway && (half & 1))) {
+                    ++half;
+                }
+                return (uint16)(sign | half);
+            }
+
+            // -- Round to nearest even. A carry out of the mantissa correctly bumps the exponent, up to infinity.
+            uint32 half = ((uint32)exponent << 10) | (mantissa >> 13);
+            uint32 remainder = mantissa & 0x1FFF;
+            if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+                ++half;
+            }
+            return (uint16)(sign | half);
+        #endif
+    }
+
+    //=============================================================================================================================
+    inline float HalfToFloat(uint16 half)
+    {
+        #if EnableF16C_
+            return _cvtsh_ss(half);
+        #else
+            uint32 sign = (uint32)(half & 0x8000) << 16;
+            uint32 exponent = (half >> 10) & 0x1F;
+            uint32 mantissa = half & 0x03FF;
+
+            if(exponent == 0) {
+                // -- Zero and denormals
+                float magnitude = (float)mantissa * (1.0f / 16777216.0f);
+                return sign ? -magnitude : magnitude;
+            }
+            if(exponent == 0x1F) {
+                return BitsToFloat(sign | 0x7F800000 | (mantissa << 13));
+            }
+
+            return BitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+        #endif
+    }
+}
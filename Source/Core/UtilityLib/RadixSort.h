@@ -0,0 +1,68 @@
+#pragma once
+
+//=================================================================================================================================
+// Joe Schutte
+//=================================================================================================================================
+
+#include "SystemLib/BasicTypes.h"
+#include "SystemLib/Memory.h"
+
+namespace Selas
+{
+    //=============================================================================================================================
+    // -- Stable least significant digit radix sort of 32 bit keys, eight bits per pass. data moves along with its key and both
+    // -- scratch arrays must hold count entries. Passes where every key shares the same digit are skipped.
+    template <typename DataType_>
+    void RadixSortMatchingArrays(uint32* keys, DataType_* data, uint32* scratchKeys, DataType_* scratchData, uint count)
+    {
+        if(count < 2) {
+            return;
+        }
+
+        uint32* srcKeys = keys;
+        DataType_* srcData = data;
+        uint32* dstKeys = scratchKeys;
+        DataType_* dstData = scratchData;
+
+        for(uint32 shift = 0; shift < 32; shift += 8) {
+            uint32 offsets[256];
+            Memory::Zero(offsets, sizeof(offsets));
+
+            for(uint scan = 0; scan < count; ++scan) {
+                ++offsets[(srcKeys[scan] >> shift) & 0xFF];
+            }
+
+            if(offsets[(srcKeys[0] >> shift) & 0xFF] == count) {
+                continue;
+            }
+
+            uint32 total = 0;
+            for(uint scan = 0; scan < 256; ++scan) {
+                uint32 digitCount = offsets[scan];
+                offsets[scan] = total;
+                total += digitCount;
+            }
+
+            for(uint scan = 0; scan < count; ++scan) {
+                uint32 destination = offsets[(srcKeys[scan] >> shift) & 0xFF]++;
+                dstKeys[destination] = srcKeys[scan];
+                dstData[destination] = srcData[scan];
+            }
+
+            uint32* tempKeys = srcKeys;
+            srcKeys = dstKeys;
+            dstKeys = tempKeys;
+
+            DataType_* tempData = srcData;
+            srcData = dstData;
+            dstData = tempData;
+        }
+
+        if(srcKeys != keys) {
+            Memory::Copy(keys, srcKeys, count * sizeof(uint32));
+            for(uint scan = 0; scan < count; ++scan) {
+                data[scan] = srcData[scan];
+            }
+        }
+    }
+}